@@ -0,0 +1,296 @@
+#ifndef STORAGE_KVDB_DB_BLOCK_H_
+#define STORAGE_KVDB_DB_BLOCK_H_
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include "db/format.h"
+#include "db/iterator.h"
+#include "util/coding.h"
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 只读的数据块/索引块，格式见BlockBuilder
+    class Block
+    {
+    public:
+        explicit Block(const BlockContents &contents)
+            : data_(contents.data.data()), size_(contents.data.size()), owned_(contents.heap_allocated)
+        {
+            if (size_ < sizeof(uint32_t))
+            {
+                size_ = 0; // 标记为错误
+            }
+            else
+            {
+                size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
+                if (NumRestarts() > max_restarts_allowed)
+                    size_ = 0; // 块太小，装不下这么多restart point
+                else
+                    restart_offset_ = static_cast<uint32_t>(size_ - (1 + NumRestarts()) * sizeof(uint32_t));
+            }
+        }
+
+        Block(const Block &) = delete;
+        Block &operator=(const Block &) = delete;
+
+        ~Block()
+        {
+            if (owned_)
+                delete[] data_;
+        }
+
+        size_t size() const { return size_; }
+
+        // 迭代器存在期间Block不能被释放
+        SliceIterator *NewIterator() const;
+
+    private:
+        class Iter;
+
+        uint32_t NumRestarts() const
+        {
+            assert(size_ >= sizeof(uint32_t));
+            return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+        }
+
+        const char *data_;
+        size_t size_;
+        uint32_t restart_offset_; // restart数组在data_中的偏移
+        bool owned_;
+    };
+
+    // 解析p开始的条目头部，出错时返回nullptr
+    inline const char *DecodeEntry(const char *p, const char *limit, uint32_t *shared, uint32_t *non_shared,
+                                   uint32_t *value_length)
+    {
+        if (limit - p < 3)
+            return nullptr;
+        *shared = reinterpret_cast<const uint8_t *>(p)[0];
+        *non_shared = reinterpret_cast<const uint8_t *>(p)[1];
+        *value_length = reinterpret_cast<const uint8_t *>(p)[2];
+        if ((*shared | *non_shared | *value_length) < 128)
+        {
+            // 三个值都只有一个字节，这是最常见的情况
+            p += 3;
+        }
+        else
+        {
+            if ((p = GetVarint32Ptr(p, limit, shared)) == nullptr)
+                return nullptr;
+            if ((p = GetVarint32Ptr(p, limit, non_shared)) == nullptr)
+                return nullptr;
+            if ((p = GetVarint32Ptr(p, limit, value_length)) == nullptr)
+                return nullptr;
+        }
+
+        if (static_cast<uint32_t>(limit - p) < (*non_shared + *value_length))
+            return nullptr;
+        return p;
+    }
+
+    class Block::Iter : public SliceIterator
+    {
+    public:
+        Iter(const char *data, uint32_t restarts, uint32_t num_restarts)
+            : data_(data), restarts_(restarts), num_restarts_(num_restarts), current_(restarts),
+              restart_index_(num_restarts)
+        {
+            assert(num_restarts_ > 0);
+        }
+
+        bool Valid() const override { return current_ < restarts_; }
+        Status status() const override { return status_; }
+
+        Slice key() const override
+        {
+            assert(Valid());
+            return key_;
+        }
+
+        Slice value() const override
+        {
+            assert(Valid());
+            return value_;
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+            ParseNextKey();
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+
+            // 退回到current_之前的restart point，再向后扫描
+            const uint32_t original = current_;
+            while (GetRestartPoint(restart_index_) >= original)
+            {
+                if (restart_index_ == 0)
+                {
+                    // 已经是第一个条目
+                    current_ = restarts_;
+                    restart_index_ = num_restarts_;
+                    return;
+                }
+                restart_index_--;
+            }
+
+            SeekToRestartPoint(restart_index_);
+            do
+            {
+            } while (ParseNextKey() && NextEntryOffset() < original);
+        }
+
+        void Seek(const Slice &target) override
+        {
+            // 在restart数组上二分，找到最后一个key < target的restart point
+            uint32_t left = 0;
+            uint32_t right = num_restarts_ - 1;
+            int current_key_compare = 0;
+
+            if (Valid())
+            {
+                // 已经定位在某个key上时用它缩小搜索范围。相等时当前位置之前可能还有
+                // 同一个key的其他版本，和大于时一样重新查找
+                current_key_compare = Slice(key_).compare(target);
+                if (current_key_compare < 0)
+                    left = restart_index_;
+                else
+                    right = restart_index_;
+            }
+
+            while (left < right)
+            {
+                uint32_t mid = (left + right + 1) / 2;
+                uint32_t region_offset = GetRestartPoint(mid);
+                uint32_t shared, non_shared, value_length;
+                const char *key_ptr = DecodeEntry(data_ + region_offset, data_ + restarts_, &shared, &non_shared,
+                                                  &value_length);
+                if (key_ptr == nullptr || (shared != 0))
+                {
+                    CorruptionError();
+                    return;
+                }
+                Slice mid_key(key_ptr, non_shared);
+                if (mid_key.compare(target) < 0)
+                    left = mid;
+                else
+                    right = mid - 1;
+            }
+
+            // 当前位置就在left对应的区间内时不需要重新定位
+            assert(current_key_compare == 0 || Valid());
+            bool skip_seek = left == restart_index_ && current_key_compare < 0;
+            if (!skip_seek)
+                SeekToRestartPoint(left);
+
+            // 在区间内线性查找第一个 >= target 的key
+            while (true)
+            {
+                if (!ParseNextKey())
+                    return;
+                if (Slice(key_).compare(target) >= 0)
+                    return;
+            }
+        }
+
+        void SeekToFirst() override
+        {
+            SeekToRestartPoint(0);
+            ParseNextKey();
+        }
+
+        void SeekToLast() override
+        {
+            SeekToRestartPoint(num_restarts_ - 1);
+            while (ParseNextKey() && NextEntryOffset() < restarts_)
+            {
+            }
+        }
+
+    private:
+        uint32_t NextEntryOffset() const
+        {
+            return static_cast<uint32_t>((value_.data() + value_.size()) - data_);
+        }
+
+        uint32_t GetRestartPoint(uint32_t index) const
+        {
+            assert(index < num_restarts_);
+            return DecodeFixed32(data_ + restarts_ + index * sizeof(uint32_t));
+        }
+
+        void SeekToRestartPoint(uint32_t index)
+        {
+            key_.clear();
+            restart_index_ = index;
+            // ParseNextKey从value_的末尾开始解析
+            uint32_t offset = GetRestartPoint(index);
+            value_ = Slice(data_ + offset, 0);
+        }
+
+        void CorruptionError()
+        {
+            current_ = restarts_;
+            restart_index_ = num_restarts_;
+            status_ = Status::Corruption("bad entry in block");
+            key_.clear();
+            value_.clear();
+        }
+
+        bool ParseNextKey()
+        {
+            current_ = NextEntryOffset();
+            const char *p = data_ + current_;
+            const char *limit = data_ + restarts_;
+            if (p >= limit)
+            {
+                // 没有更多条目
+                current_ = restarts_;
+                restart_index_ = num_restarts_;
+                return false;
+            }
+
+            uint32_t shared, non_shared, value_length;
+            p = DecodeEntry(p, limit, &shared, &non_shared, &value_length);
+            if (p == nullptr || key_.size() < shared)
+            {
+                CorruptionError();
+                return false;
+            }
+            key_.resize(shared);
+            key_.append(p, non_shared);
+            value_ = Slice(p + non_shared, value_length);
+            while (restart_index_ + 1 < num_restarts_ && GetRestartPoint(restart_index_ + 1) < current_)
+                ++restart_index_;
+            return true;
+        }
+
+        const char *const data_;
+        uint32_t const restarts_;     // restart数组的偏移
+        uint32_t const num_restarts_; // restart point的个数
+
+        // current_是当前条目在data_中的偏移，>= restarts_表示无效
+        uint32_t current_;
+        uint32_t restart_index_; // current_所在区间的restart point下标
+        std::string key_;
+        Slice value_;
+        Status status_;
+    };
+
+    inline SliceIterator *Block::NewIterator() const
+    {
+        if (size_ < sizeof(uint32_t))
+            return new EmptySliceIterator(Status::Corruption("bad block contents"));
+        const uint32_t num_restarts = NumRestarts();
+        if (num_restarts == 0)
+            return new EmptySliceIterator(Status::OK());
+        return new Iter(data_, restart_offset_, num_restarts);
+    }
+}
+
+#endif
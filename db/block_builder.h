@@ -0,0 +1,109 @@
+#ifndef STORAGE_KVDB_DB_BLOCK_BUILDER_H_
+#define STORAGE_KVDB_DB_BLOCK_BUILDER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "db/options.h"
+#include "util/coding.h"
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 块内的key按字节序递增，每个key只保存与前一个key不同的后缀：
+    //   shared_bytes: varint32 | unshared_bytes: varint32 | value_length: varint32
+    //   key_delta: char[unshared_bytes] | value: char[value_length]
+    // 每隔block_restart_interval个key保存一次完整的key(restart point)，
+    // 块末尾是所有restart point的偏移(fixed32数组)和个数(fixed32)，读取时在其上二分查找
+    class BlockBuilder
+    {
+    public:
+        explicit BlockBuilder(const Options *options) : options_(options), restarts_(), counter_(0), finished_(false)
+        {
+            assert(options->block_restart_interval >= 1);
+            restarts_.push_back(0);
+        }
+
+        BlockBuilder(const BlockBuilder &) = delete;
+        BlockBuilder &operator=(const BlockBuilder &) = delete;
+
+        // 清空内容，像新建的一样
+        void Reset()
+        {
+            buffer_.clear();
+            restarts_.clear();
+            restarts_.push_back(0);
+            counter_ = 0;
+            finished_ = false;
+            last_key_.clear();
+        }
+
+        // REQUIRES: 上一次Reset之后没有调用过Finish，key不小于之前加入的所有key。
+        // 相等的key是同一个key的多个版本，按加入的顺序存放
+        void Add(const Slice &key, const Slice &value);
+
+        // 写入restart数组，返回的Slice在Reset之前有效
+        Slice Finish();
+
+        // 当前块编码后的大小
+        size_t CurrentSizeEstimate() const
+        {
+            return buffer_.size() + restarts_.size() * sizeof(uint32_t) + sizeof(uint32_t);
+        }
+
+        bool empty() const { return buffer_.empty(); }
+
+    private:
+        const Options *options_;
+        std::string buffer_;
+        std::vector<uint32_t> restarts_;
+        int counter_; // 上一个restart point之后加入的条目数
+        bool finished_;
+        std::string last_key_;
+    };
+
+    inline void BlockBuilder::Add(const Slice &key, const Slice &value)
+    {
+        Slice last_key_piece(last_key_);
+        assert(!finished_);
+        assert(counter_ <= options_->block_restart_interval);
+        assert(buffer_.empty() || key.compare(last_key_piece) >= 0);
+        size_t shared = 0;
+        if (counter_ < options_->block_restart_interval)
+        {
+            const size_t min_length = std::min(last_key_piece.size(), key.size());
+            while ((shared < min_length) && (last_key_piece[shared] == key[shared]))
+                shared++;
+        }
+        else
+        {
+            restarts_.push_back(static_cast<uint32_t>(buffer_.size()));
+            counter_ = 0;
+        }
+        const size_t non_shared = key.size() - shared;
+
+        PutVarint32(&buffer_, static_cast<uint32_t>(shared));
+        PutVarint32(&buffer_, static_cast<uint32_t>(non_shared));
+        PutVarint32(&buffer_, static_cast<uint32_t>(value.size()));
+        buffer_.append(key.data() + shared, non_shared);
+        buffer_.append(value.data(), value.size());
+
+        last_key_.resize(shared);
+        last_key_.append(key.data() + shared, non_shared);
+        assert(Slice(last_key_) == key);
+        counter_++;
+    }
+
+    inline Slice BlockBuilder::Finish()
+    {
+        for (size_t i = 0; i < restarts_.size(); i++)
+            PutFixed32(&buffer_, restarts_[i]);
+        PutFixed32(&buffer_, static_cast<uint32_t>(restarts_.size()));
+        finished_ = true;
+        return Slice(buffer_);
+    }
+}
+
+#endif
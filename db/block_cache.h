@@ -0,0 +1,124 @@
+#ifndef STORAGE_KVDB_DB_BLOCK_CACHE_H_
+#define STORAGE_KVDB_DB_BLOCK_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "db/block.h"
+#include "db/format.h"
+#include "util/LRUCache.h"
+#include "util/cache_policy.h"
+#include "util/hash.h"
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 块缓存的key：打开的有序表文件在缓存中的编号和块在文件中的偏移
+    struct BlockCacheKey
+    {
+        uint64_t id;
+        uint64_t offset;
+
+        bool operator==(const BlockCacheKey &other) const { return id == other.id && offset == other.offset; }
+    };
+}
+
+namespace std
+{
+    template <>
+    struct hash<kvdb::BlockCacheKey>
+    {
+        size_t operator()(const kvdb::BlockCacheKey &key) const noexcept
+        {
+            return static_cast<size_t>(kvdb::Mix64(key.id) ^ key.offset);
+        }
+    };
+}
+
+namespace kvdb
+{
+    // 从文件读入并校验过的一个块。数据块和索引块通过block()访问，过滤器块直接使用contents()
+    class LoadedBlock
+    {
+    public:
+        explicit LoadedBlock(const BlockContents &contents)
+            : contents_(contents.data), heap_allocated_(contents.heap_allocated), block_(contents) {}
+
+        LoadedBlock(const LoadedBlock &) = delete;
+        LoadedBlock &operator=(const LoadedBlock &) = delete;
+
+        const Block &block() const { return block_; }
+        const Slice &contents() const { return contents_; }
+
+        // 内容在自己分配的内存中。映射到内存的文件的块指向映射，文件关闭后失效
+        bool heap_allocated() const { return heap_allocated_; }
+
+    private:
+        const Slice contents_;
+        const bool heap_allocated_;
+        // 拥有contents_的内存
+        const Block block_;
+    };
+
+    // 有序表文件的块缓存，容量按块的大小计算，多个Table可以共用一个。
+    // 条目是共享的LoadedBlock，读者拿到之后即使条目被淘汰也可以继续使用。
+    // 使用PriorityLRUPolicy，以高优先级放入的索引块和过滤器块不会被大量数据块挤出去
+    class BlockCache
+    {
+    public:
+        typedef std::shared_ptr<const LoadedBlock> Value;
+
+        // 没有指定块缓存的Table共用的默认缓存的容量
+        static const size_t kDefaultCapacity = 8 * 1024 * 1024;
+
+        explicit BlockCache(size_t capacity, int num_shard_bits = -1)
+            : cache_(capacity, num_shard_bits), next_id_(1) {}
+
+        BlockCache(const BlockCache &) = delete;
+        BlockCache &operator=(const BlockCache &) = delete;
+
+        // 进程内所有没有指定块缓存的Table共用的缓存
+        static const std::shared_ptr<BlockCache> &Default()
+        {
+            static const std::shared_ptr<BlockCache> cache = std::make_shared<BlockCache>(kDefaultCapacity);
+            return cache;
+        }
+
+        // 每个打开的有序表文件取一个不重复的编号，多个Table的文件编号相同也不会冲突。
+        // 文件关闭后它的块不会再被命中，最终被淘汰
+        uint64_t NewId() { return next_id_.fetch_add(1, std::memory_order_relaxed); }
+
+        // 不存在时返回nullptr
+        Value Lookup(const BlockCacheKey &key)
+        {
+            cache::PinnedHandle<BlockCacheKey, Value> h = cache_.Get(key);
+            return h == nullptr ? nullptr : *h;
+        }
+
+        // 替换同key的旧条目。block必须是heap_allocated的
+        void Insert(const BlockCacheKey &key, const Value &block, bool high_priority)
+        {
+            assert(block->heap_allocated());
+            const size_t charge = sizeof(Node) + sizeof(LoadedBlock) + block->contents().size();
+            Node *node = new Node(key, block, KType::kTypeValue, charge);
+            node->high_priority = high_priority;
+            cache_.Insert(node);
+        }
+
+        // 缓存中所有块的charge之和
+        size_t GetUsage() { return cache_.GetUsage(); }
+
+        cache::CacheStats GetStats() { return cache_.GetStats(); }
+        void ResetStats() { cache_.ResetStats(); }
+
+    private:
+        typedef cache::LRUHandle<BlockCacheKey, Value> Node;
+
+        cache::ShardedLRUCache<BlockCacheKey, Value, cache::PriorityLRUPolicy<BlockCacheKey, Value>> cache_;
+        std::atomic<uint64_t> next_id_;
+    };
+}
+
+#endif
@@ -0,0 +1,928 @@
+// 性能测试，用法：
+//   make bench
+//   ./build/db_bench --benchmarks=fillseq,readrandom,ycsba --num=1000000 --threads=4
+//
+// 可用的测试(--benchmarks，逗号分隔，按顺序执行)：
+//   fillseq       按key顺序写入num个key，重新创建数据库
+//   fillrandom    按随机顺序写入num个key，重新创建数据库
+//   fillbatch     同fillrandom，每batch_size个key用一个WriteBatch写入
+//   overwrite     按随机顺序覆盖写num个key
+//   readrandom    随机读取reads次
+//   multireadrandom 同readrandom，每batch_size个key用一次MultiGet读取
+//   readmissing   随机读取不存在的key
+//   readhot       只读取前1%的key
+//   deleterandom  随机删除num个key
+//   ycsba..ycsbf  YCSB的A-F负载，需要先用fillseq写入数据：
+//                 A 50%读 50%更新(zipfian)    B 95%读 5%更新(zipfian)
+//                 C 100%读(zipfian)           D 95%读 5%插入(latest)
+//                 E 95%短范围扫描 5%插入      F 50%读 50%读-改-写(zipfian)
+//   scanmix       zipfian读，其中5%的操作从随机位置开始用Get顺序读scan_length个key，
+//                 模拟在线读取与回填任务混合时扫描对缓存的冲击
+//
+// 多线程时每个线程各自执行完整的操作数，结果为所有线程的总和。
+// 每个测试输出 micros/op、ops/sec、MB/s、单次操作延迟的分位数和缓存命中率。
+// --cache_policy=lru|clock|tinylfu 选择缓存的淘汰策略
+// --compression=none|snappy|lz4|zstd 选择数据块的压缩算法，--compression_ratio控制生成的value的可压缩程度
+// --statistics=1 每个测试结束后输出Table的计数和延迟分布，--statistics_file=path同时以Prometheus格式写入文件
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "db/options.h"
+#include "db/table.h"
+#include "util/cache_policy.h"
+#include "util/env.h"
+#include "util/random.h"
+#include "util/zipfian.h"
+
+namespace
+{
+    const char *FLAGS_benchmarks =
+        "fillseq,"
+        "fillrandom,"
+        "fillbatch,"
+        "overwrite,"
+        "readrandom,"
+        "multireadrandom,"
+        "readmissing,"
+        "readhot,"
+        "deleterandom,"
+        "fillseq,"
+        "ycsba,"
+        "ycsbb,"
+        "ycsbc,"
+        "ycsbd,"
+        "ycsbe,"
+        "ycsbf,";
+
+    // key的个数
+    int FLAGS_num = 1000000;
+    // 读操作的次数，小于0时等于num
+    int FLAGS_reads = -1;
+    int FLAGS_threads = 1;
+    // key按十进制补零到这个长度
+    int FLAGS_key_size = 16;
+    int FLAGS_value_size = 100;
+    // fillbatch每个WriteBatch、multireadrandom每次MultiGet中的key数
+    int FLAGS_batch_size = 100;
+    // ycsbe每次扫描的最大key数
+    int FLAGS_scan_length = 100;
+    // zipfian分布的偏斜程度
+    double FLAGS_zipfian_theta = kvdb::ZipfianGenerator::kDefaultTheta;
+
+    // 以下小于0时使用Options的默认值
+    // 缓存的字节数
+    int64_t FLAGS_cache_capacity = -1;
+    int FLAGS_cache_shard_bits = -1;
+    int FLAGS_write_buffer_size = -1;
+    int FLAGS_bloom_bits = -1;
+    bool FLAGS_sync = false;
+    bool FLAGS_concurrent_memtable_write = false;
+    // 覆盖写放得下时原地修改memtable
+    bool FLAGS_inplace_update = false;
+    // 有序表文件映射到内存读取
+    bool FLAGS_mmap_read = false;
+    // 块缓存的字节数，0表示不使用块缓存，小于0时使用进程内共享的默认块缓存
+    int64_t FLAGS_block_cache_size = -1;
+    // 索引块和过滤器块放入块缓存
+    bool FLAGS_cache_index_and_filter_blocks = false;
+    // 数据块的压缩算法：none、snappy、lz4或zstd
+    kvdb::CompressionType FLAGS_compression = kvdb::kNoCompression;
+    // 生成的value压缩后约为原来的这个比例
+    double FLAGS_compression_ratio = 0.5;
+    // 记录Table内部的计数和延迟分布，每个测试结束后输出并清零
+    bool FLAGS_statistics = false;
+    // 不为nullptr时每个测试结束后把统计以Prometheus格式写入这个文件
+    const char *FLAGS_statistics_file = nullptr;
+    // 为true时fillseq/fillrandom不删除已有的数据
+    bool FLAGS_use_existing_db = false;
+    const char *FLAGS_db = nullptr;
+
+    // 缓存的淘汰策略：lru、clock或tinylfu
+    std::string FLAGS_cache_policy = "lru";
+
+    double NowNanos()
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 单次操作延迟的直方图，桶的边界按1.1倍增长，从10ns到几百秒
+    class Histogram
+    {
+    public:
+        Histogram() { Clear(); }
+
+        void Clear()
+        {
+            min_ = BucketLimit(kNumBuckets - 1);
+            max_ = 0;
+            num_ = 0;
+            sum_ = 0;
+            std::fill(buckets_, buckets_ + kNumBuckets, 0);
+        }
+
+        void Add(double nanos)
+        {
+            buckets_[BucketFor(nanos)]++;
+            min_ = std::min(min_, nanos);
+            max_ = std::max(max_, nanos);
+            num_++;
+            sum_ += nanos;
+        }
+
+        void Merge(const Histogram &other)
+        {
+            min_ = std::min(min_, other.min_);
+            max_ = std::max(max_, other.max_);
+            num_ += other.num_;
+            sum_ += other.sum_;
+            for (int b = 0; b < kNumBuckets; b++)
+                buckets_[b] += other.buckets_[b];
+        }
+
+        // p在[0, 100]之间，在桶内线性插值
+        double Percentile(double p) const
+        {
+            const double threshold = num_ * (p / 100.0);
+            double sum = 0;
+            for (int b = 0; b < kNumBuckets; b++)
+            {
+                sum += buckets_[b];
+                if (sum >= threshold && buckets_[b] > 0)
+                {
+                    const double left = b == 0 ? 0 : BucketLimit(b - 1);
+                    const double right = BucketLimit(b);
+                    const double pos = (threshold - (sum - buckets_[b])) / buckets_[b];
+                    return std::max(min_, std::min(max_, left + (right - left) * pos));
+                }
+            }
+            return max_;
+        }
+
+        std::string ToString() const
+        {
+            if (num_ == 0)
+                return "";
+            char buf[256];
+            std::snprintf(buf, sizeof(buf),
+                          "latency (micros): avg %.3f  p50 %.3f  p75 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+                          sum_ / num_ / 1e3, Percentile(50) / 1e3, Percentile(75) / 1e3, Percentile(99) / 1e3,
+                          Percentile(99.9) / 1e3, max_ / 1e3);
+            return buf;
+        }
+
+    private:
+        static const int kNumBuckets = 250;
+
+        static double BucketLimit(int b) { return 10.0 * std::pow(1.1, b); }
+
+        static int BucketFor(double nanos)
+        {
+            if (nanos < 10.0)
+                return 0;
+            int b = static_cast<int>(std::log(nanos / 10.0) / std::log(1.1)) + 1;
+            return std::min(b, kNumBuckets - 1);
+        }
+
+        double min_;
+        double max_;
+        double num_;
+        double sum_;
+        double buckets_[kNumBuckets];
+    };
+
+    class Stats
+    {
+    public:
+        Stats() { Start(); }
+
+        void Start()
+        {
+            done_ = 0;
+            bytes_ = 0;
+            found_ = 0;
+            hist_.Clear();
+            start_ = NowNanos();
+            last_op_finish_ = start_;
+            finish_ = start_;
+        }
+
+        void Merge(const Stats &other)
+        {
+            hist_.Merge(other.hist_);
+            done_ += other.done_;
+            bytes_ += other.bytes_;
+            found_ += other.found_;
+            // 各线程同时开始，以最晚结束的为准
+            start_ = std::min(start_, other.start_);
+            finish_ = std::max(finish_, other.finish_);
+        }
+
+        void Stop() { finish_ = NowNanos(); }
+
+        void FinishedSingleOp()
+        {
+            const double now = NowNanos();
+            hist_.Add(now - last_op_finish_);
+            last_op_finish_ = now;
+            done_++;
+        }
+
+        // 一次完成n个操作(例如一个WriteBatch)，每个操作的延迟按平均值计
+        void FinishedOps(int n)
+        {
+            const double now = NowNanos();
+            for (int i = 0; i < n; i++)
+                hist_.Add((now - last_op_finish_) / n);
+            last_op_finish_ = now;
+            done_ += n;
+        }
+
+        void AddBytes(int64_t n) { bytes_ += n; }
+        void AddFound(int64_t n) { found_ += n; }
+
+        void Report(const std::string &name, bool report_found)
+        {
+            if (done_ < 1)
+                done_ = 1;
+            const double elapsed = (finish_ - start_) / 1e9;
+            std::string extra;
+            if (bytes_ > 0)
+            {
+                char rate[100];
+                std::snprintf(rate, sizeof(rate), "%6.1f MB/s", (bytes_ / 1048576.0) / elapsed);
+                extra = rate;
+            }
+            if (report_found)
+            {
+                char found[100];
+                std::snprintf(found, sizeof(found), " (%" PRId64 " of %" PRId64 " found)", found_, done_);
+                extra += found;
+            }
+
+            std::fprintf(stdout, "%-12s : %11.3f micros/op; %10.0f ops/sec; %s\n", name.c_str(),
+                         elapsed * 1e6 / done_, done_ / elapsed, extra.c_str());
+            std::fprintf(stdout, "%s", hist_.ToString().c_str());
+            std::fflush(stdout);
+        }
+
+    private:
+        double start_;
+        double finish_;
+        double last_op_finish_;
+        int64_t done_;
+        int64_t bytes_;
+        int64_t found_;
+        Histogram hist_;
+    };
+
+    // 所有线程共享的状态，用来同时开始
+    struct SharedState
+    {
+        std::mutex mu;
+        std::condition_variable cv;
+        int total;
+        int num_initialized = 0;
+        int num_done = 0;
+        bool start = false;
+        // ycsbd/ycsbe插入新key的下一个编号
+        std::atomic<uint64_t> insert_count{0};
+    };
+
+    // 生成value的数据，预先生成1MB，每次取其中一段。
+    // 每100字节中只有compression_ratio比例是随机的，其余重复这部分，压缩后约为原来的compression_ratio
+    class RandomGenerator
+    {
+    public:
+        RandomGenerator() : pos_(0)
+        {
+            kvdb::Random rnd(301);
+            const size_t random_len = std::max<size_t>(1, static_cast<size_t>(100 * FLAGS_compression_ratio));
+            std::string piece;
+            while (data_.size() < 1048576)
+            {
+                piece.resize(random_len);
+                for (char &c : piece)
+                    c = static_cast<char>(' ' + rnd.Uniform(95));
+                for (size_t i = 0; i < 100; i++)
+                    data_.push_back(piece[i % random_len]);
+            }
+        }
+
+        std::string Generate(size_t len)
+        {
+            if (pos_ + len > data_.size())
+                pos_ = 0;
+            pos_ += len;
+            return data_.substr(pos_ - len, len);
+        }
+
+    private:
+        std::string data_;
+        size_t pos_;
+    };
+
+    struct ThreadState
+    {
+        ThreadState(int index) : tid(index), rand(1000 + index) {}
+
+        int tid;
+        kvdb::Random rand;
+        RandomGenerator gen;
+        Stats stats;
+        SharedState *shared = nullptr;
+    };
+
+    std::string KeyString(uint64_t k)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%0*" PRIu64, FLAGS_key_size, k);
+        return buf;
+    }
+
+    template <typename BenchTable>
+    class Benchmark
+    {
+    public:
+        Benchmark()
+            : num_(FLAGS_num), reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
+              dbname_(FLAGS_db != nullptr ? FLAGS_db : "/tmp/kvdbbench"),
+              block_cache_(FLAGS_block_cache_size > 0 ? std::make_shared<kvdb::BlockCache>(FLAGS_block_cache_size)
+                                                      : nullptr),
+              statistics_(FLAGS_statistics || FLAGS_statistics_file != nullptr ? std::make_shared<kvdb::Statistics>()
+                                                                              : nullptr)
+        {
+            if (!FLAGS_use_existing_db)
+                DestroyDB();
+        }
+
+        void Run()
+        {
+            PrintHeader();
+            Open();
+
+            const char *benchmarks = FLAGS_benchmarks;
+            while (benchmarks != nullptr)
+            {
+                const char *sep = std::strchr(benchmarks, ',');
+                std::string name;
+                if (sep == nullptr)
+                {
+                    name = benchmarks;
+                    benchmarks = nullptr;
+                }
+                else
+                {
+                    name = std::string(benchmarks, sep - benchmarks);
+                    benchmarks = sep + 1;
+                }
+                if (name.empty())
+                    continue;
+
+                void (Benchmark::*method)(ThreadState *) = nullptr;
+                bool fresh_db = false;
+                bool report_found = false;
+                int num_threads = FLAGS_threads;
+                if (name == "fillseq")
+                {
+                    fresh_db = true;
+                    num_threads = 1;
+                    method = &Benchmark::WriteSeq;
+                }
+                else if (name == "fillrandom")
+                {
+                    fresh_db = true;
+                    method = &Benchmark::WriteRandom;
+                }
+                else if (name == "fillbatch")
+                {
+                    fresh_db = true;
+                    method = &Benchmark::WriteBatchRandom;
+                }
+                else if (name == "overwrite")
+                    method = &Benchmark::WriteRandom;
+                else if (name == "readrandom")
+                {
+                    report_found = true;
+                    method = &Benchmark::ReadRandom;
+                }
+                else if (name == "multireadrandom")
+                {
+                    report_found = true;
+                    method = &Benchmark::MultiReadRandom;
+                }
+                else if (name == "readmissing")
+                {
+                    report_found = true;
+                    method = &Benchmark::ReadMissing;
+                }
+                else if (name == "readhot")
+                {
+                    report_found = true;
+                    method = &Benchmark::ReadHot;
+                }
+                else if (name == "deleterandom")
+                    method = &Benchmark::DeleteRandom;
+                else if (name == "ycsba")
+                    method = &Benchmark::YCSBA;
+                else if (name == "ycsbb")
+                    method = &Benchmark::YCSBB;
+                else if (name == "ycsbc")
+                    method = &Benchmark::YCSBC;
+                else if (name == "ycsbd")
+                    method = &Benchmark::YCSBD;
+                else if (name == "ycsbe")
+                    method = &Benchmark::YCSBE;
+                else if (name == "ycsbf")
+                    method = &Benchmark::YCSBF;
+                else if (name == "scanmix")
+                    method = &Benchmark::ScanMix;
+                else
+                {
+                    std::fprintf(stderr, "unknown benchmark '%s'\n", name.c_str());
+                    continue;
+                }
+
+                if (fresh_db && !FLAGS_use_existing_db)
+                {
+                    table_.reset();
+                    DestroyDB();
+                    Open();
+                }
+                if (name.compare(0, 4, "ycsb") == 0)
+                    report_found = true;
+                RunBenchmark(num_threads, name, method, report_found);
+            }
+        }
+
+    private:
+        void PrintHeader()
+        {
+            std::fprintf(stdout, "Keys:       %d bytes each\n", FLAGS_key_size);
+            std::fprintf(stdout, "Values:     %d bytes each\n", FLAGS_value_size);
+            std::fprintf(stdout, "Entries:    %d\n", num_);
+            std::fprintf(stdout, "Threads:    %d\n", FLAGS_threads);
+            std::fprintf(stdout, "Cache:      %.1f MB, %s\n", MakeOptions().cache_capacity / 1048576.0,
+                         FLAGS_cache_policy.c_str());
+            std::fprintf(stdout, "Compression: %s\n", kvdb::CompressionTypeName(FLAGS_compression));
+            std::fprintf(stdout, "DB:         %s\n", dbname_.c_str());
+            std::fprintf(stdout, "------------------------------------------------\n");
+        }
+
+        kvdb::Options MakeOptions() const
+        {
+            kvdb::Options options;
+            if (FLAGS_cache_capacity >= 0)
+                options.cache_capacity = FLAGS_cache_capacity;
+            options.cache_shard_bits = FLAGS_cache_shard_bits;
+            if (FLAGS_write_buffer_size >= 0)
+                options.write_buffer_size = FLAGS_write_buffer_size;
+            if (FLAGS_bloom_bits >= 0)
+                options.bloom_bits_per_key = FLAGS_bloom_bits;
+            options.sync = FLAGS_sync;
+            options.allow_concurrent_memtable_write = FLAGS_concurrent_memtable_write;
+            options.inplace_update = FLAGS_inplace_update;
+            options.use_mmap_reads = FLAGS_mmap_read;
+            options.block_cache = block_cache_;
+            options.no_block_cache = FLAGS_block_cache_size == 0;
+            options.cache_index_and_filter_blocks = FLAGS_cache_index_and_filter_blocks;
+            options.compression = FLAGS_compression;
+            options.statistics = statistics_;
+            return options;
+        }
+
+        void Open()
+        {
+            try
+            {
+                table_.reset(new BenchTable(MakeOptions(), dbname_));
+            }
+            catch (const std::exception &e)
+            {
+                std::fprintf(stderr, "open error: %s\n", e.what());
+                std::exit(1);
+            }
+        }
+
+        void DestroyDB()
+        {
+            kvdb::Env *env = kvdb::Env::Default();
+            std::vector<std::string> children;
+            if (env->GetChildren(dbname_, &children).ok())
+            {
+                for (const std::string &child : children)
+                    env->RemoveFile(dbname_ + "/" + child);
+            }
+        }
+
+        static void ThreadBody(Benchmark *bm, ThreadState *thread,
+                               void (Benchmark::*method)(ThreadState *))
+        {
+            SharedState *shared = thread->shared;
+            {
+                std::unique_lock<std::mutex> lock(shared->mu);
+                shared->num_initialized++;
+                if (shared->num_initialized >= shared->total)
+                    shared->cv.notify_all();
+                while (!shared->start)
+                    shared->cv.wait(lock);
+            }
+
+            thread->stats.Start();
+            (bm->*method)(thread);
+            thread->stats.Stop();
+
+            std::lock_guard<std::mutex> lock(shared->mu);
+            shared->num_done++;
+            if (shared->num_done >= shared->total)
+                shared->cv.notify_all();
+        }
+
+        void RunBenchmark(int n, const std::string &name, void (Benchmark::*method)(ThreadState *),
+                          bool report_found)
+        {
+            table_->cache_.ResetStats();
+            SharedState shared;
+            shared.total = n;
+            shared.insert_count.store(num_);
+
+            std::vector<std::unique_ptr<ThreadState>> threads;
+            std::vector<std::thread> workers;
+            for (int i = 0; i < n; i++)
+            {
+                threads.emplace_back(new ThreadState(i));
+                threads.back()->shared = &shared;
+                workers.emplace_back(&Benchmark::ThreadBody, this, threads.back().get(), method);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(shared.mu);
+                while (shared.num_initialized < n)
+                    shared.cv.wait(lock);
+                shared.start = true;
+                shared.cv.notify_all();
+                while (shared.num_done < n)
+                    shared.cv.wait(lock);
+            }
+            for (std::thread &t : workers)
+                t.join();
+
+            for (int i = 1; i < n; i++)
+                threads[0]->stats.Merge(threads[i]->stats);
+            threads[0]->stats.Report(name, report_found);
+
+            kvdb::cache::CacheStats cache_stats = table_->cache_.GetStats();
+            if (cache_stats.hits + cache_stats.misses > 0)
+            {
+                std::fprintf(stdout, "cache hit ratio: %.2f%% (%" PRIu64 " of %" PRIu64 " lookups), usage %.1f MB\n",
+                             cache_stats.HitRatio() * 100, cache_stats.hits, cache_stats.hits + cache_stats.misses,
+                             table_->cache_.GetUsage() / 1048576.0);
+                std::fflush(stdout);
+            }
+
+            if (statistics_ != nullptr)
+            {
+                if (FLAGS_statistics_file != nullptr)
+                    table_->DumpStatistics(FLAGS_statistics_file, kvdb::Statistics::kPrometheus);
+                if (FLAGS_statistics)
+                    std::fprintf(stdout, "STATISTICS:\n%s", statistics_->ToString().c_str());
+                std::fflush(stdout);
+                statistics_->Reset();
+            }
+        }
+
+        void Put(ThreadState *thread, uint64_t k)
+        {
+            const std::string key = KeyString(k);
+            table_->Insert(key, thread->gen.Generate(FLAGS_value_size));
+            thread->stats.AddBytes(key.size() + FLAGS_value_size);
+        }
+
+        void Read(ThreadState *thread, const std::string &key)
+        {
+            auto value = table_->Get(key);
+            if (value != nullptr)
+            {
+                thread->stats.AddFound(1);
+                thread->stats.AddBytes(key.size() + value->size());
+            }
+        }
+
+        void WriteSeq(ThreadState *thread)
+        {
+            for (int i = 0; i < num_; i++)
+            {
+                Put(thread, i);
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void WriteRandom(ThreadState *thread)
+        {
+            for (int i = 0; i < num_; i++)
+            {
+                Put(thread, thread->rand.Uniform(num_));
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void WriteBatchRandom(ThreadState *thread)
+        {
+            kvdb::WriteBatch<std::string, std::string> batch;
+            for (int i = 0; i < num_; i += FLAGS_batch_size)
+            {
+                batch.Clear();
+                const int n = std::min(FLAGS_batch_size, num_ - i);
+                for (int j = 0; j < n; j++)
+                {
+                    const std::string key = KeyString(thread->rand.Uniform(num_));
+                    batch.Put(key, thread->gen.Generate(FLAGS_value_size));
+                    thread->stats.AddBytes(key.size() + FLAGS_value_size);
+                }
+                table_->Write(batch);
+                thread->stats.FinishedOps(n);
+            }
+        }
+
+        void ReadRandom(ThreadState *thread)
+        {
+            for (int i = 0; i < reads_; i++)
+            {
+                Read(thread, KeyString(thread->rand.Uniform(num_)));
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void MultiReadRandom(ThreadState *thread)
+        {
+            std::vector<std::string> keys;
+            for (int i = 0; i < reads_; i += FLAGS_batch_size)
+            {
+                keys.clear();
+                const int n = std::min(FLAGS_batch_size, reads_ - i);
+                for (int j = 0; j < n; j++)
+                    keys.push_back(KeyString(thread->rand.Uniform(num_)));
+                auto values = table_->MultiGet(keys);
+                for (int j = 0; j < n; j++)
+                {
+                    if (values[j] != nullptr)
+                    {
+                        thread->stats.AddFound(1);
+                        thread->stats.AddBytes(keys[j].size() + values[j]->size());
+                    }
+                }
+                thread->stats.FinishedOps(n);
+            }
+        }
+
+        void ReadMissing(ThreadState *thread)
+        {
+            for (int i = 0; i < reads_; i++)
+            {
+                // 加上后缀后落在两个已有的key之间
+                Read(thread, KeyString(thread->rand.Uniform(num_)) + ".");
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void ReadHot(ThreadState *thread)
+        {
+            const int range = (num_ + 99) / 100;
+            for (int i = 0; i < reads_; i++)
+            {
+                Read(thread, KeyString(thread->rand.Uniform(range)));
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void DeleteRandom(ThreadState *thread)
+        {
+            for (int i = 0; i < num_; i++)
+            {
+                table_->Remove(KeyString(thread->rand.Uniform(num_)));
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        // read_percent%读，其余为更新，key按scrambled zipfian分布
+        void YCSBReadUpdate(ThreadState *thread, int read_percent, bool read_modify_write)
+        {
+            kvdb::ScrambledZipfianGenerator keys(num_, FLAGS_zipfian_theta, 301 + thread->tid);
+            for (int i = 0; i < reads_; i++)
+            {
+                const uint64_t k = keys.Next();
+                if (static_cast<int>(thread->rand.Uniform(100)) < read_percent)
+                {
+                    Read(thread, KeyString(k));
+                }
+                else
+                {
+                    if (read_modify_write)
+                        Read(thread, KeyString(k));
+                    Put(thread, k);
+                }
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        void YCSBA(ThreadState *thread) { YCSBReadUpdate(thread, 50, false); }
+        void YCSBB(ThreadState *thread) { YCSBReadUpdate(thread, 95, false); }
+        void YCSBC(ThreadState *thread) { YCSBReadUpdate(thread, 100, false); }
+        void YCSBF(ThreadState *thread) { YCSBReadUpdate(thread, 50, true); }
+
+        // 95%读最近插入的key，5%插入新key
+        void YCSBD(ThreadState *thread)
+        {
+            SharedState *shared = thread->shared;
+            kvdb::LatestGenerator keys(num_, FLAGS_zipfian_theta, 301 + thread->tid);
+            for (int i = 0; i < reads_; i++)
+            {
+                if (thread->rand.Uniform(100) < 95)
+                    Read(thread, KeyString(keys.Next(shared->insert_count.load(std::memory_order_relaxed))));
+                else
+                    Put(thread, shared->insert_count.fetch_add(1, std::memory_order_relaxed));
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        // 95%从zipfian分布的key开始扫描[1, scan_length]个key，5%插入新key
+        void YCSBE(ThreadState *thread)
+        {
+            SharedState *shared = thread->shared;
+            kvdb::ScrambledZipfianGenerator keys(num_, FLAGS_zipfian_theta, 301 + thread->tid);
+            const std::string end(1, '\xff');
+            for (int i = 0; i < reads_; i++)
+            {
+                if (thread->rand.Uniform(100) < 95)
+                {
+                    const std::string start = KeyString(keys.Next());
+                    const size_t len = 1 + thread->rand.Uniform(FLAGS_scan_length);
+                    int64_t bytes = 0;
+                    auto it = table_->Scan(start, end, len);
+                    for (; it.Valid(); it.Next())
+                        bytes += it.key().size() + it.value().size();
+                    thread->stats.AddBytes(bytes);
+                    thread->stats.AddFound(bytes > 0 ? 1 : 0);
+                }
+                else
+                {
+                    Put(thread, shared->insert_count.fetch_add(1, std::memory_order_relaxed));
+                }
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        // 95%按scrambled zipfian分布读，5%从均匀分布的位置开始用Get顺序读scan_length个key
+        void ScanMix(ThreadState *thread)
+        {
+            kvdb::ScrambledZipfianGenerator keys(num_, FLAGS_zipfian_theta, 301 + thread->tid);
+            for (int i = 0; i < reads_; i++)
+            {
+                if (thread->rand.Uniform(100) < 95)
+                {
+                    Read(thread, KeyString(keys.Next()));
+                }
+                else
+                {
+                    const int start = thread->rand.Uniform(num_);
+                    for (int k = start; k < start + FLAGS_scan_length && k < num_; k++)
+                        Read(thread, KeyString(k));
+                }
+                thread->stats.FinishedSingleOp();
+            }
+        }
+
+        const int num_;
+        const int reads_;
+        const std::string dbname_;
+        // 重新打开Table时沿用同一个块缓存
+        const std::shared_ptr<kvdb::BlockCache> block_cache_;
+        const std::shared_ptr<kvdb::Statistics> statistics_;
+        std::unique_ptr<BenchTable> table_;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        double d;
+        int n;
+        long long ll;
+        char junk;
+        if (std::strncmp(argv[i], "--benchmarks=", 13) == 0)
+            FLAGS_benchmarks = argv[i] + 13;
+        else if (std::sscanf(argv[i], "--num=%d%c", &n, &junk) == 1)
+            FLAGS_num = n;
+        else if (std::sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1)
+            FLAGS_reads = n;
+        else if (std::sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1)
+            FLAGS_threads = n;
+        else if (std::sscanf(argv[i], "--key_size=%d%c", &n, &junk) == 1)
+            FLAGS_key_size = n;
+        else if (std::sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1)
+            FLAGS_value_size = n;
+        else if (std::sscanf(argv[i], "--batch_size=%d%c", &n, &junk) == 1)
+            FLAGS_batch_size = n;
+        else if (std::sscanf(argv[i], "--scan_length=%d%c", &n, &junk) == 1)
+            FLAGS_scan_length = n;
+        else if (std::sscanf(argv[i], "--zipfian_theta=%lf%c", &d, &junk) == 1)
+            FLAGS_zipfian_theta = d;
+        else if (std::sscanf(argv[i], "--cache_capacity=%lld%c", &ll, &junk) == 1)
+            FLAGS_cache_capacity = ll;
+        else if (std::sscanf(argv[i], "--cache_shard_bits=%d%c", &n, &junk) == 1)
+            FLAGS_cache_shard_bits = n;
+        else if (std::sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1)
+            FLAGS_write_buffer_size = n;
+        else if (std::sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1)
+            FLAGS_bloom_bits = n;
+        else if (std::sscanf(argv[i], "--sync=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_sync = n;
+        else if (std::sscanf(argv[i], "--concurrent_memtable_write=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_concurrent_memtable_write = n;
+        else if (std::sscanf(argv[i], "--inplace_update=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_inplace_update = n;
+        else if (std::sscanf(argv[i], "--mmap_read=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_mmap_read = n;
+        else if (std::sscanf(argv[i], "--block_cache_size=%lld%c", &ll, &junk) == 1)
+            FLAGS_block_cache_size = ll;
+        else if (std::sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_cache_index_and_filter_blocks = n;
+        else if (std::sscanf(argv[i], "--use_existing_db=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_use_existing_db = n;
+        else if (std::sscanf(argv[i], "--statistics=%d%c", &n, &junk) == 1 && (n == 0 || n == 1))
+            FLAGS_statistics = n;
+        else if (std::strncmp(argv[i], "--statistics_file=", 18) == 0)
+            FLAGS_statistics_file = argv[i] + 18;
+        else if (std::strncmp(argv[i], "--db=", 5) == 0)
+            FLAGS_db = argv[i] + 5;
+        else if (std::strncmp(argv[i], "--cache_policy=", 15) == 0)
+            FLAGS_cache_policy = argv[i] + 15;
+        else if (std::strncmp(argv[i], "--compression=", 14) == 0)
+        {
+            bool found = false;
+            for (kvdb::CompressionType type : {kvdb::kNoCompression, kvdb::kSnappyCompression, kvdb::kLZ4Compression,
+                                               kvdb::kZstdCompression})
+            {
+                if (std::strcmp(argv[i] + 14, kvdb::CompressionTypeName(type)) == 0)
+                {
+                    FLAGS_compression = type;
+                    found = true;
+                }
+            }
+            if (!found || !kvdb::CompressionTypeSupported(FLAGS_compression))
+            {
+                std::fprintf(stderr, "Unsupported compression '%s'\n", argv[i] + 14);
+                std::exit(1);
+            }
+        }
+        else if (std::sscanf(argv[i], "--compression_ratio=%lf%c", &d, &junk) == 1)
+            FLAGS_compression_ratio = d;
+        else
+        {
+            std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+            std::exit(1);
+        }
+    }
+    if (FLAGS_num < 1 || FLAGS_threads < 1 || FLAGS_batch_size < 1 || FLAGS_scan_length < 1 ||
+        FLAGS_zipfian_theta <= 0 || FLAGS_zipfian_theta >= 1)
+    {
+        std::fprintf(stderr, "num, threads, batch_size and scan_length must be positive, zipfian_theta in (0, 1)\n");
+        std::exit(1);
+    }
+
+    if (FLAGS_cache_policy == "lru")
+    {
+        Benchmark<kvdb::Table<std::string, std::string>> benchmark;
+        benchmark.Run();
+    }
+    else if (FLAGS_cache_policy == "clock")
+    {
+        Benchmark<kvdb::Table<std::string, std::string, kvdb::cache::ClockPolicy<std::string, std::string>>> benchmark;
+        benchmark.Run();
+    }
+    else if (FLAGS_cache_policy == "tinylfu")
+    {
+        Benchmark<kvdb::Table<std::string, std::string, kvdb::cache::TinyLFUPolicy<std::string, std::string>>>
+            benchmark;
+        benchmark.Run();
+    }
+    else
+    {
+        std::fprintf(stderr, "unknown cache_policy '%s', expected lru, clock or tinylfu\n", FLAGS_cache_policy.c_str());
+        std::exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#ifndef STORAGE_KVDB_DB_DB_ITER_H_
+#define STORAGE_KVDB_DB_DB_ITER_H_
+#include "db/iterator.h"
+#include "util/coding.h"
+#include "util/slice.h"
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace kvdb
+{
+    // 内部迭代器会返回同一个key的所有版本(新版本在前)以及删除标记，
+    // DBIter在其上只保留每个key在快照中可见的最新版本，并跳过已经被删除的key。
+    // 序列号大于snapshot的版本在快照之后写入，全部跳过。在now时已经过期的版本与删除标记相同，
+    // 遮住同一个key更旧的版本
+    template <typename K, typename V>
+    class DBIter : public Iterator<K, V>
+    {
+    public:
+        // 接管iter的所有权
+        explicit DBIter(Iterator<K, V> *iter, SequenceNumber snapshot = kMaxSequenceNumber, uint64_t now = 0)
+            : iter_(iter), snapshot_(snapshot), now_(now) {}
+
+        bool Valid() const override { return iter_->Valid(); }
+
+        void SeekToFirst() override
+        {
+            iter_->SeekToFirst();
+            FindNextUserEntry(false);
+        }
+
+        void SeekToLast() override
+        {
+            iter_->SeekToLast();
+            FindPrevUserEntry();
+        }
+
+        void Seek(const K &target) override
+        {
+            iter_->Seek(target);
+            FindNextUserEntry(false);
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+            // 赋值可以复用saved_key_已有的缓冲区
+            saved_key_ = iter_->key();
+            iter_->Next();
+            FindNextUserEntry(true);
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+            // 当前位置之前可能还有同一个key在快照之后写入的版本，一起越过
+            saved_key_ = iter_->key();
+            do
+            {
+                iter_->Prev();
+            } while (iter_->Valid() && iter_->key() == saved_key_);
+            FindPrevUserEntry();
+        }
+
+        const K &key() const override { return iter_->key(); }
+        const V &value() const override { return iter_->value(); }
+        KType type() const override { return iter_->type(); }
+        SequenceNumber sequence() const override { return iter_->sequence(); }
+        uint64_t expire_at() const override { return iter_->expire_at(); }
+        Status status() const override { return iter_->status(); }
+
+    private:
+        // 向后找到第一个未被删除的key的最新可见版本，skipping为true时跳过与saved_key_相同的旧版本
+        void FindNextUserEntry(bool skipping)
+        {
+            while (iter_->Valid())
+            {
+                if (iter_->sequence() > snapshot_ || (skipping && iter_->key() == saved_key_))
+                {
+                    iter_->Next();
+                }
+                else if (iter_->type() == KType::kTypeDelete || IsExpired(iter_->expire_at(), now_))
+                {
+                    // 该key的更旧版本也都不可见
+                    saved_key_ = iter_->key();
+                    skipping = true;
+                    iter_->Next();
+                }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        // iter_位于某个key的最后一个(最旧)版本，向前退到该key在快照中可见的最新版本，
+        // 若没有可见版本或者它是删除标记、已经过期则继续向前
+        void FindPrevUserEntry()
+        {
+            while (iter_->Valid())
+            {
+                saved_key_ = iter_->key();
+                do
+                {
+                    iter_->Prev();
+                } while (iter_->Valid() && iter_->key() == saved_key_);
+
+                if (iter_->Valid())
+                    iter_->Next();
+                else
+                    iter_->SeekToFirst();
+                while (iter_->Valid() && iter_->key() == saved_key_ && iter_->sequence() > snapshot_)
+                    iter_->Next();
+
+                if (iter_->Valid() && iter_->key() == saved_key_ && iter_->type() == KType::kTypeValue &&
+                    !IsExpired(iter_->expire_at(), now_))
+                    return;
+                // 退到这个key的所有版本之前
+                if (!iter_->Valid())
+                    iter_->SeekToLast();
+                while (iter_->Valid() && !(iter_->key() < saved_key_))
+                    iter_->Prev();
+            }
+        }
+
+        std::unique_ptr<Iterator<K, V>> iter_;
+        const SequenceNumber snapshot_;
+        const uint64_t now_;
+        K saved_key_;
+    };
+
+    // Table::Scan返回的迭代器，在DBIter的基础上限制结束位置[..., end)和最多返回的条数。
+    // prefix不为空时遇到第一个编码后不以prefix开头的key就结束
+    template <typename K, typename V>
+    class ScanIterator
+    {
+    public:
+        // 接管iter的所有权，iter需要已经定位到起始位置
+        ScanIterator(Iterator<K, V> *iter, const K &end, size_t limit, std::string prefix = std::string())
+            : iter_(iter), end_(end), remaining_(limit), prefix_(std::move(prefix))
+        {
+            CheckPrefix();
+        }
+
+        bool Valid() const { return remaining_ > 0 && iter_->Valid() && iter_->key() < end_; }
+
+        // REQUIRES: Valid()
+        void Next()
+        {
+            assert(Valid());
+            iter_->Next();
+            --remaining_;
+            CheckPrefix();
+        }
+
+        // 返回的引用指向底层节点，只在调用Next之前有效
+        const K &key() const { return iter_->key(); }
+        const V &value() const { return iter_->value(); }
+
+        // 读取磁盘文件出错时Valid()提前返回false
+        Status status() const { return iter_->status(); }
+
+    private:
+        // 当前key超出前缀的范围时结束遍历
+        void CheckPrefix()
+        {
+            if (prefix_.empty() || remaining_ == 0 || !iter_->Valid())
+                return;
+            encoded_.clear();
+            Codec<K>::Encode(&encoded_, iter_->key());
+            if (!Slice(encoded_).starts_with(prefix_))
+                remaining_ = 0;
+        }
+
+        std::unique_ptr<Iterator<K, V>> iter_;
+        const K end_;
+        size_t remaining_;
+        const std::string prefix_;
+        // 编码当前key的缓冲区
+        std::string encoded_;
+    };
+}
+
+#endif
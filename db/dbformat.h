@@ -0,0 +1,164 @@
+#ifndef STORAGE_KVDB_DB_DBFORMAT_H_
+#define STORAGE_KVDB_DB_DBFORMAT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "db/iterator.h"
+#include "db/sstable.h"
+#include "util/KVNode.h"
+#include "util/coding.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 有序表文件中的条目：
+    //   key   = Codec<K>编码后的key，按字节序与K的operator<一致
+    //   value = fixed64 (sequence << 8 | type) | Codec<V>编码后的value (删除标记没有value)
+    // 带过期时间的value的type为kTypeValueWithExpiry，在value之前多一个fixed64的过期时间。
+    // 同一个key可以有多个版本，按序列号从新到旧相邻存放，并且总在同一个数据块中
+
+    template <typename V>
+    inline void EncodeTableValue(std::string *dst, KType type, SequenceNumber seq, const V *value,
+                                 uint64_t expire_at = 0)
+    {
+        if (type == KType::kTypeValue && expire_at != 0)
+        {
+            PutFixed64(dst, PackSequenceAndType(seq, KType::kTypeValueWithExpiry));
+            PutFixed64(dst, expire_at);
+        }
+        else
+            PutFixed64(dst, PackSequenceAndType(seq, type));
+        if (type == KType::kTypeValue)
+            Codec<V>::Encode(dst, *value);
+    }
+
+    // 只解码序列号，用于跳过快照中不可见的版本
+    inline bool DecodeTableSequence(const Slice &input, SequenceNumber *seq)
+    {
+        if (input.size() < 8)
+            return false;
+        *seq = DecodeFixed64(input.data()) >> 8;
+        return true;
+    }
+
+    // kTypeValueWithExpiry解码为kTypeValue，过期时间写入*expire_at，其他类型的*expire_at为0
+    template <typename V>
+    inline bool DecodeTableValue(const Slice &input, KType *type, SequenceNumber *seq, V *value, uint64_t *expire_at)
+    {
+        if (input.size() < 8)
+            return false;
+        const uint64_t tag = DecodeFixed64(input.data());
+        *type = static_cast<KType>(tag & 0xff);
+        *seq = tag >> 8;
+        *expire_at = 0;
+        if (*type == KType::kTypeDelete)
+        {
+            *value = V();
+            return input.size() == 8;
+        }
+        size_t offset = 8;
+        if (*type == KType::kTypeValueWithExpiry)
+        {
+            if (input.size() < 16)
+                return false;
+            *type = KType::kTypeValue;
+            *expire_at = DecodeFixed64(input.data() + 8);
+            offset = 16;
+        }
+        if (*type != KType::kTypeValue)
+            return false;
+        return Codec<V>::Decode(Slice(input.data() + offset, input.size() - offset), value);
+    }
+
+    // 一个有序表文件
+    struct FileMetaData
+    {
+        uint64_t number = 0;
+        uint64_t file_size = 0;
+        std::string smallest; // 文件内最小的key(编码后)
+        std::string largest;  // 文件内最大的key(编码后)
+        std::shared_ptr<SSTable> table;
+    };
+
+    // 把有序表文件的字节迭代器解码成Iterator<K, V>
+    template <typename K, typename V>
+    class TableFileIterator : public Iterator<K, V>
+    {
+    public:
+        // 接管iter的所有权
+        explicit TableFileIterator(SliceIterator *iter)
+            : iter_(iter), type_(KType::kTypeValue), sequence_(0), expire_at_(0) {}
+
+        bool Valid() const override { return status_.ok() && iter_->Valid(); }
+
+        void SeekToFirst() override
+        {
+            iter_->SeekToFirst();
+            Decode();
+        }
+
+        void SeekToLast() override
+        {
+            iter_->SeekToLast();
+            Decode();
+        }
+
+        void Seek(const K &target) override
+        {
+            encoded_.clear();
+            Codec<K>::Encode(&encoded_, target);
+            iter_->Seek(encoded_);
+            Decode();
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+            iter_->Next();
+            Decode();
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+            iter_->Prev();
+            Decode();
+        }
+
+        const K &key() const override { return key_; }
+        const V &value() const override { return value_; }
+        KType type() const override { return type_; }
+        SequenceNumber sequence() const override { return sequence_; }
+        uint64_t expire_at() const override { return expire_at_; }
+
+        Status status() const override
+        {
+            if (!status_.ok())
+                return status_;
+            return iter_->status();
+        }
+
+    private:
+        void Decode()
+        {
+            if (!iter_->Valid())
+                return;
+            if (!Codec<K>::Decode(iter_->key(), &key_) ||
+                !DecodeTableValue(iter_->value(), &type_, &sequence_, &value_, &expire_at_))
+                status_ = Status::Corruption("bad entry in table file");
+        }
+
+        std::unique_ptr<SliceIterator> iter_;
+        std::string encoded_;
+        K key_;
+        V value_;
+        KType type_;
+        SequenceNumber sequence_;
+        uint64_t expire_at_;
+        Status status_;
+    };
+}
+
+#endif
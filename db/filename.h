@@ -0,0 +1,129 @@
+#ifndef STORAGE_KVDB_DB_FILENAME_H_
+#define STORAGE_KVDB_DB_FILENAME_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "util/env.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    enum class FileType
+    {
+        kLogFile,
+        kTableFile,
+        kTempFile,
+        kDescriptorFile,
+        kCurrentFile,
+    };
+
+    inline std::string MakeFileName(const std::string &dbname, uint64_t number, const char *suffix)
+    {
+        char buf[100];
+        std::snprintf(buf, sizeof(buf), "/%06llu.%s", static_cast<unsigned long long>(number), suffix);
+        return dbname + buf;
+    }
+
+    // 返回dbname目录下编号为number的日志文件名
+    inline std::string LogFileName(const std::string &dbname, uint64_t number)
+    {
+        return MakeFileName(dbname, number, "log");
+    }
+
+    // 返回dbname目录下编号为number的有序表文件名
+    inline std::string TableFileName(const std::string &dbname, uint64_t number)
+    {
+        return MakeFileName(dbname, number, "sst");
+    }
+
+    // 写入过程中使用的临时文件，写完后重命名为正式文件名
+    inline std::string TempFileName(const std::string &dbname, uint64_t number)
+    {
+        return MakeFileName(dbname, number, "dbtmp");
+    }
+
+    // 记录各层文件变化的MANIFEST文件
+    inline std::string DescriptorFileName(const std::string &dbname, uint64_t number)
+    {
+        char buf[100];
+        std::snprintf(buf, sizeof(buf), "/MANIFEST-%06llu", static_cast<unsigned long long>(number));
+        return dbname + buf;
+    }
+
+    // CURRENT文件的内容是当前使用的MANIFEST文件名
+    inline std::string CurrentFileName(const std::string &dbname)
+    {
+        return dbname + "/CURRENT";
+    }
+
+    // 解析目录中的文件名，识别成功时返回true并填写编号和类型
+    inline bool ParseFileName(const std::string &filename, uint64_t *number, FileType *type)
+    {
+        if (filename == "CURRENT")
+        {
+            *number = 0;
+            *type = FileType::kCurrentFile;
+            return true;
+        }
+        const std::string manifest_prefix = "MANIFEST-";
+        if (filename.compare(0, manifest_prefix.size(), manifest_prefix) == 0)
+        {
+            if (filename.size() == manifest_prefix.size())
+                return false;
+            uint64_t num = 0;
+            for (size_t i = manifest_prefix.size(); i < filename.size(); i++)
+            {
+                char c = filename[i];
+                if (c < '0' || c > '9')
+                    return false;
+                num = num * 10 + (c - '0');
+            }
+            *number = num;
+            *type = FileType::kDescriptorFile;
+            return true;
+        }
+
+        size_t dot = filename.find('.');
+        if (dot == 0 || dot == std::string::npos)
+            return false;
+        uint64_t num = 0;
+        for (size_t i = 0; i < dot; i++)
+        {
+            char c = filename[i];
+            if (c < '0' || c > '9')
+                return false;
+            num = num * 10 + (c - '0');
+        }
+        std::string suffix = filename.substr(dot + 1);
+        if (suffix == "log")
+            *type = FileType::kLogFile;
+        else if (suffix == "sst")
+            *type = FileType::kTableFile;
+        else if (suffix == "dbtmp")
+            *type = FileType::kTempFile;
+        else
+            return false;
+        *number = num;
+        return true;
+    }
+
+    // 让CURRENT指向编号为descriptor_number的MANIFEST，先写临时文件再重命名，保证原子替换
+    inline Status SetCurrentFile(Env *env, const std::string &dbname, uint64_t descriptor_number)
+    {
+        std::string manifest = DescriptorFileName(dbname, descriptor_number);
+        std::string contents = manifest.substr(dbname.size() + 1) + "\n";
+        std::string tmp = TempFileName(dbname, descriptor_number);
+        Status s = WriteStringToFile(env, contents, tmp, true);
+        if (s.ok())
+            s = env->RenameFile(tmp, CurrentFileName(dbname));
+        if (s.ok())
+            s = env->SyncDir(dbname);
+        else
+            env->RemoveFile(tmp);
+        return s;
+    }
+}
+
+#endif
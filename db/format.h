@@ -0,0 +1,222 @@
+#ifndef STORAGE_KVDB_DB_FORMAT_H_
+#define STORAGE_KVDB_DB_FORMAT_H_
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include "util/bloom.h"
+#include "util/coding.h"
+#include "util/compression.h"
+#include "util/crc32c.h"
+#include "util/env.h"
+#include "util/perf_context.h"
+#include "util/prefix_extractor.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 有序表文件的布局：
+    //   [data block 1] ... [data block N] [metaindex block] [index block] [footer]
+    // 每个块后面跟着 type (1字节) | crc32c (4字节) 的尾部，
+    // footer定长，保存metaindex和index块的位置以及magic number
+
+    // 文件内一个块的位置和大小(不含尾部)
+    class BlockHandle
+    {
+    public:
+        // 两个varint64的最大长度
+        enum
+        {
+            kMaxEncodedLength = 10 + 10
+        };
+
+        BlockHandle() : offset_(~static_cast<uint64_t>(0)), size_(~static_cast<uint64_t>(0)) {}
+
+        uint64_t offset() const { return offset_; }
+        void set_offset(uint64_t offset) { offset_ = offset; }
+        uint64_t size() const { return size_; }
+        void set_size(uint64_t size) { size_ = size; }
+
+        void EncodeTo(std::string *dst) const
+        {
+            assert(offset_ != ~static_cast<uint64_t>(0));
+            assert(size_ != ~static_cast<uint64_t>(0));
+            PutVarint64(dst, offset_);
+            PutVarint64(dst, size_);
+        }
+
+        Status DecodeFrom(Slice *input)
+        {
+            if (GetVarint64(input, &offset_) && GetVarint64(input, &size_))
+                return Status::OK();
+            return Status::Corruption("bad block handle");
+        }
+
+    private:
+        uint64_t offset_;
+        uint64_t size_;
+    };
+
+    // 位于文件末尾的定长footer
+    class Footer
+    {
+    public:
+        // 两个补齐到最大长度的BlockHandle + 8字节magic number
+        enum
+        {
+            kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8
+        };
+
+        const BlockHandle &metaindex_handle() const { return metaindex_handle_; }
+        void set_metaindex_handle(const BlockHandle &h) { metaindex_handle_ = h; }
+        const BlockHandle &index_handle() const { return index_handle_; }
+        void set_index_handle(const BlockHandle &h) { index_handle_ = h; }
+
+        void EncodeTo(std::string *dst) const;
+        Status DecodeFrom(Slice *input);
+
+    private:
+        BlockHandle metaindex_handle_;
+        BlockHandle index_handle_;
+    };
+
+    // 按小端写入后为 "kvdbsst\0"
+    static const uint64_t kTableMagicNumber = 0x007473736264766bull;
+
+    // 块尾部：1字节type + 4字节crc。type为块内容的压缩算法(CompressionType)
+    static const size_t kBlockTrailerSize = 5;
+
+    // 元数据索引中过滤器块的key
+    inline std::string FilterBlockName()
+    {
+        return std::string("filter.") + BloomFilterPolicy::Name();
+    }
+
+    // 元数据索引中前缀过滤器块的key，包含提取器的名字，换了提取器后旧文件的前缀过滤器不再使用
+    inline std::string PrefixFilterBlockName(const PrefixExtractor &extractor)
+    {
+        return std::string("prefix_filter.") + BloomFilterPolicy::Name() + "." + extractor.Name();
+    }
+
+    // 元数据索引中Zstd字典块的key
+    inline std::string CompressionDictBlockName()
+    {
+        return "compression.dict";
+    }
+
+    struct BlockContents
+    {
+        Slice data;          // 块的实际内容
+        bool heap_allocated; // true时调用方负责delete[] data.data()
+    };
+
+    inline void Footer::EncodeTo(std::string *dst) const
+    {
+        const size_t original_size = dst->size();
+        metaindex_handle_.EncodeTo(dst);
+        index_handle_.EncodeTo(dst);
+        dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength);
+        PutFixed64(dst, kTableMagicNumber);
+        assert(dst->size() == original_size + kEncodedLength);
+    }
+
+    inline Status Footer::DecodeFrom(Slice *input)
+    {
+        if (input->size() < kEncodedLength)
+            return Status::Corruption("file is too short to be an sstable");
+
+        const char *magic_ptr = input->data() + kEncodedLength - 8;
+        if (DecodeFixed64(magic_ptr) != kTableMagicNumber)
+            return Status::Corruption("not an sstable (bad magic number)");
+
+        Status result = metaindex_handle_.DecodeFrom(input);
+        if (result.ok())
+            result = index_handle_.DecodeFrom(input);
+        if (result.ok())
+        {
+            // 跳过补齐的部分
+            const char *end = magic_ptr + 8;
+            *input = Slice(end, input->data() + input->size() - end);
+        }
+        return result;
+    }
+
+    // 读取handle指向的块并校验尾部，成功时result->data指向块内容。
+    // 压缩的块解压到新分配的内存中，dict为文件的Zstd字典，没有时为nullptr
+    inline Status ReadBlock(RandomAccessFile *file, bool verify_checksums, const BlockHandle &handle,
+                            BlockContents *result, const CompressionDict *dict = nullptr)
+    {
+        result->data = Slice();
+        result->heap_allocated = false;
+
+        size_t n = static_cast<size_t>(handle.size());
+        // 映射到内存的文件直接返回映射中的地址，不需要缓冲区
+        char *buf = file->ZeroCopy() ? nullptr : new char[n + kBlockTrailerSize];
+        Slice contents;
+        Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+        if (!s.ok())
+        {
+            delete[] buf;
+            return s;
+        }
+        if (contents.size() != n + kBlockTrailerSize)
+        {
+            delete[] buf;
+            return Status::Corruption("truncated block read");
+        }
+
+        // crc覆盖块内容和type字节
+        const char *data = contents.data();
+        if (verify_checksums)
+        {
+            const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+            const uint32_t actual = crc32c::Value(data, n + 1);
+            if (actual != crc)
+            {
+                delete[] buf;
+                return Status::Corruption("block checksum mismatch");
+            }
+        }
+
+        switch (data[n])
+        {
+        case kNoCompression:
+            if (data != buf)
+            {
+                // 文件实现返回了自己持有的内存
+                delete[] buf;
+                result->data = Slice(data, n);
+            }
+            else
+            {
+                result->data = Slice(buf, n);
+                result->heap_allocated = true;
+            }
+            break;
+        case kSnappyCompression:
+        case kLZ4Compression:
+        case kZstdCompression:
+        {
+            char *uncompressed = nullptr;
+            size_t size = 0;
+            PerfTimer timer(&PerfContext::block_decompress_nanos);
+            s = Uncompress(static_cast<CompressionType>(data[n]), Slice(data, n), dict, &uncompressed, &size);
+            delete[] buf;
+            if (!s.ok())
+                return s;
+            if (uncompressed == nullptr)
+                return Status::Corruption("decompressor produced no output");
+            result->data = Slice(uncompressed, size);
+            result->heap_allocated = true;
+            break;
+        }
+        default:
+            delete[] buf;
+            return Status::Corruption("bad block type");
+        }
+        return Status::OK();
+    }
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef STORAGE_KVDB_DB_INLINE_SKIPLIST_H_
+#define STORAGE_KVDB_DB_INLINE_SKIPLIST_H_
+#include <cassert>
+#include <cstring>
+#include "db/skiplist.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/comparator.h"
+#include "util/KVNode.h"
+#include "util/slice.h"
+namespace kvdb
+{
+    // 指向arena中一个条目的开头，条目格式为
+    //   varint32 key长度 | key | fixed64 (sequence << 8 | type) | varint32 value长度 | value
+    // 条目本身就是序列化的形式，可以原样写出，再用InlineSkipList::DecodeEntry解析
+    struct EntryRef
+    {
+        const char *data = nullptr;
+
+        Slice key() const
+        {
+            uint32_t len;
+            const char *p = DecodeLength(data, &len);
+            return Slice(p, len);
+        }
+        uint64_t tag() const { return DecodeFixed64(key_end()); }
+        Slice value() const
+        {
+            uint32_t len;
+            const char *p = DecodeLength(key_end() + 8, &len);
+            return Slice(p, len);
+        }
+        // 整个条目的编码
+        Slice entry() const
+        {
+            const Slice v = value();
+            return Slice(data, v.data() + v.size() - data);
+        }
+
+    private:
+        const char *key_end() const
+        {
+            const Slice k = key();
+            return k.data() + k.size();
+        }
+
+        // 条目是自己写入的，长度一定完整。短key/value的长度只有一个字节，不进入循环
+        static const char *DecodeLength(const char *p, uint32_t *len)
+        {
+            if ((static_cast<uint8_t>(*p) & 0x80) == 0)
+            {
+                *len = static_cast<uint8_t>(*p);
+                return p + 1;
+            }
+            *len = 0;
+            return GetVarint32Ptr(p, p + 5, len);
+        }
+    };
+
+    // value已经在条目中，SkipList节点中的value不保存任何内容
+    struct EmptyValue
+    {
+    };
+
+    // 按Cmp比较条目中的key，查找时也可以直接与Slice比较
+    template <typename Cmp>
+    class EntryOrder
+    {
+    public:
+        explicit EntryOrder(const Cmp *cmp) : cmp_(cmp) {}
+
+        bool Less(const EntryRef &a, const EntryRef &b) const { return cmp_->Compare(a.key(), b.key()) < 0; }
+        bool Less(const EntryRef &a, const Slice &b) const { return cmp_->Compare(a.key(), b) < 0; }
+        bool Less(const Slice &a, const EntryRef &b) const { return cmp_->Compare(a, b.key()) < 0; }
+
+        const Cmp *comparator() const { return cmp_; }
+
+    private:
+        const Cmp *cmp_;
+    };
+
+    // 按字节存储key/value的跳表，key的顺序由运行时的Comparator决定。
+    // 每个条目编码后从arena中分配，节点中只保存指向条目的EntryRef，查找和插入都由SkipList完成。
+    // 排列顺序与SkipList相同：key升序，同一个key序列号降序。
+    // Cmp为BytewiseComparatorImpl等内置比较器时Compare被内联；为Comparator时通过虚函数调用用户的比较器
+    template <typename Cmp = Comparator>
+    class InlineSkipList
+    {
+        typedef SkipList<EntryRef, EmptyValue, EntryOrder<Cmp>> List;
+
+    public:
+        // cmp和arena的生命周期必须长于InlineSkipList
+        InlineSkipList(const Cmp *cmp, Arena *arena) : arena_(arena), list_(arena, EntryOrder<Cmp>(cmp)) {}
+
+        InlineSkipList(const InlineSkipList &) = delete;
+        InlineSkipList &operator=(const InlineSkipList &) = delete;
+
+        // 删除标记不保存value，条目中的value为空
+        // REQUIRES: 同一时刻只有一个写线程
+        void Insert(const Slice &key, const Slice &value, KType type, SequenceNumber seq)
+        {
+            list_.Insert(NewEntry(key, value, type, seq, false), EmptyValue(), type, seq);
+        }
+
+        // 多个写线程可以同时调用，不能与Insert混用
+        void InsertConcurrently(const Slice &key, const Slice &value, KType type, SequenceNumber seq)
+        {
+            list_.InsertConcurrently(NewEntry(key, value, type, seq, true), EmptyValue(), type, seq);
+        }
+
+        // 查找key序列号不大于snapshot的最新版本(包括删除标记)，*value指向arena中的条目，不做拷贝
+        bool Get(const Slice &key, SequenceNumber snapshot, Slice *value, KType *type) const
+        {
+            const KVnode<EntryRef, EmptyValue> *x = list_.Get(key, snapshot);
+            if (x == nullptr)
+                return false;
+            *value = x->key.value();
+            *type = x->type();
+            return true;
+        }
+
+        bool Contains(const Slice &key) const { return list_.Get(key) != nullptr; }
+
+        // 从input开头解析一个条目并把input前移到条目之后，格式错误时返回false
+        static bool DecodeEntry(Slice *input, Slice *key, Slice *value, KType *type, SequenceNumber *seq)
+        {
+            if (!GetLengthPrefixedSlice(input, key) || input->size() < 8)
+                return false;
+            const uint64_t tag = DecodeFixed64(input->data());
+            input->remove_prefix(8);
+            *type = static_cast<KType>(tag & 0xff);
+            *seq = tag >> 8;
+            if (*type != KType::kTypeValue && *type != KType::kTypeDelete)
+                return false;
+            return GetLengthPrefixedSlice(input, value);
+        }
+
+        // 遍历所有条目(包括删除标记和旧版本)的迭代器，返回的Slice指向arena，不做拷贝
+        class Iterator
+        {
+        public:
+            // 迭代器创建后处于无效状态
+            explicit Iterator(const InlineSkipList *list) : iter_(&list->list_) {}
+
+            bool Valid() const { return iter_.Valid(); }
+
+            // REQUIRES: Valid()
+            Slice key() const { return iter_.key().key(); }
+            Slice value() const { return iter_.key().value(); }
+            KType type() const { return iter_.type(); }
+            SequenceNumber sequence() const { return iter_.sequence(); }
+            Slice entry() const { return iter_.key().entry(); }
+
+            void Next() { iter_.Next(); }
+            void Prev() { iter_.Prev(); }
+            // 定位到第一个key >= target的条目，即target最新的版本
+            void Seek(const Slice &target) { iter_.Seek(target); }
+            void SeekToFirst() { iter_.SeekToFirst(); }
+            void SeekToLast() { iter_.SeekToLast(); }
+
+        private:
+            typename List::Iterator iter_;
+        };
+
+    private:
+        EntryRef NewEntry(const Slice &key, Slice value, KType type, SequenceNumber seq, bool concurrent)
+        {
+            if (type != KType::kTypeValue)
+                value = Slice();
+            const size_t size = VarintLength(key.size()) + key.size() + 8 + VarintLength(value.size()) + value.size();
+            char *const mem = concurrent ? arena_->AllocateAlignedConcurrent(size) : arena_->Allocate(size);
+            char *p = EncodeVarint32(mem, static_cast<uint32_t>(key.size()));
+            std::memcpy(p, key.data(), key.size());
+            p += key.size();
+            EncodeFixed64(p, PackSequenceAndType(seq, type));
+            p += 8;
+            p = EncodeVarint32(p, static_cast<uint32_t>(value.size()));
+            std::memcpy(p, value.data(), value.size());
+            assert(p + value.size() == mem + size);
+            EntryRef ref;
+            ref.data = mem;
+            return ref;
+        }
+
+        Arena *const arena_;
+        List list_;
+    };
+}
+#endif
@@ -0,0 +1,108 @@
+#ifndef STORAGE_KVDB_DB_ITERATOR_H_
+#define STORAGE_KVDB_DB_ITERATOR_H_
+#include "util/KVNode.h"
+#include "util/slice.h"
+#include "util/status.h"
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace kvdb
+{
+    // 有序遍历key/value的迭代器接口。key()/value()返回的引用指向底层数据，
+    // 只在迭代器移动之前有效
+    template <typename K, typename V>
+    class Iterator
+    {
+    public:
+        Iterator() = default;
+        Iterator(const Iterator &) = delete;
+        Iterator &operator=(const Iterator &) = delete;
+        virtual ~Iterator()
+        {
+            for (auto &cleanup : cleanups_)
+                cleanup();
+        }
+
+        virtual bool Valid() const = 0;
+
+        virtual void SeekToFirst() = 0;
+        virtual void SeekToLast() = 0;
+        // 定位到第一个 >= target 的位置
+        virtual void Seek(const K &target) = 0;
+
+        // REQUIRES: Valid()
+        virtual void Next() = 0;
+        virtual void Prev() = 0;
+
+        // REQUIRES: Valid()
+        virtual const K &key() const = 0;
+        virtual const V &value() const = 0;
+        virtual KType type() const = 0;
+        // 这个版本写入时的序列号
+        virtual SequenceNumber sequence() const = 0;
+        // 这个版本的过期时间(Env::NowMicros)，0表示永不过期
+        virtual uint64_t expire_at() const = 0;
+
+        // 读取磁盘文件出错时Valid()返回false，错误通过status()返回
+        virtual Status status() const { return Status::OK(); }
+
+        // 迭代器析构时调用，通常用来释放迭代器引用的memtable/文件
+        void RegisterCleanup(std::function<void()> cleanup) { cleanups_.push_back(std::move(cleanup)); }
+
+    private:
+        std::vector<std::function<void()>> cleanups_;
+    };
+
+    // 遍历磁盘文件中字节形式key/value的迭代器，key按字节序排列。
+    // key()/value()指向迭代器内部的缓冲区，只在迭代器移动之前有效
+    class SliceIterator
+    {
+    public:
+        SliceIterator() = default;
+        SliceIterator(const SliceIterator &) = delete;
+        SliceIterator &operator=(const SliceIterator &) = delete;
+        virtual ~SliceIterator() = default;
+
+        virtual bool Valid() const = 0;
+        virtual void SeekToFirst() = 0;
+        virtual void SeekToLast() = 0;
+        virtual void Seek(const Slice &target) = 0;
+        virtual void Next() = 0;
+        virtual void Prev() = 0;
+        virtual Slice key() const = 0;
+        virtual Slice value() const = 0;
+        virtual Status status() const = 0;
+    };
+
+    // 不包含任何条目的迭代器，用于出错时返回错误状态
+    class EmptySliceIterator : public SliceIterator
+    {
+    public:
+        explicit EmptySliceIterator(const Status &s) : status_(s) {}
+
+        bool Valid() const override { return false; }
+        void SeekToFirst() override {}
+        void SeekToLast() override {}
+        void Seek(const Slice &) override {}
+        void Next() override { assert(false); }
+        void Prev() override { assert(false); }
+        Slice key() const override
+        {
+            assert(false);
+            return Slice();
+        }
+        Slice value() const override
+        {
+            assert(false);
+            return Slice();
+        }
+        Status status() const override { return status_; }
+
+    private:
+        Status status_;
+    };
+}
+
+#endif
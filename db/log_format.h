@@ -0,0 +1,31 @@
+#ifndef STORAGE_KVDB_DB_LOG_FORMAT_H_
+#define STORAGE_KVDB_DB_LOG_FORMAT_H_
+
+namespace kvdb
+{
+    namespace log
+    {
+        // 日志文件由32KB的块组成，每条记录的头部为
+        //   checksum (4字节) | length (2字节) | type (1字节)
+        // 放不进当前块剩余空间的记录被切成多个分片，用type标记位置
+        enum RecordType
+        {
+            // 预分配文件时填充的零
+            kZeroType = 0,
+
+            kFullType = 1,
+
+            // 分片
+            kFirstType = 2,
+            kMiddleType = 3,
+            kLastType = 4
+        };
+        static const int kMaxRecordType = kLastType;
+
+        static const int kBlockSize = 32768;
+
+        static const int kHeaderSize = 4 + 2 + 1;
+    }
+}
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef STORAGE_KVDB_DB_LOG_READER_H_
+#define STORAGE_KVDB_DB_LOG_READER_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "db/log_format.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/env.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    namespace log
+    {
+        class Reader
+        {
+        public:
+            // 检测到损坏时通知调用方
+            class Reporter
+            {
+            public:
+                virtual ~Reporter() = default;
+
+                // 大约丢弃了bytes字节的数据
+                virtual void Corruption(size_t bytes, const Status &status) = 0;
+            };
+
+            // reporter可以为nullptr；checksum为true时校验crc。
+            // Reader存在期间file和reporter必须有效
+            Reader(SequentialFile *file, Reporter *reporter, bool checksum)
+                : file_(file), reporter_(reporter), checksum_(checksum), backing_store_(new char[kBlockSize]),
+                  buffer_(), eof_(false) {}
+
+            Reader(const Reader &) = delete;
+            Reader &operator=(const Reader &) = delete;
+
+            ~Reader() { delete[] backing_store_; }
+
+            // 读取下一条完整的记录，成功返回true。*record可能指向scratch或内部缓冲区，
+            // 只在下一次调用ReadRecord之前有效
+            bool ReadRecord(Slice *record, std::string *scratch);
+
+        private:
+            // ReadPhysicalRecord返回的特殊值
+            enum
+            {
+                kEof = kMaxRecordType + 1,
+                // 遇到无效的分片(crc错误、长度错误、零长度的预分配区域等)
+                kBadRecord = kMaxRecordType + 2
+            };
+
+            unsigned int ReadPhysicalRecord(Slice *result);
+
+            void ReportCorruption(uint64_t bytes, const char *reason)
+            {
+                ReportDrop(bytes, Status::Corruption(reason));
+            }
+
+            void ReportDrop(uint64_t bytes, const Status &reason)
+            {
+                if (reporter_ != nullptr)
+                    reporter_->Corruption(static_cast<size_t>(bytes), reason);
+            }
+
+            SequentialFile *const file_;
+            Reporter *const reporter_;
+            bool const checksum_;
+            char *const backing_store_;
+            Slice buffer_;
+            bool eof_; // 上一次读取不足一个块，说明已经到达文件末尾
+        };
+
+        // 只记录第一个损坏的Reporter，恢复WAL和MANIFEST时共用
+        class StatusReporter : public Reader::Reporter
+        {
+        public:
+            Status status;
+
+            void Corruption(size_t /*bytes*/, const Status &s) override
+            {
+                if (status.ok())
+                    status = s;
+            }
+        };
+
+        inline bool Reader::ReadRecord(Slice *record, std::string *scratch)
+        {
+            scratch->clear();
+            record->clear();
+            bool in_fragmented_record = false;
+
+            Slice fragment;
+            while (true)
+            {
+                const unsigned int record_type = ReadPhysicalRecord(&fragment);
+                switch (record_type)
+                {
+                case kFullType:
+                    if (in_fragmented_record && !scratch->empty())
+                        ReportCorruption(scratch->size(), "partial record without end(1)");
+                    scratch->clear();
+                    *record = fragment;
+                    return true;
+
+                case kFirstType:
+                    if (in_fragmented_record && !scratch->empty())
+                        ReportCorruption(scratch->size(), "partial record without end(2)");
+                    scratch->assign(fragment.data(), fragment.size());
+                    in_fragmented_record = true;
+                    break;
+
+                case kMiddleType:
+                    if (!in_fragmented_record)
+                        ReportCorruption(fragment.size(), "missing start of fragmented record(1)");
+                    else
+                        scratch->append(fragment.data(), fragment.size());
+                    break;
+
+                case kLastType:
+                    if (!in_fragmented_record)
+                    {
+                        ReportCorruption(fragment.size(), "missing start of fragmented record(2)");
+                    }
+                    else
+                    {
+                        scratch->append(fragment.data(), fragment.size());
+                        *record = Slice(*scratch);
+                        return true;
+                    }
+                    break;
+
+                case kEof:
+                    // 写到一半时崩溃留下的不完整记录，直接丢弃不算损坏
+                    scratch->clear();
+                    return false;
+
+                case kBadRecord:
+                    if (in_fragmented_record)
+                    {
+                        ReportCorruption(scratch->size(), "error in middle of record");
+                        in_fragmented_record = false;
+                        scratch->clear();
+                    }
+                    break;
+
+                default:
+                {
+                    char buf[40];
+                    std::snprintf(buf, sizeof(buf), "unknown record type %u", record_type);
+                    ReportCorruption((fragment.size() + (in_fragmented_record ? scratch->size() : 0)), buf);
+                    in_fragmented_record = false;
+                    scratch->clear();
+                    break;
+                }
+                }
+            }
+            return false;
+        }
+
+        inline unsigned int Reader::ReadPhysicalRecord(Slice *result)
+        {
+            while (true)
+            {
+                if (buffer_.size() < kHeaderSize)
+                {
+                    if (!eof_)
+                    {
+                        // 上一个块剩下的是填充，读取下一个块
+                        buffer_.clear();
+                        Status status = file_->Read(kBlockSize, &buffer_, backing_store_);
+                        if (!status.ok())
+                        {
+                            buffer_.clear();
+                            ReportDrop(kBlockSize, status);
+                            eof_ = true;
+                            return kEof;
+                        }
+                        else if (buffer_.size() < kBlockSize)
+                        {
+                            eof_ = true;
+                        }
+                        continue;
+                    }
+                    else
+                    {
+                        // 文件末尾不足一个头部，是写入时崩溃留下的，不算损坏
+                        buffer_.clear();
+                        return kEof;
+                    }
+                }
+
+                const char *header = buffer_.data();
+                const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
+                const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
+                const unsigned int type = header[6];
+                const uint32_t length = a | (b << 8);
+                if (kHeaderSize + length > buffer_.size())
+                {
+                    size_t drop_size = buffer_.size();
+                    buffer_.clear();
+                    if (!eof_)
+                    {
+                        ReportCorruption(drop_size, "bad record length");
+                        return kBadRecord;
+                    }
+                    // 文件末尾的记录不完整，同样是写入时崩溃留下的
+                    return kEof;
+                }
+
+                if (type == kZeroType && length == 0)
+                {
+                    // 预分配的零区域，跳过且不报告
+                    buffer_.clear();
+                    return kBadRecord;
+                }
+
+                if (checksum_)
+                {
+                    uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
+                    uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+                    if (actual_crc != expected_crc)
+                    {
+                        // 长度字段可能也已损坏，丢弃整个块剩下的部分
+                        size_t drop_size = buffer_.size();
+                        buffer_.clear();
+                        ReportCorruption(drop_size, "checksum mismatch");
+                        return kBadRecord;
+                    }
+                }
+
+                buffer_.remove_prefix(kHeaderSize + length);
+                *result = Slice(header + kHeaderSize, length);
+                return type;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+using namespace kvdb::log;
+
+// 内存中的文件，记录写入的数据并支持顺序读取
+class StringFile : public WritableFile, public SequentialFile
+{
+public:
+    std::string contents_;
+    size_t read_pos_ = 0;
+
+    Status Append(const Slice &data) override
+    {
+        contents_.append(data.data(), data.size());
+        return Status::OK();
+    }
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+
+    Status Read(size_t n, Slice *result, char *scratch) override
+    {
+        n = std::min(n, contents_.size() - read_pos_);
+        memcpy(scratch, contents_.data() + read_pos_, n);
+        read_pos_ += n;
+        *result = Slice(scratch, n);
+        return Status::OK();
+    }
+    Status Skip(uint64_t n) override
+    {
+        read_pos_ = std::min<size_t>(contents_.size(), read_pos_ + n);
+        return Status::OK();
+    }
+};
+
+class ReportCollector : public Reader::Reporter
+{
+public:
+    size_t dropped_bytes_ = 0;
+    std::string message_;
+
+    void Corruption(size_t bytes, const Status &status) override
+    {
+        dropped_bytes_ += bytes;
+        message_.append(status.ToString());
+    }
+};
+
+static std::string BigString(const std::string &partial_string, size_t n)
+{
+    std::string result;
+    while (result.size() < n)
+        result.append(partial_string);
+    result.resize(n);
+    return result;
+}
+
+class LogTest : public testing::Test
+{
+protected:
+    StringFile file_;
+    Writer writer_{&file_};
+    ReportCollector report_;
+
+    void Write(const std::string &msg) { ASSERT_TRUE(writer_.AddRecord(Slice(msg)).ok()); }
+
+    std::vector<std::string> ReadAll()
+    {
+        file_.read_pos_ = 0;
+        Reader reader(&file_, &report_, true);
+        std::vector<std::string> records;
+        std::string scratch;
+        Slice record;
+        while (reader.ReadRecord(&record, &scratch))
+            records.push_back(record.ToString());
+        return records;
+    }
+};
+
+TEST_F(LogTest, Empty)
+{
+    EXPECT_TRUE(ReadAll().empty());
+}
+
+TEST_F(LogTest, ReadWrite)
+{
+    Write("foo");
+    Write("bar");
+    Write("");
+    Write("xxxx");
+    EXPECT_EQ(ReadAll(), std::vector<std::string>({"foo", "bar", "", "xxxx"}));
+    EXPECT_EQ(report_.dropped_bytes_, 0u);
+}
+
+TEST_F(LogTest, Fragmentation)
+{
+    // 跨越多个块的记录会被切成First/Middle/Last分片
+    Write("small");
+    Write(BigString("medium", 50000));
+    Write(BigString("large", 100000));
+    std::vector<std::string> records = ReadAll();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0], "small");
+    EXPECT_EQ(records[1], BigString("medium", 50000));
+    EXPECT_EQ(records[2], BigString("large", 100000));
+}
+
+TEST_F(LogTest, MarginalTrailer)
+{
+    // 块末尾恰好只剩一个头部的空间
+    const int n = kBlockSize - 2 * kHeaderSize;
+    Write(BigString("foo", n));
+    ASSERT_EQ(file_.contents_.size(), static_cast<size_t>(kBlockSize - kHeaderSize));
+    Write("");
+    Write("bar");
+    std::vector<std::string> records = ReadAll();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[2], "bar");
+}
+
+TEST_F(LogTest, RandomRead)
+{
+    const int N = 500;
+    Random write_rnd(301);
+    for (int i = 0; i < N; i++)
+        Write(BigString(std::to_string(i), write_rnd.Skewed(17)));
+    Random read_rnd(301);
+    std::vector<std::string> records = ReadAll();
+    ASSERT_EQ(records.size(), static_cast<size_t>(N));
+    for (int i = 0; i < N; i++)
+        ASSERT_EQ(records[i], BigString(std::to_string(i), read_rnd.Skewed(17)));
+}
+
+TEST_F(LogTest, ChecksumMismatch)
+{
+    Write("foooooo");
+    Write("bar");
+    file_.contents_[kHeaderSize + 1] ^= 0x1;
+    // 整个块被丢弃并报告损坏
+    EXPECT_TRUE(ReadAll().empty());
+    EXPECT_GT(report_.dropped_bytes_, 0u);
+    EXPECT_NE(report_.message_.find("checksum mismatch"), std::string::npos);
+}
+
+TEST_F(LogTest, TruncatedTrailingRecordIsIgnored)
+{
+    Write("foo");
+    Write("bar");
+    // 模拟写入最后一条记录时崩溃
+    file_.contents_.resize(file_.contents_.size() - 1);
+    EXPECT_EQ(ReadAll(), std::vector<std::string>({"foo"}));
+    EXPECT_EQ(report_.dropped_bytes_, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,127 @@
+#ifndef STORAGE_KVDB_DB_LOG_WRITER_H_
+#define STORAGE_KVDB_DB_LOG_WRITER_H_
+
+#include <cassert>
+#include <cstdint>
+#include "db/log_format.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/env.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    namespace log
+    {
+        class Writer
+        {
+        public:
+            // dest必须是空文件，Writer存在期间dest必须有效
+            explicit Writer(WritableFile *dest) : dest_(dest), block_offset_(0) { InitTypeCrc(); }
+
+            // dest已有dest_length字节的数据，从末尾继续追加
+            Writer(WritableFile *dest, uint64_t dest_length)
+                : dest_(dest), block_offset_(dest_length % kBlockSize) { InitTypeCrc(); }
+
+            Writer(const Writer &) = delete;
+            Writer &operator=(const Writer &) = delete;
+
+            // 追加一条记录，只写入文件缓冲区，是否落盘由调用方Sync决定
+            Status AddRecord(const Slice &slice);
+
+        private:
+            void InitTypeCrc()
+            {
+                for (int i = 0; i <= kMaxRecordType; i++)
+                {
+                    char t = static_cast<char>(i);
+                    type_crc_[i] = crc32c::Value(&t, 1);
+                }
+            }
+
+            Status EmitPhysicalRecord(RecordType type, const char *ptr, size_t length);
+
+            WritableFile *dest_;
+            int block_offset_; // 当前块内的偏移
+
+            // 预先计算各个type的crc，减少计算每条记录crc的开销
+            uint32_t type_crc_[kMaxRecordType + 1];
+        };
+
+        inline Status Writer::AddRecord(const Slice &slice)
+        {
+            const char *ptr = slice.data();
+            size_t left = slice.size();
+
+            // 必要时切分成多个分片；空记录也要写出一个长度为0的分片
+            Status s;
+            bool begin = true;
+            do
+            {
+                const int leftover = kBlockSize - block_offset_;
+                assert(leftover >= 0);
+                if (leftover < kHeaderSize)
+                {
+                    // 剩余空间放不下头部，用0填满后换到下一个块
+                    if (leftover > 0)
+                    {
+                        static_assert(kHeaderSize == 7, "");
+                        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+                    }
+                    block_offset_ = 0;
+                }
+
+                assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+
+                const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+                const size_t fragment_length = (left < avail) ? left : avail;
+
+                RecordType type;
+                const bool end = (left == fragment_length);
+                if (begin && end)
+                    type = kFullType;
+                else if (begin)
+                    type = kFirstType;
+                else if (end)
+                    type = kLastType;
+                else
+                    type = kMiddleType;
+
+                s = EmitPhysicalRecord(type, ptr, fragment_length);
+                ptr += fragment_length;
+                left -= fragment_length;
+                begin = false;
+            } while (s.ok() && left > 0);
+            return s;
+        }
+
+        inline Status Writer::EmitPhysicalRecord(RecordType t, const char *ptr, size_t length)
+        {
+            assert(length <= 0xffff); // length只有2个字节
+            assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+
+            char buf[kHeaderSize];
+            buf[4] = static_cast<char>(length & 0xff);
+            buf[5] = static_cast<char>(length >> 8);
+            buf[6] = static_cast<char>(t);
+
+            // checksum覆盖type和数据
+            uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+            crc = crc32c::Mask(crc);
+            EncodeFixed32(buf, crc);
+
+            Status s = dest_->Append(Slice(buf, kHeaderSize));
+            if (s.ok())
+            {
+                s = dest_->Append(Slice(ptr, length));
+                if (s.ok())
+                    s = dest_->Flush();
+            }
+            block_offset_ += kHeaderSize + length;
+            return s;
+        }
+    }
+}
+
+#endif
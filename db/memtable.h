@@ -1,37 +1,237 @@
 #ifndef STORAGE_KVDB_DB_MEMTABLE_H_
 #define STORAGE_KVDB_DB_MEMTABLE_H_
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include "db/iterator.h"
 #include "util/KVNode.h"
+#include "util/arena.h"
+#include "util/bloom.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/prefix_extractor.h"
+#include "util/statistics.h"
 #include "skiplist.h"
-#include <memory>
-#include <map>
 namespace kvdb
 {
+    // 新value能否直接赋值到memtable节点中已有的value上，不占用新的内存。
+    // 定长类型总是可以；std::string在新值不超过原有容量时赋值不会重新分配
+    template <typename V>
+    struct InPlaceUpdateFits
+    {
+        bool operator()(const V & /*old_value*/, const V & /*new_value*/) const
+        {
+            return std::is_trivially_copyable<V>::value;
+        }
+    };
+
+    template <>
+    struct InPlaceUpdateFits<std::string>
+    {
+        bool operator()(const std::string &old_value, const std::string &new_value) const
+        {
+            return new_value.size() <= old_value.capacity();
+        }
+    };
+
+    // MemTable拥有自己的arena，skiplist的所有节点都从中分配，
+    // MemTable析构时整块释放
     template <typename K, typename V>
     class MemTable
     {
-        typedef std::shared_ptr<KVnode<K, V>> kvnode;
-
     private:
-        // std::map<K, kvnode> skiplist_;
+        // arena_必须在skiplist_之前构造、之后析构
+        Arena arena_;
         SkipList<K, V> skiplist_;
+        // 原地修改value与读取value按key分段加锁，为0时不支持原地修改
+        const size_t num_locks_;
+        std::unique_ptr<std::shared_mutex[]> locks_;
+        // 插入的key的前缀组成的布隆过滤器，没有设置prefix_extractor时为nullptr
+        const std::shared_ptr<const PrefixExtractor> prefix_extractor_;
+        std::unique_ptr<DynamicBloom> prefix_bloom_;
+        Statistics *const statistics_;
+
+        // key有前缀时返回true，*hash为前缀的BloomHash
+        template <typename Q>
+        bool PrefixHash(const Q &key, uint32_t *hash) const
+        {
+            // 编码用的缓冲区每个线程复用，不必每次分配
+            static thread_local std::string encoded;
+            encoded.clear();
+            Codec<K>::Encode(&encoded, key);
+            if (!prefix_extractor_->InDomain(encoded))
+                return false;
+            *hash = BloomHash(prefix_extractor_->Transform(encoded));
+            return true;
+        }
+
+        void AddPrefix(const K &key)
+        {
+            uint32_t hash;
+            if (prefix_bloom_ != nullptr && PrefixHash(key, &hash))
+                prefix_bloom_->Add(hash);
+        }
+
+        // 前缀过滤器判断key不在memtable中时返回false
+        template <typename Q>
+        bool KeyMayMatch(const Q &key) const
+        {
+            uint32_t hash;
+            if (prefix_bloom_ == nullptr || !PrefixHash(key, &hash) || prefix_bloom_->MayContain(hash))
+                return true;
+            RecordTick(statistics_, kMemTablePrefixBloomUseful);
+            return false;
+        }
 
     public:
-        void Insert(kvnode x);
-        kvnode Get(const K &key);
+        typedef typename SkipList<K, V>::Splice Splice;
+
+        // num_locks大于0时支持Update原地修改。prefix_extractor不为nullptr时建立
+        // prefix_bloom_bits位的前缀布隆过滤器，Get先检查key的前缀，statistics记录过滤掉的次数
+        explicit MemTable(size_t num_locks = 0, std::shared_ptr<const PrefixExtractor> prefix_extractor = nullptr,
+                          size_t prefix_bloom_bits = 0, Statistics *statistics = nullptr)
+            : skiplist_(&arena_), num_locks_(num_locks),
+              locks_(num_locks > 0 ? new std::shared_mutex[num_locks] : nullptr),
+              prefix_extractor_(std::move(prefix_extractor)),
+              prefix_bloom_(prefix_extractor_ != nullptr ? new DynamicBloom(prefix_bloom_bits) : nullptr),
+              statistics_(statistics) {}
+
+        MemTable(const MemTable &) = delete;
+        MemTable &operator=(const MemTable &) = delete;
+
+        // seq为这次修改的序列号，expire_at为过期时间，0表示永不过期
+        void Insert(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at = 0);
+        // 按key升序连续插入多个条目时用同一个splice，减少跳表的查找
+        void Insert(const K &key, const V &value, KType type, SequenceNumber seq, Splice *splice,
+                    uint64_t expire_at = 0);
+        // 多个写线程可以同时调用，不能与Insert混用
+        void InsertConcurrently(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at = 0);
+        // key最新的版本是没有过期时间的value且新value放得下时原地覆盖并把序列号改为seq，不分配新节点，返回true；
+        // 否则不做修改返回false，由调用方Insert。覆盖后旧的值对任何快照都不再可见，
+        // 调用方要保证这时没有快照或迭代器能看到旧版本
+        // REQUIRES: SupportsInPlaceUpdate()，同一时刻只有一个写线程
+        bool Update(const K &key, const V &value, SequenceNumber seq);
+        bool SupportsInPlaceUpdate() const { return num_locks_ > 0; }
+        // 保护key的value的锁。支持原地修改时，读取Get返回的节点的value要持有它的共享锁
+        // REQUIRES: SupportsInPlaceUpdate()
+        std::shared_mutex &GetLock(const K &key) const
+        {
+            assert(SupportsInPlaceUpdate());
+            return locks_[Mix64(static_cast<uint64_t>(std::hash<K>()(key))) % num_locks_];
+        }
+
+        // 返回序列号不大于snapshot的最新版本，指向memtable内部节点，节点随memtable一起释放。
+        // key可以是std::string_view等能与K直接比较的类型
+        template <typename Q>
+        const KVnode<K, V> *Get(const Q &key, SequenceNumber snapshot = kMaxSequenceNumber) const;
+        // 按key升序查找多个key时用同一个splice，从上一个key的位置继续查找
+        const KVnode<K, V> *Get(const K &key, SequenceNumber snapshot, Splice *splice) const;
+
+        // 返回遍历memtable所有节点(包括删除标记和旧版本)的迭代器，调用方负责delete。
+        // 迭代器存在期间memtable不能被释放
+        Iterator<K, V> *NewIterator() const;
+
+        // 前缀过滤器判断memtable中没有以prefix为前缀的key时返回false，没有过滤器时总是返回true
+        bool PrefixMayMatch(const Slice &prefix) const
+        {
+            if (prefix_bloom_ == nullptr || prefix_bloom_->MayContain(BloomHash(prefix)))
+                return true;
+            RecordTick(statistics_, kMemTablePrefixBloomUseful);
+            return false;
+        }
+
+        // memtable占用的内存字节数：arena中的节点加上key和value在堆上的内容，决定何时flush
+        size_t ApproximateMemoryUsage() const { return arena_.MemoryUsage() + skiplist_.ApproximateHeapUsage(); }
+    };
+
+    template <typename K, typename V>
+    class MemTableIterator : public Iterator<K, V>
+    {
+    public:
+        explicit MemTableIterator(const SkipList<K, V> *list) : iter_(list) {}
+
+        bool Valid() const override { return iter_.Valid(); }
+        void SeekToFirst() override { iter_.SeekToFirst(); }
+        void SeekToLast() override { iter_.SeekToLast(); }
+        void Seek(const K &target) override { iter_.Seek(target); }
+        void Next() override { iter_.Next(); }
+        void Prev() override { iter_.Prev(); }
+        const K &key() const override { return iter_.key(); }
+        const V &value() const override { return iter_.value(); }
+        KType type() const override { return iter_.type(); }
+        SequenceNumber sequence() const override { return iter_.sequence(); }
+        uint64_t expire_at() const override { return iter_.expire_at(); }
+
+    private:
+        typename SkipList<K, V>::Iterator iter_;
     };
 
     template <typename K, typename V>
-    void MemTable<K, V>::Insert(kvnode x)
+    Iterator<K, V> *MemTable<K, V>::NewIterator() const
+    {
+        return new MemTableIterator<K, V>(&skiplist_);
+    }
+
+    template <typename K, typename V>
+    void MemTable<K, V>::Insert(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at)
+    {
+        // 先加入过滤器再插入跳表，读线程看到节点时前缀一定已经在过滤器中
+        AddPrefix(key);
+        skiplist_.Insert(key, value, type, seq, expire_at);
+    }
+
+    template <typename K, typename V>
+    void MemTable<K, V>::Insert(const K &key, const V &value, KType type, SequenceNumber seq, Splice *splice,
+                                uint64_t expire_at)
+    {
+        AddPrefix(key);
+        skiplist_.Insert(key, value, type, seq, splice, expire_at);
+    }
+
+    template <typename K, typename V>
+    bool MemTable<K, V>::Update(const K &key, const V &value, SequenceNumber seq)
+    {
+        assert(SupportsInPlaceUpdate());
+        // 只有写线程修改节点，检查时不需要加锁。过期时间不随value修改，带过期时间的节点总是插入新版本
+        KVnode<K, V> *node = skiplist_.GetLatest(key);
+        if (node == nullptr || node->type() != KType::kTypeValue || node->expire_at != 0 ||
+            !InPlaceUpdateFits<V>()(node->value, value))
+            return false;
+
+        std::unique_lock<std::shared_mutex> lock(GetLock(key));
+        node->value = value;
+        // 新的序列号比这个key的其他版本都大，节点在跳表中的位置不变
+        node->SetTag(seq, KType::kTypeValue);
+        return true;
+    }
+
+    template <typename K, typename V>
+    void MemTable<K, V>::InsertConcurrently(const K &key, const V &value, KType type, SequenceNumber seq,
+                                            uint64_t expire_at)
+    {
+        AddPrefix(key);
+        skiplist_.InsertConcurrently(key, value, type, seq, expire_at);
+    }
+
+    template <typename K, typename V>
+    const KVnode<K, V> *MemTable<K, V>::Get(const K &key, SequenceNumber snapshot, Splice *splice) const
     {
-        skiplist_.Insert(x);
+        if (!KeyMayMatch(key))
+            return nullptr;
+        return skiplist_.Get(key, snapshot, splice);
     }
 
     template <typename K, typename V>
-    typename MemTable<K, V>::kvnode MemTable<K, V>::Get(const K &key)
+    template <typename Q>
+    const KVnode<K, V> *MemTable<K, V>::Get(const Q &key, SequenceNumber snapshot) const
     {
+        if (!KeyMayMatch(key))
+            return nullptr;
 
-        return skiplist_.Get(key);
+        return skiplist_.Get(key, snapshot);
     }
 }
 
-#endif
\ No newline at end of file
+#endif
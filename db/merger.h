@@ -0,0 +1,198 @@
+#ifndef STORAGE_KVDB_DB_MERGER_H_
+#define STORAGE_KVDB_DB_MERGER_H_
+#include "db/iterator.h"
+#include <cassert>
+#include <memory>
+#include <vector>
+
+namespace kvdb
+{
+    // 把多个有序迭代器合并成一个。key相同时按children的顺序输出，
+    // 所以children应当从新到旧排列(memtable、immutable memtable、最新的文件...)，
+    // 这样同一个key的各个版本仍然是新版本在前，上层的DBIter可以直接使用
+    template <typename K, typename V>
+    class MergingIterator : public Iterator<K, V>
+    {
+    public:
+        // 接管children的所有权
+        explicit MergingIterator(const std::vector<Iterator<K, V> *> &children)
+            : current_(nullptr), direction_(kForward)
+        {
+            for (Iterator<K, V> *child : children)
+                children_.emplace_back(child);
+        }
+
+        bool Valid() const override { return current_ != nullptr; }
+
+        void SeekToFirst() override
+        {
+            for (auto &child : children_)
+                child->SeekToFirst();
+            FindSmallest();
+            direction_ = kForward;
+        }
+
+        void SeekToLast() override
+        {
+            for (auto &child : children_)
+                child->SeekToLast();
+            FindLargest();
+            direction_ = kReverse;
+        }
+
+        void Seek(const K &target) override
+        {
+            for (auto &child : children_)
+                child->Seek(target);
+            FindSmallest();
+            direction_ = kForward;
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+
+            // 反向移动之后其他child位于小于key()的位置，
+            // 需要把它们移到合并顺序中key()之后的第一个条目
+            if (direction_ != kForward)
+            {
+                const K target = key();
+                for (size_t i = 0; i < children_.size(); ++i)
+                {
+                    Iterator<K, V> *child = children_[i].get();
+                    if (child == current_)
+                        continue;
+                    child->Seek(target);
+                    // 排在current_之前的child中等于target的条目已经输出过
+                    if (i < current_index_)
+                    {
+                        while (child->Valid() && !(target < child->key()))
+                            child->Next();
+                    }
+                }
+                direction_ = kForward;
+            }
+
+            current_->Next();
+            FindSmallest();
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+
+            // 正向移动之后其他child位于大于key()的位置，
+            // 需要把它们移到合并顺序中key()之前的最后一个条目
+            if (direction_ != kReverse)
+            {
+                const K target = key();
+                for (size_t i = 0; i < children_.size(); ++i)
+                {
+                    Iterator<K, V> *child = children_[i].get();
+                    if (child == current_)
+                        continue;
+                    child->Seek(target);
+                    // 排在current_之前的child中等于target的条目在合并顺序中位于current_之前
+                    if (i < current_index_)
+                    {
+                        while (child->Valid() && !(target < child->key()))
+                            child->Next();
+                    }
+                    if (child->Valid())
+                        child->Prev();
+                    else
+                        child->SeekToLast();
+                }
+                direction_ = kReverse;
+            }
+
+            current_->Prev();
+            FindLargest();
+        }
+
+        const K &key() const override
+        {
+            assert(Valid());
+            return current_->key();
+        }
+
+        const V &value() const override
+        {
+            assert(Valid());
+            return current_->value();
+        }
+
+        KType type() const override
+        {
+            assert(Valid());
+            return current_->type();
+        }
+
+        SequenceNumber sequence() const override
+        {
+            assert(Valid());
+            return current_->sequence();
+        }
+
+        uint64_t expire_at() const override
+        {
+            assert(Valid());
+            return current_->expire_at();
+        }
+
+        Status status() const override
+        {
+            for (auto &child : children_)
+            {
+                Status s = child->status();
+                if (!s.ok())
+                    return s;
+            }
+            return Status::OK();
+        }
+
+    private:
+        enum Direction
+        {
+            kForward,
+            kReverse
+        };
+
+        // key相同时取下标最小(最新)的child
+        void FindSmallest()
+        {
+            current_ = nullptr;
+            for (size_t i = 0; i < children_.size(); ++i)
+            {
+                Iterator<K, V> *child = children_[i].get();
+                if (child->Valid() && (current_ == nullptr || child->key() < current_->key()))
+                {
+                    current_ = child;
+                    current_index_ = i;
+                }
+            }
+        }
+
+        // key相同时取下标最大(最旧)的child，与正向的顺序相反
+        void FindLargest()
+        {
+            current_ = nullptr;
+            for (size_t i = 0; i < children_.size(); ++i)
+            {
+                Iterator<K, V> *child = children_[i].get();
+                if (child->Valid() && (current_ == nullptr || !(child->key() < current_->key())))
+                {
+                    current_ = child;
+                    current_index_ = i;
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<Iterator<K, V>>> children_;
+        Iterator<K, V> *current_;
+        size_t current_index_;
+        Direction direction_;
+    };
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef STORAGE_KVDB_DB_OPTIONS_H_
+#define STORAGE_KVDB_DB_OPTIONS_H_
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "util/compression.h"
+#include "util/env.h"
+#include "util/prefix_extractor.h"
+#include "util/statistics.h"
+
+namespace kvdb
+{
+    namespace cache
+    {
+        class CacheBudget;
+    }
+
+    class BlockCache;
+
+    // 控制Table行为的选项
+    struct Options
+    {
+        // 缓存的容量(字节)。每个条目按句柄的大小加上key和value在堆上的内存计算
+        size_t cache_capacity = 8 * 1024 * 1024;
+
+        // 不为空时多个Table的缓存共用这个容量上限，cache_capacity被忽略
+        std::shared_ptr<cache::CacheBudget> cache_budget;
+
+        // 缓存分成2^cache_shard_bits个分片，各自加锁；小于0时根据容量自动选择
+        int cache_shard_bits = -1;
+
+        // 为true时多个线程可以同时调用Table::Insert/Remove，
+        // memtable使用CAS并发插入；为false时调用方需要保证只有一个写线程
+        bool allow_concurrent_memtable_write = false;
+
+        // 为true时覆盖写一个已经在当前memtable中的key，且新value放得下时直接修改原来的节点，
+        // 不分配新节点，反复覆盖同一批key时memtable不会增长。存在快照或迭代器期间照常插入新版本。
+        // 与allow_concurrent_memtable_write同时开启时不生效
+        bool inplace_update = false;
+
+        // 原地修改时按key分段加锁的段数
+        size_t inplace_update_num_locks = 10000;
+
+        // 不为nullptr时记录计数和读写的延迟分布，多个Table可以共用一个。
+        // 每次读写多几次原子加法；StatsLevel::kAll时每次读写还要多读两次时钟
+        std::shared_ptr<Statistics> statistics;
+
+        // 不为nullptr时按key的前缀建立布隆过滤器：每个memtable一个，查找memtable前先检查key的前缀；
+        // bloom_bits_per_key大于0时每个有序表文件也写入一个前缀过滤器。
+        // ReadOptions::prefix_same_as_start的Scan跳过过滤器判断不含这个前缀的memtable和文件
+        std::shared_ptr<const PrefixExtractor> prefix_extractor;
+
+        // memtable前缀布隆过滤器的字节数占write_buffer_size的比例
+        double memtable_prefix_bloom_size_ratio = 0.02;
+
+        // 文件系统接口，也是带过期时间的条目(Table::Insert的ttl)使用的时钟。
+        // 只在内存中的Table只用它的NowMicros
+        Env *env = Env::Default();
+
+        // 以下选项只对带目录打开的Table生效
+
+        // 为true时每组写入在返回前对日志执行fdatasync，崩溃不会丢失已返回的写入。
+        // 并发的写入会合并成一组，共用一次write和fdatasync
+        bool sync = true;
+
+        // 一组写入合并成一条日志记录的最大字节数
+        size_t max_write_batch_group_size = 1 << 20;
+
+        // memtable超过这个大小后转为只读，由后台线程写入磁盘上的有序表文件
+        size_t write_buffer_size = 4 * 1024 * 1024;
+
+        // 有序表文件中数据块的大小(未压缩)
+        size_t block_size = 4 * 1024;
+
+        // 数据块内每隔多少个key保存一个完整的key(restart point)，其余key只保存与前一个key不同的后缀
+        int block_restart_interval = 16;
+
+        // 数据块的压缩算法，压缩后节省不到1/8时原样保存。当前编译的版本不支持的算法(见
+        // CompressionTypeSupported)也原样保存。读取时按块尾部记录的算法解压，解压后的块放入块缓存
+        CompressionType compression = kNoCompression;
+
+        // 不为空时第i层的文件使用compression_per_level[i]，更深的层使用最后一个，compression被忽略。
+        // 例如{kNoCompression, kLZ4Compression, kLZ4Compression, kZstdCompression}：
+        // 第0层不压缩，第1、2层用LZ4，第3层及以下用Zstd
+        std::vector<CompressionType> compression_per_level;
+
+        // Zstd的压缩级别
+        int zstd_compression_level = 3;
+
+        // 大于0时每个用Zstd压缩的文件从开头的数据块训练一个不超过这个大小的字典，保存在文件中。
+        // 块之间重复的内容(如JSON的字段名)放进字典，小块的压缩率明显提高
+        size_t zstd_max_dict_bytes = 0;
+
+        // 训练字典使用的数据块的总大小，字典训练好之前这些块缓存在内存中
+        size_t zstd_max_train_bytes = 1 << 20;
+
+        // 读取有序表文件时校验块的crc
+        bool verify_checksums = true;
+
+        // 有序表文件的块缓存，缓存读入的块，重复读同一个块时不再读文件和校验crc。
+        // 为nullptr时使用进程内所有Table共用的BlockCache::Default()
+        std::shared_ptr<BlockCache> block_cache;
+
+        // 为true时不使用块缓存，每次都从文件读取
+        bool no_block_cache = false;
+
+        // 为true时索引块和过滤器块也以高优先级放入块缓存，占用计入缓存的容量；
+        // 为false时由打开的文件自己持有，不计入缓存
+        bool cache_index_and_filter_blocks = false;
+
+        // cache_index_and_filter_blocks为true时，打开的文件仍然一直持有自己的索引块和过滤器块，
+        // 它们被淘汰后也不需要重新读取；为false时每次查找从块缓存中取
+        bool pin_index_and_filter_blocks = false;
+
+        // 为true时有序表文件整个映射到内存，读取数据块直接使用映射中的地址，
+        // 不为每个块分配缓冲区和拷贝。点查的文件提示内核不要预读，合并的输入文件提示顺序读取
+        bool use_mmap_reads = false;
+
+        // 同时映射的有序表文件数上限，超过后新打开的文件退回到pread
+        int max_mmap_files = 1000;
+
+        // 每个有序表文件带一个布隆过滤器，每个key占用的位数，10位时误判率约1%。
+        // 打开文件时过滤器读入内存，查找不存在的key时通常不需要读任何块。0表示不使用
+        int bloom_bits_per_key = 10;
+
+        // 第0层的文件由memtable直接写入，互相之间key范围可能重叠，查找时要逐个检查。
+        // 文件数达到这个值时开始把第0层合并到第1层
+        int level0_file_num_compaction_trigger = 4;
+
+        // 第0层文件数达到这个值时每次写入延迟1ms，让后台线程追上
+        int level0_slowdown_writes_trigger = 8;
+
+        // 第0层文件数达到这个值时写入等待后台合并
+        int level0_stop_writes_trigger = 12;
+
+        // 第1层的总大小上限，之后每层是上一层的10倍，超过时合并到下一层
+        uint64_t max_bytes_for_level_base = 10 * 1024 * 1024;
+
+        // 合并产生的单个有序表文件的目标大小
+        uint64_t max_file_size = 2 * 1024 * 1024;
+    };
+
+    class Snapshot;
+
+    // 控制一次读取的选项
+    struct ReadOptions
+    {
+        // 不为nullptr时只读取快照创建之前写入的数据，不经过缓存；
+        // 为nullptr时读取最新的数据。快照必须由同一个Table的GetSnapshot返回且没有释放
+        const Snapshot *snapshot = nullptr;
+
+        // 为true且Options::prefix_extractor不为nullptr时，Scan只返回与begin前缀相同的key，
+        // 遇到第一个前缀不同的key就停止，并且不遍历前缀过滤器判断不含这个前缀的memtable和文件。
+        // begin没有前缀时与普通的Scan相同
+        bool prefix_same_as_start = false;
+    };
+}
+
+#endif
@@ -2,56 +2,217 @@
 #define STORAGE_KVDB_DB_SKIPLIST_H_
 #include <cassert>
 #include <atomic>
-#include <malloc.h>
+#include <functional>
+#include <new>
+#include <thread>
+#include <utility>
+#include "util/arena.h"
 #include "util/random.h"
 #include "util/KVNode.h"
-#include <memory>
+#include "util/perf_context.h"
 namespace kvdb
 {
 
-    template <typename K, typename V>
-    class SkipList
+    // SkipList默认的key顺序：直接用operator<比较，Q可以是能与K比较的类型(如std::string_view)
+    struct DefaultKeyOrder
     {
-        typedef std::shared_ptr<KVnode<K, V>> kvnode;
+        template <typename A, typename B>
+        bool Less(const A &a, const B &b) const { return a < b; }
+    };
 
+    // 节点及其内联的key/value都从arena中分配，SkipList析构时只调用析构函数，
+    // 内存随arena一起释放，所以arena的生命周期必须长于SkipList。
+    // 节点按(key升序, 序列号降序)排列，同一个key的多次写入都会保留，新版本排在旧版本之前。
+    // 序列号相同时后插入的节点排在前面。
+    // key的顺序由Order::Less(a, b)决定，例如InlineSkipList用指向arena中条目的EntryRef作为key，
+    // 按运行时指定的Comparator排列
+    template <typename K, typename V, typename Order = DefaultKeyOrder>
+    class SkipList
+    {
     private:
         struct Node;
 
     public:
-        SkipList();
+        // 记录上一次Insert或Get每一层的前驱节点。按key升序连续操作时，下一个key的查找
+        // 从这些节点开始，不必每次都从head_出发。节点不会被删除，所以Splice一直有效
+        class Splice
+        {
+        public:
+            Splice()
+            {
+                for (Node *&x : prev_)
+                    x = nullptr;
+            }
+
+        private:
+            friend class SkipList;
+            // prev_[i]为第i层上一个key的前驱，为nullptr时这一层没有记录
+            Node *prev_[12];
+        };
+
+        explicit SkipList(Arena *arena, Order order = Order());
+        ~SkipList();
 
-        // insert key into skiplist
-        void Insert(kvnode x);
+        SkipList(const SkipList &) = delete;
+        SkipList &operator=(const SkipList &) = delete;
 
-        kvnode Get(const K &key);
+        // insert key into skiplist，expire_at为节点的过期时间，0表示永不过期
+        // REQUIRES: 同一时刻只有一个写线程
+        void Insert(const K &key, const V &value, KType type, SequenceNumber seq = 0, uint64_t expire_at = 0);
+        // 带位置提示的插入，每一层从splice中小于key的前驱开始查找，插入后更新splice。
+        // key不小于上一次用同一个splice操作的key时最快
+        // REQUIRES: 同一时刻只有一个写线程
+        void Insert(const K &key, const V &value, KType type, SequenceNumber seq, Splice *splice,
+                    uint64_t expire_at = 0);
+
+        // 允许多个线程同时调用的插入，每层通过CAS把新节点接入链表，
+        // 读线程不需要加锁。不能与Insert同时使用
+        void InsertConcurrently(const K &key, const V &value, KType type, SequenceNumber seq = 0,
+                                uint64_t expire_at = 0);
+
+        // 返回key序列号不大于snapshot的最新节点(包括删除标记)，不存在返回nullptr。
+        // Q为K或者可以直接与K比较的类型，如std::string对应的std::string_view，查找时不构造K
+        template <typename Q>
+        const KVnode<K, V> *Get(const Q &key, SequenceNumber snapshot = kMaxSequenceNumber) const;
+        // 带位置提示的Get，用法与带splice的Insert相同。可以与写线程并发
+        const KVnode<K, V> *Get(const K &key, SequenceNumber snapshot, Splice *splice) const;
+        // 返回key最新的节点(包括删除标记)，供MemTable原地修改使用，不存在返回nullptr。
+        // 修改节点时不能改变它在链表中的位置
+        // REQUIRES: 同一时刻只有一个写线程
+        KVnode<K, V> *GetLatest(const K &key);
         // if key in skiplist return true
         bool Contains(const K &key) const;
 
+        // 节点内的key和value在堆上另外占用的字节数(例如长std::string的内容)，不在arena中
+        size_t ApproximateHeapUsage() const { return heap_usage_.load(std::memory_order_relaxed); }
+
+        // 遍历skiplist的迭代器，直接返回节点内的引用，不做拷贝
+        class Iterator
+        {
+        public:
+            // 迭代器创建后处于无效状态
+            explicit Iterator(const SkipList *list) : list_(list), node_(nullptr) {}
+
+            bool Valid() const { return node_ != nullptr; }
+
+            // REQUIRES: Valid()
+            const KVnode<K, V> &node() const
+            {
+                assert(Valid());
+                return node_->kvnode_;
+            }
+            const K &key() const { return node().key; }
+            const V &value() const { return node().value; }
+            KType type() const { return node().type(); }
+            SequenceNumber sequence() const { return node().sequence(); }
+            uint64_t expire_at() const { return node().expire_at; }
+
+            // REQUIRES: Valid()
+            void Next()
+            {
+                assert(Valid());
+                node_ = node_->Next(0);
+            }
+
+            // 节点没有prev指针，从头查找最后一个小于当前key的节点，
+            // 再沿第0层越过同key的较新版本找到当前节点的前驱
+            // REQUIRES: Valid()
+            void Prev()
+            {
+                assert(Valid());
+                Node *x = list_->FindLessThan(node_->key());
+                while (x->Next(0) != node_)
+                    x = x->Next(0);
+                node_ = (x == list_->head_) ? nullptr : x;
+            }
+
+            // 定位到第一个 >= target 的节点，即target最新的版本
+            // target可以是Order能与K比较的其他类型
+            template <typename Q>
+            void Seek(const Q &target) { node_ = list_->FindGreaterOrEqual(target, kMaxSequenceNumber, nullptr); }
+
+            void SeekToFirst() { node_ = list_->head_->Next(0); }
+
+            void SeekToLast()
+            {
+                node_ = list_->FindLast();
+                if (node_ == list_->head_)
+                    node_ = nullptr;
+            }
+
+        private:
+            const SkipList *list_;
+            Node *node_;
+        };
+
     private:
         inline int GetMaxHeight() const { return max_height_.load(std::memory_order_relaxed); }
 
-        const int KMaxHeight = 12;
+        static const int KMaxHeight = 12;
+        static_assert(sizeof(Splice::prev_) / sizeof(Node *) == KMaxHeight, "Splice must cover every level");
+        Arena *const arena_;
+        const Order order_;
+        std::atomic<size_t> heap_usage_;
         Node *const head_;
-        Node *NewNode(kvnode key, int height);
+        Node *NewNode(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at, int height);
+        Node *NewNodeConcurrently(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at,
+                                  int height);
         std::atomic<int> max_height_;
 
-        Node *FindNodeEqual(const K &key, Node **prev) const;
+        // 节点x是否排在(key, seq)之前：key更小，或者key相同而序列号更大
+        template <typename Q>
+        bool Before(const Node *x, const Q &key, SequenceNumber seq) const
+        {
+            return order_.Less(x->key(), key) || (!order_.Less(key, x->key()) && x->sequence() > seq);
+        }
+
+        // 第一个不小于key的节点x是否就是key
+        template <typename Q>
+        bool Matches(const Node *x, const Q &key) const { return x != nullptr && !order_.Less(key, x->key()); }
+
+        // 把一次查找经过的层数、前进的节点数和比较次数加到当前线程的PerfContext上
+        static void RecordSearch(uint64_t levels, uint64_t visited, uint64_t comparisons)
+        {
+            if (GetPerfLevel() < PerfLevel::kEnableCount)
+                return;
+            PerfContext *context = GetPerfContext();
+            context->skiplist_levels_visited += levels;
+            context->skiplist_nodes_visited += visited;
+            context->key_comparisons += comparisons;
+        }
+
+        // 返回第一个不排在(key, seq)之前的节点，prev[i]记录第i层最后一个排在它之前的节点
+        template <typename Q>
+        Node *FindGreaterOrEqual(const Q &key, SequenceNumber seq, Node **prev) const;
+        // 同上，每一层从splice中的前驱开始查找，前驱不在(key, seq)之前时忽略。查找后把prev记入splice
+        Node *FindGreaterOrEqual(const K &key, SequenceNumber seq, Node **prev, Splice *splice) const;
+        // 返回最后一个key < key的节点，不存在时返回head_
+        Node *FindLessThan(const K &key) const;
+        // 返回最后一个节点，链表为空时返回head_
+        Node *FindLast() const;
+        // 从before开始在第level层向后查找，使得before排在(key, seq)之前而after不在
+        void FindSpliceForLevel(const K &key, SequenceNumber seq, Node *before, int level, Node **out_prev,
+                                Node **out_next) const;
         int RandomHeight();
+        // 每个线程使用自己的随机数生成器，供InsertConcurrently使用
+        int RandomHeightConcurrently();
+        int RandomHeight(Random *rnd);
 
         Random rnd_;
     };
 
-    template <typename K, typename V>
-    struct SkipList<K, V>::Node
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node
     {
 
-        explicit Node(std::shared_ptr<KVnode<K, V>> k) : kvnode_(k) {}
+        Node(const K &k, const V &v, KType t, SequenceNumber s, uint64_t e) : kvnode_(k, v, t, s, e) {}
 
-        std::shared_ptr<KVnode<K, V>> kvnode_;
+        KVnode<K, V> kvnode_;
 
-        inline K &key() { return kvnode_->key; }
-        inline V &value() { return kvnode_->value; }
-        inline KType ktype() { return kvnode_->type; }
+        inline const K &key() const { return kvnode_.key; }
+        inline const V &value() const { return kvnode_.value; }
+        inline KType ktype() const { return kvnode_.type(); }
+        inline SequenceNumber sequence() const { return kvnode_.sequence(); }
         Node *Next(int n)
         {
             assert(n >= 0);
@@ -76,60 +237,142 @@ namespace kvdb
             next_[n].store(x, std::memory_order_relaxed);
         }
 
+        bool CASNext(int n, Node *expected, Node *x)
+        {
+            assert(n >= 0);
+            return next_[n].compare_exchange_strong(expected, x);
+        }
+
     private:
         // next_是一个不定长数组，next[i] 代表第i层
         std::atomic<Node *> next_[1];
     };
 
-    template <typename K, typename V>
-    struct SkipList<K, V>::Node *SkipList<K, V>::NewNode(kvnode x, int height)
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::NewNode(const K &key, const V &value, KType type, SequenceNumber seq,
+                                                         uint64_t expire_at, int height)
     {
-        char *const node_memory = (char *const)malloc(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node *>));
-        return new (node_memory) Node(x);
+        static_assert(alignof(Node) <= Arena::kAlign, "Node alignment exceeds arena alignment");
+        char *const node_memory = arena_->AllocateAligned(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node *>));
+        Node *x = new (node_memory) Node(key, value, type, seq, expire_at);
+        heap_usage_.fetch_add(HeapUsage(x->key()) + HeapUsage(x->value()), std::memory_order_relaxed);
+        return x;
     }
 
-    template <typename K, typename V>
-    SkipList<K, V>::SkipList() : head_(NewNode(kvnode(), KMaxHeight)), max_height_(1), rnd_(0xdeadbeef)
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::NewNodeConcurrently(const K &key, const V &value, KType type,
+                                                                     SequenceNumber seq, uint64_t expire_at,
+                                                                     int height)
+    {
+        char *const node_memory = arena_->AllocateAlignedConcurrent(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node *>));
+        Node *x = new (node_memory) Node(key, value, type, seq, expire_at);
+        heap_usage_.fetch_add(HeapUsage(x->key()) + HeapUsage(x->value()), std::memory_order_relaxed);
+        return x;
+    }
+
+    template <typename K, typename V, typename Order>
+    SkipList<K, V, Order>::SkipList(Arena *arena, Order order)
+        : arena_(arena), order_(std::move(order)), heap_usage_(0), head_(NewNode(K(), V(), KType::kTypeValue, 0, 0, KMaxHeight)), max_height_(1), rnd_(0xdeadbeef)
     {
 
         for (int i = 0; i < KMaxHeight; ++i)
             head_->SetNext(i, nullptr);
     }
 
-    template <typename K, typename V>
-    struct SkipList<K, V>::Node *SkipList<K, V>::FindNodeEqual(const K &key, Node **prev) const
+    template <typename K, typename V, typename Order>
+    SkipList<K, V, Order>::~SkipList()
+    {
+        // 内存属于arena，这里只负责析构内联的key/value(例如std::string持有的堆内存)
+        Node *x = head_;
+        while (x != nullptr)
+        {
+            Node *next = x->NoBarrier_Next(0);
+            x->~Node();
+            x = next;
+        }
+    }
+
+    template <typename K, typename V, typename Order>
+    template <typename Q>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::FindGreaterOrEqual(const Q &key, SequenceNumber seq, Node **prev) const
     {
         Node *now = head_;
+        // 计数只在局部变量中累加，查找结束时加到PerfContext上一次
+        uint64_t visited = 0, comparisons = 0;
 
-        int height = GetMaxHeight();
+        const int max_height = GetMaxHeight();
+        int height = max_height;
         while (height--)
         {
             Node *next = now->Next(height);
-            while (next != nullptr && next->key() <= key)
+            while (next != nullptr && Before(next, key, seq))
             {
                 now = next;
                 next = now->Next(height);
+                ++visited;
             }
+            comparisons += next != nullptr;
             if (prev != nullptr)
                 prev[height] = now;
+            if (height == 0)
+            {
+                RecordSearch(max_height, visited, visited + comparisons);
+                return next;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::FindLessThan(const K &key) const
+    {
+        Node *now = head_;
+
+        int height = GetMaxHeight();
+        while (height--)
+        {
+            Node *next = now->Next(height);
+            while (next != nullptr && order_.Less(next->key(), key))
+            {
+                now = next;
+                next = now->Next(height);
+            }
+        }
+        return now;
+    }
+
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::FindLast() const
+    {
+        Node *now = head_;
+
+        int height = GetMaxHeight();
+        while (height--)
+        {
+            Node *next = now->Next(height);
+            while (next != nullptr)
+            {
+                now = next;
+                next = now->Next(height);
+            }
         }
         return now;
     }
 
-    template <typename K, typename V>
-    bool SkipList<K, V>::Contains(const K &key) const
+    template <typename K, typename V, typename Order>
+    bool SkipList<K, V, Order>::Contains(const K &key) const
     {
-        Node *now = FindNodeEqual(key, nullptr);
-        return (now != nullptr && now->key() == key);
+        Node *x = FindGreaterOrEqual(key, kMaxSequenceNumber, nullptr);
+        return Matches(x, key);
     }
 
-    template <typename K, typename V>
-    int SkipList<K, V>::RandomHeight()
+    template <typename K, typename V, typename Order>
+    int SkipList<K, V, Order>::RandomHeight(Random *rnd)
     {
         // Increase height with probability 1 in kBranching
         static const unsigned int kBranching = 4;
         int height = 1;
-        while (height < KMaxHeight && rnd_.OneIn(kBranching))
+        while (height < KMaxHeight && rnd->OneIn(kBranching))
         {
             height++;
         }
@@ -138,13 +381,46 @@ namespace kvdb
         return height;
     }
 
-    template <typename K, typename V>
-    void SkipList<K, V>::Insert(kvnode kvnode)
+    template <typename K, typename V, typename Order>
+    int SkipList<K, V, Order>::RandomHeight()
+    {
+        return RandomHeight(&rnd_);
+    }
+
+    template <typename K, typename V, typename Order>
+    int SkipList<K, V, Order>::RandomHeightConcurrently()
+    {
+        // 种子取自线程id，避免不同线程生成相同的高度序列
+        static thread_local Random rnd(static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+        return RandomHeight(&rnd);
+    }
+
+    template <typename K, typename V, typename Order>
+    void SkipList<K, V, Order>::FindSpliceForLevel(const K &key, SequenceNumber seq, Node *before, int level, Node **out_prev,
+                                            Node **out_next) const
+    {
+        uint64_t visited = 0;
+        while (true)
+        {
+            Node *next = before->Next(level);
+            if (next == nullptr || !Before(next, key, seq))
+            {
+                *out_prev = before;
+                *out_next = next;
+                RecordSearch(1, visited, visited + (next != nullptr));
+                return;
+            }
+            before = next;
+            ++visited;
+        }
+    }
+
+    template <typename K, typename V, typename Order>
+    void SkipList<K, V, Order>::Insert(const K &key, const V &value, KType type, SequenceNumber seq, uint64_t expire_at)
     {
 
-        K &key = kvnode->key;
         Node *prev[KMaxHeight];
-        Node *x = FindNodeEqual(key, prev);
+        Node *x = FindGreaterOrEqual(key, seq, prev);
 
         int height = RandomHeight();
         if (height > GetMaxHeight())
@@ -154,7 +430,7 @@ namespace kvdb
             max_height_.store(height, std::memory_order_relaxed);
         }
 
-        x = NewNode(kvnode, height);
+        x = NewNode(key, value, type, seq, expire_at, height);
 
         for (int i = 0; i < height; ++i)
         {
@@ -163,15 +439,118 @@ namespace kvdb
         }
     }
 
-    template <typename K, typename V>
-    typename SkipList<K, V>::kvnode SkipList<K, V>::Get(const K &key)
+    template <typename K, typename V, typename Order>
+    struct SkipList<K, V, Order>::Node *SkipList<K, V, Order>::FindGreaterOrEqual(const K &key, SequenceNumber seq, Node **prev,
+                                                                    Splice *splice) const
+    {
+        const int max_height = GetMaxHeight();
+        Node *before = head_;
+        Node *next = nullptr;
+        for (int i = max_height - 1; i >= 0; --i)
+        {
+            // splice和上一层找到的前驱都在这一层上且排在(key, seq)之前，从较靠后的一个开始
+            Node *hint = splice->prev_[i];
+            if (hint != nullptr && hint != head_ && Before(hint, key, seq) &&
+                (before == head_ || Before(before, hint->key(), hint->sequence())))
+                before = hint;
+            FindSpliceForLevel(key, seq, before, i, &prev[i], &next);
+            before = prev[i];
+            splice->prev_[i] = prev[i];
+        }
+        return next;
+    }
+
+    template <typename K, typename V, typename Order>
+    void SkipList<K, V, Order>::Insert(const K &key, const V &value, KType type, SequenceNumber seq, Splice *splice,
+                                uint64_t expire_at)
     {
-        Node *x = FindNodeEqual(key, nullptr);
+        Node *prev[KMaxHeight];
+        FindGreaterOrEqual(key, seq, prev, splice);
+
+        int height = RandomHeight();
+        if (height > GetMaxHeight())
+        {
+            for (int i = GetMaxHeight(); i < height; ++i)
+                prev[i] = head_;
+            max_height_.store(height, std::memory_order_relaxed);
+        }
 
-        // 找到node有三种情况，找不到证明可能持久化可能不存在return nullptr
-        // 找到判断type, ktype == delete 证明删除了 返回nullptr
-        // ktype == value 才返回kvnode
-        return (x != head_ && x != nullptr && x->key() == key && x->ktype() == KType::kTypeValue) ? x->kvnode_ : nullptr;
+        Node *x = NewNode(key, value, type, seq, expire_at, height);
+        for (int i = 0; i < height; ++i)
+        {
+            x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+            prev[i]->SetNext(i, x);
+        }
+    }
+
+    template <typename K, typename V, typename Order>
+    void SkipList<K, V, Order>::InsertConcurrently(const K &key, const V &value, KType type, SequenceNumber seq,
+                                            uint64_t expire_at)
+    {
+        int height = RandomHeightConcurrently();
+
+        // 用CAS提升max_height_，失败说明其他线程已经提升到更高
+        int max_height = GetMaxHeight();
+        while (height > max_height)
+        {
+            if (max_height_.compare_exchange_weak(max_height, height))
+            {
+                max_height = height;
+                break;
+            }
+        }
+
+        // 自顶向下计算每一层的插入位置
+        Node *prev[KMaxHeight];
+        Node *next[KMaxHeight];
+        Node *before = head_;
+        for (int i = max_height - 1; i >= 0; --i)
+        {
+            FindSpliceForLevel(key, seq, before, i, &prev[i], &next[i]);
+            before = prev[i];
+        }
+
+        Node *x = NewNodeConcurrently(key, value, type, seq, expire_at, height);
+
+        // 自底向上接入，保证在第i层可见的节点在更低层一定可见
+        for (int i = 0; i < height; ++i)
+        {
+            while (true)
+            {
+                x->NoBarrier_SetNext(i, next[i]);
+                if (prev[i]->CASNext(i, next[i], x))
+                    break;
+                // 有其他线程在prev[i]之后插入了节点，从prev[i]重新查找这一层
+                FindSpliceForLevel(key, seq, prev[i], i, &prev[i], &next[i]);
+            }
+        }
+    }
+
+    template <typename K, typename V, typename Order>
+    const KVnode<K, V> *SkipList<K, V, Order>::Get(const K &key, SequenceNumber snapshot, Splice *splice) const
+    {
+        Node *prev[KMaxHeight];
+        Node *x = FindGreaterOrEqual(key, snapshot, prev, splice);
+        return Matches(x, key) ? &x->kvnode_ : nullptr;
+    }
+
+    template <typename K, typename V, typename Order>
+    template <typename Q>
+    const KVnode<K, V> *SkipList<K, V, Order>::Get(const Q &key, SequenceNumber snapshot) const
+    {
+        // 第一个不排在(key, snapshot)之前的节点就是快照中可见的最新版本
+        Node *x = FindGreaterOrEqual(key, snapshot, nullptr);
+
+        // 找不到证明可能持久化可能不存在return nullptr
+        // 找到则直接返回节点，由调用方根据ktype判断是否已被删除
+        return Matches(x, key) ? &x->kvnode_ : nullptr;
+    }
+
+    template <typename K, typename V, typename Order>
+    KVnode<K, V> *SkipList<K, V, Order>::GetLatest(const K &key)
+    {
+        Node *x = FindGreaterOrEqual(key, kMaxSequenceNumber, nullptr);
+        return Matches(x, key) ? &x->kvnode_ : nullptr;
     }
 }
 #endif
\ No newline at end of file
@@ -1,48 +1,55 @@
 #include "db/skiplist.h"
+#include "db/inline_skiplist.h"
 
 #include <gtest/gtest.h>
 
 #include <thread>
 #include <iostream>
 #include <cassert>
+#include <string>
+#include <vector>
 using namespace kvdb;
 
 TEST(SkipListTest, EmptyList)
 {
-    SkipList<int> list;
+    Arena arena;
+    SkipList<int, int> list(&arena);
     EXPECT_FALSE(list.Contains(10));
 }
 
 TEST(SkipListTest, InsertInterage)
 {
     const int N = 1000;
-    SkipList<int> list;
+    Arena arena;
+    SkipList<int, int> list(&arena);
 
     for (int i = 1; i < N; ++i)
-        list.Insert(i);
+        list.Insert(i, i, KType::kTypeValue);
     for (int i = 1; i < N; ++i)
         EXPECT_TRUE(list.Contains(i));
 }
 
 TEST(SkipListTest, InsertChar)
 {
-    SkipList<char> list;
+    Arena arena;
+    SkipList<char, int> list(&arena);
 
     for (int i = 0; i < 26; ++i)
-        list.Insert(i + 'a');
+        list.Insert(i + 'a', i, KType::kTypeValue);
     for (int i = 0; i < 26; ++i)
         EXPECT_TRUE(list.Contains(i + 'a'));
 }
 
 TEST(SkipListTest, InsertString)
 {
-    SkipList<std::string> list;
+    Arena arena;
+    SkipList<std::string, int> list(&arena);
     std::string x = "abcdefghijklmnopqrstuvwxyz";
 
     for (int i = 0; i < 25; ++i)
     {
         std::string key = x.substr(i, 1);
-        list.Insert(key);
+        list.Insert(key, i, KType::kTypeValue);
     }
 
     for (int i = 0; i < 25; ++i)
@@ -53,16 +60,16 @@ TEST(SkipListTest, InsertString)
 }
 
 // 插入函数，用于线程执行
-void insertRange(SkipList<int> &list, int start, int end)
+void insertRange(SkipList<int, int> &list, int start, int end)
 {
     for (int i = start; i < end; ++i)
     {
-        list.Insert(i);
+        list.Insert(i, i, KType::kTypeValue);
     }
 }
 
 // 检查函数，用于线程执行
-void checkRange(SkipList<int> &list, int start, int end)
+void checkRange(SkipList<int, int> &list, int start, int end)
 {
     for (int i = start; i < end; ++i)
     {
@@ -75,7 +82,8 @@ TEST(SkipListTest, InsertInterageMultiThreaded)
 {
     const int numThreads = 4;
     const int N = 1000;
-    SkipList<int> list;
+    Arena arena;
+    SkipList<int, int> list(&arena);
 
     std::vector<std::thread> insertThreads;
     std::vector<std::thread> checkThreads;
@@ -106,6 +114,377 @@ TEST(SkipListTest, InsertInterageMultiThreaded)
     }
 }
 
+// 多个线程同时调用InsertConcurrently
+TEST(SkipListTest, InsertConcurrently)
+{
+    const int numThreads = 4;
+    const int N = 20000;
+    Arena arena;
+    SkipList<int, int> list(&arena);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&list, t]()
+                             {
+                                 // 交错写入，让不同线程竞争相邻的插入位置
+                                 for (int i = t; i < N; i += numThreads)
+                                     list.InsertConcurrently(i, i * 2, KType::kTypeValue); });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int i = 0; i < N; ++i)
+    {
+        const KVnode<int, int> *x = list.Get(i);
+        ASSERT_TRUE(x != nullptr);
+        EXPECT_EQ(x->value, i * 2);
+    }
+    EXPECT_FALSE(list.Contains(N));
+}
+
+TEST(SkipListTest, GetReturnsLatestVersion)
+{
+    Arena arena;
+    SkipList<std::string, int> list(&arena);
+    list.Insert("a", 1, KType::kTypeValue);
+    list.Insert("b", 2, KType::kTypeValue);
+    list.Insert("a", 3, KType::kTypeValue);
+
+    const KVnode<std::string, int> *x = list.Get("a");
+    ASSERT_TRUE(x != nullptr);
+    EXPECT_EQ(x->value, 3);
+
+    list.Insert("a", 0, KType::kTypeDelete);
+    x = list.Get("a");
+    ASSERT_TRUE(x != nullptr);
+    EXPECT_EQ(x->type(), KType::kTypeDelete);
+    EXPECT_TRUE(list.Get("c") == nullptr);
+    EXPECT_GT(arena.MemoryUsage(), 0u);
+}
+
+TEST(SkipListTest, InsertWithSplice)
+{
+    Arena arena;
+    SkipList<int, int> list(&arena);
+    for (int i = 0; i < 1000; i += 3)
+        list.Insert(i, i, KType::kTypeValue);
+
+    // 升序插入沿用splice，重复的key和比上一个key小的key都要插到正确的位置
+    SkipList<int, int>::Splice splice;
+    const int keys[] = {1, 2, 2, 500, 501, 999, 1500, 4, 4, 2000};
+    for (int i = 0; i < 10; ++i)
+        list.Insert(keys[i], 10000 + i, KType::kTypeValue, 0, &splice);
+
+    EXPECT_EQ(list.Get(2)->value, 10002);
+    EXPECT_EQ(list.Get(4)->value, 10008);
+    EXPECT_EQ(list.Get(1500)->value, 10006);
+    EXPECT_EQ(list.Get(2000)->value, 10009);
+
+    // 第0层严格有序，同key的新版本在前
+    SkipList<int, int>::Iterator iter(&list);
+    int count = 0;
+    int prev_key = -1;
+    int prev_value = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next(), ++count)
+    {
+        ASSERT_LE(prev_key, iter.key());
+        if (prev_key == iter.key())
+        {
+            ASSERT_GT(prev_value, iter.value());
+        }
+        prev_key = iter.key();
+        prev_value = iter.value();
+    }
+    EXPECT_EQ(count, 334 + 10);
+}
+
+TEST(SkipListTest, GetWithSplice)
+{
+    Arena arena;
+    SkipList<int, int> list(&arena);
+    for (int i = 0; i < 1000; i += 2)
+        list.Insert(i, i, KType::kTypeValue);
+
+    // 升序、重复和回退的key都能找到
+    SkipList<int, int>::Splice splice;
+    const int keys[] = {0, 1, 2, 2, 100, 998, 999, 1000, 50, 51, 52};
+    for (int key : keys)
+    {
+        const KVnode<int, int> *x = list.Get(key, kMaxSequenceNumber, &splice);
+        if (key % 2 == 0 && key < 1000)
+        {
+            ASSERT_TRUE(x != nullptr) << key;
+            EXPECT_EQ(x->value, key);
+        }
+        else
+        {
+            EXPECT_TRUE(x == nullptr) << key;
+        }
+    }
+}
+
+TEST(SkipListTest, Iterator)
+{
+    Arena arena;
+    SkipList<int, int> list(&arena);
+    SkipList<int, int>::Iterator iter(&list);
+    EXPECT_FALSE(iter.Valid());
+    iter.SeekToFirst();
+    EXPECT_FALSE(iter.Valid());
+
+    for (int i = 0; i < 100; i += 2)
+        list.Insert(i, i, KType::kTypeValue);
+    // 同一个key的新版本排在旧版本之前
+    list.Insert(10, 100, KType::kTypeValue);
+
+    iter.Seek(9);
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key(), 10);
+    EXPECT_EQ(iter.value(), 100);
+    iter.Next();
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key(), 10);
+    EXPECT_EQ(iter.value(), 10);
+    iter.Next();
+    EXPECT_EQ(iter.key(), 12);
+
+    // Prev需要经过同key的两个版本
+    iter.Prev();
+    EXPECT_EQ(iter.value(), 10);
+    iter.Prev();
+    EXPECT_EQ(iter.value(), 100);
+    iter.Prev();
+    EXPECT_EQ(iter.key(), 8);
+
+    iter.SeekToFirst();
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key(), 0);
+    iter.Prev();
+    EXPECT_FALSE(iter.Valid());
+
+    iter.SeekToLast();
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key(), 98);
+    iter.Next();
+    EXPECT_FALSE(iter.Valid());
+
+    iter.Seek(99);
+    EXPECT_FALSE(iter.Valid());
+}
+
+TEST(SkipListTest, GetWithSnapshot)
+{
+    Arena arena;
+    SkipList<int, int> list(&arena);
+    // 乱序插入同一个key的多个版本
+    list.Insert(1, 10, KType::kTypeValue, 10);
+    list.Insert(1, 30, KType::kTypeValue, 30);
+    list.Insert(1, 20, KType::kTypeDelete, 20);
+    list.Insert(2, 5, KType::kTypeValue, 5);
+
+    EXPECT_EQ(list.Get(1)->value, 30);
+    auto *x = list.Get(1, 29);
+    ASSERT_TRUE(x != nullptr);
+    EXPECT_EQ(x->type(), KType::kTypeDelete);
+    EXPECT_EQ(x->sequence(), 20u);
+    EXPECT_EQ(list.Get(1, 19)->value, 10);
+    EXPECT_TRUE(list.Get(1, 9) == nullptr);
+    EXPECT_TRUE(list.Get(2, 4) == nullptr);
+    EXPECT_EQ(list.Get(2, 5)->value, 5);
+
+    // 迭代顺序为key升序，同一个key序列号降序
+    SkipList<int, int>::Iterator iter(&list);
+    SequenceNumber expected[] = {30, 20, 10, 5};
+    int n = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next())
+        EXPECT_EQ(iter.sequence(), expected[n++]);
+    EXPECT_EQ(n, 4);
+}
+
+TEST(SkipListTest, HeapUsage)
+{
+    Arena arena;
+    SkipList<std::string, std::string> list(&arena);
+    // 短字符串在对象内部，不占用堆内存
+    list.Insert("a", "b", KType::kTypeValue, 1);
+    EXPECT_EQ(list.ApproximateHeapUsage(), 0u);
+    const std::string value(4096, 'v');
+    for (int i = 0; i < 10; ++i)
+        list.Insert("key" + std::to_string(i), value, KType::kTypeValue, i + 2);
+    EXPECT_GE(list.ApproximateHeapUsage(), 10 * value.size());
+    EXPECT_LT(arena.MemoryUsage(), list.ApproximateHeapUsage());
+}
+
+static std::string Fixed64Key(uint64_t v)
+{
+    std::string s;
+    PutFixed64(&s, v);
+    return s;
+}
+
+// 用户自定义的比较器：按长度，长度相同时按字节，只能通过虚函数调用
+class LengthFirstComparator : public Comparator
+{
+public:
+    int Compare(const Slice &a, const Slice &b) const override
+    {
+        if (a.size() != b.size())
+            return a.size() < b.size() ? -1 : 1;
+        return a.compare(b);
+    }
+    const char *Name() const override { return "test.LengthFirstComparator"; }
+};
+
+template <typename Cmp>
+static std::vector<std::string> InlineListKeys(const Cmp *cmp, const std::vector<std::string> &keys)
+{
+    Arena arena;
+    InlineSkipList<Cmp> list(cmp, &arena);
+    SequenceNumber seq = 0;
+    for (const std::string &key : keys)
+        list.Insert(key, "v", KType::kTypeValue, ++seq);
+    std::vector<std::string> result;
+    typename InlineSkipList<Cmp>::Iterator iter(&list);
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next())
+        result.push_back(iter.key().ToString());
+    // 反向遍历得到相反的顺序
+    std::vector<std::string> reversed;
+    for (iter.SeekToLast(); iter.Valid(); iter.Prev())
+        reversed.push_back(iter.key().ToString());
+    EXPECT_EQ(std::vector<std::string>(reversed.rbegin(), reversed.rend()), result);
+    return result;
+}
+
+TEST(InlineSkipListTest, Comparators)
+{
+    EXPECT_LT(BytewiseComparator()->Compare("abc", "abd"), 0);
+    EXPECT_LT(BytewiseComparator()->Compare("ab", "abc"), 0);
+    EXPECT_GT(ReverseBytewiseComparator()->Compare("abc", "abd"), 0);
+    EXPECT_EQ(ReverseBytewiseComparator()->Compare("abc", "abc"), 0);
+    // 小端编码按字节比较的顺序与数值不同
+    const std::string a = Fixed64Key(255), b = Fixed64Key(256);
+    EXPECT_GT(BytewiseComparator()->Compare(a, b), 0);
+    EXPECT_LT(U64FixedComparator()->Compare(a, b), 0);
+    EXPECT_LT(U64FixedComparator()->Compare(b, "short"), 0);
+    const Comparator *cmp = U64FixedComparator();
+    EXPECT_STREQ(cmp->Name(), "kvdb.U64FixedComparator");
+    EXPECT_TRUE(cmp->Equal(a, Fixed64Key(255)));
+
+    const std::vector<std::string> keys = {"b", "abc", "a", "ab", "c"};
+    EXPECT_EQ(InlineListKeys(BytewiseComparator(), keys), (std::vector<std::string>{"a", "ab", "abc", "b", "c"}));
+    EXPECT_EQ(InlineListKeys(ReverseBytewiseComparator(), keys), (std::vector<std::string>{"c", "b", "abc", "ab", "a"}));
+    LengthFirstComparator length_first;
+    EXPECT_EQ(InlineListKeys<Comparator>(&length_first, keys), (std::vector<std::string>{"a", "b", "c", "ab", "abc"}));
+    std::vector<std::string> numbers;
+    for (uint64_t v : {1000000, 3, 256, 255, 70000})
+        numbers.push_back(Fixed64Key(v));
+    std::vector<std::string> sorted;
+    for (uint64_t v : {3, 255, 256, 70000, 1000000})
+        sorted.push_back(Fixed64Key(v));
+    EXPECT_EQ(InlineListKeys(U64FixedComparator(), numbers), sorted);
+}
+
+TEST(InlineSkipListTest, GetWithSnapshot)
+{
+    Arena arena;
+    InlineSkipList<BytewiseComparatorImpl> list(BytewiseComparator(), &arena);
+    list.Insert("key", "v10", KType::kTypeValue, 10);
+    list.Insert("key", "v30", KType::kTypeValue, 30);
+    list.Insert("key", "ignored", KType::kTypeDelete, 20);
+    list.Insert("key2", std::string(1000, 'x'), KType::kTypeValue, 5);
+
+    Slice value;
+    KType type;
+    ASSERT_TRUE(list.Get("key", kMaxSequenceNumber, &value, &type));
+    EXPECT_EQ(value.ToString(), "v30");
+    EXPECT_EQ(type, KType::kTypeValue);
+    ASSERT_TRUE(list.Get("key", 29, &value, &type));
+    EXPECT_EQ(type, KType::kTypeDelete);
+    EXPECT_TRUE(value.empty());
+    ASSERT_TRUE(list.Get("key", 19, &value, &type));
+    EXPECT_EQ(value.ToString(), "v10");
+    EXPECT_FALSE(list.Get("key", 9, &value, &type));
+    EXPECT_FALSE(list.Get("ke", kMaxSequenceNumber, &value, &type));
+    ASSERT_TRUE(list.Get("key2", 5, &value, &type));
+    EXPECT_EQ(value.ToString(), std::string(1000, 'x'));
+
+    InlineSkipList<BytewiseComparatorImpl>::Iterator iter(&list);
+    iter.Seek("key0");
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key().ToString(), "key2");
+    iter.Seek("key");
+    SequenceNumber expected[] = {30, 20, 10, 5};
+    int n = 0;
+    for (; iter.Valid(); iter.Next())
+        EXPECT_EQ(iter.sequence(), expected[n++]);
+    EXPECT_EQ(n, 4);
+}
+
+TEST(InlineSkipListTest, InsertConcurrently)
+{
+    Arena arena;
+    InlineSkipList<> list(BytewiseComparator(), &arena);
+    const int kThreads = 4, kPerThread = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&list, t]()
+                             {
+                                 for (int i = 0; i < kPerThread; ++i)
+                                 {
+                                     const std::string key = Fixed64Key(static_cast<uint64_t>(i) * kThreads + t);
+                                     list.InsertConcurrently(key, key, KType::kTypeValue, i + 1);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    InlineSkipList<>::Iterator iter(&list);
+    std::string prev;
+    int n = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next(), ++n)
+    {
+        ASSERT_LT(prev, iter.key().ToString());
+        ASSERT_EQ(iter.key(), iter.value());
+        prev = iter.key().ToString();
+    }
+    EXPECT_EQ(n, kThreads * kPerThread);
+}
+
+TEST(InlineSkipListTest, EntryEncoding)
+{
+    Arena arena;
+    InlineSkipList<> list(BytewiseComparator(), &arena);
+    for (int i = 0; i < 100; ++i)
+        list.Insert("k" + std::to_string(i), std::string(i, 'v'), i % 5 == 0 ? KType::kTypeDelete : KType::kTypeValue, i + 1);
+
+    // 按顺序把条目原样写出，再逐个解析
+    std::string data;
+    InlineSkipList<>::Iterator iter(&list);
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next())
+        data.append(iter.entry().data(), iter.entry().size());
+    Slice input(data);
+    int n = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next(), ++n)
+    {
+        Slice key, value;
+        KType type;
+        SequenceNumber seq;
+        ASSERT_TRUE(InlineSkipList<>::DecodeEntry(&input, &key, &value, &type, &seq));
+        EXPECT_EQ(key, iter.key());
+        EXPECT_EQ(value, iter.value());
+        EXPECT_EQ(type, iter.type());
+        EXPECT_EQ(seq, iter.sequence());
+    }
+    EXPECT_EQ(n, 100);
+    EXPECT_TRUE(input.empty());
+    Slice truncated(data.data(), 3), key, value;
+    KType type;
+    SequenceNumber seq;
+    EXPECT_FALSE(InlineSkipList<>::DecodeEntry(&truncated, &key, &value, &type, &seq));
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,79 @@
+#ifndef STORAGE_KVDB_DB_SNAPSHOT_H_
+#define STORAGE_KVDB_DB_SNAPSHOT_H_
+#include <cassert>
+#include "util/KVNode.h"
+
+namespace kvdb
+{
+    // Table::GetSnapshot返回的一致性视图，只记录创建时最后一个已经写入的序列号。
+    // 通过ReadOptions::snapshot读取时只能看到序列号不大于它的版本
+    class Snapshot
+    {
+    public:
+        SequenceNumber sequence() const { return sequence_; }
+
+    private:
+        friend class SnapshotList;
+
+        explicit Snapshot(SequenceNumber seq) : sequence_(seq), prev_(nullptr), next_(nullptr) {}
+
+        const SequenceNumber sequence_;
+        Snapshot *prev_;
+        Snapshot *next_;
+    };
+
+    // 所有未释放的快照组成的双向链表。序列号单调递增，新快照加在尾部，
+    // 所以链表按序列号升序排列，头部是最旧的快照。调用方负责加锁
+    class SnapshotList
+    {
+    public:
+        SnapshotList() : head_(0)
+        {
+            head_.prev_ = &head_;
+            head_.next_ = &head_;
+        }
+
+        SnapshotList(const SnapshotList &) = delete;
+        SnapshotList &operator=(const SnapshotList &) = delete;
+
+        // 没有释放的快照随链表一起释放
+        ~SnapshotList()
+        {
+            while (!empty())
+                Delete(head_.next_);
+        }
+
+        bool empty() const { return head_.next_ == &head_; }
+
+        // REQUIRES: !empty()
+        SequenceNumber OldestSequence() const
+        {
+            assert(!empty());
+            return head_.next_->sequence_;
+        }
+
+        const Snapshot *New(SequenceNumber seq)
+        {
+            assert(empty() || head_.prev_->sequence_ <= seq);
+            Snapshot *s = new Snapshot(seq);
+            s->next_ = &head_;
+            s->prev_ = head_.prev_;
+            s->prev_->next_ = s;
+            s->next_->prev_ = s;
+            return s;
+        }
+
+        void Delete(const Snapshot *snapshot)
+        {
+            Snapshot *s = const_cast<Snapshot *>(snapshot);
+            s->prev_->next_ = s->next_;
+            s->next_->prev_ = s->prev_;
+            delete s;
+        }
+
+    private:
+        Snapshot head_;
+    };
+}
+
+#endif
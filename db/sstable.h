@@ -0,0 +1,496 @@
+#ifndef STORAGE_KVDB_DB_SSTABLE_H_
+#define STORAGE_KVDB_DB_SSTABLE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "db/block.h"
+#include "db/block_cache.h"
+#include "db/format.h"
+#include "db/iterator.h"
+#include "db/options.h"
+#include "util/bloom.h"
+#include "util/env.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 只读的有序表文件，打开时读入索引块，数据块在查找时按需读取。
+    // 有块缓存时读入的数据块放入缓存，可以被多个线程同时使用
+    class SSTable
+    {
+    public:
+        // 成功时*table接管file的所有权；失败时*table为nullptr，file由调用方释放
+        static Status Open(const Options &options, RandomAccessFile *file, uint64_t file_size, SSTable **table);
+
+        SSTable(const SSTable &) = delete;
+        SSTable &operator=(const SSTable &) = delete;
+
+        ~SSTable() { delete file_; }
+
+        // 遍历文件内所有条目，迭代器存在期间SSTable不能被释放
+        SliceIterator *NewIterator() const;
+
+        // 提示之后读取这个文件的方式
+        void Hint(AccessPattern pattern) const { file_->Hint(pattern); }
+
+        // 按从新到旧的顺序对key完全相等的每个条目调用handler(value)，直到handler返回true。
+        // 布隆过滤器判断key不存在时不读取任何块
+        template <typename Handler>
+        Status InternalGet(const Slice &key, Handler &&handler) const;
+
+        // 查找按升序排列的n个key，对keys[i]的每个条目调用handler(i, value)，直到handler返回true。
+        // 相邻的key落在同一个数据块时只读取一次数据块
+        template <typename Handler>
+        Status MultiGet(const Slice *keys, size_t n, Handler &&handler) const;
+
+        // 文件的前缀过滤器判断没有以prefix为前缀的key时返回false。
+        // 没有前缀过滤器(未设置prefix_extractor，或者文件用别的提取器写入)时总是返回true
+        bool PrefixMayMatch(const Slice &prefix) const;
+
+    private:
+        class Iter;
+
+        SSTable(const Options &options, RandomAccessFile *file, uint64_t cache_id, const BlockHandle &index_handle)
+            : options_(options), file_(file), cache_id_(cache_id), index_handle_(index_handle), has_filter_(false),
+              has_prefix_filter_(false) {}
+
+        // 读取handle指向的块，压缩的块解压后返回。
+        // cache不为nullptr时先在缓存中查找，未命中时读入并放入缓存
+        Status LoadBlock(BlockCache *cache, const BlockHandle &handle, bool high_priority,
+                         BlockCache::Value *block) const;
+
+        // 索引块和过滤器块使用的缓存，不放入缓存时为nullptr
+        BlockCache *MetaCache() const
+        {
+            return options_.cache_index_and_filter_blocks ? options_.block_cache.get() : nullptr;
+        }
+
+        // 读取元数据索引中的压缩字典和过滤器。读不到字典时无法解压数据块，返回错误；
+        // 过滤器出错时不使用过滤器。pin为true时一直持有过滤器
+        Status ReadMeta(const BlockHandle &metaindex_handle, bool pin);
+        // 在元数据索引中查找名为name的过滤器块，找到并且能读取时*has为true，pin为true时读入*filter
+        void ReadFilter(SliceIterator *meta_iter, const std::string &name, bool pin, BlockHandle *handle, bool *has,
+                        BlockCache::Value *filter);
+
+        // 自己持有时直接返回，否则从块缓存中取
+        Status IndexBlock(BlockCache::Value *block) const;
+
+        // 没有过滤器或者读取出错时返回nullptr
+        BlockCache::Value Filter() const { return Filter(filter_, has_filter_, filter_handle_); }
+        BlockCache::Value Filter(const BlockCache::Value &pinned, bool has, const BlockHandle &handle) const;
+
+        // 读取索引条目index_value指向的数据块
+        Status ReadDataBlock(const Slice &index_value, BlockCache::Value *block) const;
+
+        const Options options_;
+        // 打开失败时置为nullptr，交还给调用方
+        RandomAccessFile *file_;
+        // 块缓存中的编号，没有块缓存时为0
+        const uint64_t cache_id_;
+        const BlockHandle index_handle_;
+        BlockHandle filter_handle_;
+        bool has_filter_;
+        BlockHandle prefix_filter_handle_;
+        bool has_prefix_filter_;
+        // 自己持有的索引块、整个文件的布隆过滤器和前缀过滤器，放入块缓存且不固定时为nullptr
+        BlockCache::Value index_block_;
+        BlockCache::Value filter_;
+        BlockCache::Value prefix_filter_;
+        // 数据块的Zstd字典，没有时为nullptr
+        std::unique_ptr<CompressionDict> dict_;
+    };
+
+    inline Status SSTable::Open(const Options &options, RandomAccessFile *file, uint64_t size, SSTable **table)
+    {
+        *table = nullptr;
+        if (size < Footer::kEncodedLength)
+            return Status::Corruption("file is too short to be an sstable");
+
+        char footer_space[Footer::kEncodedLength];
+        Slice footer_input;
+        Status s = file->Read(size - Footer::kEncodedLength, Footer::kEncodedLength, &footer_input, footer_space);
+        if (!s.ok())
+            return s;
+
+        Footer footer;
+        s = footer.DecodeFrom(&footer_input);
+        if (!s.ok())
+            return s;
+
+        const uint64_t cache_id = options.block_cache != nullptr ? options.block_cache->NewId() : 0;
+        std::unique_ptr<SSTable> t(new SSTable(options, file, cache_id, footer.index_handle()));
+        const bool pin = t->MetaCache() == nullptr || options.pin_index_and_filter_blocks;
+        BlockCache::Value index_block;
+        s = t->ReadMeta(footer.metaindex_handle(), pin);
+        if (s.ok())
+            s = t->LoadBlock(t->MetaCache(), footer.index_handle(), true, &index_block);
+        if (!s.ok())
+        {
+            t->file_ = nullptr;
+            return s;
+        }
+        if (pin)
+            t->index_block_ = std::move(index_block);
+        *table = t.release();
+        return Status::OK();
+    }
+
+    inline Status SSTable::LoadBlock(BlockCache *cache, const BlockHandle &handle, bool high_priority,
+                                     BlockCache::Value *block) const
+    {
+        Statistics *stats = options_.statistics.get();
+        const BlockCacheKey key{cache_id_, handle.offset()};
+        if (cache != nullptr)
+        {
+            const bool hit = (*block = cache->Lookup(key)) != nullptr;
+            PerfCount(hit ? &PerfContext::block_cache_hit_count : &PerfContext::block_cache_miss_count);
+            RecordTick(stats, hit ? kBlockCacheHit : kBlockCacheMiss);
+            if (hit)
+                return Status::OK();
+        }
+
+        BlockContents contents;
+        Status s;
+        {
+            PerfTimer timer(&PerfContext::block_read_nanos);
+            s = ReadBlock(file_, options_.verify_checksums, handle, &contents, dict_.get());
+        }
+        if (!s.ok())
+            return s;
+        PerfCount(&PerfContext::block_read_count);
+        PerfCount(&PerfContext::block_read_bytes, handle.size());
+        RecordTick(stats, kBlockReadCount);
+        RecordTick(stats, kBlockReadBytes, handle.size());
+        *block = std::make_shared<LoadedBlock>(contents);
+        if (cache != nullptr && contents.heap_allocated)
+        {
+            cache->Insert(key, *block, high_priority);
+            RecordTick(stats, kBlockCacheAdd);
+        }
+        return Status::OK();
+    }
+
+    inline Status SSTable::ReadMeta(const BlockHandle &metaindex_handle, bool pin)
+    {
+        BlockContents contents;
+        Status s = ReadBlock(file_, options_.verify_checksums, metaindex_handle, &contents);
+        if (!s.ok())
+            return s;
+        Block meta(contents);
+        std::unique_ptr<SliceIterator> iter(meta.NewIterator());
+        BlockHandle handle;
+        Slice input;
+
+        const std::string dict_name = CompressionDictBlockName();
+        iter->Seek(dict_name);
+        if (iter->Valid() && iter->key() == Slice(dict_name))
+        {
+            input = iter->value();
+            BlockContents dict;
+            s = handle.DecodeFrom(&input);
+            if (s.ok())
+                s = ReadBlock(file_, options_.verify_checksums, handle, &dict);
+            if (!s.ok())
+                return s;
+            dict_.reset(new CompressionDict(dict.data, CompressionDict::kUncompress, options_.zstd_compression_level));
+            if (dict.heap_allocated)
+                delete[] dict.data.data();
+        }
+        if (!iter->status().ok())
+            return iter->status();
+
+        if (options_.bloom_bits_per_key <= 0)
+            return Status::OK();
+        ReadFilter(iter.get(), FilterBlockName(), pin, &filter_handle_, &has_filter_, &filter_);
+        if (options_.prefix_extractor != nullptr)
+            ReadFilter(iter.get(), PrefixFilterBlockName(*options_.prefix_extractor), pin, &prefix_filter_handle_,
+                       &has_prefix_filter_, &prefix_filter_);
+        return Status::OK();
+    }
+
+    inline void SSTable::ReadFilter(SliceIterator *meta_iter, const std::string &name, bool pin, BlockHandle *handle,
+                                    bool *has, BlockCache::Value *filter)
+    {
+        meta_iter->Seek(name);
+        if (!meta_iter->Valid() || meta_iter->key() != Slice(name))
+            return;
+
+        Slice input = meta_iter->value();
+        BlockCache::Value block;
+        if (!handle->DecodeFrom(&input).ok() || !LoadBlock(MetaCache(), *handle, true, &block).ok())
+            return;
+        *has = true;
+        if (pin)
+            *filter = std::move(block);
+    }
+
+    inline Status SSTable::IndexBlock(BlockCache::Value *block) const
+    {
+        if (index_block_ != nullptr)
+        {
+            *block = index_block_;
+            return Status::OK();
+        }
+        return LoadBlock(MetaCache(), index_handle_, true, block);
+    }
+
+    inline BlockCache::Value SSTable::Filter(const BlockCache::Value &pinned, bool has, const BlockHandle &handle) const
+    {
+        if (pinned != nullptr || !has)
+            return pinned;
+        BlockCache::Value filter;
+        if (!LoadBlock(MetaCache(), handle, true, &filter).ok())
+            return nullptr;
+        return filter;
+    }
+
+    inline bool SSTable::PrefixMayMatch(const Slice &prefix) const
+    {
+        const BlockCache::Value filter = Filter(prefix_filter_, has_prefix_filter_, prefix_filter_handle_);
+        if (filter == nullptr || BloomFilterPolicy::KeyMayMatch(prefix, filter->contents()))
+            return true;
+        RecordTick(options_.statistics.get(), kPrefixFilterUseful);
+        return false;
+    }
+
+    inline Status SSTable::ReadDataBlock(const Slice &index_value, BlockCache::Value *block) const
+    {
+        BlockHandle handle;
+        Slice input = index_value;
+        Status s = handle.DecodeFrom(&input);
+        if (!s.ok())
+            return s;
+        return LoadBlock(options_.block_cache.get(), handle, false, block);
+    }
+
+    template <typename Handler>
+    Status SSTable::InternalGet(const Slice &key, Handler &&handler) const
+    {
+        return MultiGet(&key, 1, [&handler](size_t, const Slice &value)
+                        { return handler(value); });
+    }
+
+    template <typename Handler>
+    Status SSTable::MultiGet(const Slice *keys, size_t n, Handler &&handler) const
+    {
+        // 自己持有索引块和过滤器时不复制shared_ptr
+        BlockCache::Value index_holder;
+        const LoadedBlock *index_block = index_block_.get();
+        if (index_block == nullptr)
+        {
+            Status s = IndexBlock(&index_holder);
+            if (!s.ok())
+                return s;
+            index_block = index_holder.get();
+        }
+        BlockCache::Value filter_holder;
+        const LoadedBlock *filter = filter_.get();
+        if (filter == nullptr && has_filter_)
+        {
+            filter_holder = Filter();
+            filter = filter_holder.get();
+        }
+
+        std::unique_ptr<SliceIterator> index_iter(index_block->block().NewIterator());
+        // 当前读入的数据块及其索引条目，block_iter_必须先于block释放
+        BlockCache::Value block;
+        std::unique_ptr<SliceIterator> block_iter;
+        std::string block_handle;
+        for (size_t i = 0; i < n; i++)
+        {
+            const Slice &key = keys[i];
+            if (filter != nullptr && !BloomFilterPolicy::KeyMayMatch(key, filter->contents()))
+            {
+                PerfCount(&PerfContext::bloom_filter_useful);
+                RecordTick(options_.statistics.get(), kBloomFilterUseful);
+                continue;
+            }
+
+            index_iter->Seek(key);
+            if (!index_iter->Valid())
+                return index_iter->status(); // 这个key和之后的key都大于文件内所有key
+
+            // 索引key >= 对应数据块的所有key，所以key只可能在这个块中
+            if (block == nullptr || index_iter->value() != Slice(block_handle))
+            {
+                block_iter.reset();
+                Status s = ReadDataBlock(index_iter->value(), &block);
+                if (!s.ok())
+                    return s;
+                block_handle.assign(index_iter->value().data(), index_iter->value().size());
+                block_iter.reset(block->block().NewIterator());
+            }
+            // 同一个key的所有版本都在这个块中
+            for (block_iter->Seek(key); block_iter->Valid() && block_iter->key() == key; block_iter->Next())
+            {
+                if (handler(i, block_iter->value()))
+                    break;
+            }
+            if (!block_iter->status().ok())
+                return block_iter->status();
+        }
+        return Status::OK();
+    }
+
+    // 两层迭代器：外层遍历索引块，内层遍历当前数据块
+    class SSTable::Iter : public SliceIterator
+    {
+    public:
+        explicit Iter(const SSTable *table) : table_(table)
+        {
+            Status s = table->IndexBlock(&index_block_);
+            index_iter_.reset(s.ok() ? index_block_->block().NewIterator() : new EmptySliceIterator(s));
+        }
+
+        bool Valid() const override { return data_iter_ != nullptr && data_iter_->Valid(); }
+
+        Slice key() const override
+        {
+            assert(Valid());
+            return data_iter_->key();
+        }
+
+        Slice value() const override
+        {
+            assert(Valid());
+            return data_iter_->value();
+        }
+
+        Status status() const override
+        {
+            if (!index_iter_->status().ok())
+                return index_iter_->status();
+            if (data_iter_ != nullptr && !data_iter_->status().ok())
+                return data_iter_->status();
+            return status_;
+        }
+
+        void Seek(const Slice &target) override
+        {
+            index_iter_->Seek(target);
+            InitDataBlock();
+            if (data_iter_ != nullptr)
+                data_iter_->Seek(target);
+            SkipEmptyDataBlocksForward();
+        }
+
+        void SeekToFirst() override
+        {
+            index_iter_->SeekToFirst();
+            InitDataBlock();
+            if (data_iter_ != nullptr)
+                data_iter_->SeekToFirst();
+            SkipEmptyDataBlocksForward();
+        }
+
+        void SeekToLast() override
+        {
+            index_iter_->SeekToLast();
+            InitDataBlock();
+            if (data_iter_ != nullptr)
+                data_iter_->SeekToLast();
+            SkipEmptyDataBlocksBackward();
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+            data_iter_->Next();
+            SkipEmptyDataBlocksForward();
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+            data_iter_->Prev();
+            SkipEmptyDataBlocksBackward();
+        }
+
+    private:
+        void SkipEmptyDataBlocksForward()
+        {
+            while (data_iter_ == nullptr || !data_iter_->Valid())
+            {
+                if (!index_iter_->Valid())
+                {
+                    SetDataIterator(nullptr);
+                    return;
+                }
+                index_iter_->Next();
+                InitDataBlock();
+                if (data_iter_ != nullptr)
+                    data_iter_->SeekToFirst();
+            }
+        }
+
+        void SkipEmptyDataBlocksBackward()
+        {
+            while (data_iter_ == nullptr || !data_iter_->Valid())
+            {
+                if (!index_iter_->Valid())
+                {
+                    SetDataIterator(nullptr);
+                    return;
+                }
+                index_iter_->Prev();
+                InitDataBlock();
+                if (data_iter_ != nullptr)
+                    data_iter_->SeekToLast();
+            }
+        }
+
+        void SetDataIterator(SliceIterator *data_iter)
+        {
+            // 保留第一个错误
+            if (data_iter_ != nullptr && status_.ok() && !data_iter_->status().ok())
+                status_ = data_iter_->status();
+            data_iter_.reset(data_iter);
+        }
+
+        // 根据index_iter_的位置加载数据块，已经加载的块不重复读取
+        void InitDataBlock()
+        {
+            if (!index_iter_->Valid())
+            {
+                SetDataIterator(nullptr);
+                return;
+            }
+            Slice handle = index_iter_->value();
+            if (data_iter_ != nullptr && handle == Slice(data_block_handle_))
+                return;
+
+            BlockCache::Value block;
+            Status s = table_->ReadDataBlock(handle, &block);
+            // 迭代器必须在块之前释放
+            SetDataIterator(nullptr);
+            data_block_ = std::move(block);
+            if (!s.ok())
+            {
+                SetDataIterator(new EmptySliceIterator(s));
+                data_block_handle_.clear();
+                return;
+            }
+            data_block_handle_.assign(handle.data(), handle.size());
+            SetDataIterator(data_block_->block().NewIterator());
+        }
+
+        const SSTable *const table_;
+        // 声明在index_iter_之前，保证晚于index_iter_析构
+        BlockCache::Value index_block_;
+        std::unique_ptr<SliceIterator> index_iter_;
+        BlockCache::Value data_block_;
+        // 声明在data_block_之后，保证先于data_block_析构
+        std::unique_ptr<SliceIterator> data_iter_;
+        std::string data_block_handle_;
+        Status status_;
+    };
+
+    inline SliceIterator *SSTable::NewIterator() const
+    {
+        return new Iter(this);
+    }
+}
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef STORAGE_KVDB_DB_SSTABLE_BUILDER_H_
+#define STORAGE_KVDB_DB_SSTABLE_BUILDER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "db/block_builder.h"
+#include "db/format.h"
+#include "db/options.h"
+#include "util/bloom.h"
+#include "util/compression.h"
+#include "util/crc32c.h"
+#include "util/env.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 把[start, limit)之间的一个尽量短的key写回*start，用作索引块中两个数据块的分隔
+    inline void FindShortestSeparator(std::string *start, const Slice &limit)
+    {
+        size_t min_length = std::min(start->size(), limit.size());
+        size_t diff_index = 0;
+        while ((diff_index < min_length) && ((*start)[diff_index] == limit[diff_index]))
+            diff_index++;
+
+        if (diff_index >= min_length)
+            return; // 一个是另一个的前缀，不缩短
+
+        uint8_t diff_byte = static_cast<uint8_t>((*start)[diff_index]);
+        if (diff_byte < static_cast<uint8_t>(0xff) && diff_byte + 1 < static_cast<uint8_t>(limit[diff_index]))
+        {
+            (*start)[diff_index]++;
+            start->resize(diff_index + 1);
+            assert(Slice(*start).compare(limit) < 0);
+        }
+    }
+
+    // 把*key换成一个 >= *key 的短key，用作最后一个数据块的分隔
+    inline void FindShortSuccessor(std::string *key)
+    {
+        size_t n = key->size();
+        for (size_t i = 0; i < n; i++)
+        {
+            const uint8_t byte = (*key)[i];
+            if (byte != static_cast<uint8_t>(0xff))
+            {
+                (*key)[i] = byte + 1;
+                key->resize(i + 1);
+                return;
+            }
+        }
+        // 全是0xff时保持不变
+    }
+
+    // 第level层的文件使用的压缩算法
+    inline CompressionType CompressionForLevel(const Options &options, int level)
+    {
+        if (options.compression_per_level.empty())
+            return options.compression;
+        const size_t i = std::min<size_t>(level, options.compression_per_level.size() - 1);
+        return options.compression_per_level[i];
+    }
+
+    // 按key递增的顺序写入有序表文件，格式见format.h。
+    // 调用方负责在Finish之后Sync/Close文件
+    class SSTableBuilder
+    {
+    public:
+        // 构建期间file必须有效。level为文件所在的层，决定数据块的压缩算法
+        SSTableBuilder(const Options &options, WritableFile *file, int level = 0)
+            : options_(options), file_(file), offset_(0), data_block_(&options_), index_block_(&index_block_options_),
+              num_entries_(0), closed_(false), pending_index_entry_(false),
+              compression_(CompressionForLevel(options, level)),
+              buffering_(compression_ == kZstdCompression && options.zstd_max_dict_bytes > 0 &&
+                         CompressionTypeSupported(kZstdCompression)),
+              buffered_bytes_(0)
+        {
+        }
+
+        SSTableBuilder(const SSTableBuilder &) = delete;
+        SSTableBuilder &operator=(const SSTableBuilder &) = delete;
+
+        // REQUIRES: Finish或Abandon已经调用
+        ~SSTableBuilder() { assert(closed_); }
+
+        // REQUIRES: key不小于之前加入的所有key(按字节序)。
+        // 相等的key总是放在同一个数据块中，查找一个key的所有版本只需要读一个块
+        void Add(const Slice &key, const Slice &value);
+
+        // 写入过滤器块、索引块和footer
+        Status Finish();
+
+        // 放弃构建，文件内容无效
+        void Abandon()
+        {
+            assert(!closed_);
+            closed_ = true;
+        }
+
+        Status status() const { return status_; }
+        uint64_t NumEntries() const { return num_entries_; }
+        // 目前为止写入文件的字节数，Finish之后即文件大小
+        uint64_t FileSize() const { return offset_; }
+
+    private:
+        struct IndexBlockOptions : public Options
+        {
+            // 索引块每个条目都保存完整的key，便于二分
+            IndexBlockOptions() { block_restart_interval = 1; }
+        };
+
+        bool ok() const { return status_.ok(); }
+        // 把当前数据块写入文件，训练字典期间先缓存起来
+        void Flush();
+        // 用缓存的数据块训练字典，然后把它们压缩写出
+        void EnterUnbuffered();
+        void AddIndexEntry(const std::string &separator, const BlockHandle &handle);
+        // compress为true时按compression_压缩，只用于数据块
+        void WriteBlock(const Slice &raw, bool compress, BlockHandle *handle);
+        void WriteBlock(BlockBuilder *block, BlockHandle *handle);
+        void WriteRawBlock(const Slice &contents, CompressionType type, BlockHandle *handle);
+
+        const Options options_;
+        const IndexBlockOptions index_block_options_;
+        WritableFile *file_;
+        uint64_t offset_;
+        Status status_;
+        BlockBuilder data_block_;
+        BlockBuilder index_block_;
+        std::string last_key_;
+        uint64_t num_entries_;
+        bool closed_;
+
+        // 数据块写出后要等到下一个key到来才能决定索引中的分隔key，
+        // 这样分隔key可以更短。为true时pending_handle_还没有加入索引
+        bool pending_index_entry_;
+        BlockHandle pending_handle_;
+
+        // 所有key的BloomHash，Finish时生成整个文件的过滤器
+        std::vector<uint32_t> key_hashes_;
+        // 设置了prefix_extractor时每个不同前缀的BloomHash，以及上一个加入的前缀。
+        // key有序，前缀相同的key相邻，只需要与上一个比较
+        std::vector<uint32_t> prefix_hashes_;
+        std::string last_prefix_;
+
+        const CompressionType compression_;
+        std::string compressed_output_;
+
+        // 训练Zstd字典期间缓存的数据块和它们在索引中的分隔key。
+        // 最后一个块的分隔key要等下一个key到来才能确定，此时pending_index_entry_为true
+        struct BufferedBlock
+        {
+            std::string contents;
+            std::string separator;
+        };
+        bool buffering_;
+        std::vector<BufferedBlock> buffered_;
+        size_t buffered_bytes_;
+        std::unique_ptr<CompressionDict> dict_;
+    };
+
+    inline void SSTableBuilder::Add(const Slice &key, const Slice &value)
+    {
+        assert(!closed_);
+        if (!ok())
+            return;
+        if (num_entries_ > 0)
+            assert(key.compare(Slice(last_key_)) >= 0);
+
+        // 数据块只在两个不同的key之间切分
+        if (data_block_.CurrentSizeEstimate() >= options_.block_size && key.compare(Slice(last_key_)) != 0)
+            Flush();
+
+        if (pending_index_entry_)
+        {
+            assert(data_block_.empty());
+            FindShortestSeparator(&last_key_, key);
+            if (buffering_)
+                buffered_.back().separator = last_key_;
+            else
+                AddIndexEntry(last_key_, pending_handle_);
+            pending_index_entry_ = false;
+        }
+
+        if (options_.bloom_bits_per_key > 0)
+        {
+            key_hashes_.push_back(BloomHash(key));
+            const PrefixExtractor *extractor = options_.prefix_extractor.get();
+            if (extractor != nullptr && extractor->InDomain(key))
+            {
+                const Slice prefix = extractor->Transform(key);
+                if (prefix_hashes_.empty() || prefix != Slice(last_prefix_))
+                {
+                    prefix_hashes_.push_back(BloomHash(prefix));
+                    last_prefix_.assign(prefix.data(), prefix.size());
+                }
+            }
+        }
+
+        last_key_.assign(key.data(), key.size());
+        num_entries_++;
+        data_block_.Add(key, value);
+    }
+
+    inline void SSTableBuilder::Flush()
+    {
+        assert(!closed_);
+        if (!ok() || data_block_.empty())
+            return;
+        assert(!pending_index_entry_);
+        if (buffering_)
+        {
+            const Slice raw = data_block_.Finish();
+            buffered_.push_back(BufferedBlock{raw.ToString(), std::string()});
+            buffered_bytes_ += raw.size();
+            data_block_.Reset();
+            pending_index_entry_ = true;
+            if (buffered_bytes_ >= options_.zstd_max_train_bytes)
+                EnterUnbuffered();
+            return;
+        }
+        WriteBlock(data_block_.Finish(), true, &pending_handle_);
+        data_block_.Reset();
+        if (ok())
+        {
+            pending_index_entry_ = true;
+            status_ = file_->Flush();
+        }
+    }
+
+    inline void SSTableBuilder::EnterUnbuffered()
+    {
+        assert(buffering_);
+        buffering_ = false;
+        std::vector<std::string> samples;
+        samples.reserve(buffered_.size());
+        for (const BufferedBlock &block : buffered_)
+            samples.push_back(block.contents);
+        std::string dict;
+        // 训练失败(如样本太少)时不使用字典
+        if (!samples.empty() && TrainCompressionDict(samples, options_.zstd_max_dict_bytes, &dict))
+            dict_.reset(new CompressionDict(dict, CompressionDict::kCompress, options_.zstd_compression_level));
+
+        for (size_t i = 0; i < buffered_.size() && ok(); ++i)
+        {
+            WriteBlock(buffered_[i].contents, true, &pending_handle_);
+            // 最后一个块的分隔key还没有确定，留给Add或Finish
+            if (ok() && i + 1 < buffered_.size())
+                AddIndexEntry(buffered_[i].separator, pending_handle_);
+        }
+        buffered_.clear();
+        buffered_bytes_ = 0;
+        if (ok())
+            status_ = file_->Flush();
+    }
+
+    inline void SSTableBuilder::AddIndexEntry(const std::string &separator, const BlockHandle &handle)
+    {
+        std::string handle_encoding;
+        handle.EncodeTo(&handle_encoding);
+        index_block_.Add(separator, Slice(handle_encoding));
+    }
+
+    inline void SSTableBuilder::WriteBlock(const Slice &raw, bool compress, BlockHandle *handle)
+    {
+        Slice contents = raw;
+        CompressionType type = kNoCompression;
+        compressed_output_.clear();
+        // 压缩率太低时保存原始内容，读取时省去解压
+        if (compress && compression_ != kNoCompression &&
+            Compress(compression_, raw, options_.zstd_compression_level, dict_.get(), &compressed_output_) &&
+            compressed_output_.size() < raw.size() - raw.size() / 8)
+        {
+            contents = compressed_output_;
+            type = compression_;
+        }
+        WriteRawBlock(contents, type, handle);
+    }
+
+    inline void SSTableBuilder::WriteBlock(BlockBuilder *block, BlockHandle *handle)
+    {
+        WriteBlock(block->Finish(), false, handle);
+        block->Reset();
+    }
+
+    inline void SSTableBuilder::WriteRawBlock(const Slice &contents, CompressionType type, BlockHandle *handle)
+    {
+        handle->set_offset(offset_);
+        handle->set_size(contents.size());
+        status_ = file_->Append(contents);
+        if (status_.ok())
+        {
+            char trailer[kBlockTrailerSize];
+            trailer[0] = type;
+            uint32_t crc = crc32c::Value(contents.data(), contents.size());
+            crc = crc32c::Extend(crc, trailer, 1); // crc同时覆盖type
+            EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+            status_ = file_->Append(Slice(trailer, kBlockTrailerSize));
+            if (status_.ok())
+                offset_ += contents.size() + kBlockTrailerSize;
+        }
+    }
+
+    inline Status SSTableBuilder::Finish()
+    {
+        Flush();
+        if (buffering_ && ok())
+            EnterUnbuffered();
+        assert(!closed_);
+        closed_ = true;
+
+        BlockHandle dict_block_handle, filter_block_handle, prefix_filter_block_handle, metaindex_block_handle,
+            index_block_handle;
+
+        // 压缩数据块使用的字典，读取时打开文件就要载入
+        if (ok() && dict_ != nullptr)
+            WriteRawBlock(dict_->data(), kNoCompression, &dict_block_handle);
+
+        // 过滤器块，整个文件一个过滤器，查找时在读索引块之前就可以排除
+        const bool has_filter = ok() && options_.bloom_bits_per_key > 0;
+        if (has_filter)
+        {
+            std::string filter;
+            BloomFilterPolicy policy(options_.bloom_bits_per_key);
+            policy.CreateFilter(key_hashes_.data(), key_hashes_.size(), &filter);
+            WriteRawBlock(filter, kNoCompression, &filter_block_handle);
+        }
+
+        // 前缀过滤器块，前缀扫描时用来跳过整个文件
+        const bool has_prefix_filter = has_filter && ok() && options_.prefix_extractor != nullptr;
+        if (has_prefix_filter)
+        {
+            std::string filter;
+            BloomFilterPolicy policy(options_.bloom_bits_per_key);
+            policy.CreateFilter(prefix_hashes_.data(), prefix_hashes_.size(), &filter);
+            WriteRawBlock(filter, kNoCompression, &prefix_filter_block_handle);
+        }
+
+        // 元数据索引块，key为元数据的名字，value为元数据块的位置
+        if (ok())
+        {
+            // key按字节序加入
+            BlockBuilder meta_index_block(&options_);
+            std::string handle_encoding;
+            if (dict_ != nullptr)
+            {
+                dict_block_handle.EncodeTo(&handle_encoding);
+                meta_index_block.Add(CompressionDictBlockName(), handle_encoding);
+            }
+            if (has_filter)
+            {
+                handle_encoding.clear();
+                filter_block_handle.EncodeTo(&handle_encoding);
+                meta_index_block.Add(FilterBlockName(), handle_encoding);
+            }
+            if (has_prefix_filter)
+            {
+                handle_encoding.clear();
+                prefix_filter_block_handle.EncodeTo(&handle_encoding);
+                meta_index_block.Add(PrefixFilterBlockName(*options_.prefix_extractor), handle_encoding);
+            }
+            WriteBlock(&meta_index_block, &metaindex_block_handle);
+        }
+
+        if (ok())
+        {
+            if (pending_index_entry_)
+            {
+                FindShortSuccessor(&last_key_);
+                AddIndexEntry(last_key_, pending_handle_);
+                pending_index_entry_ = false;
+            }
+            WriteBlock(&index_block_, &index_block_handle);
+        }
+
+        if (ok())
+        {
+            Footer footer;
+            footer.set_metaindex_handle(metaindex_block_handle);
+            footer.set_index_handle(index_block_handle);
+            std::string footer_encoding;
+            footer.EncodeTo(&footer_encoding);
+            status_ = file_->Append(footer_encoding);
+            if (status_.ok())
+                offset_ += footer_encoding.size();
+        }
+        return status_;
+    }
+}
+
+#endif
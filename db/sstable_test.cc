@@ -0,0 +1,574 @@
+#include "db/sstable.h"
+#include "db/sstable_builder.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+
+// 内存中的文件，写入的数据可以随机读取
+class StringFile : public WritableFile, public RandomAccessFile
+{
+public:
+    std::string contents_;
+    mutable int reads_ = 0;
+
+    Status Append(const Slice &data) override
+    {
+        contents_.append(data.data(), data.size());
+        return Status::OK();
+    }
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+
+    Status Read(uint64_t offset, size_t n, Slice *result, char *scratch) const override
+    {
+        if (offset > contents_.size())
+            return Status::InvalidArgument("read past end of file");
+        reads_++;
+        n = std::min<size_t>(n, contents_.size() - offset);
+        std::memcpy(scratch, contents_.data() + offset, n);
+        *result = Slice(scratch, n);
+        return Status::OK();
+    }
+};
+
+class SSTableTest : public testing::Test
+{
+protected:
+    SSTableTest() : table_(nullptr) { options_.block_size = 256; }
+
+    ~SSTableTest() override { delete table_; }
+
+    // 把keys_(已排序)写入文件并打开，SSTable接管file_
+    Status Build()
+    {
+        file_ = new StringFile;
+        SSTableBuilder builder(options_, file_);
+        for (const std::string &key : keys_)
+            builder.Add(key, "v" + key);
+        Status s = builder.Finish();
+        EXPECT_EQ(builder.NumEntries(), keys_.size());
+        EXPECT_EQ(builder.FileSize(), file_->contents_.size());
+        if (!s.ok())
+            return s;
+        return Reopen();
+    }
+
+    Status Reopen()
+    {
+        delete table_;
+        table_ = nullptr;
+        Status s = SSTable::Open(options_, file_, file_->contents_.size(), &table_);
+        if (!s.ok())
+            delete file_;
+        return s;
+    }
+
+    // 带公共前缀的key，测试块内的前缀压缩
+    void FillKeys(int n)
+    {
+        char buf[32];
+        for (int i = 0; i < n; ++i)
+        {
+            std::snprintf(buf, sizeof(buf), "key%08d", i * 2);
+            keys_.push_back(buf);
+        }
+    }
+
+    Options options_;
+    std::vector<std::string> keys_;
+    StringFile *file_;
+    SSTable *table_;
+};
+
+TEST_F(SSTableTest, Empty)
+{
+    ASSERT_TRUE(Build().ok());
+    std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+    iter->SeekToFirst();
+    ASSERT_FALSE(iter->Valid());
+    iter->SeekToLast();
+    ASSERT_FALSE(iter->Valid());
+    iter->Seek("a");
+    ASSERT_FALSE(iter->Valid());
+    ASSERT_TRUE(iter->status().ok());
+}
+
+TEST_F(SSTableTest, IterateBothDirections)
+{
+    FillKeys(2000);
+    ASSERT_TRUE(Build().ok());
+    // 文件应当被切成了很多个数据块
+    ASSERT_GT(file_->contents_.size(), 20 * options_.block_size);
+
+    std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+    size_t i = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i)
+    {
+        ASSERT_EQ(iter->key().ToString(), keys_[i]);
+        ASSERT_EQ(iter->value().ToString(), "v" + keys_[i]);
+    }
+    ASSERT_EQ(i, keys_.size());
+
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+        ASSERT_EQ(iter->key().ToString(), keys_[--i]);
+    ASSERT_EQ(i, 0u);
+    ASSERT_TRUE(iter->status().ok());
+}
+
+TEST_F(SSTableTest, Seek)
+{
+    FillKeys(2000);
+    ASSERT_TRUE(Build().ok());
+
+    std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+    Random rnd(301);
+    char buf[32];
+    for (int n = 0; n < 1000; ++n)
+    {
+        // 偶数存在，奇数落在两个key之间
+        int k = rnd.Uniform(4002);
+        std::snprintf(buf, sizeof(buf), "key%08d", k);
+        std::string target(buf);
+        iter->Seek(target);
+        auto pos = std::lower_bound(keys_.begin(), keys_.end(), target);
+        if (pos == keys_.end())
+        {
+            ASSERT_FALSE(iter->Valid());
+            continue;
+        }
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(iter->key().ToString(), *pos);
+
+        // 从Seek的位置继续双向移动
+        if (pos != keys_.begin())
+        {
+            iter->Prev();
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(iter->key().ToString(), *(pos - 1));
+            iter->Next();
+        }
+        iter->Next();
+        if (pos + 1 == keys_.end())
+            ASSERT_FALSE(iter->Valid());
+        else
+            ASSERT_EQ(iter->key().ToString(), *(pos + 1));
+    }
+}
+
+TEST_F(SSTableTest, InternalGet)
+{
+    FillKeys(2000);
+    ASSERT_TRUE(Build().ok());
+
+    for (int i = 0; i < 4002; ++i)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "key%08d", i);
+        std::string found;
+        bool called = false;
+        Status s = table_->InternalGet(buf, [&](const Slice &value)
+                                       {
+                                           called = true;
+                                           found = value.ToString();
+                                           return true; });
+        ASSERT_TRUE(s.ok()) << s.ToString();
+        if (i % 2 == 0 && i < 4000)
+        {
+            ASSERT_TRUE(called) << buf;
+            ASSERT_EQ(found, std::string("v") + buf);
+        }
+        else
+        {
+            ASSERT_FALSE(called) << buf;
+        }
+    }
+}
+
+TEST_F(SSTableTest, DuplicateKeysStayInOneBlock)
+{
+    // 每个key连续写入3个版本，块较小，同一个key的版本不能跨块
+    FillKeys(500);
+    std::vector<std::string> keys;
+    for (const std::string &key : keys_)
+        keys.insert(keys.end(), 3, key);
+    keys_.swap(keys);
+    ASSERT_TRUE(Build().ok());
+
+    for (int i = 0; i < 1000; i += 2)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "key%08d", i);
+        int calls = 0;
+        // 返回false继续查看同一个key的下一个版本
+        Status s = table_->InternalGet(buf, [&](const Slice &)
+                                       { return ++calls == 3; });
+        ASSERT_TRUE(s.ok()) << s.ToString();
+        ASSERT_EQ(calls, 3) << buf;
+    }
+}
+
+TEST_F(SSTableTest, ChecksumMismatch)
+{
+    FillKeys(100);
+    ASSERT_TRUE(Build().ok());
+
+    // 破坏第一个数据块
+    file_->contents_[10] ^= 0x1;
+    bool called = false;
+    Status s = table_->InternalGet(keys_[0], [&](const Slice &)
+                                   { return called = true; });
+    ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+    ASSERT_FALSE(called);
+
+    std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+    iter->SeekToFirst();
+    // 出错的块被跳过，错误通过status返回
+    ASSERT_TRUE(iter->status().IsCorruption());
+}
+
+TEST_F(SSTableTest, BadMagicNumber)
+{
+    FillKeys(10);
+    ASSERT_TRUE(Build().ok());
+    std::string contents = file_->contents_;
+    contents[contents.size() - 1] ^= 0x1;
+    file_ = new StringFile;
+    file_->contents_ = contents;
+    ASSERT_TRUE(Reopen().IsCorruption());
+}
+
+TEST_F(SSTableTest, BloomFilterSkipsBlockReads)
+{
+    FillKeys(2000);
+    for (int bits : {10, 0})
+    {
+        options_.bloom_bits_per_key = bits;
+        delete table_;
+        table_ = nullptr;
+        ASSERT_TRUE(Build().ok());
+
+        // 奇数都不存在
+        file_->reads_ = 0;
+        int found = 0;
+        for (int i = 1; i < 4000; i += 2)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "key%08d", i);
+            ASSERT_TRUE(table_->InternalGet(buf, [&](const Slice &)
+                                            { return ++found > 0; })
+                            .ok());
+        }
+        ASSERT_EQ(found, 0);
+        if (bits > 0)
+            ASSERT_LT(file_->reads_, 2000 / 50); // 误判率约1%
+        else
+            ASSERT_EQ(file_->reads_, 2000);
+
+        // 存在的key不受影响
+        for (int i = 0; i < 4000; i += 2)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "key%08d", i);
+            ASSERT_TRUE(table_->InternalGet(buf, [&](const Slice &)
+                                            { return ++found > 0; })
+                            .ok());
+        }
+        ASSERT_EQ(found, 2000);
+    }
+}
+
+TEST_F(SSTableTest, MmapReads)
+{
+    FillKeys(2000);
+    ASSERT_TRUE(Build().ok());
+    Env *env = Env::Default();
+    const std::string fname = testing::TempDir() + "kvdb_sstable_mmap";
+    ASSERT_TRUE(WriteStringToFile(env, file_->contents_, fname, false).ok());
+
+    // 只允许映射一个文件
+    auto limiter = std::make_shared<MmapLimiter>(1);
+    RandomAccessFile *mapped;
+    ASSERT_TRUE(env->NewMmapReadableFile(fname, limiter, &mapped).ok());
+    ASSERT_TRUE(mapped->ZeroCopy());
+    RandomAccessFile *fallback;
+    ASSERT_TRUE(env->NewMmapReadableFile(fname, limiter, &fallback).ok());
+    ASSERT_FALSE(fallback->ZeroCopy());
+    delete fallback;
+
+    SSTable *table;
+    ASSERT_TRUE(SSTable::Open(options_, mapped, file_->contents_.size(), &table).ok());
+    std::unique_ptr<SSTable> guard(table);
+    table->Hint(AccessPattern::kSequential);
+    std::unique_ptr<SliceIterator> iter(table->NewIterator());
+    size_t i = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i)
+    {
+        ASSERT_EQ(iter->key().ToString(), keys_[i]);
+        ASSERT_EQ(iter->value().ToString(), "v" + keys_[i]);
+    }
+    ASSERT_EQ(i, keys_.size());
+    ASSERT_TRUE(iter->status().ok());
+    iter.reset();
+
+    table->Hint(AccessPattern::kRandom);
+    for (const std::string &key : keys_)
+    {
+        std::string found;
+        ASSERT_TRUE(table->InternalGet(key, [&](const Slice &value)
+                                       {
+                                           found = value.ToString();
+                                           return true; })
+                        .ok());
+        ASSERT_EQ(found, "v" + key);
+    }
+
+    // 关闭映射的文件后额度归还
+    guard.reset();
+    ASSERT_TRUE(env->NewMmapReadableFile(fname, limiter, &mapped).ok());
+    ASSERT_TRUE(mapped->ZeroCopy());
+    delete mapped;
+    env->RemoveFile(fname);
+}
+
+TEST_F(SSTableTest, BlockCache)
+{
+    FillKeys(2000);
+    options_.block_cache = std::make_shared<BlockCache>(1 << 20);
+    ASSERT_TRUE(Build().ok());
+    // 索引块和过滤器块默认由SSTable自己持有
+    ASSERT_EQ(options_.block_cache->GetUsage(), 0u);
+
+    // table_释放时会删除file_，用同样的内容换一个文件重新打开
+    auto reopen = [&]()
+    {
+        std::string contents = file_->contents_;
+        delete table_;
+        table_ = nullptr;
+        file_ = new StringFile;
+        file_->contents_ = contents;
+        return Reopen();
+    };
+    auto get_all = [&]()
+    {
+        for (const std::string &key : keys_)
+        {
+            std::string found;
+            ASSERT_TRUE(table_->InternalGet(key, [&](const Slice &value)
+                                            {
+                                                found = value.ToString();
+                                                return true; })
+                            .ok());
+            ASSERT_EQ(found, "v" + key);
+        }
+    };
+    file_->reads_ = 0;
+    get_all();
+    const int block_reads = file_->reads_;
+    ASSERT_GT(options_.block_cache->GetUsage(), 0u);
+
+    // 所有块都在缓存中，不再读文件
+    file_->reads_ = 0;
+    get_all();
+    std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+    {
+    }
+    ASSERT_TRUE(iter->status().ok());
+    iter.reset();
+    ASSERT_EQ(file_->reads_, 0);
+
+    // 重新打开后编号不同，之前缓存的块不会被命中
+    ASSERT_TRUE(reopen().ok());
+    file_->reads_ = 0;
+    get_all();
+    ASSERT_GT(file_->reads_, 0);
+
+    // 索引块和过滤器块以高优先级放入很小的缓存，大量数据块不会把它们挤出去，
+    // 与固定在SSTable中时读文件的次数相同
+    options_.cache_index_and_filter_blocks = true;
+    for (bool pin : {true, false})
+    {
+        options_.pin_index_and_filter_blocks = pin;
+        options_.block_cache = std::make_shared<BlockCache>(16 * 1024, 0);
+        ASSERT_TRUE(reopen().ok());
+        ASSERT_GT(options_.block_cache->GetUsage(), 0u);
+        file_->reads_ = 0;
+        get_all();
+        ASSERT_EQ(file_->reads_, block_reads) << pin;
+    }
+}
+
+TEST_F(SSTableTest, Compression)
+{
+    FillKeys(2000);
+    ASSERT_TRUE(Build().ok());
+    const size_t raw_size = file_->contents_.size();
+
+    std::vector<CompressionType> types = {kLZ4Compression};
+    if (CompressionTypeSupported(kSnappyCompression))
+        types.push_back(kSnappyCompression);
+    if (CompressionTypeSupported(kZstdCompression))
+        types.push_back(kZstdCompression);
+    for (CompressionType type : types)
+    {
+        options_.compression = type;
+        options_.block_cache = std::make_shared<BlockCache>(1 << 20);
+        delete table_;
+        table_ = nullptr;
+        ASSERT_TRUE(Build().ok());
+        ASSERT_LT(file_->contents_.size(), raw_size * 3 / 4) << CompressionTypeName(type);
+
+        std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+        size_t i = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i)
+        {
+            ASSERT_EQ(iter->key().ToString(), keys_[i]);
+            ASSERT_EQ(iter->value().ToString(), "v" + keys_[i]);
+        }
+        ASSERT_EQ(i, keys_.size());
+        ASSERT_TRUE(iter->status().ok());
+        iter.reset();
+
+        // 解压后的块放入块缓存，之后的读取不再读文件和解压
+        ASSERT_GT(options_.block_cache->GetUsage(), file_->contents_.size());
+        file_->reads_ = 0;
+        for (const std::string &key : keys_)
+        {
+            std::string found;
+            ASSERT_TRUE(table_->InternalGet(key, [&](const Slice &value)
+                                            {
+                                                found = value.ToString();
+                                                return true; })
+                            .ok());
+            ASSERT_EQ(found, "v" + key);
+        }
+        ASSERT_EQ(file_->reads_, 0);
+
+        // 压缩的内容损坏时校验和不符
+        file_->contents_[10] ^= 0x1;
+        options_.block_cache = nullptr;
+        std::string contents = file_->contents_;
+        file_ = new StringFile;
+        file_->contents_ = contents;
+        ASSERT_TRUE(Reopen().ok());
+        ASSERT_TRUE(table_->InternalGet(keys_[0], [](const Slice &)
+                                        { return true; })
+                        .IsCorruption());
+    }
+}
+
+TEST_F(SSTableTest, IncompressibleBlocksStayRaw)
+{
+    // 随机的value压缩后节省不到1/8，原样保存
+    Random rnd(301);
+    FillKeys(500);
+    std::vector<std::string> values;
+    for (size_t i = 0; i < keys_.size(); i++)
+    {
+        std::string value(100, '\0');
+        for (char &c : value)
+            c = static_cast<char>(rnd.Uniform(256));
+        values.push_back(value);
+    }
+    size_t sizes[2];
+    for (int compress = 0; compress < 2; compress++)
+    {
+        options_.compression = compress ? kLZ4Compression : kNoCompression;
+        StringFile file;
+        SSTableBuilder builder(options_, &file);
+        for (size_t i = 0; i < keys_.size(); i++)
+            builder.Add(keys_[i], values[i]);
+        ASSERT_TRUE(builder.Finish().ok());
+        sizes[compress] = file.contents_.size();
+    }
+    ASSERT_EQ(sizes[0], sizes[1]);
+}
+
+TEST_F(SSTableTest, CompressionPerLevel)
+{
+    options_.compression = kZstdCompression;
+    ASSERT_EQ(CompressionForLevel(options_, 5), kZstdCompression);
+    options_.compression_per_level = {kNoCompression, kLZ4Compression, kZstdCompression};
+    ASSERT_EQ(CompressionForLevel(options_, 0), kNoCompression);
+    ASSERT_EQ(CompressionForLevel(options_, 1), kLZ4Compression);
+    ASSERT_EQ(CompressionForLevel(options_, 2), kZstdCompression);
+    ASSERT_EQ(CompressionForLevel(options_, 6), kZstdCompression);
+}
+
+TEST_F(SSTableTest, ZstdDictionary)
+{
+    if (!CompressionTypeSupported(kZstdCompression))
+        return;
+    FillKeys(4000);
+    options_.compression = kZstdCompression;
+    ASSERT_TRUE(Build().ok());
+    const size_t plain_size = file_->contents_.size();
+
+    // 用开头的一部分块训练字典，或者整个文件的块都缓存到Finish时再训练
+    options_.zstd_max_dict_bytes = 4096;
+    for (size_t train_bytes : {size_t(32 * 1024), size_t(1) << 30})
+    {
+        options_.zstd_max_train_bytes = train_bytes;
+        delete table_;
+        table_ = nullptr;
+        ASSERT_TRUE(Build().ok());
+        // 小块之间重复的内容在字典中，即使加上字典本身文件也更小
+        ASSERT_LT(file_->contents_.size(), plain_size) << train_bytes;
+
+        std::unique_ptr<SliceIterator> iter(table_->NewIterator());
+        size_t i = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++i)
+            ASSERT_EQ(iter->value().ToString(), "v" + keys_[i]);
+        ASSERT_EQ(i, keys_.size());
+        ASSERT_TRUE(iter->status().ok());
+        for (size_t k = 0; k < keys_.size(); k += 7)
+        {
+            std::string found;
+            ASSERT_TRUE(table_->InternalGet(keys_[k], [&](const Slice &value)
+                                            {
+                                                found = value.ToString();
+                                                return true; })
+                            .ok());
+            ASSERT_EQ(found, "v" + keys_[k]);
+        }
+    }
+}
+
+TEST(SSTableFormatTest, ShortestSeparator)
+{
+    std::string start = "abcdefg";
+    FindShortestSeparator(&start, "abzzz");
+    ASSERT_EQ(start, "abd");
+
+    // 前缀关系时不变
+    start = "abc";
+    FindShortestSeparator(&start, "abcd");
+    ASSERT_EQ(start, "abc");
+
+    // 只差1时无法缩短
+    start = "abc1";
+    FindShortestSeparator(&start, "abc2");
+    ASSERT_EQ(start, "abc1");
+
+    std::string key = "abc";
+    FindShortSuccessor(&key);
+    ASSERT_EQ(key, "b");
+    key = "\xff\xff";
+    FindShortSuccessor(&key);
+    ASSERT_EQ(key, "\xff\xff");
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
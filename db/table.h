@@ -1,92 +1,1747 @@
 #ifndef STORAGE_KVDB_DB_TABLE_H_
 #define STORAGE_KVDB_DB_TABLE_H_
+#include "db/db_iter.h"
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merger.h"
+#include "db/options.h"
+#include "db/snapshot.h"
+#include "db/sstable.h"
+#include "db/sstable_builder.h"
+#include "db/version_set.h"
+#include "db/write_batch.h"
 #include "util/LRUCache.h"
 #include "util/KVNode.h"
+#include "util/coding.h"
+#include "util/env.h"
+#include "util/hash.h"
+#include "util/perf_context.h"
+#include "util/statistics.h"
+#include "util/status.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 namespace kvdb
 {
     using namespace cache;
-    template <typename K, typename V>
+    // CachePolicy为缓存的淘汰策略，见util/LRUCache.h和util/cache_policy.h
+    template <typename K, typename V, typename CachePolicy = LRUPolicy<K, V>>
     class Table
     {
 
-        typedef std::shared_ptr<KVnode<K, V>> kvnode;
+        typedef LRUHandle<K, V> Handle;
 
     private:
-        MemTable<K, V> memtable_;
+        // 等待写入日志的一次修改或一个batch
+        struct Writer
+        {
+            Writer(const K *k, const V *v, KType t, uint64_t e)
+                : key(k), value(v), type(t), expire_at(e), batch(nullptr), sequence(0), done(false), apply(false) {}
+            explicit Writer(const WriteBatch<K, V> *b)
+                : key(nullptr), value(nullptr), type(KType::kTypeValue), expire_at(0), batch(b), sequence(0),
+                  done(false), apply(false) {}
+
+            const K *key;
+            const V *value;
+            KType type;
+            uint64_t expire_at;
+            // 不为nullptr时写入的是整个batch，忽略key/value/type
+            const WriteBatch<K, V> *batch;
+            // leader分配的序列号，batch中的第i个修改使用sequence + i
+            SequenceNumber sequence;
+
+            Status status;
+            bool done;
+            // 日志已经写好，由写线程自己把修改插入memtable
+            bool apply;
+            std::condition_variable cv;
+        };
+
+        const Options options_;
+        // 为空时不写日志，数据只在内存中
+        const std::string dbname_;
+
+        // 保护以下所有成员
+        mutable std::mutex mutex_;
+        // 只由当前组的leader在持有mutex_时替换，读者持有引用期间memtable不会被释放
+        std::shared_ptr<MemTable<K, V>> mem_;
+        // 已满、正在由后台线程写入磁盘的memtable，没有时为nullptr
+        std::shared_ptr<MemTable<K, V>> imm_;
+        // 合并过程中不加锁检查，有imm_时先把它写入磁盘，避免写线程长时间等待
+        std::atomic<bool> has_imm_;
+        // 每层有哪些有序表文件，后台线程修改时整体替换当前版本
+        VersionSet versions_;
+        // 正在写入、还没有加入版本的文件，不能被当作无用文件删除
+        std::set<uint64_t> pending_outputs_;
+
+        std::deque<Writer *> writers_;
+        // 当前组内还没有插入memtable的写线程数
+        int pending_apply_;
+        // 还没有释放的快照
+        SnapshotList snapshots_;
+        // 正在原地修改memtable、还没有发布序列号的写入数
+        int inplace_writers_;
+        // 存在的迭代器和正在创建的快照数，不为0时不原地修改，迭代器不加锁读取memtable中的value
+        mutable int inplace_blockers_;
+        // inplace_writers_减到0时通知
+        mutable std::condition_variable inplace_cv_;
+
+        // 已经分配出去的最大序列号
+        std::atomic<SequenceNumber> allocated_sequence_;
+        // 已经插入memtable、对快照可见的最大序列号。按分配的顺序推进，
+        // 不大于它的修改都已经写完，所以快照不会缺少序列号更小的修改
+        std::atomic<SequenceNumber> last_sequence_;
+        // 日志或有序表文件写入失败后磁盘状态不确定，之后的写入全部失败
+        Status bg_error_;
 
-        kvnode NewNode(const K &key, const V &value, KType type);
+        // imm_写完、合并完成、后台出错或者Table析构时通知，后台线程和等待的写线程共用
+        std::condition_variable bg_cv_;
+        // 合并过程中不加锁检查，析构时尽快放弃正在进行的合并
+        std::atomic<bool> shutting_down_;
+        std::thread bg_thread_;
 
-        inline V *IsKTypeValueReturnValue(const kvnode &x)
+        // 只由当前组的leader访问
+        WritableFile *logfile_;
+        log::Writer *log_;
+        uint64_t logfile_number_;
+
+        // expire_at为过期时间，0表示永不过期
+        void Write(const K &key, const V &value, KType type, uint64_t expire_at = 0);
+        // 排队写入日志，成为leader时负责写入整个组
+        void JoinWriteGroup(Writer *w);
+        void WriteToLog(Writer *w, std::unique_lock<std::mutex> &lock);
+        // 分配组内修改的序列号，*last_sequence为最后一个
+        void BuildBatchGroup(std::vector<Writer *> *group, std::string *record, SequenceNumber *last_sequence);
+        // inplace为true时写入的值尽量原地覆盖memtable中的旧值
+        void Apply(const Writer *w, bool inplace);
+        void Apply(const K &key, const V &value, KType type, uint64_t expire_at, SequenceNumber seq, bool inplace);
+        // batch中的修改按key排序后插入memtable，相邻的插入共用跳表的查找位置。
+        // 第i个修改的序列号为seq + i
+        void ApplyBatch(const WriteBatch<K, V> &batch, SequenceNumber seq, bool inplace);
+        void MemTableInsert(const K &key, const V &value, KType type, uint64_t expire_at, SequenceNumber seq,
+                            bool inplace);
+        std::shared_ptr<MemTable<K, V>> NewMemTable() const
         {
-            if (x->type != KType::kTypeValue)
-            {
-                return nullptr;
-            }
-            return &(x->value); // 假设 KVNode 的 value 是直接存储的值（非指针）
+            const bool inplace = options_.inplace_update && !options_.allow_concurrent_memtable_write;
+            const size_t prefix_bloom_bits =
+                static_cast<size_t>(options_.write_buffer_size * options_.memtable_prefix_bloom_size_ratio) * 8;
+            return std::make_shared<MemTable<K, V>>(inplace ? options_.inplace_update_num_locks : 0,
+                                                    options_.prefix_extractor, prefix_bloom_bits,
+                                                    options_.statistics.get());
+        }
+        // 没有快照和迭代器能看到旧版本时开始一次原地修改，返回false时照常插入新版本。
+        // 返回true时要在发布序列号之后调用EndInPlaceWrite。REQUIRES: 持有mutex_
+        bool BeginInPlaceWrite()
+        {
+            if (!mem_->SupportsInPlaceUpdate() || !snapshots_.empty() || inplace_blockers_ > 0)
+                return false;
+            ++inplace_writers_;
+            return true;
+        }
+        // REQUIRES: 持有mutex_
+        void EndInPlaceWrite()
+        {
+            if (--inplace_writers_ == 0)
+                inplace_cv_.notify_all();
+        }
+        // 只在内存中的Table没有leader，每次写入自己判断能否原地修改，没有开启原地修改时不加锁
+        bool BeginInMemoryWrite()
+        {
+            if (!mem_->SupportsInPlaceUpdate())
+                return false;
+            std::lock_guard<std::mutex> lock(mutex_);
+            return BeginInPlaceWrite();
+        }
+        void EndInMemoryWrite(bool inplace)
+        {
+            if (!inplace)
+                return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            EndInPlaceWrite();
+        }
+        // 阻止新的原地修改，并等待正在进行的原地修改发布，之后memtable中可见的旧版本不会再被覆盖。
+        // 不再需要时减少inplace_blockers_。REQUIRES: 持有mutex_
+        void BlockInPlaceWrites(std::unique_lock<std::mutex> &lock) const
+        {
+            ++inplace_blockers_;
+            while (inplace_writers_ > 0)
+                inplace_cv_.wait(lock);
+        }
+        // 拷贝memtable中的节点，开启原地修改时持有key的锁读取value
+        Handle *CopyMemTableNode(const MemTable<K, V> &mem, const KVnode<K, V> *node) const;
+        // 分配n个连续的序列号，返回第一个
+        SequenceNumber AllocateSequence(uint32_t n)
+        {
+            return allocated_sequence_.fetch_add(n, std::memory_order_relaxed) + 1;
+        }
+        // [first, last]已经插入memtable后调用，等到first之前的序列号都发布之后再发布last
+        void PublishSequence(SequenceNumber first, SequenceNumber last);
+        // flush和合并可以丢弃序列号不大于它、且被更新版本覆盖的旧版本。REQUIRES: 持有mutex_
+        SequenceNumber SmallestSnapshot() const
+        {
+            return snapshots_.empty() ? last_sequence_.load(std::memory_order_acquire) : snapshots_.OldestSequence();
+        }
+        void UpdateCache(const K &key, const V &value, KType type, uint64_t expire_at);
+        Status MakeRoomForWrite(std::unique_lock<std::mutex> &lock);
+        // 记录写入因为后台跟不上而等待的时间，start为开始等待时的perf::NowNanos()
+        void RecordWriteStall(uint64_t start) const
+        {
+            const uint64_t nanos = perf::NowNanos() - start;
+            RecordTick(options_.statistics.get(), kWriteStallNanos, nanos);
+            if (GetPerfLevel() >= PerfLevel::kEnableTime)
+                GetPerfContext()->write_stall_nanos += nanos;
         }
 
+        void BackgroundThread();
+        void CompactMemTable(std::unique_lock<std::mutex> &lock);
+        void BackgroundCompaction(std::unique_lock<std::mutex> &lock);
+        Status DoCompactionWork(Compaction *c, std::unique_lock<std::mutex> &lock);
+        // 删除当前版本不再引用的有序表文件、旧日志和旧MANIFEST
+        void RemoveObsoleteFiles(std::unique_lock<std::mutex> &lock);
+
+        // 把mem写入编号为number的有序表文件，mem为空或者所有条目都被丢弃时不创建文件。每个key保留最新版本，
+        // 以及序列号大于smallest_snapshot的版本之后第一个不大于它的版本，它们可能对某个快照可见。
+        // base不为nullptr时，已经过期、对所有快照可见、并且base的文件中没有这个key的最新版本连同旧版本一起丢弃
+        Status WriteTableFile(const MemTable<K, V> &mem, uint64_t number, FileMetaData *meta,
+                              SequenceNumber smallest_snapshot, const Version *base);
+        // 有序表文件先写入临时文件，落盘之后再重命名，目录中的有序表文件总是完整的
+        Status OpenTableOutput(uint64_t number, WritableFile **file);
+        Status FinishTableOutput(SSTableBuilder *builder, WritableFile *file, FileMetaData *meta);
+        // 返回key在snapshot中可见的版本，是引用计数为1的新条目，key不存在时返回nullptr
+        template <typename Q>
+        Handle *LoadNode(const Q &key, SequenceNumber snapshot) const;
+        // Get的实现，Q为K或者可以代替K查找的类型
+        template <typename Q>
+        PinnedHandle<K, V> GetImpl(const ReadOptions &options, const Q &key);
+        // 批量的LoadNode，结果写入nodes[i]。出错时释放已加载的条目并抛出std::runtime_error
+        void LoadNodes(const K *const *keys, size_t n, Handle **nodes, SequenceNumber snapshot) const;
+
+        Status Recover();
+        // *max_sequence更新为日志中最大的序列号
+        Status ReplayLogFile(uint64_t number, VersionEdit *edit, SequenceNumber *max_sequence);
+        Status NewLogFile(uint64_t number);
+
+        // 日志记录格式：fixed64 第一个条目的序列号 | varint32 条目数 | 各条目，条目格式见WriteBatch。
+        // 对每个条目调用handler(key, value, type, seq, expire_at)
+        template <typename Handler>
+        static Status DecodeRecord(const Slice &record, Handler &&handler);
+
+        // prefix不为nullptr时不遍历前缀过滤器判断不含prefix的memtable和文件，
+        // 以及key范围与prefix不相交的文件，只能用于遍历以prefix开头的key
+        Iterator<K, V> *NewIterator(const ReadOptions &options, const std::string *prefix) const;
+
+        // 缓存条目，charge为条目占用的内存。已经过期的value换成删除标记，读者看到key不存在
+        Handle *NewNode(const K &key, const V &value, KType type, uint64_t expire_at) const;
+        // 从磁盘读到的条目要保存一份K，查找用的key是其他类型时在这里构造
+        static const K &ToKey(const K &key) { return key; }
+        template <typename Q>
+        static K ToKey(const Q &key) { return K(key); }
+
     public:
-        LRUCache<K, V> cache_;
-        Table(int size) : cache_(size) {}
+        ShardedLRUCache<K, V, CachePolicy> cache_;
+        // cache_capacity为缓存的字节数
+        Table(size_t cache_capacity) : Table(Options(), cache_capacity) {}
+        explicit Table(const Options &options) : Table(options, options.cache_capacity) {}
 
+        // 打开dbname目录下的数据库，所有修改在插入memtable之前先写入日志。
+        // memtable超过write_buffer_size后由后台线程写入第0层的有序表文件，
+        // 某一层的文件过多或过大时后台线程把它合并到下一层，每层文件的列表记录在MANIFEST中。
+        // 打开时把已有日志重放并写入新的有序表文件。失败时抛出std::runtime_error
+        Table(const Options &options, const std::string &dbname);
+        ~Table();
+
+        Table(const Table &) = delete;
+        Table &operator=(const Table &) = delete;
+
+        // 写日志失败时抛出std::runtime_error
         void Insert(const K &key, const V &value);
-        V *Get(const K &key);
+        // 写入ttl之后过期的value：过期后Get和迭代器看不到key，缓存优先淘汰它，flush和合并直接丢弃它，
+        // 不需要再调用Remove写删除标记。ttl从options.env->NowMicros()算起，不大于0时写入的value已经过期
+        void Insert(const K &key, const V &value, std::chrono::microseconds ttl);
+        // 执行batch中的所有修改，只排队一次、写一条日志记录，恢复时batch要么全部重放要么全部丢弃。
+        // 同一个key在batch中多次出现时以最后一次为准。写日志失败时抛出std::runtime_error
+        void Write(const WriteBatch<K, V> &batch);
+        // 依次查找缓存、memtable、imm_和各层有序表文件，读取文件出错时抛出std::runtime_error。
+        // 返回的句柄固定住缓存条目，即使条目被淘汰或被新值替换，句柄释放前值都有效
+        PinnedHandle<K, V> Get(const K &key) { return GetImpl(ReadOptions(), key); }
+        // options.snapshot不为nullptr时返回快照中的值。缓存只保存最新的值，
+        // 快照读直接查找memtable和文件，返回的句柄不在缓存中
+        PinnedHandle<K, V> Get(const ReadOptions &options, const K &key) { return GetImpl(options, key); }
+        // 用可以代替K查找的类型查找，如Table<std::string, V>::Get(std::string_view)。
+        // 缓存、memtable中的查找都不构造K，只有从文件读到条目时才构造一份放入缓存
+        template <typename Q, typename = std::enable_if_t<IsTransparentKey<K, Q>::value>>
+        PinnedHandle<K, V> Get(const Q &key) { return GetImpl(ReadOptions(), key); }
+        template <typename Q, typename = std::enable_if_t<IsTransparentKey<K, Q>::value>>
+        PinnedHandle<K, V> Get(const ReadOptions &options, const Q &key) { return GetImpl(options, key); }
+        // 批量查找，结果与对每个key调用Get相同，第i个句柄对应keys[i]。
+        // 缓存按分片分组查找，每个分片加一次锁；未命中的key排序后在memtable中
+        // 从上一个key的位置继续查找，读磁盘时同一文件中落在同一数据块的key只读一次块
+        std::vector<PinnedHandle<K, V>> MultiGet(const std::vector<K> &keys) { return MultiGet(ReadOptions(), keys); }
+        std::vector<PinnedHandle<K, V>> MultiGet(const ReadOptions &options, const std::vector<K> &keys);
         void Remove(const K &key);
+
+        // 返回按key有序遍历的迭代器，只包含每个key的最新版本，不包含已删除的key。
+        // 迭代器相当于创建时的一个快照，之后的修改不可见，也不会阻塞写入。
+        // 调用方负责delete，迭代器期间Table不能被释放
+        Iterator<K, V> *NewIterator() const { return NewIterator(ReadOptions()); }
+        // options.snapshot不为nullptr时遍历快照中的数据
+        Iterator<K, V> *NewIterator(const ReadOptions &options) const { return NewIterator(options, nullptr); }
+
+        // 按key升序返回[begin, end)内最多limit个key/value，不拷贝数据。
+        // options.prefix_same_as_start为true时只返回与begin前缀相同的key，见ReadOptions
+        ScanIterator<K, V> Scan(const K &begin, const K &end,
+                                size_t limit = std::numeric_limits<size_t>::max()) const
+        {
+            return Scan(ReadOptions(), begin, end, limit);
+        }
+        ScanIterator<K, V> Scan(const ReadOptions &options, const K &begin, const K &end,
+                                size_t limit = std::numeric_limits<size_t>::max()) const;
+
+        // 创建当前状态的快照，通过ReadOptions::snapshot读取时看不到之后的修改。
+        // 快照存在期间flush和合并会保留它能看到的旧版本，不再使用时要调用ReleaseSnapshot
+        const Snapshot *GetSnapshot();
+        void ReleaseSnapshot(const Snapshot *snapshot);
+
+        // 磁盘上有序表文件的个数
+        size_t NumTableFiles() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t n = 0;
+            for (int level = 0; level < kNumLevels; level++)
+                n += versions_.NumLevelFiles(level);
+            return n;
+        }
+
+        // 第level层有序表文件的个数
+        int NumLevelFiles(int level) const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return versions_.NumLevelFiles(level);
+        }
+
+        // 等待后台线程写完imm_并完成所有需要的合并，后台出错时抛出std::runtime_error
+        void WaitForCompaction();
+
+        // 把options.statistics导出到文件fname，导出前先把memtable大小、缓存占用和文件数记入瞬时值，
+        // 多个Table共用一个Statistics时瞬时值是最后导出的Table的。
+        // 没有设置statistics或写文件失败时抛出std::runtime_error
+        void DumpStatistics(const std::string &fname, Statistics::Format format = Statistics::kText);
+
+    private:
+        // 只在内存中的Table
+        Table(const Options &options, size_t cache_capacity)
+            : options_(options), mem_(NewMemTable()), has_imm_(false),
+              versions_(dbname_, options), pending_apply_(0), inplace_writers_(0), inplace_blockers_(0),
+              allocated_sequence_(0), last_sequence_(0), shutting_down_(false), logfile_(nullptr),
+              log_(nullptr), logfile_number_(0),
+              cache_(cache_capacity, options.cache_shard_bits, options.cache_budget, options.env) {}
     };
 
-    template <typename K, typename V>
-    typename Table<K, V>::kvnode Table<K, V>::NewNode(const K &key, const V &value, KType type)
+    template <typename K, typename V, typename CachePolicy>
+    Table<K, V, CachePolicy>::Table(const Options &options, const std::string &dbname)
+        : options_(options), dbname_(dbname), mem_(NewMemTable()), has_imm_(false),
+          versions_(dbname, options), pending_apply_(0), inplace_writers_(0), inplace_blockers_(0),
+          allocated_sequence_(0), last_sequence_(0),
+          shutting_down_(false), logfile_(nullptr), log_(nullptr), logfile_number_(0),
+          cache_(options.cache_capacity, options.cache_shard_bits, options.cache_budget, options.env)
     {
-        return std::make_shared<KVnode<K, V>>(key, value, type);
+        Status s;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            s = Recover();
+            if (s.ok())
+                RemoveObsoleteFiles(lock);
+        }
+        if (!s.ok())
+        {
+            delete log_;
+            delete logfile_;
+            throw std::runtime_error(s.ToString());
+        }
+        bg_thread_ = std::thread(&Table::BackgroundThread, this);
     }
 
-    template <typename K, typename V>
-    void Table<K, V>::Insert(const K &key, const V &value)
+    template <typename K, typename V, typename CachePolicy>
+    Table<K, V, CachePolicy>::~Table()
     {
-        // kv节点在memtable和缓存内直接被修改返回true，kv节点只在缓存或不存在返回false需要插入到memtable中
-        if (!cache_.Insert(key, value))
-            memtable_.Insert(NewNode(key, value, KType::kTypeValue));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutting_down_ = true;
+        }
+        // 正在写的imm_会写完，正在进行的合并被放弃，还没开始写的imm_留在日志中，下次打开时恢复
+        bg_cv_.notify_all();
+        if (bg_thread_.joinable())
+            bg_thread_.join();
+
+        delete log_;
+        if (logfile_ != nullptr)
+            logfile_->Close();
+        delete logfile_;
     }
 
-    template <typename K, typename V>
-    V *Table<K, V>::Get(const K &key)
+    template <typename K, typename V, typename CachePolicy>
+    typename Table<K, V, CachePolicy>::Handle *Table<K, V, CachePolicy>::NewNode(const K &key, const V &value,
+                                                                                  KType type, uint64_t expire_at) const
     {
-        kvnode x = cache_.Get(key);
+        // 缓存删除标记而不是过期的value，之后的Get直接命中，不用再查找memtable和文件
+        if (expire_at != 0 && IsExpired(expire_at, options_.env->NowMicros()))
+            return new Handle(key, V(), KType::kTypeDelete, DefaultCharge<K, V>()(key, V()));
+        return new Handle(key, value, type, DefaultCharge<K, V>()(key, value), expire_at);
+    }
 
-        if (x != nullptr)
+    template <typename K, typename V, typename CachePolicy>
+    typename Table<K, V, CachePolicy>::Handle *
+    Table<K, V, CachePolicy>::CopyMemTableNode(const MemTable<K, V> &mem, const KVnode<K, V> *node) const
+    {
+        if (!mem.SupportsInPlaceUpdate())
+            return NewNode(node->key, node->value, node->type(), node->expire_at);
+        std::shared_lock<std::shared_mutex> lock(mem.GetLock(node->key));
+        return NewNode(node->key, node->value, node->type(), node->expire_at);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    template <typename Handler>
+    Status Table<K, V, CachePolicy>::DecodeRecord(const Slice &record, Handler &&handler)
+    {
+        Slice input = record;
+        uint32_t count;
+        if (input.size() < 8)
+            return Status::Corruption("log record too small");
+        SequenceNumber seq = DecodeFixed64(input.data());
+        input.remove_prefix(8);
+        if (!GetVarint32(&input, &count))
+            return Status::Corruption("log record too small");
+
+        Status s = WriteBatch<K, V>::DecodeEntries(&input, count,
+                                                   [&](const K &key, const V &value, KType type, uint64_t expire_at)
+                                                   { handler(key, value, type, seq++, expire_at); });
+        if (!s.ok())
+            return s;
+        if (!input.empty())
+            return Status::Corruption("trailing bytes in log record");
+        return Status::OK();
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::NewLogFile(uint64_t number)
+    {
+        WritableFile *file;
+        Status s = options_.env->NewWritableFile(LogFileName(dbname_, number), &file);
+        if (!s.ok())
+            return s;
+        delete log_;
+        if (logfile_ != nullptr)
+            logfile_->Close();
+        delete logfile_;
+        logfile_ = file;
+        log_ = new log::Writer(file);
+        logfile_number_ = number;
+        return Status::OK();
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::ReplayLogFile(uint64_t number, VersionEdit *edit, SequenceNumber *max_sequence)
+    {
+        std::string fname = LogFileName(dbname_, number);
+        SequentialFile *file;
+        Status s = options_.env->NewSequentialFile(fname, &file);
+        if (!s.ok())
+            return s;
+
+        log::StatusReporter reporter;
+        log::Reader reader(file, &reporter, true);
+        std::string scratch;
+        Slice record;
+        while (s.ok() && reader.ReadRecord(&record, &scratch))
         {
-            // 在缓存中
-            return IsKTypeValueReturnValue(x);
+            s = DecodeRecord(record, [this, max_sequence](const K &key, const V &value, KType type, SequenceNumber seq,
+                                                          uint64_t expire_at)
+                             {
+                                 mem_->Insert(key, value, type, seq, expire_at);
+                                 *max_sequence = std::max(*max_sequence, seq); });
+            if (s.ok() && mem_->ApproximateMemoryUsage() > options_.write_buffer_size)
+            {
+                // 日志很大时边重放边写入文件，避免memtable无限增长。打开期间没有快照，只保留最新版本。
+                // 之前重放写入的文件还不在当前版本中，不能判断过期的条目有没有要遮住的旧值
+                FileMetaData meta;
+                s = WriteTableFile(*mem_, versions_.NewFileNumber(), &meta, kMaxSequenceNumber, nullptr);
+                if (s.ok())
+                {
+                    if (meta.table != nullptr)
+                        edit->AddFile(0, meta);
+                    mem_ = NewMemTable();
+                }
+            }
         }
+        delete file;
+        if (s.ok())
+            s = reporter.status;
+        if (!s.ok())
+            return Status::Corruption(fname, s.ToString());
+        return s;
+    }
+
+    // REQUIRES: 持有mutex_，后台线程还没有启动
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::Recover()
+    {
+        Env *env = options_.env;
+        Status s = env->CreateDir(dbname_);
+        if (!s.ok())
+            return s;
+
+        const bool has_manifest = env->FileExists(CurrentFileName(dbname_));
+        s = versions_.Recover();
+        if (!s.ok())
+            return s;
+
+        std::vector<std::string> filenames;
+        s = env->GetChildren(dbname_, &filenames);
+        if (!s.ok())
+            return s;
+        std::vector<uint64_t> logs, tables;
+        for (const std::string &filename : filenames)
+        {
+            uint64_t number;
+            FileType type;
+            if (!ParseFileName(filename, &number, &type))
+                continue;
+            versions_.MarkFileNumberUsed(number);
+            // 编号小于LogNumber()的日志中的数据已经写入有序表文件
+            if (type == FileType::kLogFile && number >= versions_.LogNumber())
+                logs.push_back(number);
+            else if (type == FileType::kTableFile)
+                tables.push_back(number);
+        }
+
+        VersionEdit edit;
+        if (!has_manifest)
+        {
+            // 还没有MANIFEST时创建的目录：有序表文件都比日志旧，全部放入第0层
+            for (uint64_t number : tables)
+            {
+                FileMetaData meta;
+                meta.number = number;
+                s = env->GetFileSize(TableFileName(dbname_, number), &meta.file_size);
+                if (s.ok())
+                    s = versions_.OpenTable(&meta);
+                if (!s.ok())
+                    return s;
+                std::unique_ptr<SliceIterator> iter(meta.table->NewIterator());
+                iter->SeekToFirst();
+                if (iter->Valid())
+                    meta.smallest = iter->key().ToString();
+                iter->SeekToLast();
+                if (iter->Valid())
+                    meta.largest = iter->key().ToString();
+                if (!iter->status().ok())
+                    return iter->status();
+                if (iter->Valid())
+                    edit.AddFile(0, meta);
+            }
+        }
+
+        // 按编号顺序重放，后写的日志覆盖先写的
+        std::sort(logs.begin(), logs.end());
+        SequenceNumber max_sequence = versions_.LastSequence();
+        for (uint64_t number : logs)
+        {
+            s = ReplayLogFile(number, &edit, &max_sequence);
+            if (!s.ok())
+                return s;
+        }
+        // 新的修改从日志和文件中最大的序列号之后继续分配
+        versions_.SetLastSequence(max_sequence);
+        allocated_sequence_.store(max_sequence, std::memory_order_relaxed);
+        last_sequence_.store(max_sequence, std::memory_order_release);
+
+        // 恢复出的数据写入新文件，和新日志的编号一起记录到MANIFEST之后旧日志就可以删除。
+        // 记录之前崩溃的话，下次打开会重放相同的日志，新写的文件没有被引用，会被删除
+        if (!logs.empty())
+        {
+            FileMetaData meta;
+            s = WriteTableFile(*mem_, versions_.NewFileNumber(), &meta, kMaxSequenceNumber, nullptr);
+            if (!s.ok())
+                return s;
+            if (meta.table != nullptr)
+                edit.AddFile(0, meta);
+            mem_ = NewMemTable();
+        }
+
+        s = NewLogFile(versions_.NewFileNumber());
+        if (!s.ok())
+            return s;
+        edit.SetLogNumber(logfile_number_);
+        return versions_.LogAndApply(&edit, nullptr);
+    }
+
+    // REQUIRES: 持有mutex_
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::RemoveObsoleteFiles(std::unique_lock<std::mutex> &lock)
+    {
+        // 出错后不确定版本是否已经写入MANIFEST，不删除任何文件
+        if (!bg_error_.ok())
+            return;
+
+        std::set<uint64_t> live = pending_outputs_;
+        versions_.AddLiveFiles(&live);
+        const uint64_t log_number = versions_.LogNumber();
+        const uint64_t manifest_number = versions_.ManifestFileNumber();
+
+        // 有序表文件只由后台线程(即当前线程)创建，之后新建的日志编号都不小于log_number，
+        // 删除期间不需要持有锁
+        lock.unlock();
+        std::vector<std::string> filenames;
+        options_.env->GetChildren(dbname_, &filenames);
+        for (const std::string &filename : filenames)
+        {
+            uint64_t number;
+            FileType type;
+            if (!ParseFileName(filename, &number, &type))
+                continue;
+            bool keep = true;
+            switch (type)
+            {
+            case FileType::kLogFile:
+                keep = number >= log_number;
+                break;
+            case FileType::kDescriptorFile:
+                keep = number >= manifest_number;
+                break;
+            case FileType::kTableFile:
+            case FileType::kTempFile:
+                keep = live.count(number) > 0;
+                break;
+            case FileType::kCurrentFile:
+                break;
+            }
+            if (!keep)
+                options_.env->RemoveFile(dbname_ + "/" + filename);
+        }
+        lock.lock();
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::OpenTableOutput(uint64_t number, WritableFile **file)
+    {
+        return options_.env->NewWritableFile(TempFileName(dbname_, number), file);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::FinishTableOutput(SSTableBuilder *builder, WritableFile *file, FileMetaData *meta)
+    {
+        Status s = builder->Finish();
+        meta->file_size = builder->FileSize();
+        if (s.ok())
+            s = file->Sync();
+        if (s.ok())
+            s = file->Close();
+        delete file;
+
+        Env *env = options_.env;
+        const std::string tmp = TempFileName(dbname_, meta->number);
+        if (s.ok())
+            s = env->RenameFile(tmp, TableFileName(dbname_, meta->number));
+        if (s.ok())
+            s = env->SyncDir(dbname_);
+        if (s.ok())
+            s = versions_.OpenTable(meta);
         else
+            env->RemoveFile(tmp);
+        return s;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::WriteTableFile(const MemTable<K, V> &mem, uint64_t number, FileMetaData *meta,
+                                                    SequenceNumber smallest_snapshot, const Version *base)
+    {
+        meta->number = number;
+        meta->file_size = 0;
+        std::unique_ptr<Iterator<K, V>> iter(mem.NewIterator());
+        iter->SeekToFirst();
+        if (!iter->Valid())
+            return Status::OK();
+
+        WritableFile *file;
+        Status s = OpenTableOutput(number, &file);
+        if (!s.ok())
+            return s;
+
+        SSTableBuilder builder(options_, file, 0);
+        const uint64_t now = options_.env->NowMicros();
+        uint64_t expired = 0;
+        std::string key, last_key, value;
+        bool has_last_key = false;
+        // 同一个key上一个版本的序列号
+        SequenceNumber last_sequence_for_key = 0;
+        for (; iter->Valid(); iter->Next())
         {
-            x = memtable_.Get(key);
-            if (x != nullptr)
+            key.clear();
+            Codec<K>::Encode(&key, iter->key());
+            const bool new_key = !has_last_key || key != last_key;
+            if (new_key)
             {
-                // 在memtable中
-                // 插入到cache内
-                cache_.Insert(x);
-                return IsKTypeValueReturnValue(x);
+                last_key = key;
+                has_last_key = true;
             }
+            // 更新的版本已经对所有快照可见时，这个版本不会再被读到。
+            // 每个key的最新版本一般要保留，删除标记和过期的value也要遮住更旧文件中的值；
+            // 过期的value对所有快照可见、并且文件中没有这个key时已经没有要遮住的值
+            bool drop = !new_key && last_sequence_for_key <= smallest_snapshot;
+            if (!drop && base != nullptr && IsExpired(iter->expire_at(), now) &&
+                iter->sequence() <= smallest_snapshot && !base->KeyInRange(key))
+            {
+                drop = true;
+                ++expired;
+            }
+            last_sequence_for_key = iter->sequence();
+            if (drop)
+                continue;
+            value.clear();
+            EncodeTableValue(&value, iter->type(), iter->sequence(), &iter->value(), iter->expire_at());
+            builder.Add(key, value);
+            if (builder.NumEntries() == 1)
+                meta->smallest = key;
+            meta->largest = key;
+        }
+        RecordTick(options_.statistics.get(), kExpiredKeysDropped, expired);
+        if (builder.NumEntries() == 0)
+        {
+            // 所有条目都已过期，不创建文件
+            builder.Abandon();
+            file->Close();
+            delete file;
+            return options_.env->RemoveFile(TempFileName(dbname_, number));
+        }
+        return FinishTableOutput(&builder, file, meta);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::BackgroundThread()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            while (!shutting_down_ && (!bg_error_.ok() || (imm_ == nullptr && !versions_.NeedsCompaction())))
+                bg_cv_.wait(lock);
+            if (shutting_down_)
+                break;
+            // 写线程可能正在等待imm_，优先写入
+            if (imm_ != nullptr)
+                CompactMemTable(lock);
             else
+                BackgroundCompaction(lock);
+            bg_cv_.notify_all();
+        }
+    }
+
+    // REQUIRES: 持有mutex_，imm_ != nullptr
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::CompactMemTable(std::unique_lock<std::mutex> &lock)
+    {
+        std::shared_ptr<MemTable<K, V>> imm = imm_;
+        const uint64_t number = versions_.NewFileNumber();
+        const SequenceNumber smallest_snapshot = SmallestSnapshot();
+        // 只有后台线程(即当前线程)向版本中加入文件，写文件期间base之外不会出现这些key的旧版本
+        const std::shared_ptr<const Version> base = versions_.current();
+        pending_outputs_.insert(number);
+
+        lock.unlock();
+        FileMetaData meta;
+        Status s;
+        {
+            StatsTimer timer(options_.statistics.get(), kFlushLatency);
+            s = WriteTableFile(*imm, number, &meta, smallest_snapshot, base.get());
+        }
+        if (s.ok())
+        {
+            RecordTick(options_.statistics.get(), kMemTableFlushes);
+            RecordTick(options_.statistics.get(), kFlushBytesWritten, meta.file_size);
+        }
+        lock.lock();
+
+        if (s.ok())
+        {
+            // imm_的数据已经在文件中，当前日志之前的日志都不再需要
+            VersionEdit edit;
+            if (meta.table != nullptr)
+                edit.AddFile(0, meta);
+            edit.SetLogNumber(logfile_number_);
+            s = versions_.LogAndApply(&edit, &lock);
+        }
+        pending_outputs_.erase(number);
+        if (!s.ok())
+        {
+            bg_error_ = s;
+            return;
+        }
+        imm_ = nullptr;
+        has_imm_.store(false, std::memory_order_release);
+        RemoveObsoleteFiles(lock);
+    }
+
+    // REQUIRES: 持有mutex_
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::BackgroundCompaction(std::unique_lock<std::mutex> &lock)
+    {
+        std::unique_ptr<Compaction> c(versions_.PickCompaction());
+        if (c == nullptr)
+            return;
+
+        Status s;
+        if (c->IsTrivialMove())
+        {
+            // 直接把文件移到下一层，不需要读写数据
+            const FileMetaData &f = c->inputs[0][0];
+            c->edit()->RemoveFile(c->level(), f.number);
+            c->edit()->AddFile(c->level() + 1, f);
+            s = versions_.LogAndApply(c->edit(), &lock);
+        }
+        else
+        {
+            StatsTimer timer(options_.statistics.get(), kCompactionLatency);
+            s = DoCompactionWork(c.get(), lock);
+            RecordTick(options_.statistics.get(), kCompactions);
+        }
+
+        if (!s.ok())
+        {
+            // 析构时放弃的合并不算错误，写了一半的文件在下次打开时删除
+            if (!shutting_down_)
+                bg_error_ = s;
+            return;
+        }
+        RemoveObsoleteFiles(lock);
+    }
+
+    // 把c的输入文件合并写入level+1层，每个key保留最新版本和仍可能被快照读到的旧版本。
+    // REQUIRES: 持有mutex_，合并期间释放
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::DoCompactionWork(Compaction *c, std::unique_lock<std::mutex> &lock)
+    {
+        std::vector<FileMetaData> outputs;
+        std::vector<uint64_t> output_numbers;
+        // 之后创建的快照能看到输入文件中每个key的最新版本，只需要考虑现有的快照
+        const SequenceNumber smallest_snapshot = SmallestSnapshot();
+        lock.unlock();
+        // 在这之前过期的value可以像删除标记一样丢弃
+        const uint64_t now = options_.env->NowMicros();
+        uint64_t expired = 0;
+
+        // 输入文件合并完就会删除，这期间主要是从头到尾的读取
+        for (int which = 0; which < 2; which++)
+        {
+            for (const FileMetaData &f : c->inputs[which])
+                f.table->Hint(AccessPattern::kSequential);
+        }
+
+        // 按从新到旧的顺序合并：第0层文件互相重叠，每个文件一个迭代器，
+        // 其余各层内文件不重叠，每层一个迭代器
+        std::vector<Iterator<K, V> *> children;
+        for (int which = 0; which < 2; which++)
+        {
+            if (c->level() + which == 0)
             {
-                return nullptr;
-                // 在磁盘内查找
+                for (const FileMetaData &f : c->inputs[which])
+                    children.push_back(new TableFileIterator<K, V>(f.table->NewIterator()));
+            }
+            else if (!c->inputs[which].empty())
+            {
+                children.push_back(new LevelIterator<K, V>(&c->inputs[which]));
             }
         }
-        throw std::runtime_error("Key not found");
+        std::unique_ptr<Iterator<K, V>> input(new MergingIterator<K, V>(children));
+
+        Status s;
+        std::unique_ptr<SSTableBuilder> builder;
+        WritableFile *file = nullptr;
+        FileMetaData meta;
+        std::string key, last_key, value;
+        bool has_last_key = false;
+        SequenceNumber last_sequence_for_key = 0;
+        for (input->SeekToFirst(); input->Valid(); input->Next())
+        {
+            if (shutting_down_.load(std::memory_order_acquire))
+            {
+                s = Status::IOError("table is shutting down during compaction");
+                break;
+            }
+            if (has_imm_.load(std::memory_order_acquire))
+            {
+                // 合并可能持续很久，不能让写线程一直等待imm_
+                lock.lock();
+                if (imm_ != nullptr)
+                {
+                    CompactMemTable(lock);
+                    bg_cv_.notify_all();
+                }
+                lock.unlock();
+            }
+
+            key.clear();
+            Codec<K>::Encode(&key, input->key());
+            const bool new_key = !has_last_key || key != last_key;
+            if (new_key)
+            {
+                last_key = key;
+                has_last_key = true;
+            }
+            // 同一个key较新的版本排在前面。更新的版本已经对所有快照可见时这个版本不会再被读到；
+            // 删除标记或过期的value对所有快照可见、且更下面的层都不包含这个key时，已经没有需要遮住的旧值
+            bool drop = !new_key && last_sequence_for_key <= smallest_snapshot;
+            const bool expired_value = input->type() == KType::kTypeValue && IsExpired(input->expire_at(), now);
+            if (!drop && (input->type() == KType::kTypeDelete || expired_value) &&
+                input->sequence() <= smallest_snapshot && c->IsBaseLevelForKey(key))
+            {
+                drop = true;
+                expired += expired_value;
+            }
+            last_sequence_for_key = input->sequence();
+            if (drop)
+                continue;
+
+            // 同一个key的所有版本写入同一个文件，各层内文件的key范围仍然不重叠
+            if (builder != nullptr && new_key && builder->FileSize() >= c->MaxOutputFileSize())
+            {
+                s = FinishTableOutput(builder.get(), file, &meta);
+                builder.reset();
+                if (!s.ok())
+                    break;
+                outputs.push_back(meta);
+            }
+
+            if (builder == nullptr)
+            {
+                meta = FileMetaData();
+                lock.lock();
+                meta.number = versions_.NewFileNumber();
+                pending_outputs_.insert(meta.number);
+                lock.unlock();
+                output_numbers.push_back(meta.number);
+                s = OpenTableOutput(meta.number, &file);
+                if (!s.ok())
+                    break;
+                builder.reset(new SSTableBuilder(options_, file, c->level() + 1));
+                meta.smallest = key;
+            }
+            value.clear();
+            EncodeTableValue(&value, input->type(), input->sequence(), &input->value(), input->expire_at());
+            builder->Add(key, value);
+            meta.largest = key;
+        }
+        RecordTick(options_.statistics.get(), kExpiredKeysDropped, expired);
+        if (s.ok())
+            s = input->status();
+        if (s.ok() && builder != nullptr)
+        {
+            s = FinishTableOutput(builder.get(), file, &meta);
+            builder.reset();
+            if (s.ok())
+                outputs.push_back(meta);
+        }
+        if (builder != nullptr)
+        {
+            builder->Abandon();
+            builder.reset();
+            file->Close();
+            delete file;
+        }
+        input.reset();
+
+        lock.lock();
+        if (s.ok())
+        {
+            c->AddInputDeletions(c->edit());
+            for (const FileMetaData &f : outputs)
+                c->edit()->AddFile(c->level() + 1, f);
+            s = versions_.LogAndApply(c->edit(), &lock);
+        }
+        for (uint64_t number : output_numbers)
+            pending_outputs_.erase(number);
+        if (!s.ok())
+        {
+            // 输入文件还留在版本中，恢复点查的提示
+            for (int which = 0; which < 2; which++)
+            {
+                for (const FileMetaData &f : c->inputs[which])
+                    f.table->Hint(AccessPattern::kRandom);
+            }
+        }
+        return s;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::MemTableInsert(const K &key, const V &value, KType type, uint64_t expire_at,
+                                                  SequenceNumber seq, bool inplace)
+    {
+        // mem_只由leader在组与组之间替换，插入期间不会改变
+        if (inplace && type == KType::kTypeValue && expire_at == 0 && mem_->Update(key, value, seq))
+            return;
+        if (options_.allow_concurrent_memtable_write)
+            mem_->InsertConcurrently(key, value, type, seq, expire_at);
+        else
+            mem_->Insert(key, value, type, seq, expire_at);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::PublishSequence(SequenceNumber first, SequenceNumber last)
+    {
+        // 并发写入时序列号更小的修改可能还没有插入完，先等它发布
+        while (last_sequence_.load(std::memory_order_acquire) != first - 1)
+            std::this_thread::yield();
+        last_sequence_.store(last, std::memory_order_release);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Apply(const Writer *w, bool inplace)
+    {
+        if (w->batch != nullptr)
+            ApplyBatch(*w->batch, w->sequence, inplace);
+        else
+            Apply(*w->key, *w->value, w->type, w->expire_at, w->sequence, inplace);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Apply(const K &key, const V &value, KType type, uint64_t expire_at,
+                                         SequenceNumber seq, bool inplace)
+    {
+        {
+            PerfTimer timer(&PerfContext::write_memtable_nanos);
+            MemTableInsert(key, value, type, expire_at, seq, inplace);
+        }
+        // 修改缓存必须在写入memtable之后，否则并发的Get可能回填旧值
+        UpdateCache(key, value, type, expire_at);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::ApplyBatch(const WriteBatch<K, V> &batch, SequenceNumber seq, bool inplace)
+    {
+        struct Entry
+        {
+            K key;
+            V value;
+            KType type;
+            uint64_t expire_at;
+            SequenceNumber seq;
+        };
+        std::vector<Entry> entries;
+        entries.reserve(batch.Count());
+        Status s = batch.Iterate([&entries, &seq](const K &key, const V &value, KType type, uint64_t expire_at)
+                                 { entries.push_back(Entry{key, value, type, expire_at, seq++}); });
+        assert(s.ok());
+        (void)s;
+
+        // 跳表按序列号排列同一个key的版本；稳定排序保持同一个key的先后顺序，缓存最后更新为最新的值
+        auto less = [](const Entry &a, const Entry &b)
+        { return a.key < b.key; };
+        if (!std::is_sorted(entries.begin(), entries.end(), less))
+            std::stable_sort(entries.begin(), entries.end(), less);
+
+        PerfTimer timer(&PerfContext::write_memtable_nanos);
+        if (options_.allow_concurrent_memtable_write)
+        {
+            for (const Entry &e : entries)
+                mem_->InsertConcurrently(e.key, e.value, e.type, e.seq, e.expire_at);
+        }
+        else
+        {
+            typename MemTable<K, V>::Splice splice;
+            for (const Entry &e : entries)
+            {
+                if (inplace && e.type == KType::kTypeValue && e.expire_at == 0 && mem_->Update(e.key, e.value, e.seq))
+                    continue;
+                mem_->Insert(e.key, e.value, e.type, e.seq, &splice, e.expire_at);
+            }
+        }
+        timer.Stop();
+        for (const Entry &e : entries)
+            UpdateCache(e.key, e.value, e.type, e.expire_at);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::UpdateCache(const K &key, const V &value, KType type, uint64_t expire_at)
+    {
+        if (type == KType::kTypeDelete || options_.allow_concurrent_memtable_write)
+        {
+            // 多个写线程写入同一个key时无法确定谁的值最新，直接让缓存失效，
+            // 下次Get从memtable读取
+            cache_.Remove(key);
+        }
+        else
+        {
+            // 缓存中持有的是memtable节点的拷贝，存在时同步修改
+            cache_.Insert(key, value, DefaultCharge<K, V>()(key, value), expire_at);
+        }
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Write(const K &key, const V &value, KType type, uint64_t expire_at)
+    {
+        StatsTimer timer(options_.statistics.get(), type == KType::kTypeDelete ? kDeleteLatency : kPutLatency);
+        RecordTick(options_.statistics.get(), kKeysWritten);
+        if (dbname_.empty())
+        {
+            const bool inplace = BeginInMemoryWrite();
+            const SequenceNumber seq = AllocateSequence(1);
+            Apply(key, value, type, expire_at, seq, inplace);
+            PublishSequence(seq, seq);
+            EndInMemoryWrite(inplace);
+            return;
+        }
+
+        Writer w(&key, &value, type, expire_at);
+        JoinWriteGroup(&w);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Write(const WriteBatch<K, V> &batch)
+    {
+        if (batch.Count() == 0)
+            return;
+        StatsTimer timer(options_.statistics.get(), kWriteBatchLatency);
+        RecordTick(options_.statistics.get(), kKeysWritten, batch.Count());
+        if (dbname_.empty())
+        {
+            const bool inplace = BeginInMemoryWrite();
+            const SequenceNumber seq = AllocateSequence(batch.Count());
+            ApplyBatch(batch, seq, inplace);
+            PublishSequence(seq, seq + batch.Count() - 1);
+            EndInMemoryWrite(inplace);
+            return;
+        }
+
+        Writer w(&batch);
+        JoinWriteGroup(&w);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::JoinWriteGroup(Writer *w)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        writers_.push_back(w);
+        {
+            PerfTimer timer(&PerfContext::write_wait_nanos);
+            while (!w->done && !w->apply && w != writers_.front())
+                w->cv.wait(lock);
+        }
+
+        if (w->apply)
+        {
+            // leader已经把本组写入日志，各自并发插入memtable
+            lock.unlock();
+            Apply(w, false);
+            lock.lock();
+            if (--pending_apply_ == 0)
+                writers_.front()->cv.notify_one();
+            PerfTimer timer(&PerfContext::write_wait_nanos);
+            while (!w->done)
+                w->cv.wait(lock);
+        }
+        else if (!w->done)
+        {
+            // 成为leader，负责把排在后面的写线程一起写入日志
+            WriteToLog(w, lock);
+        }
+
+        if (!w->status.ok())
+            throw std::runtime_error(w->status.ToString());
+    }
+
+    // REQUIRES: 持有mutex_，w位于writers_队首
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::WriteToLog(Writer *w, std::unique_lock<std::mutex> &lock)
+    {
+        std::vector<Writer *> group;
+        std::string record;
+        SequenceNumber last_sequence = 0;
+        bool inplace = false;
+        Status s = MakeRoomForWrite(lock);
+        if (s.ok())
+        {
+            BuildBatchGroup(&group, &record, &last_sequence);
+            inplace = BeginInPlaceWrite();
+        }
+        else
+            group.push_back(w);
+
+        if (s.ok())
+        {
+            // 写日志期间释放锁，后来的写线程可以继续排队，组成下一组
+            lock.unlock();
+            Statistics *stats = options_.statistics.get();
+            RecordTick(stats, kWriteGroups);
+            {
+                PerfTimer timer(&PerfContext::write_wal_nanos);
+                s = log_->AddRecord(record);
+                if (s.ok() && options_.sync)
+                {
+                    StatsTimer sync_timer(stats, kWalSyncLatency);
+                    s = logfile_->Sync();
+                    RecordTick(stats, kWalSyncs);
+                }
+            }
+
+            if (s.ok())
+            {
+                if (options_.allow_concurrent_memtable_write && group.size() > 1)
+                {
+                    lock.lock();
+                    pending_apply_ = static_cast<int>(group.size()) - 1;
+                    for (Writer *follower : group)
+                    {
+                        if (follower != w)
+                        {
+                            follower->apply = true;
+                            follower->cv.notify_one();
+                        }
+                    }
+                    lock.unlock();
+                    Apply(w, false);
+                    lock.lock();
+                    // 本组全部插入memtable之后下一组才能开始，保证同一个key的写入顺序与日志一致
+                    while (pending_apply_ > 0)
+                        w->cv.wait(lock);
+                }
+                else
+                {
+                    for (Writer *writer : group)
+                        Apply(writer, inplace);
+                    lock.lock();
+                }
+                // 整组插入完成后才对快照可见
+                PublishSequence(w->sequence, last_sequence);
+                versions_.SetLastSequence(last_sequence);
+            }
+            else
+            {
+                lock.lock();
+                bg_error_ = s;
+            }
+        }
+        if (inplace)
+            EndInPlaceWrite();
+
+        for (Writer *writer : group)
+        {
+            assert(writers_.front() == writer);
+            writers_.pop_front();
+            writer->status = s;
+            writer->done = true;
+            if (writer != w)
+                writer->cv.notify_one();
+        }
+
+        if (!writers_.empty())
+            writers_.front()->cv.notify_one();
+    }
+
+    // memtable已满时换成新的memtable和日志，旧的交给后台线程写入文件。
+    // REQUIRES: 持有mutex_，调用方位于writers_队首
+    template <typename K, typename V, typename CachePolicy>
+    Status Table<K, V, CachePolicy>::MakeRoomForWrite(std::unique_lock<std::mutex> &lock)
+    {
+        bool allow_delay = true;
+        while (true)
+        {
+            if (!bg_error_.ok())
+                return bg_error_;
+            if (allow_delay && versions_.NumLevelFiles(0) >= options_.level0_slowdown_writes_trigger)
+            {
+                // 第0层文件接近上限时每组写入延迟1ms，把等待分摊到很多次写入上，
+                // 而不是到达上限之后让一次写入等待整个合并
+                const uint64_t start = perf::NowNanos();
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                allow_delay = false;
+                lock.lock();
+                RecordWriteStall(start);
+                continue;
+            }
+            if (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)
+                return Status::OK();
+            if (imm_ != nullptr)
+            {
+                // 上一个memtable还没写完，等待后台线程
+                const uint64_t start = perf::NowNanos();
+                bg_cv_.wait(lock);
+                RecordWriteStall(start);
+                continue;
+            }
+            if (versions_.NumLevelFiles(0) >= options_.level0_stop_writes_trigger)
+            {
+                // 第0层文件太多，每次查找都要检查它们，等待合并
+                const uint64_t start = perf::NowNanos();
+                bg_cv_.wait(lock);
+                RecordWriteStall(start);
+                continue;
+            }
+
+            // 旧日志在imm_写入文件、MANIFEST记录新的日志编号之后删除
+            Status s = NewLogFile(versions_.NewFileNumber());
+            if (!s.ok())
+            {
+                bg_error_ = s;
+                return s;
+            }
+            imm_ = std::move(mem_);
+            has_imm_.store(true, std::memory_order_release);
+            mem_ = NewMemTable();
+            bg_cv_.notify_all();
+        }
+    }
+
+    // REQUIRES: 持有mutex_，writers_非空
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::BuildBatchGroup(std::vector<Writer *> *group, std::string *record,
+                                                   SequenceNumber *last_sequence)
+    {
+        std::string entries;
+        uint32_t count = 0;
+        for (Writer *writer : writers_)
+        {
+            if (!group->empty() && entries.size() >= options_.max_write_batch_group_size)
+                break;
+            if (writer->batch != nullptr)
+            {
+                entries.append(writer->batch->Contents());
+                count += writer->batch->Count();
+            }
+            else
+            {
+                WriteBatch<K, V>::EncodeEntry(&entries, writer->type, *writer->key, writer->value,
+                                              writer->expire_at);
+                ++count;
+            }
+            group->push_back(writer);
+        }
+
+        // 组内的修改按日志中的顺序使用连续的序列号
+        SequenceNumber seq = AllocateSequence(count);
+        PutFixed64(record, seq);
+        PutVarint32(record, count);
+        record->append(entries);
+        for (Writer *writer : *group)
+        {
+            writer->sequence = seq;
+            seq += writer->batch != nullptr ? writer->batch->Count() : 1;
+        }
+        *last_sequence = seq - 1;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Insert(const K &key, const V &value)
+    {
+        Write(key, value, KType::kTypeValue);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Insert(const K &key, const V &value, std::chrono::microseconds ttl)
+    {
+        // 过期时间不能为0，0表示永不过期
+        const uint64_t now = std::max<uint64_t>(options_.env->NowMicros(), 1);
+        Write(key, value, KType::kTypeValue, ttl.count() > 0 ? now + static_cast<uint64_t>(ttl.count()) : now);
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    template <typename Q>
+    typename Table<K, V, CachePolicy>::Handle *Table<K, V, CachePolicy>::LoadNode(const Q &key,
+                                                                                   SequenceNumber snapshot) const
+    {
+        std::shared_ptr<MemTable<K, V>> mem, imm;
+        std::shared_ptr<const Version> current;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            mem = mem_;
+            imm = imm_;
+            current = versions_.current();
+        }
+
+        Statistics *stats = options_.statistics.get();
+        const MemTable<K, V> *source = mem.get();
+        const KVnode<K, V> *node;
+        {
+            PerfTimer timer(&PerfContext::get_from_memtable_nanos);
+            node = mem->Get(key, snapshot);
+            if (node == nullptr && imm != nullptr)
+            {
+                source = imm.get();
+                node = imm->Get(key, snapshot);
+            }
+        }
+        if (node != nullptr)
+        {
+            PerfCount(&PerfContext::memtable_hit_count);
+            RecordTick(stats, kMemTableHit);
+            // 拷贝一份插入到cache内，memtable节点的内存属于arena
+            return CopyMemTableNode(*source, node);
+        }
+        RecordTick(stats, kMemTableMiss);
+
+        // 在磁盘内查找，先第0层从新到旧，再逐层向下
+        PerfTimer timer(&PerfContext::get_from_table_files_nanos);
+        std::string encoded;
+        Codec<K>::Encode(&encoded, key);
+        Handle *result = nullptr;
+        bool found = false;
+        bool corrupted = false;
+        Status s = current->Get(encoded, [&](const Slice &input)
+                                {
+                                    KType type;
+                                    SequenceNumber seq;
+                                    V value;
+                                    uint64_t expire_at;
+                                    if (!DecodeTableValue(input, &type, &seq, &value, &expire_at))
+                                        corrupted = true;
+                                    else if (seq > snapshot)
+                                        return false;
+                                    else
+                                        result = NewNode(ToKey(key), value, type, expire_at);
+                                    return true; }, &found);
+        if (s.ok() && corrupted)
+            s = Status::Corruption(dbname_, "bad table entry");
+        if (!s.ok())
+        {
+            if (result != nullptr)
+                result->Unref();
+            throw std::runtime_error(s.ToString());
+        }
+        return result;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    template <typename Q>
+    PinnedHandle<K, V> Table<K, V, CachePolicy>::GetImpl(const ReadOptions &options, const Q &key)
+    {
+        Statistics *stats = options_.statistics.get();
+        StatsTimer timer(stats, kGetLatency);
+        PinnedHandle<K, V> x;
+        if (options.snapshot != nullptr)
+        {
+            x = PinnedHandle<K, V>(LoadNode(key, options.snapshot->sequence()));
+        }
+        else
+        {
+            // 未命中时在分片锁外加载，加载期间写入方修改过同一分片时不回填，
+            // 保证不会把写线程已经失效的旧值放入缓存
+            bool miss = false;
+            x = cache_.GetOrLoad(key, [&]()
+                                 {
+                                     miss = true;
+                                     return LoadNode(key, kMaxSequenceNumber); });
+            PerfCount(miss ? &PerfContext::row_cache_miss_count : &PerfContext::row_cache_hit_count);
+            RecordTick(stats, miss ? kRowCacheMiss : kRowCacheHit);
+        }
+        // 缓存中的删除标记对调用方表现为不存在，过期的value在缓存中查找不到，加载时换成删除标记
+        if (x != nullptr && x.type() != KType::kTypeValue)
+            x.Release();
+        RecordTick(stats, kKeysRead);
+        if (x != nullptr)
+            RecordTick(stats, kKeysFound);
+        return x;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::LoadNodes(const K *const *unsorted, size_t n, Handle **result,
+                                             SequenceNumber snapshot) const
+    {
+        // 排序后依次查找，nodes[i]对应keys[i]，最后按原来的顺序写回result
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [unsorted](size_t a, size_t b)
+                  { return *unsorted[a] < *unsorted[b]; });
+        std::vector<const K *> sorted_keys(n);
+        for (size_t i = 0; i < n; ++i)
+            sorted_keys[i] = unsorted[order[i]];
+        const K *const *keys = sorted_keys.data();
+        std::vector<Handle *> nodes(n, nullptr);
+
+        std::shared_ptr<MemTable<K, V>> mem, imm;
+        std::shared_ptr<const Version> current;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            mem = mem_;
+            imm = imm_;
+            current = versions_.current();
+        }
+
+        // 按升序在memtable中查找，每个key从上一个key的位置继续
+        typename MemTable<K, V>::Splice mem_splice, imm_splice;
+        std::vector<size_t> disk;
+        PerfTimer mem_timer(&PerfContext::get_from_memtable_nanos);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const MemTable<K, V> *source = mem.get();
+            const KVnode<K, V> *node = mem->Get(*keys[i], snapshot, &mem_splice);
+            if (node == nullptr && imm != nullptr)
+            {
+                source = imm.get();
+                node = imm->Get(*keys[i], snapshot, &imm_splice);
+            }
+            if (node != nullptr)
+                nodes[i] = CopyMemTableNode(*source, node);
+            else
+                disk.push_back(i);
+        }
+        mem_timer.Stop();
+        PerfCount(&PerfContext::memtable_hit_count, n - disk.size());
+        RecordTick(options_.statistics.get(), kMemTableHit, n - disk.size());
+        RecordTick(options_.statistics.get(), kMemTableMiss, disk.size());
+
+        Status s;
+        bool corrupted = false;
+        if (!disk.empty())
+        {
+            PerfTimer timer(&PerfContext::get_from_table_files_nanos);
+            // 编码保持顺序，编码后的key仍然是升序的
+            std::vector<std::string> encoded(disk.size());
+            std::vector<Slice> slices(disk.size());
+            for (size_t j = 0; j < disk.size(); ++j)
+            {
+                Codec<K>::Encode(&encoded[j], *keys[disk[j]]);
+                slices[j] = encoded[j];
+            }
+            s = current->MultiGet(slices, [&](size_t j, const Slice &input)
+                                  {
+                                      KType type;
+                                      SequenceNumber seq;
+                                      V value;
+                                      uint64_t expire_at;
+                                      if (!DecodeTableValue(input, &type, &seq, &value, &expire_at))
+                                          corrupted = true;
+                                      else if (seq > snapshot)
+                                          return false;
+                                      else
+                                          nodes[disk[j]] = NewNode(*keys[disk[j]], value, type, expire_at);
+                                      return true; });
+        }
+        if (s.ok() && corrupted)
+            s = Status::Corruption(dbname_, "bad table entry");
+        if (!s.ok())
+        {
+            for (Handle *x : nodes)
+            {
+                if (x != nullptr)
+                    x->Unref();
+            }
+            throw std::runtime_error(s.ToString());
+        }
+        for (size_t i = 0; i < n; ++i)
+            result[order[i]] = nodes[i];
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    std::vector<PinnedHandle<K, V>> Table<K, V, CachePolicy>::MultiGet(const ReadOptions &options,
+                                                                       const std::vector<K> &keys)
+    {
+        Statistics *stats = options_.statistics.get();
+        StatsTimer timer(stats, kMultiGetLatency);
+        std::vector<const K *> ptrs(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+            ptrs[i] = &keys[i];
+        std::vector<PinnedHandle<K, V>> handles(keys.size());
+        if (options.snapshot != nullptr)
+        {
+            std::vector<Handle *> nodes(keys.size(), nullptr);
+            LoadNodes(ptrs.data(), ptrs.size(), nodes.data(), options.snapshot->sequence());
+            for (size_t i = 0; i < keys.size(); ++i)
+                handles[i] = PinnedHandle<K, V>(nodes[i]);
+        }
+        else
+        {
+            size_t misses = 0;
+            cache_.MultiGetOrLoad(ptrs.data(), ptrs.size(), handles.data(),
+                                  [this, &misses](const K *const *miss_keys, size_t n, Handle **nodes)
+                                  {
+                                      misses = n;
+                                      LoadNodes(miss_keys, n, nodes, kMaxSequenceNumber); });
+            PerfCount(&PerfContext::row_cache_hit_count, keys.size() - misses);
+            PerfCount(&PerfContext::row_cache_miss_count, misses);
+            RecordTick(stats, kRowCacheHit, keys.size() - misses);
+            RecordTick(stats, kRowCacheMiss, misses);
+        }
+
+        // 缓存中的删除标记对调用方表现为不存在
+        size_t found = 0;
+        for (PinnedHandle<K, V> &x : handles)
+        {
+            if (x != nullptr && x.type() != KType::kTypeValue)
+                x.Release();
+            found += x != nullptr;
+        }
+        RecordTick(stats, kKeysRead, keys.size());
+        RecordTick(stats, kKeysFound, found);
+        return handles;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    Iterator<K, V> *Table<K, V, CachePolicy>::NewIterator(const ReadOptions &options, const std::string *prefix) const
+    {
+        std::shared_ptr<MemTable<K, V>> mem, imm;
+        std::shared_ptr<const Version> current;
+        SequenceNumber snapshot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // 迭代器不加锁读取memtable中的value，存在期间不原地修改
+            BlockInPlaceWrites(lock);
+            mem = mem_;
+            imm = imm_;
+            current = versions_.current();
+            // 没有指定快照时以当前最后一个写入的序列号为快照，之后插入memtable的修改不可见
+            snapshot = options.snapshot != nullptr ? options.snapshot->sequence()
+                                                   : last_sequence_.load(std::memory_order_acquire);
+        }
+
+        // 缓存中只是部分数据的拷贝，遍历只需要看memtable和文件。
+        // 按从新到旧的顺序合并，同一个key的新版本排在前面
+        std::vector<Iterator<K, V> *> children;
+        if (prefix == nullptr)
+        {
+            children.push_back(mem->NewIterator());
+            if (imm != nullptr)
+                children.push_back(imm->NewIterator());
+            for (const FileMetaData &f : current->files(0))
+                children.push_back(new TableFileIterator<K, V>(f.table->NewIterator()));
+            for (int level = 1; level < kNumLevels; level++)
+            {
+                if (!current->files(level).empty())
+                    children.push_back(new LevelIterator<K, V>(&current->files(level)));
+            }
+        }
+        else
+        {
+            // 以prefix开头的key在[prefix, prefix之后第一个不以它开头的key)之间，
+            // 每层只有少数文件与这个范围相交，逐个检查前缀过滤器
+            auto may_contain = [prefix](const FileMetaData &f)
+            {
+                if (Slice(f.largest).compare(*prefix) < 0)
+                    return false;
+                if (Slice(f.smallest).compare(*prefix) > 0 && !Slice(f.smallest).starts_with(*prefix))
+                    return false;
+                return f.table->PrefixMayMatch(*prefix);
+            };
+            if (mem->PrefixMayMatch(*prefix))
+                children.push_back(mem->NewIterator());
+            if (imm != nullptr && imm->PrefixMayMatch(*prefix))
+                children.push_back(imm->NewIterator());
+            for (int level = 0; level < kNumLevels; level++)
+            {
+                for (const FileMetaData &f : current->files(level))
+                {
+                    if (may_contain(f))
+                        children.push_back(new TableFileIterator<K, V>(f.table->NewIterator()));
+                }
+            }
+        }
+
+        // 前缀扫描可能一个child都没有，这时合并迭代器一直无效
+        Iterator<K, V> *internal = children.size() == 1 ? children[0] : new MergingIterator<K, V>(children);
+        // 创建时已经过期的value在迭代器中不可见
+        Iterator<K, V> *iter = new DBIter<K, V>(internal, snapshot, options_.env->NowMicros());
+        // 迭代器存在期间持有memtable和版本的引用，版本中的文件不会被关闭
+        iter->RegisterCleanup([this, mem, imm, current]()
+                              {
+                                  std::lock_guard<std::mutex> lock(mutex_);
+                                  --inplace_blockers_; });
+        return iter;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::WaitForCompaction()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (bg_thread_.joinable() && bg_error_.ok() && (imm_ != nullptr || versions_.NeedsCompaction()))
+            bg_cv_.wait(lock);
+        if (!bg_error_.ok())
+            throw std::runtime_error(bg_error_.ToString());
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    ScanIterator<K, V> Table<K, V, CachePolicy>::Scan(const ReadOptions &options, const K &begin, const K &end,
+                                                      size_t limit) const
+    {
+        StatsTimer timer(options_.statistics.get(), kScanLatency);
+        PerfTimer perf_timer(&PerfContext::seek_nanos);
+        // 前缀扫描只合并可能含有begin的前缀的memtable和文件
+        std::string prefix;
+        const PrefixExtractor *extractor = options_.prefix_extractor.get();
+        if (options.prefix_same_as_start && extractor != nullptr)
+        {
+            std::string encoded;
+            Codec<K>::Encode(&encoded, begin);
+            if (extractor->InDomain(encoded))
+                prefix = extractor->Transform(encoded).ToString();
+        }
+        Iterator<K, V> *iter = NewIterator(options, prefix.empty() ? nullptr : &prefix);
+        iter->Seek(begin);
+        return ScanIterator<K, V>(iter, end, limit, std::move(prefix));
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::DumpStatistics(const std::string &fname, Statistics::Format format)
+    {
+        Statistics *stats = options_.statistics.get();
+        if (stats == nullptr)
+            throw std::runtime_error("DumpStatistics: options.statistics is not set");
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats->SetGauge(kMemTableBytes, static_cast<int64_t>(mem_->ApproximateMemoryUsage()));
+            stats->SetGauge(kImmMemTableBytes,
+                            imm_ != nullptr ? static_cast<int64_t>(imm_->ApproximateMemoryUsage()) : 0);
+            int64_t files = 0;
+            for (int level = 0; level < kNumLevels; level++)
+                files += versions_.NumLevelFiles(level);
+            stats->SetGauge(kNumTableFiles, files);
+            stats->SetGauge(kNumLevel0Files, versions_.NumLevelFiles(0));
+        }
+        stats->SetGauge(kRowCacheUsage, static_cast<int64_t>(cache_.GetUsage()));
+        const std::shared_ptr<BlockCache> block_cache = VersionSet::SanitizeOptions(options_).block_cache;
+        stats->SetGauge(kBlockCacheUsage, block_cache != nullptr ? static_cast<int64_t>(block_cache->GetUsage()) : 0);
+
+        Status s = stats->DumpTo(options_.env, fname, format);
+        if (!s.ok())
+            throw std::runtime_error(s.ToString());
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    const Snapshot *Table<K, V, CachePolicy>::GetSnapshot()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // 正在原地修改的写入会覆盖快照能看到的旧版本，等它们发布之后再取序列号
+        BlockInPlaceWrites(lock);
+        const Snapshot *snapshot = snapshots_.New(last_sequence_.load(std::memory_order_acquire));
+        --inplace_blockers_;
+        return snapshot;
+    }
+
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::ReleaseSnapshot(const Snapshot *snapshot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshots_.Delete(snapshot);
     }
 
-    template <typename K, typename V>
-    void Table<K, V>::Remove(const K &key)
+    template <typename K, typename V, typename CachePolicy>
+    void Table<K, V, CachePolicy>::Remove(const K &key)
     {
-        // 删除缓存中的key
-        cache_.Remove(key);
         // Insert一个delete类型的节点进入memtable
-        memtable_.Insert(NewNode(key, V(), KType::kTypeDelete));
+        Write(key, V(), KType::kTypeDelete);
     }
 }
 
-#endif
\ No newline at end of file
+#endif
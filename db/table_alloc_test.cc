@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "db/table.h"
+#include "util/env.h"
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 替换全局的operator new会影响整个测试程序，所以单独编译成一个测试，不和table_test放在一起
+
+// 统计当前线程在count_allocations为true期间调用operator new的次数
+static thread_local bool count_allocations = false;
+static thread_local size_t num_allocations = 0;
+
+void *operator new(size_t size)
+{
+    if (count_allocations)
+        ++num_allocations;
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+// 不内联，避免编译器在调用处把operator new和free配对后给出-Wmismatched-new-delete
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+static std::string NewTestDir(const std::string &name)
+{
+    std::string dir = testing::TempDir() + "kvdb_" + name;
+    kvdb::Env *env = kvdb::Env::Default();
+    std::vector<std::string> children;
+    if (env->GetChildren(dir, &children).ok())
+    {
+        for (const std::string &child : children)
+            env->RemoveFile(dir + "/" + child);
+    }
+    return dir;
+}
+
+TEST(TableAllocTest, CacheHitDoesNotAllocate)
+{
+    std::string dir = NewTestDir("table_alloc");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.cache_capacity = 1 << 20;
+    // key超过短字符串优化的长度，构造std::string一定会分配内存
+    auto key = [](int i)
+    { return "transparent-key-" + std::to_string(i) + std::string(20, 'k'); };
+    kvdb::Table<std::string, int> table(options, dir);
+    for (int i = 0; i < 3000; ++i)
+        table.Insert(key(i), i);
+    table.WaitForCompaction();
+
+    // 命中缓存时整个查找过程不分配内存
+    const std::string buf = key(5);
+    const std::string_view sv(buf);
+    ASSERT_EQ(*table.Get(sv), 5);
+    count_allocations = true;
+    num_allocations = 0;
+    for (int i = 0; i < 100; ++i)
+        table.Get(sv);
+    count_allocations = false;
+    ASSERT_EQ(num_allocations, 0u);
+    // 用std::string查找，调用方要先构造key
+    count_allocations = true;
+    for (int i = 0; i < 100; ++i)
+        table.Get(key(5));
+    count_allocations = false;
+    ASSERT_GT(num_allocations, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,12 +1,24 @@
 #include <gtest/gtest.h>
 #include "db/table.h"
+#include "util/env.h"
+#include "util/random.h"
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
 using StringTable = kvdb::Table<std::string, int>;
 using IntTable = kvdb::Table<int, std::string>;
 
+// 缓存按字节计算容量。测试中的key和value都是短字符串，每个条目只占用句柄本身的大小
+const size_t kStringEntry = sizeof(kvdb::cache::LRUHandle<std::string, int>);
+const size_t kIntEntry = sizeof(kvdb::cache::LRUHandle<int, std::string>);
+
 TEST(TableTest, EmptyTable)
 {
-    StringTable table(2); // 缓存容量为 2
+    StringTable table(2 * kStringEntry); // 缓存容量为 2
 
     ASSERT_EQ(table.Get("key1"), nullptr);
     ASSERT_EQ(table.Get("key2"), nullptr);
@@ -18,7 +30,7 @@ TEST(TableTest, EmptyTable)
 
 TEST(TableTest, RemoveTable)
 {
-    StringTable table(2); // 缓存容量为 2
+    StringTable table(2 * kStringEntry); // 缓存容量为 2
     table.Insert("key1", 1);
     ASSERT_EQ(*table.Get("key1"), 1);
     table.Remove("key1");
@@ -31,7 +43,7 @@ TEST(TableTest, RemoveTable)
 
 TEST(TableTest, BasicInsertAndGet)
 {
-    StringTable table(2); // 缓存容量为 2
+    StringTable table(2 * kStringEntry); // 缓存容量为 2
 
     // 插入键值对
     table.Insert("key1", 100);
@@ -48,7 +60,7 @@ TEST(TableTest, BasicInsertAndGet)
 
 TEST(TableTest, LRUCacheEviction)
 {
-    StringTable table(2); // 缓存容量 2
+    StringTable table(2 * kStringEntry); // 缓存容量 2
 
     // 插入三个键，触发 LRU 淘汰（最早插入的 "key1" 应被淘汰）
     table.Insert("key1", 100);
@@ -73,7 +85,7 @@ TEST(TableTest, LRUCacheEviction)
 
 TEST(TableTest, RemoveOperation)
 {
-    StringTable table(2);
+    StringTable table(2 * kStringEntry);
 
     table.Insert("key1", 100);
     table.Get("key1");
@@ -89,7 +101,7 @@ TEST(TableTest, RemoveOperation)
 
 TEST(TableTest, CacheAndMemTableIntegration)
 {
-    StringTable table(1); // 缓存容量 1
+    StringTable table(1 * kStringEntry); // 缓存容量 1
 
     // 插入键值对，缓存命中
     table.Insert("key1", 100);
@@ -113,7 +125,7 @@ TEST(TableTest, CacheAndMemTableIntegration)
 TEST(TableTest, StressTestWithLargeData)
 {
     const int capacity = 10000;
-    IntTable table(capacity);
+    IntTable table(capacity * kIntEntry);
 
     // 插入大量数据，测试 LRU 性能和内存释放
     for (int i = 0; i < 2 * capacity; ++i)
@@ -138,7 +150,7 @@ TEST(TableTest, StressTestWithLargeData)
 TEST(TableTest, OverloadData)
 {
     const int capacity = 10000;
-    StringTable table(capacity);
+    StringTable table(capacity * kStringEntry);
 
     // 插入大量数据，测试 LRU 性能和内存释放
     for (int i = 0; i <= 2 * capacity; ++i)
@@ -149,6 +161,1200 @@ TEST(TableTest, OverloadData)
     ASSERT_EQ(*table.Get("a"), 2 * capacity);
 }
 
+TEST(TableTest, ByteChargedCache)
+{
+    // 长value占用堆内存，缓存按字节淘汰
+    const std::string big(1000, 'x');
+    const size_t charge = kvdb::cache::DefaultCharge<int, std::string>()(0, big);
+    ASSERT_GT(charge, kIntEntry + big.size());
+    IntTable table(10 * charge);
+    for (int i = 0; i < 100; ++i)
+    {
+        table.Insert(i, big);
+        table.Get(i);
+    }
+    ASSERT_LE(table.cache_.GetUsage(), 10 * charge);
+    ASSERT_GT(table.cache_.GetUsage(), 8 * charge);
+    ASSERT_TRUE(table.cache_.Contains(99));
+    ASSERT_FALSE(table.cache_.Contains(89));
+
+    // 调用方持有的条目计入pinned用量
+    ASSERT_EQ(table.cache_.GetPinnedUsage(), 0u);
+    auto value = table.Get(99);
+    ASSERT_EQ(table.cache_.GetPinnedUsage(), charge);
+    value.Release();
+    ASSERT_EQ(table.cache_.GetPinnedUsage(), 0u);
+}
+
+TEST(TableTest, SharedCacheBudget)
+{
+    kvdb::Options options;
+    options.cache_budget = std::make_shared<kvdb::cache::CacheBudget>(100 * kIntEntry);
+    {
+        IntTable a(options);
+        StringTable b(options);
+        for (int i = 0; i < 1000; ++i)
+        {
+            a.Insert(i, "v");
+            a.Get(i);
+            b.Insert(std::to_string(i), i);
+            b.Get(std::to_string(i));
+            ASSERT_LE(options.cache_budget->GetUsage(), 100 * kIntEntry + kStringEntry);
+        }
+        ASSERT_EQ(options.cache_budget->GetUsage(), a.cache_.GetUsage() + b.cache_.GetUsage());
+        ASSERT_GT(a.cache_.GetUsage(), 0u);
+        ASSERT_GT(b.cache_.GetUsage(), 0u);
+    }
+    // Table关闭后归还用量
+    ASSERT_EQ(options.cache_budget->GetUsage(), 0u);
+}
+
+TEST(TableTest, ConcurrentInsert)
+{
+    kvdb::Options options;
+    options.cache_capacity = 100 * kIntEntry;
+    options.allow_concurrent_memtable_write = true;
+    IntTable table(options);
+
+    const int numThreads = 4;
+    const int N = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&table, t]()
+                             {
+                                 for (int i = t; i < N; i += numThreads)
+                                 {
+                                     table.Insert(i, std::to_string(i));
+                                     table.Get(i);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int i = 0; i < N; ++i)
+    {
+        auto value = table.Get(i);
+        ASSERT_TRUE(value != nullptr);
+        ASSERT_EQ(*value, std::to_string(i));
+    }
+}
+
+TEST(TableTest, Scan)
+{
+    IntTable table(10 * kIntEntry);
+    for (int i = 0; i < 100; ++i)
+        table.Insert(i, std::to_string(i));
+    // 覆盖写和删除：Scan只返回最新版本，不返回已删除的key
+    table.Insert(20, "new");
+    table.Remove(21);
+    table.Remove(22);
+    table.Insert(22, "back");
+
+    std::vector<int> keys;
+    std::vector<std::string> values;
+    for (auto it = table.Scan(19, 25); it.Valid(); it.Next())
+    {
+        keys.push_back(it.key());
+        values.push_back(it.value());
+    }
+    ASSERT_EQ(keys, std::vector<int>({19, 20, 22, 23, 24}));
+    ASSERT_EQ(values, std::vector<std::string>({"19", "new", "back", "23", "24"}));
+
+    int count = 0;
+    for (auto it = table.Scan(50, 1000, 7); it.Valid(); it.Next())
+        ASSERT_EQ(it.key(), 50 + count++);
+    ASSERT_EQ(count, 7);
+}
+
+TEST(TableTest, IteratorReverse)
+{
+    IntTable table(10 * kIntEntry);
+    for (int i = 0; i < 10; ++i)
+        table.Insert(i, std::to_string(i));
+    table.Remove(9);
+    table.Remove(5);
+    table.Insert(3, "x");
+    table.Remove(0);
+
+    std::unique_ptr<kvdb::Iterator<int, std::string>> iter(table.NewIterator());
+    std::vector<int> keys;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+        keys.push_back(iter->key());
+    ASSERT_EQ(keys, std::vector<int>({8, 7, 6, 4, 3, 2, 1}));
+
+    iter->Seek(3);
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->value(), "x");
+}
+
+// 返回一个空的数据库目录
+static std::string NewTestDir(const std::string &name)
+{
+    std::string dir = testing::TempDir() + "kvdb_" + name;
+    kvdb::Env *env = kvdb::Env::Default();
+    std::vector<std::string> children;
+    if (env->GetChildren(dir, &children).ok())
+    {
+        for (const std::string &child : children)
+            env->RemoveFile(dir + "/" + child);
+    }
+    return dir;
+}
+
+TEST(TableTest, RecoverFromLog)
+{
+    std::string dir = NewTestDir("recover");
+    kvdb::Options options;
+    {
+        IntTable table(options, dir);
+        for (int i = 0; i < 1000; ++i)
+            table.Insert(i, std::to_string(i));
+        table.Insert(7, "seven");
+        table.Remove(8);
+    }
+
+    for (int round = 0; round < 3; ++round)
+    {
+        // 重新打开后数据从日志恢复，再写入的数据在下一次打开时同样可见
+        IntTable table(options, dir);
+        for (int i = 0; i < 1000; ++i)
+        {
+            auto value = table.Get(i);
+            if (i == 8)
+            {
+                ASSERT_EQ(value, nullptr);
+            }
+            else
+            {
+                ASSERT_TRUE(value != nullptr);
+                ASSERT_EQ(*value, i == 7 ? "seven" : std::to_string(i)) << i;
+            }
+        }
+        for (int i = 1000; i < 1000 + round; ++i)
+            ASSERT_EQ(*table.Get(i), std::to_string(i));
+        table.Insert(1000 + round, std::to_string(1000 + round));
+    }
+
+    // 恢复后旧日志被删除，只剩一个日志文件
+    std::vector<std::string> children;
+    ASSERT_TRUE(kvdb::Env::Default()->GetChildren(dir, &children).ok());
+    int logs = 0;
+    for (const std::string &child : children)
+        logs += child.find(".log") != std::string::npos;
+    ASSERT_EQ(logs, 1);
+}
+
+TEST(TableTest, GroupCommit)
+{
+    std::string dir = NewTestDir("group_commit");
+    const int numThreads = 4;
+    const int N = 500;
+    for (bool concurrent : {false, true})
+    {
+        kvdb::Options options;
+        options.allow_concurrent_memtable_write = concurrent;
+        {
+            IntTable table(options, dir);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < numThreads; ++t)
+            {
+                threads.emplace_back([&table, t]()
+                                     {
+                                         for (int i = t; i < N; i += numThreads)
+                                             table.Insert(i, std::to_string(i)); });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            for (int i = 0; i < N; ++i)
+                ASSERT_EQ(*table.Get(i), std::to_string(i));
+        }
+        IntTable table(options, dir);
+        for (int i = 0; i < N; ++i)
+            ASSERT_EQ(*table.Get(i), std::to_string(i));
+    }
+}
+
+TEST(TableTest, WriteBatch)
+{
+    IntTable table(100 * kIntEntry);
+    table.Insert(1, "old");
+    table.Insert(2, "two");
+
+    kvdb::WriteBatch<int, std::string> batch;
+    // 乱序加入，同一个key以最后一次为准
+    batch.Put(5, "five");
+    batch.Put(1, "one");
+    batch.Delete(2);
+    batch.Put(3, "three");
+    batch.Put(5, "FIVE");
+    batch.Delete(3);
+    ASSERT_EQ(batch.Count(), 6u);
+    table.Write(batch);
+
+    ASSERT_EQ(*table.Get(1), "one");
+    ASSERT_EQ(table.Get(2), nullptr);
+    ASSERT_EQ(table.Get(3), nullptr);
+    ASSERT_EQ(*table.Get(5), "FIVE");
+
+    batch.Clear();
+    ASSERT_EQ(batch.Count(), 0u);
+    ASSERT_EQ(batch.ApproximateSize(), 0u);
+    table.Write(batch);
+    ASSERT_EQ(*table.Get(1), "one");
+}
+
+TEST(TableTest, MultiGet)
+{
+    std::string dir = NewTestDir("multi_get");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.cache_capacity = 64 * kIntEntry;
+    const int N = 4000;
+    const std::string pad(50, 'x');
+    IntTable table(options, dir);
+    for (int i = 0; i < N; i += 2)
+        table.Insert(i, std::to_string(i) + pad);
+    table.WaitForCompaction();
+    // 一部分在有序表文件中，一部分在memtable中，其中有删除和覆盖
+    for (int i = 0; i < N; i += 10)
+        table.Remove(i);
+    for (int i = 0; i < N; i += 6)
+        table.Insert(i, "new");
+    ASSERT_GT(table.NumTableFiles(), 0u);
+
+    kvdb::Random rnd(301);
+    for (int round = 0; round < 20; ++round)
+    {
+        // 乱序、有重复、有不存在的key
+        std::vector<int> keys;
+        for (int i = 0; i < 100; ++i)
+            keys.push_back(rnd.Uniform(N + 100));
+        keys.push_back(keys[0]);
+        auto values = table.MultiGet(keys);
+        ASSERT_EQ(values.size(), keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            auto expected = table.Get(keys[i]);
+            if (expected == nullptr)
+                ASSERT_EQ(values[i], nullptr) << keys[i];
+            else
+                ASSERT_EQ(*values[i], *expected) << keys[i];
+        }
+    }
+    ASSERT_TRUE(table.MultiGet(std::vector<int>()).empty());
+}
+
+TEST(TableTest, WriteBatchRecover)
+{
+    std::string dir = NewTestDir("write_batch");
+    const int numThreads = 4;
+    const int kBatches = 50;
+    const int kBatchSize = 20;
+    for (bool concurrent : {false, true})
+    {
+        kvdb::Options options;
+        options.allow_concurrent_memtable_write = concurrent;
+        {
+            // 多个线程同时写batch，与单key写入组成同一组
+            IntTable table(options, dir);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < numThreads; ++t)
+            {
+                threads.emplace_back([&table, t]()
+                                     {
+                                         kvdb::WriteBatch<int, std::string> batch;
+                                         for (int b = 0; b < kBatches; ++b)
+                                         {
+                                             batch.Clear();
+                                             for (int i = 0; i < kBatchSize; ++i)
+                                             {
+                                                 int key = (t * kBatches + b) * kBatchSize + i;
+                                                 batch.Put(key, std::to_string(key));
+                                             }
+                                             table.Write(batch);
+                                             table.Remove((t * kBatches + b) * kBatchSize);
+                                         } });
+            }
+            for (auto &thread : threads)
+                thread.join();
+        }
+        IntTable table(options, dir);
+        for (int key = 0; key < numThreads * kBatches * kBatchSize; ++key)
+        {
+            if (key % kBatchSize == 0)
+                ASSERT_EQ(table.Get(key), nullptr) << key;
+            else
+                ASSERT_EQ(*table.Get(key), std::to_string(key)) << key;
+        }
+    }
+}
+
+TEST(TableTest, FlushToTableFile)
+{
+    std::string dir = NewTestDir("flush");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 64 * 1024;
+    options.cache_capacity = 16 * kIntEntry;
+    const int N = 20000;
+    const std::string pad(100, 'x');
+
+    // 偶数被覆盖写，3的倍数被删除，写入量远大于write_buffer_size
+    auto expected = [&](int i) -> std::string
+    {
+        if (i % 3 == 0)
+            return "";
+        return (i % 2 == 0 ? "new" : "old") + std::to_string(i) + pad;
+    };
+    {
+        IntTable table(options, dir);
+        for (int i = 0; i < N; ++i)
+            table.Insert(i, "old" + std::to_string(i) + pad);
+        for (int i = 0; i < N; i += 2)
+            table.Insert(i, "new" + std::to_string(i) + pad);
+        for (int i = 0; i < N; i += 3)
+            table.Remove(i);
+        ASSERT_GT(table.NumTableFiles(), 0u);
+
+        for (int i = 0; i < N; ++i)
+        {
+            auto value = table.Get(i);
+            if (expected(i).empty())
+                ASSERT_EQ(value, nullptr) << i;
+            else
+                ASSERT_EQ(*value, expected(i)) << i;
+        }
+    }
+
+    for (int round = 0; round < 2; ++round)
+    {
+        // 重新打开后，日志中的数据写入新文件，旧文件中的数据仍然可见
+        IntTable table(options, dir);
+        ASSERT_GT(table.NumTableFiles(), 0u);
+        for (int i = 0; i < N; ++i)
+        {
+            auto value = table.Get(i);
+            if (expected(i).empty())
+                ASSERT_EQ(value, nullptr) << i;
+            else
+                ASSERT_EQ(*value, expected(i)) << i;
+        }
+    }
+}
+
+TEST(TableTest, FlushCountsValueBytes)
+{
+    // 大value的内容不在arena中，也要计入memtable的大小，写入量约为write_buffer_size的16倍
+    auto stats = std::make_shared<kvdb::Statistics>();
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 64 * 1024;
+    options.cache_capacity = 16 * kIntEntry;
+    options.statistics = stats;
+    IntTable table(options, NewTestDir("flush_value_bytes"));
+    const std::string value(4096, 'v');
+    for (int i = 0; i < 256; ++i)
+        table.Insert(i, value);
+    table.WaitForCompaction();
+    ASSERT_GE(stats->GetTickerCount(kvdb::kMemTableFlushes), 12u);
+    for (int i = 0; i < 256; ++i)
+        ASSERT_EQ(*table.Get(i), value) << i;
+}
+
+TEST(TableTest, ScanMergesTableFiles)
+{
+    std::string dir = NewTestDir("scan_files");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    const int N = 5000;
+    IntTable table(options, dir);
+    for (int i = 0; i < N; ++i)
+        table.Insert(i, std::to_string(i));
+    for (int i = 0; i < N; i += 2)
+        table.Remove(i);
+    for (int i = 0; i < N; i += 4)
+        table.Insert(i, "again" + std::to_string(i));
+    ASSERT_GT(table.NumTableFiles(), 1u);
+
+    // 合并memtable和多个文件，同一个key只看最新版本
+    std::vector<int> keys;
+    for (int i = 0; i < N; ++i)
+    {
+        if (i % 2 != 0 || i % 4 == 0)
+            keys.push_back(i);
+    }
+    auto value_of = [](int i)
+    { return i % 4 == 0 ? "again" + std::to_string(i) : std::to_string(i); };
+
+    size_t n = 0;
+    for (auto it = table.Scan(0, N); it.Valid(); it.Next(), ++n)
+    {
+        ASSERT_EQ(it.key(), keys[n]);
+        ASSERT_EQ(it.value(), value_of(keys[n]));
+    }
+    ASSERT_EQ(n, keys.size());
+
+    std::unique_ptr<kvdb::Iterator<int, std::string>> iter(table.NewIterator());
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+    {
+        ASSERT_EQ(iter->key(), keys[--n]);
+        ASSERT_EQ(iter->value(), value_of(keys[n]));
+    }
+    ASSERT_EQ(n, 0u);
+
+    // 中途改变方向
+    iter->Seek(101);
+    ASSERT_EQ(iter->key(), 101);
+    iter->Prev();
+    ASSERT_EQ(iter->key(), 100);
+    iter->Prev();
+    ASSERT_EQ(iter->key(), 99);
+    iter->Next();
+    ASSERT_EQ(iter->key(), 100);
+    iter->Next();
+    ASSERT_EQ(iter->key(), 101);
+    ASSERT_TRUE(iter->status().ok());
+}
+
+// 目录中有序表文件的总大小
+static uint64_t TableFileBytes(const std::string &dir)
+{
+    kvdb::Env *env = kvdb::Env::Default();
+    std::vector<std::string> children;
+    env->GetChildren(dir, &children);
+    uint64_t total = 0;
+    for (const std::string &child : children)
+    {
+        uint64_t number, size;
+        kvdb::FileType type;
+        if (kvdb::ParseFileName(child, &number, &type) && type == kvdb::FileType::kTableFile &&
+            env->GetFileSize(dir + "/" + child, &size).ok())
+            total += size;
+    }
+    return total;
+}
+
+TEST(TableTest, LeveledCompaction)
+{
+    std::string dir = NewTestDir("leveled");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 2;
+    options.max_bytes_for_level_base = 128 * 1024;
+    options.max_file_size = 32 * 1024;
+    options.cache_capacity = 16 * kIntEntry;
+    const int N = 4000;
+    const int kRounds = 10;
+    const std::string pad(50, 'x');
+
+    auto value_of = [&](int round, int i)
+    { return std::to_string(round) + "_" + std::to_string(i) + pad; };
+    {
+        IntTable table(options, dir);
+        for (int round = 0; round < kRounds; ++round)
+        {
+            for (int i = 0; i < N; ++i)
+                table.Insert(i, value_of(round, i));
+        }
+        table.WaitForCompaction();
+
+        // 第0层的文件数不超过触发值，数据被合并到更下面的层
+        ASSERT_LT(table.NumLevelFiles(0), options.level0_file_num_compaction_trigger);
+        ASSERT_GT(table.NumLevelFiles(2), 0);
+        // 旧版本在合并时被丢弃，磁盘上只比一轮的数据多一些
+        const uint64_t round_bytes = N * (value_of(0, N).size() + 8);
+        ASSERT_LT(TableFileBytes(dir), 3 * round_bytes);
+
+        for (int i = 0; i < N; ++i)
+            ASSERT_EQ(*table.Get(i), value_of(kRounds - 1, i)) << i;
+    }
+
+    // 重新打开时从MANIFEST恢复每层的文件
+    IntTable table(options, dir);
+    ASSERT_GT(table.NumLevelFiles(2), 0);
+    int n = 0;
+    for (auto it = table.Scan(0, N); it.Valid(); it.Next(), ++n)
+    {
+        ASSERT_EQ(it.key(), n);
+        ASSERT_EQ(it.value(), value_of(kRounds - 1, n));
+    }
+    ASSERT_EQ(n, N);
+}
+
+TEST(TableTest, CompactionDropsDeletedKeys)
+{
+    std::string dir = NewTestDir("drop_deleted");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 1;
+    const int N = 5000;
+    const std::string pad(100, 'x');
+
+    IntTable table(options, dir);
+    for (int i = 0; i < N; ++i)
+        table.Insert(i, std::to_string(i) + pad);
+    table.WaitForCompaction();
+    const uint64_t before = TableFileBytes(dir);
+    ASSERT_GT(before, N * pad.size());
+
+    for (int i = 0; i < N; ++i)
+        table.Remove(i);
+    // 写入其他key，让删除标记所在的memtable写入文件
+    for (int i = 0; i < 1000; ++i)
+        table.Insert(N + i, pad);
+    table.WaitForCompaction();
+
+    // 删除标记到达最底层后和被删除的值一起丢弃
+    ASSERT_LT(TableFileBytes(dir), before / 2);
+    for (int i = 0; i < N; i += 7)
+        ASSERT_EQ(table.Get(i), nullptr) << i;
+    auto it = table.Scan(0, N + 1000);
+    ASSERT_TRUE(it.Valid());
+    ASSERT_EQ(it.key(), N);
+}
+
+TEST(TableTest, Snapshot)
+{
+    IntTable table(1 << 20);
+    for (int i = 0; i < 100; ++i)
+        table.Insert(i, "v1-" + std::to_string(i));
+    const kvdb::Snapshot *snapshot = table.GetSnapshot();
+    kvdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+
+    // 快照之后的覆盖、删除和batch
+    for (int i = 0; i < 100; i += 2)
+        table.Insert(i, "v2");
+    for (int i = 1; i < 100; i += 3)
+        table.Remove(i);
+    kvdb::WriteBatch<int, std::string> batch;
+    batch.Put(200, "new");
+    batch.Delete(5);
+    table.Write(batch);
+    std::unique_ptr<kvdb::Iterator<int, std::string>> latest(table.NewIterator());
+    table.Insert(300, "after iterator");
+
+    std::vector<int> keys;
+    for (int i = 0; i < 100; ++i)
+    {
+        auto value = table.Get(read_options, i);
+        ASSERT_TRUE(value != nullptr) << i;
+        ASSERT_EQ(*value, "v1-" + std::to_string(i));
+        keys.push_back(i);
+    }
+    ASSERT_EQ(table.Get(read_options, 200), nullptr);
+    auto values = table.MultiGet(read_options, keys);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(*values[i], "v1-" + std::to_string(i));
+
+    int count = 0;
+    for (auto it = table.Scan(read_options, 0, 1000); it.Valid(); it.Next(), ++count)
+    {
+        ASSERT_EQ(it.key(), count);
+        ASSERT_EQ(it.value(), "v1-" + std::to_string(count));
+    }
+    ASSERT_EQ(count, 100);
+    std::unique_ptr<kvdb::Iterator<int, std::string>> iter(table.NewIterator(read_options));
+    count = 0;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev(), ++count)
+        ASSERT_EQ(iter->key(), 99 - count);
+    ASSERT_EQ(count, 100);
+
+    // 不带快照的读取看到最新的数据，迭代器看不到创建之后的写入
+    ASSERT_EQ(*table.Get(0), "v2");
+    ASSERT_EQ(table.Get(1), nullptr);
+    ASSERT_EQ(table.Get(5), nullptr);
+    ASSERT_EQ(*table.Get(200), "new");
+    count = 0;
+    for (latest->SeekToLast(); latest->Valid(); latest->Prev(), ++count)
+    {
+        ASSERT_NE(latest->key(), 300);
+        ASSERT_NE(latest->key() % 3, 1);
+    }
+    ASSERT_EQ(count, 100 - 33 - 1 + 1);
+    table.ReleaseSnapshot(snapshot);
+}
+
+TEST(TableTest, SnapshotScanWhileWriting)
+{
+    kvdb::Options options;
+    options.allow_concurrent_memtable_write = true;
+    IntTable table(options);
+    const int N = 200;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t)
+    {
+        writers.emplace_back([&table, &done, t]()
+                             {
+                                 // 每个batch把i和i + N写成相同的值
+                                 for (int round = 0; !done.load(); ++round)
+                                 {
+                                     kvdb::WriteBatch<int, std::string> batch;
+                                     for (int i = t; i < N; i += 2)
+                                     {
+                                         batch.Put(i, std::to_string(round));
+                                         batch.Put(i + N, std::to_string(round));
+                                     }
+                                     table.Write(batch);
+                                 } });
+    }
+
+    for (int scan = 0; scan < 200; ++scan)
+    {
+        const kvdb::Snapshot *snapshot = table.GetSnapshot();
+        kvdb::ReadOptions read_options;
+        read_options.snapshot = snapshot;
+        std::vector<std::string> values;
+        for (auto it = table.Scan(read_options, 0, 2 * N); it.Valid(); it.Next())
+            values.push_back(it.value());
+        // 快照中每个batch要么全部可见要么全部不可见
+        if (!values.empty())
+        {
+            ASSERT_EQ(values.size(), 2u * N);
+            for (int i = 0; i < N; ++i)
+                ASSERT_EQ(values[i], values[i + N]) << i;
+        }
+        table.ReleaseSnapshot(snapshot);
+    }
+    done = true;
+    for (auto &writer : writers)
+        writer.join();
+}
+
+TEST(TableTest, SnapshotSurvivesCompaction)
+{
+    std::string dir = NewTestDir("snapshot");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 1;
+    const int N = 2000;
+    const std::string pad(100, 'x');
+    auto rewrite = [&](IntTable *table, const std::string &version)
+    {
+        for (int i = 0; i < N; ++i)
+            table->Insert(i, version + pad);
+        table->WaitForCompaction();
+    };
+    {
+        IntTable table(options, dir);
+        rewrite(&table, "v1");
+        const kvdb::Snapshot *snapshot = table.GetSnapshot();
+        kvdb::ReadOptions read_options;
+        read_options.snapshot = snapshot;
+        rewrite(&table, "v2");
+        for (int i = 0; i < N; i += 10)
+            table.Remove(i);
+        rewrite(&table, "v3");
+        ASSERT_GT(table.NumTableFiles(), 0u);
+
+        // 被覆盖和删除的旧版本仍然保留在文件中
+        for (int i = 0; i < N; i += 7)
+        {
+            auto value = table.Get(read_options, i);
+            ASSERT_TRUE(value != nullptr) << i;
+            ASSERT_EQ(*value, "v1" + pad);
+            ASSERT_EQ(*table.Get(i), "v3" + pad);
+        }
+        int count = 0;
+        for (auto it = table.Scan(read_options, 0, N); it.Valid(); it.Next(), ++count)
+            ASSERT_EQ(it.value(), "v1" + pad);
+        ASSERT_TRUE(table.Scan(read_options, 0, N).status().ok());
+        ASSERT_EQ(count, N);
+        const uint64_t with_snapshot = TableFileBytes(dir);
+
+        // 释放快照之后，下一次合并只保留最新版本
+        table.ReleaseSnapshot(snapshot);
+        rewrite(&table, "v4");
+        ASSERT_LT(TableFileBytes(dir), with_snapshot / 2);
+    }
+
+    // 重新打开后序列号从MANIFEST中记录的位置继续，快照能看到已有的数据
+    IntTable table(options, dir);
+    const kvdb::Snapshot *snapshot = table.GetSnapshot();
+    kvdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    table.Insert(0, "v5");
+    ASSERT_EQ(*table.Get(read_options, 0), "v4" + pad);
+    ASSERT_EQ(*table.Get(0), "v5");
+    table.ReleaseSnapshot(snapshot);
+}
+
+TEST(TableTest, InPlaceUpdate)
+{
+    std::string dir = NewTestDir("inplace");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 256 * 1024;
+    options.inplace_update = true;
+    const int N = 1000;
+    {
+        StringTable table(options, dir);
+        // 反复覆盖同一批key，memtable不增长，不会写出有序表文件
+        for (int round = 0; round < 100; ++round)
+        {
+            for (int i = 0; i < N; ++i)
+                table.Insert(std::to_string(i), round);
+        }
+        ASSERT_EQ(table.NumTableFiles(), 0u);
+        for (int i = 0; i < N; ++i)
+            ASSERT_EQ(*table.Get(std::to_string(i)), 99);
+
+        // 快照和迭代器存在期间插入新版本，旧版本仍然可见
+        const kvdb::Snapshot *snapshot = table.GetSnapshot();
+        kvdb::ReadOptions read_options;
+        read_options.snapshot = snapshot;
+        std::unique_ptr<kvdb::Iterator<std::string, int>> iter(table.NewIterator());
+        for (int i = 0; i < N; ++i)
+            table.Insert(std::to_string(i), 100);
+        ASSERT_EQ(*table.Get(read_options, "7"), 99);
+        ASSERT_EQ(*table.Get("7"), 100);
+        int count = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++count)
+            ASSERT_EQ(iter->value(), 99);
+        ASSERT_EQ(count, N);
+        iter.reset();
+        table.ReleaseSnapshot(snapshot);
+
+        kvdb::WriteBatch<std::string, int> batch;
+        batch.Put("7", 101);
+        batch.Delete("8");
+        table.Write(batch);
+        table.Insert("9", 102);
+        ASSERT_EQ(*table.Get("7"), 101);
+        ASSERT_EQ(table.Get("8"), nullptr);
+        ASSERT_EQ(*table.Get("9"), 102);
+    }
+
+    // 每次写入仍然记录在日志中，重放后得到最新的值
+    StringTable table(options, dir);
+    ASSERT_EQ(*table.Get("0"), 100);
+    ASSERT_EQ(*table.Get("7"), 101);
+    ASSERT_EQ(table.Get("8"), nullptr);
+    ASSERT_EQ(*table.Get("9"), 102);
+
+    // value放不下时插入新版本
+    kvdb::Options string_options;
+    string_options.inplace_update = true;
+    IntTable strings(string_options);
+    strings.Insert(1, "short");
+    strings.Insert(1, "tiny");
+    ASSERT_EQ(*strings.Get(1), "tiny");
+    strings.Insert(1, std::string(100, 'x'));
+    ASSERT_EQ(*strings.Get(1), std::string(100, 'x'));
+}
+
+TEST(TableTest, MmapReads)
+{
+    std::string dir = NewTestDir("mmap");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 2;
+    options.max_file_size = 64 * 1024;
+    options.use_mmap_reads = true;
+    // 超过上限的文件用pread读取，两种文件混在一起
+    options.max_mmap_files = 3;
+    const int N = 5000;
+    const std::string pad(100, 'x');
+    {
+        IntTable table(options, dir);
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < N; ++i)
+                table.Insert(i, std::to_string(round) + pad);
+        }
+        table.WaitForCompaction();
+        ASSERT_GT(table.NumTableFiles(), 3u);
+        for (int i = 0; i < N; i += 7)
+            ASSERT_EQ(*table.Get(i), "2" + pad);
+    }
+
+    IntTable table(options, dir);
+    int count = 0;
+    for (auto it = table.Scan(0, N); it.Valid(); it.Next(), ++count)
+    {
+        ASSERT_EQ(it.key(), count);
+        ASSERT_EQ(it.value(), "2" + pad);
+    }
+    ASSERT_EQ(count, N);
+}
+
+TEST(TableTest, SharedBlockCache)
+{
+    // 两个Table的文件编号相同，共用一个块缓存时不能互相命中
+    auto block_cache = std::make_shared<kvdb::BlockCache>(4 << 20);
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.cache_capacity = 16 * kIntEntry;
+    options.block_cache = block_cache;
+    options.cache_index_and_filter_blocks = true;
+    const int N = 5000;
+    const std::string pad(100, 'x');
+    IntTable a(options, NewTestDir("block_cache_a"));
+    IntTable b(options, NewTestDir("block_cache_b"));
+    for (int i = 0; i < N; ++i)
+    {
+        a.Insert(i, "a" + std::to_string(i) + pad);
+        b.Insert(i, "b" + std::to_string(i) + pad);
+    }
+    a.WaitForCompaction();
+    b.WaitForCompaction();
+    ASSERT_GT(a.NumTableFiles(), 0u);
+    ASSERT_GT(b.NumTableFiles(), 0u);
+
+    for (int round = 0; round < 2; ++round)
+    {
+        block_cache->ResetStats();
+        for (int i = 0; i < N; i += 3)
+        {
+            ASSERT_EQ(*a.Get(i), "a" + std::to_string(i) + pad);
+            ASSERT_EQ(*b.Get(i), "b" + std::to_string(i) + pad);
+        }
+    }
+    // 第二轮读的块都已经在缓存中
+    kvdb::cache::CacheStats stats = block_cache->GetStats();
+    ASSERT_GT(stats.hits, 0u);
+    ASSERT_EQ(stats.misses, 0u);
+    ASSERT_GT(block_cache->GetUsage(), 0u);
+    ASSERT_LE(block_cache->GetUsage(), 4u << 20);
+}
+
+TEST(TableTest, CompressionPerLevel)
+{
+    std::string dir = NewTestDir("compression");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 2;
+    options.compression_per_level = {kvdb::kNoCompression, kvdb::kLZ4Compression};
+    const int N = 5000;
+    auto value = [](int i, int round)
+    {
+        return "{\"id\":" + std::to_string(i) + ",\"round\":" + std::to_string(round) + ",\"tags\":[\"a\",\"b\"]}";
+    };
+    {
+        IntTable table(options, dir);
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < N; ++i)
+                table.Insert(i, value(i, round));
+        }
+        table.WaitForCompaction();
+        // 第0层不压缩，合并到第1层的文件用LZ4压缩
+        ASSERT_GT(table.NumLevelFiles(1), 0);
+    }
+
+    IntTable table(options, dir);
+    for (int i = 0; i < N; ++i)
+        ASSERT_EQ(*table.Get(i), value(i, 2)) << i;
+}
+
+TEST(TableTest, Statistics)
+{
+    auto stats = std::make_shared<kvdb::Statistics>();
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.cache_capacity = 16 * kIntEntry;
+    options.statistics = stats;
+    const int N = 3000;
+    const std::string pad(50, 'x');
+    IntTable table(options, NewTestDir("statistics"));
+    for (int i = 0; i < N; ++i)
+        table.Insert(i, std::to_string(i) + pad);
+    table.Remove(0);
+    table.WaitForCompaction();
+    ASSERT_EQ(stats->GetTickerCount(kvdb::kKeysWritten), uint64_t(N + 1));
+    ASSERT_EQ(stats->GetHistogramData(kvdb::kPutLatency).count, uint64_t(N));
+    ASSERT_EQ(stats->GetHistogramData(kvdb::kDeleteLatency).count, 1u);
+    ASSERT_EQ(stats->GetTickerCount(kvdb::kWriteGroups), uint64_t(N + 1));
+    ASSERT_GT(stats->GetTickerCount(kvdb::kMemTableFlushes), 0u);
+    ASSERT_GT(stats->GetTickerCount(kvdb::kFlushBytesWritten), 0u);
+
+    ASSERT_EQ(table.Get(0), nullptr);
+    for (int i = 1; i < N; ++i)
+        ASSERT_EQ(*table.Get(i), std::to_string(i) + pad);
+    ASSERT_EQ(stats->GetTickerCount(kvdb::kKeysRead), uint64_t(N));
+    ASSERT_EQ(stats->GetTickerCount(kvdb::kKeysFound), uint64_t(N - 1));
+    ASSERT_EQ(stats->GetTickerCount(kvdb::kRowCacheHit) + stats->GetTickerCount(kvdb::kRowCacheMiss), uint64_t(N));
+    ASSERT_GT(stats->GetTickerCount(kvdb::kBlockCacheHit) + stats->GetTickerCount(kvdb::kBlockCacheMiss), 0u);
+    kvdb::HistogramData get = stats->GetHistogramData(kvdb::kGetLatency);
+    ASSERT_EQ(get.count, uint64_t(N));
+    ASSERT_LE(get.median, get.p99);
+
+    // 一次写入和memtable中的读取的明细
+    kvdb::SetPerfLevel(kvdb::PerfLevel::kEnableTime);
+    kvdb::PerfContext *perf = kvdb::GetPerfContext();
+    perf->Reset();
+    table.Insert(N, "new");
+    ASSERT_GT(perf->write_wal_nanos, 0u);
+    ASSERT_GT(perf->write_memtable_nanos, 0u);
+    perf->Reset();
+    ASSERT_EQ(*table.Get(N), "new");
+    ASSERT_EQ(perf->row_cache_miss_count, 1u);
+    ASSERT_EQ(perf->memtable_hit_count, 1u);
+    ASSERT_GT(perf->skiplist_levels_visited, 0u);
+    ASSERT_GT(perf->key_comparisons, 0u);
+    ASSERT_GT(perf->get_from_memtable_nanos, 0u);
+    ASSERT_EQ(perf->get_from_table_files_nanos, 0u);
+
+    // 快照读不经过行缓存，旧的key从文件中读取
+    kvdb::ReadOptions read_options;
+    read_options.snapshot = table.GetSnapshot();
+    perf->Reset();
+    ASSERT_EQ(*table.Get(read_options, 1), "1" + pad);
+    ASSERT_EQ(perf->row_cache_miss_count + perf->row_cache_hit_count, 0u);
+    ASSERT_EQ(perf->block_cache_hit_count + perf->block_cache_miss_count, 1u);
+    ASSERT_GT(perf->get_from_table_files_nanos, 0u);
+    table.ReleaseSnapshot(read_options.snapshot);
+    kvdb::SetPerfLevel(kvdb::PerfLevel::kDisable);
+
+    const std::string fname = testing::TempDir() + "kvdb_table_statistics.prom";
+    table.DumpStatistics(fname, kvdb::Statistics::kPrometheus);
+    std::string contents;
+    ASSERT_TRUE(kvdb::ReadFileToString(kvdb::Env::Default(), fname, &contents).ok());
+    ASSERT_NE(contents.find("kvdb_keys_written_total " + std::to_string(N + 2) + "\n"), std::string::npos);
+    ASSERT_NE(contents.find("kvdb_table_files " + std::to_string(table.NumTableFiles()) + "\n"), std::string::npos);
+    ASSERT_GT(stats->GetGauge(kvdb::kMemTableBytes), 0);
+    ASSERT_GT(stats->GetGauge(kvdb::kRowCacheUsage), 0);
+    kvdb::Env::Default()->RemoveFile(fname);
+
+    // 没有设置statistics
+    IntTable plain(16 * kIntEntry);
+    ASSERT_THROW(plain.DumpStatistics(fname), std::runtime_error);
+}
+
+TEST(TableTest, TransparentGet)
+{
+    std::string dir = NewTestDir("transparent_get");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.cache_capacity = 1 << 20;
+    const int N = 3000;
+    // key超过短字符串优化的长度，构造std::string一定会分配内存
+    auto key = [](int i)
+    { return "transparent-key-" + std::to_string(i) + std::string(20, 'k'); };
+    StringTable table(options, dir);
+    for (int i = 0; i < N; ++i)
+        table.Insert(key(i), i);
+    table.WaitForCompaction();
+    ASSERT_GT(table.NumTableFiles(), 0u);
+    // 一部分在memtable中，其中有覆盖和删除
+    for (int i = 0; i < N; i += 7)
+        table.Insert(key(i), -i);
+    for (int i = 1; i < N; i += 11)
+        table.Remove(key(i));
+    const kvdb::Snapshot *snapshot = table.GetSnapshot();
+    table.Insert(key(2), 1000000);
+    kvdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+
+    std::string buf;
+    for (int i = 0; i < N + 10; ++i)
+    {
+        buf = key(i);
+        const std::string_view sv(buf);
+        int expected = i % 7 == 0 ? -i : i;
+        auto snapshot_value = table.Get(read_options, sv);
+        if (i >= N || i % 11 == 1)
+        {
+            ASSERT_EQ(table.Get(sv), nullptr) << i;
+            ASSERT_EQ(snapshot_value, nullptr) << i;
+            continue;
+        }
+        ASSERT_EQ(*snapshot_value, expected) << i;
+        if (i == 2)
+            expected = 1000000;
+        // 第一次从memtable或文件加载，第二次命中缓存
+        ASSERT_EQ(*table.Get(sv), expected) << i;
+        ASSERT_EQ(*table.Get(sv), expected) << i;
+        ASSERT_EQ(*table.Get(buf), expected) << i;
+    }
+    table.ReleaseSnapshot(snapshot);
+}
+
+TEST(TableTest, PrefixScan)
+{
+    std::string dir = NewTestDir("prefix_scan");
+    kvdb::Options options;
+    options.sync = false;
+    options.write_buffer_size = 16 * 1024;
+    options.max_file_size = 4 * 1024;
+    options.cache_capacity = 1 << 20;
+    options.prefix_extractor = kvdb::NewDelimitedPrefixExtractor(':');
+    auto stats = std::make_shared<kvdb::Statistics>();
+    options.statistics = stats;
+    const int kTenants = 50, kKeys = 40;
+    auto key = [](int tenant, int i)
+    { return "tenant" + std::to_string(tenant) + ":entity" + std::to_string(i) + ":field"; };
+    {
+        // 每个文件只含少数租户，偶数租户之后还有一批写入留在memtable中
+        StringTable table(options, dir);
+        for (int t = 0; t < kTenants; ++t)
+            for (int i = 0; i < kKeys; ++i)
+                table.Insert(key(t, i), t * 1000 + i);
+        table.WaitForCompaction();
+        ASSERT_GT(table.NumTableFiles(), 4u);
+        for (int t = 0; t < kTenants; t += 2)
+            table.Insert(key(t, kKeys), -t);
+        table.Remove(key(3, 0));
+
+        kvdb::ReadOptions read_options;
+        read_options.prefix_same_as_start = true;
+        for (int t = 0; t < kTenants + 2; ++t)
+        {
+            const std::string prefix = "tenant" + std::to_string(t) + ":";
+            std::vector<std::string> expected;
+            for (auto it = table.Scan(prefix, "~"); it.Valid(); it.Next())
+            {
+                if (it.key().compare(0, prefix.size(), prefix) == 0)
+                    expected.push_back(it.key());
+            }
+            std::vector<std::string> keys;
+            for (auto it = table.Scan(read_options, prefix, "~"); it.Valid(); it.Next())
+                keys.push_back(it.key());
+            ASSERT_EQ(keys, expected) << prefix;
+            const size_t n = t >= kTenants ? 0 : kKeys + (t % 2 == 0) - (t == 3);
+            ASSERT_EQ(keys.size(), n) << prefix;
+        }
+        // 其他租户所在的文件和不含这个前缀的memtable被跳过
+        ASSERT_GT(stats->GetTickerCount(kvdb::kPrefixFilterUseful), 0u);
+        const uint64_t useful = stats->GetTickerCount(kvdb::kMemTablePrefixBloomUseful);
+        ASSERT_GT(useful, 0u);
+        // 点查不存在的租户时不查找memtable的跳表
+        ASSERT_EQ(table.Get(key(kTenants + 5, 0)), nullptr);
+        ASSERT_GT(stats->GetTickerCount(kvdb::kMemTablePrefixBloomUseful), useful);
+        ASSERT_EQ(*table.Get(key(4, kKeys)), -4);
+
+        // limit和end仍然生效，没有前缀的begin退回到普通的Scan
+        int count = 0;
+        for (auto it = table.Scan(read_options, key(7, 0), key(7, 20), 5); it.Valid(); it.Next())
+            ++count;
+        ASSERT_EQ(count, 5);
+        auto it = table.Scan(read_options, "tenant", "~");
+        ASSERT_TRUE(it.Valid());
+        ASSERT_EQ(it.key(), key(0, 0));
+    }
+
+    // 换了前缀提取器后旧文件的前缀过滤器不再使用，结果不变
+    options.prefix_extractor = kvdb::NewFixedPrefixExtractor(8);
+    StringTable table(options, dir);
+    kvdb::ReadOptions read_options;
+    read_options.prefix_same_as_start = true;
+    std::vector<std::string> keys;
+    for (auto it = table.Scan(read_options, "tenant1:", "~"); it.Valid(); it.Next())
+        keys.push_back(it.key());
+    ASSERT_EQ(keys.size(), static_cast<size_t>(kKeys));
+    // 前8个字节为"tenant12"，包括tenant12和tenant120-129(不存在)
+    keys.clear();
+    for (auto it = table.Scan(read_options, "tenant12", "~"); it.Valid(); it.Next())
+        keys.push_back(it.key());
+    ASSERT_EQ(keys.size(), static_cast<size_t>(kKeys + 1));
+}
+
+// 时间只由测试推进的Env，用来控制条目的过期
+class ManualClockEnv : public kvdb::Env
+{
+public:
+    explicit ManualClockEnv(uint64_t now) : now_(now) {}
+    uint64_t NowMicros() override { return now_.load(); }
+    void Advance(std::chrono::microseconds d) { now_ += d.count(); }
+
+private:
+    std::atomic<uint64_t> now_;
+};
+
+TEST(TableTest, TimeToLive)
+{
+    std::string dir = NewTestDir("ttl");
+    ManualClockEnv env(1000000);
+    kvdb::Options options;
+    options.env = &env;
+    options.sync = false;
+    options.write_buffer_size = 32 * 1024;
+    options.level0_file_num_compaction_trigger = 1;
+    auto stats = std::make_shared<kvdb::Statistics>();
+    options.statistics = stats;
+    const int N = 5000;
+    const std::string pad(100, 'x');
+    {
+        // 偶数key在60秒后过期，奇数key永不过期
+        IntTable table(options, dir);
+        for (int i = 0; i < N; ++i)
+        {
+            if (i % 2 == 0)
+                table.Insert(i, std::to_string(i) + pad, std::chrono::seconds(60));
+            else
+                table.Insert(i, std::to_string(i) + pad);
+        }
+        table.WaitForCompaction();
+        ASSERT_GT(table.NumTableFiles(), 0u);
+        auto x = table.Get(0);
+        ASSERT_EQ(*x, "0" + pad);
+        ASSERT_EQ(x.expire_at(), 1000000u + 60 * 1000000u);
+        ASSERT_EQ(table.Get(1).expire_at(), 0u);
+        x.Release();
+
+        env.Advance(std::chrono::seconds(60));
+        // 缓存中的、memtable中的和文件中的过期条目都不可见
+        ASSERT_EQ(table.Get(0), nullptr);
+        for (int i = 0; i < N; i += 7)
+            ASSERT_EQ(table.Get(i) == nullptr, i % 2 == 0) << i;
+        std::vector<kvdb::cache::PinnedHandle<int, std::string>> handles = table.MultiGet({2, 3, 4, 5});
+        ASSERT_EQ(handles[0], nullptr);
+        ASSERT_EQ(*handles[1], "3" + pad);
+        ASSERT_EQ(handles[2], nullptr);
+        ASSERT_EQ(*handles[3], "5" + pad);
+        handles.clear();
+        int count = 0;
+        for (auto it = table.Scan(0, N); it.Valid(); it.Next(), ++count)
+            ASSERT_EQ(it.key() % 2, 1);
+        ASSERT_EQ(count, N / 2);
+
+        // 过期后重新写入的值不带过期时间
+        table.Insert(4, "new");
+        ASSERT_EQ(*table.Get(4), "new");
+        // 新写入的ttl从当前时间算起，负的ttl写入时已经过期
+        table.Insert(6, "short", std::chrono::milliseconds(10));
+        table.Insert(N, "gone", std::chrono::seconds(-1));
+        ASSERT_EQ(*table.Get(6), "short");
+        ASSERT_EQ(table.Get(N), nullptr);
+
+        // 覆盖写奇数key，合并重写整个key范围，过期的偶数key不写删除标记就被丢弃
+        const uint64_t before = TableFileBytes(dir);
+        for (int i = 1; i < N; i += 2)
+            table.Insert(i, std::to_string(i) + pad);
+        table.WaitForCompaction();
+        ASSERT_GT(stats->GetTickerCount(kvdb::kExpiredKeysDropped), 0u);
+        ASSERT_LT(TableFileBytes(dir), before);
+        ASSERT_EQ(table.Get(2), nullptr);
+        ASSERT_EQ(*table.Get(4), "new");
+        ASSERT_EQ(*table.Get(9), "9" + pad);
+    }
+
+    // 日志中的过期时间在重放后仍然生效
+    IntTable table(options, dir);
+    ASSERT_EQ(*table.Get(6), "short");
+    env.Advance(std::chrono::milliseconds(10));
+    ASSERT_EQ(table.Get(6), nullptr);
+    ASSERT_EQ(table.Get(8), nullptr);
+    ASSERT_EQ(table.Get(N), nullptr);
+    ASSERT_EQ(*table.Get(4), "new");
+    int count = 0;
+    for (auto it = table.Scan(0, N); it.Valid(); it.Next())
+        ++count;
+    ASSERT_EQ(count, N / 2 + 1);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,215 @@
+#ifndef STORAGE_KVDB_DB_VERSION_EDIT_H_
+#define STORAGE_KVDB_DB_VERSION_EDIT_H_
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "db/dbformat.h"
+#include "util/coding.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 层数，第0层由memtable写入，最后一层保存最旧的数据
+    static const int kNumLevels = 7;
+
+    // 一次对文件集合的修改，按顺序写入MANIFEST。
+    // 重放MANIFEST中所有的VersionEdit即可得到当前每层有哪些文件
+    class VersionEdit
+    {
+    public:
+        VersionEdit() { Clear(); }
+
+        void Clear()
+        {
+            log_number_ = 0;
+            next_file_number_ = 0;
+            last_sequence_ = 0;
+            has_log_number_ = false;
+            has_next_file_number_ = false;
+            has_last_sequence_ = false;
+            deleted_files_.clear();
+            new_files_.clear();
+        }
+
+        // 编号小于number的日志中的数据都已经写入文件
+        void SetLogNumber(uint64_t number)
+        {
+            has_log_number_ = true;
+            log_number_ = number;
+        }
+
+        void SetNextFile(uint64_t number)
+        {
+            has_next_file_number_ = true;
+            next_file_number_ = number;
+        }
+
+        // 有序表文件和日志中最大的序列号，重新打开后从它之后继续分配
+        void SetLastSequence(SequenceNumber seq)
+        {
+            has_last_sequence_ = true;
+            last_sequence_ = seq;
+        }
+
+        // 在level层加入文件。只编码文件的编号、大小和key范围，
+        // 已经打开的f.table随edit一起进入新版本，不需要重新打开
+        void AddFile(int level, const FileMetaData &f)
+        {
+            new_files_.push_back(std::make_pair(level, f));
+        }
+
+        void RemoveFile(int level, uint64_t file)
+        {
+            deleted_files_.insert(std::make_pair(level, file));
+        }
+
+        void EncodeTo(std::string *dst) const;
+        Status DecodeFrom(const Slice &src);
+
+    private:
+        friend class VersionSet;
+
+        // MANIFEST记录中每个字段前的tag，不能修改已有的值
+        enum Tag
+        {
+            kLogNumber = 2,
+            kNextFileNumber = 3,
+            kLastSequence = 4,
+            kDeletedFile = 6,
+            kNewFile = 7,
+        };
+
+        static bool GetLevel(Slice *input, int *level)
+        {
+            uint32_t v;
+            if (GetVarint32(input, &v) && v < kNumLevels)
+            {
+                *level = static_cast<int>(v);
+                return true;
+            }
+            return false;
+        }
+
+        uint64_t log_number_;
+        uint64_t next_file_number_;
+        SequenceNumber last_sequence_;
+        bool has_log_number_;
+        bool has_next_file_number_;
+        bool has_last_sequence_;
+
+        std::set<std::pair<int, uint64_t>> deleted_files_;
+        std::vector<std::pair<int, FileMetaData>> new_files_;
+    };
+
+    inline void VersionEdit::EncodeTo(std::string *dst) const
+    {
+        if (has_log_number_)
+        {
+            PutVarint32(dst, kLogNumber);
+            PutVarint64(dst, log_number_);
+        }
+        if (has_next_file_number_)
+        {
+            PutVarint32(dst, kNextFileNumber);
+            PutVarint64(dst, next_file_number_);
+        }
+        if (has_last_sequence_)
+        {
+            PutVarint32(dst, kLastSequence);
+            PutVarint64(dst, last_sequence_);
+        }
+        for (const auto &deleted_file : deleted_files_)
+        {
+            PutVarint32(dst, kDeletedFile);
+            PutVarint32(dst, deleted_file.first);
+            PutVarint64(dst, deleted_file.second);
+        }
+        for (const auto &new_file : new_files_)
+        {
+            const FileMetaData &f = new_file.second;
+            PutVarint32(dst, kNewFile);
+            PutVarint32(dst, new_file.first);
+            PutVarint64(dst, f.number);
+            PutVarint64(dst, f.file_size);
+            PutLengthPrefixedSlice(dst, f.smallest);
+            PutLengthPrefixedSlice(dst, f.largest);
+        }
+    }
+
+    inline Status VersionEdit::DecodeFrom(const Slice &src)
+    {
+        Clear();
+        Slice input = src;
+        const char *msg = nullptr;
+        uint32_t tag;
+        int level;
+        uint64_t number;
+        FileMetaData f;
+        Slice str;
+
+        while (msg == nullptr && GetVarint32(&input, &tag))
+        {
+            switch (tag)
+            {
+            case kLogNumber:
+                if (GetVarint64(&input, &log_number_))
+                    has_log_number_ = true;
+                else
+                    msg = "log number";
+                break;
+
+            case kNextFileNumber:
+                if (GetVarint64(&input, &next_file_number_))
+                    has_next_file_number_ = true;
+                else
+                    msg = "next file number";
+                break;
+
+            case kLastSequence:
+                if (GetVarint64(&input, &last_sequence_))
+                    has_last_sequence_ = true;
+                else
+                    msg = "last sequence number";
+                break;
+
+            case kDeletedFile:
+                if (GetLevel(&input, &level) && GetVarint64(&input, &number))
+                    deleted_files_.insert(std::make_pair(level, number));
+                else
+                    msg = "deleted file";
+                break;
+
+            case kNewFile:
+                if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) && GetVarint64(&input, &f.file_size) &&
+                    GetLengthPrefixedSlice(&input, &str))
+                {
+                    f.smallest = str.ToString();
+                    if (GetLengthPrefixedSlice(&input, &str))
+                    {
+                        f.largest = str.ToString();
+                        new_files_.push_back(std::make_pair(level, f));
+                        break;
+                    }
+                }
+                msg = "new-file entry";
+                break;
+
+            default:
+                msg = "unknown tag";
+                break;
+            }
+        }
+
+        if (msg == nullptr && !input.empty())
+            msg = "invalid tag";
+        if (msg != nullptr)
+            return Status::Corruption("VersionEdit", msg);
+        return Status::OK();
+    }
+}
+
+#endif
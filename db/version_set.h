@@ -0,0 +1,788 @@
+#ifndef STORAGE_KVDB_DB_VERSION_SET_H_
+#define STORAGE_KVDB_DB_VERSION_SET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/iterator.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "db/options.h"
+#include "db/sstable.h"
+#include "db/version_edit.h"
+#include "util/env.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 返回files中第一个largest >= key的文件下标，没有时返回files.size()。
+    // REQUIRES: files按key范围排列且互不重叠
+    inline size_t FindFile(const std::vector<FileMetaData> &files, const Slice &key)
+    {
+        size_t left = 0;
+        size_t right = files.size();
+        while (left < right)
+        {
+            size_t mid = (left + right) / 2;
+            if (Slice(files[mid].largest).compare(key) < 0)
+                left = mid + 1;
+            else
+                right = mid;
+        }
+        return right;
+    }
+
+    // 某一时刻每层有哪些文件，创建之后不再修改。
+    // 第0层按文件编号从新到旧排列，其余各层按key范围排列且互不重叠
+    class Version
+    {
+    public:
+        const std::vector<FileMetaData> &files(int level) const { return files_[level]; }
+        int NumFiles(int level) const { return static_cast<int>(files_[level].size()); }
+
+        uint64_t NumLevelBytes(int level) const
+        {
+            uint64_t sum = 0;
+            for (const FileMetaData &f : files_[level])
+                sum += f.file_size;
+            return sum;
+        }
+
+        // 从新到旧对编码后的key的每个版本调用handler(value)，handler返回true表示
+        // 这个版本可见，此时停止查找并把*found设为true
+        template <typename Handler>
+        Status Get(const Slice &key, Handler &&handler, bool *found) const;
+
+        // 批量的Get，keys按升序排列。对keys[i]的每个版本调用handler(i, value)，直到返回true。
+        // 同一个文件中要查找的key一起交给SSTable::MultiGet，落在同一数据块的key只读一次块
+        template <typename Handler>
+        Status MultiGet(const std::vector<Slice> &keys, Handler &&handler) const;
+
+        // level层中key范围与[smallest, largest]重叠的文件
+        void GetOverlappingInputs(int level, const Slice &smallest, const Slice &largest,
+                                  std::vector<FileMetaData> *inputs) const
+        {
+            inputs->clear();
+            for (const FileMetaData &f : files_[level])
+            {
+                if (Slice(f.largest).compare(smallest) < 0 || Slice(f.smallest).compare(largest) > 0)
+                    continue;
+                inputs->push_back(f);
+            }
+        }
+
+        // 是否有文件的key范围包含编码后的key，返回false时所有文件中都没有key的任何版本
+        bool KeyInRange(const Slice &key) const
+        {
+            for (const FileMetaData &f : files_[0])
+            {
+                if (key.compare(f.smallest) >= 0 && key.compare(f.largest) <= 0)
+                    return true;
+            }
+            for (int level = 1; level < kNumLevels; level++)
+            {
+                const std::vector<FileMetaData> &files = files_[level];
+                size_t index = FindFile(files, key);
+                if (index < files.size() && key.compare(files[index].smallest) >= 0)
+                    return true;
+            }
+            return false;
+        }
+
+    private:
+        friend class VersionSet;
+
+        std::vector<FileMetaData> files_[kNumLevels];
+
+        // 最需要合并的层，score >= 1时需要合并
+        double compaction_score_ = -1;
+        int compaction_level_ = -1;
+    };
+
+    template <typename Handler>
+    Status Version::Get(const Slice &key, Handler &&handler, bool *found) const
+    {
+        *found = false;
+        auto on_match = [&](const Slice &value)
+        {
+            *found = handler(value);
+            return *found;
+        };
+
+        // 第0层的文件可能互相重叠，逐个检查
+        for (const FileMetaData &f : files_[0])
+        {
+            if (key.compare(f.smallest) < 0 || key.compare(f.largest) > 0)
+                continue;
+            Status s = f.table->InternalGet(key, on_match);
+            if (!s.ok() || *found)
+                return s;
+        }
+
+        // 其余各层最多只有一个文件可能包含key
+        for (int level = 1; level < kNumLevels; level++)
+        {
+            const std::vector<FileMetaData> &files = files_[level];
+            size_t index = FindFile(files, key);
+            if (index >= files.size() || key.compare(files[index].smallest) < 0)
+                continue;
+            Status s = files[index].table->InternalGet(key, on_match);
+            if (!s.ok() || *found)
+                return s;
+        }
+        return Status::OK();
+    }
+
+    template <typename Handler>
+    Status Version::MultiGet(const std::vector<Slice> &keys, Handler &&handler) const
+    {
+        std::vector<bool> found(keys.size(), false);
+        // 下一个文件中要查找的key，以及它们在keys中的下标
+        std::vector<Slice> batch;
+        std::vector<size_t> batch_index;
+        auto lookup = [&](const FileMetaData &f)
+        {
+            Status s = f.table->MultiGet(batch.data(), batch.size(), [&](size_t j, const Slice &value)
+                                         {
+                                             const bool visible = handler(batch_index[j], value);
+                                             if (visible)
+                                                 found[batch_index[j]] = true;
+                                             return visible; });
+            batch.clear();
+            batch_index.clear();
+            return s;
+        };
+
+        // 第0层从新到旧，已经找到的key不再查找更旧的文件
+        for (const FileMetaData &f : files_[0])
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (found[i] || keys[i].compare(f.smallest) < 0 || keys[i].compare(f.largest) > 0)
+                    continue;
+                batch.push_back(keys[i]);
+                batch_index.push_back(i);
+            }
+            if (batch.empty())
+                continue;
+            Status s = lookup(f);
+            if (!s.ok())
+                return s;
+        }
+
+        // 其余各层的文件按key排列，升序的key依次落在升序的文件中
+        for (int level = 1; level < kNumLevels; level++)
+        {
+            const std::vector<FileMetaData> &files = files_[level];
+            size_t current = files.size();
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (found[i])
+                    continue;
+                size_t index = FindFile(files, keys[i]);
+                if (index >= files.size() || keys[i].compare(files[index].smallest) < 0)
+                    continue;
+                if (index != current && !batch.empty())
+                {
+                    Status s = lookup(files[current]);
+                    if (!s.ok())
+                        return s;
+                }
+                current = index;
+                batch.push_back(keys[i]);
+                batch_index.push_back(i);
+            }
+            if (!batch.empty())
+            {
+                Status s = lookup(files[current]);
+                if (!s.ok())
+                    return s;
+            }
+        }
+        return Status::OK();
+    }
+
+    // 一次合并：把level层的inputs[0]和level+1层与之重叠的inputs[1]合并写入level+1层
+    class Compaction
+    {
+    public:
+        int level() const { return level_; }
+        VersionEdit *edit() { return &edit_; }
+        uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
+
+        // 只有一个输入文件且下一层没有重叠时，直接把文件移到下一层，不需要重写
+        bool IsTrivialMove() const { return inputs[0].size() == 1 && inputs[1].empty(); }
+
+        // 把所有输入文件从对应的层删除
+        void AddInputDeletions(VersionEdit *edit) const
+        {
+            for (int which = 0; which < 2; which++)
+            {
+                for (const FileMetaData &f : inputs[which])
+                    edit->RemoveFile(level_ + which, f.number);
+            }
+        }
+
+        // 输出层以下的各层都不包含key时返回true，此时key的删除标记可以丢弃。
+        // REQUIRES: 多次调用时key递增
+        bool IsBaseLevelForKey(const Slice &key)
+        {
+            for (int lvl = level_ + 2; lvl < kNumLevels; lvl++)
+            {
+                const std::vector<FileMetaData> &files = input_version_->files(lvl);
+                while (level_ptrs_[lvl] < files.size())
+                {
+                    const FileMetaData &f = files[level_ptrs_[lvl]];
+                    if (key.compare(f.largest) <= 0)
+                    {
+                        if (key.compare(f.smallest) >= 0)
+                            return false;
+                        break;
+                    }
+                    level_ptrs_[lvl]++;
+                }
+            }
+            return true;
+        }
+
+        std::vector<FileMetaData> inputs[2];
+
+    private:
+        friend class VersionSet;
+
+        Compaction(int level, uint64_t max_output_file_size, std::shared_ptr<const Version> input_version)
+            : level_(level), max_output_file_size_(max_output_file_size), input_version_(std::move(input_version))
+        {
+            for (int i = 0; i < kNumLevels; i++)
+                level_ptrs_[i] = 0;
+        }
+
+        int level_;
+        uint64_t max_output_file_size_;
+        // 选择输入文件时的版本，合并期间保持这些文件不被关闭
+        std::shared_ptr<const Version> input_version_;
+        VersionEdit edit_;
+        // IsBaseLevelForKey在各层的扫描位置
+        size_t level_ptrs_[kNumLevels];
+    };
+
+    // 管理当前版本、文件编号和MANIFEST。调用方负责加锁，
+    // 只有LogAndApply在写MANIFEST期间会释放调用方的锁
+    class VersionSet
+    {
+    public:
+        VersionSet(const std::string &dbname, const Options &options)
+            : dbname_(dbname), options_(SanitizeOptions(options)), next_file_number_(2), manifest_file_number_(0), log_number_(0),
+              last_sequence_(0), mmap_limiter_(std::make_shared<MmapLimiter>(options.max_mmap_files)),
+              descriptor_file_(nullptr), descriptor_log_(nullptr), current_(std::make_shared<Version>()) {}
+
+        VersionSet(const VersionSet &) = delete;
+        VersionSet &operator=(const VersionSet &) = delete;
+
+        ~VersionSet()
+        {
+            delete descriptor_log_;
+            if (descriptor_file_ != nullptr)
+                descriptor_file_->Close();
+            delete descriptor_file_;
+        }
+
+        // 从CURRENT指向的MANIFEST恢复，CURRENT不存在时是一个新的数据库
+        Status Recover();
+
+        // 把edit写入MANIFEST并生成新的当前版本。lock不为nullptr时写文件期间释放它。
+        // 同一时刻只能有一个线程调用
+        Status LogAndApply(VersionEdit *edit, std::unique_lock<std::mutex> *lock);
+
+        std::shared_ptr<const Version> current() const { return current_; }
+
+        uint64_t NewFileNumber() { return next_file_number_++; }
+
+        void MarkFileNumberUsed(uint64_t number)
+        {
+            if (next_file_number_ <= number)
+                next_file_number_ = number + 1;
+        }
+
+        // 编号小于它的日志已经不再需要
+        uint64_t LogNumber() const { return log_number_; }
+
+        // 已经写入的最大序列号，每次LogAndApply一起记录到MANIFEST
+        SequenceNumber LastSequence() const { return last_sequence_; }
+        void SetLastSequence(SequenceNumber seq)
+        {
+            assert(seq >= last_sequence_);
+            last_sequence_ = seq;
+        }
+        uint64_t ManifestFileNumber() const { return manifest_file_number_; }
+
+        int NumLevelFiles(int level) const { return current_->NumFiles(level); }
+
+        bool NeedsCompaction() const { return current_->compaction_score_ >= 1; }
+
+        // 选出下一次合并，不需要合并时返回nullptr。调用方负责delete
+        Compaction *PickCompaction();
+
+        // 当前版本引用的所有文件
+        void AddLiveFiles(std::set<uint64_t> *live) const
+        {
+            for (int level = 0; level < kNumLevels; level++)
+            {
+                for (const FileMetaData &f : current_->files(level))
+                    live->insert(f.number);
+            }
+        }
+
+        // 打开f对应的有序表文件，填写f->table
+        Status OpenTable(FileMetaData *f) const;
+
+        // 没有指定块缓存时使用进程内共享的默认块缓存
+        static Options SanitizeOptions(const Options &src)
+        {
+            Options result = src;
+            if (result.no_block_cache)
+                result.block_cache = nullptr;
+            else if (result.block_cache == nullptr)
+                result.block_cache = BlockCache::Default();
+            return result;
+        }
+
+        // level层的总大小上限
+        uint64_t MaxBytesForLevel(int level) const
+        {
+            uint64_t result = options_.max_bytes_for_level_base;
+            while (level > 1)
+            {
+                result *= 10;
+                level--;
+            }
+            return result;
+        }
+
+    private:
+        // 把edit应用到base上得到新版本
+        Status BuildVersion(const Version &base, const VersionEdit &edit, Version *v) const;
+        // 计算下一次合并的层
+        void Finalize(Version *v) const;
+
+        const std::string dbname_;
+        const Options options_;
+        uint64_t next_file_number_;
+        uint64_t manifest_file_number_;
+        uint64_t log_number_;
+        SequenceNumber last_sequence_;
+        // 限制use_mmap_reads时映射的文件数，每个映射的文件持有一份引用
+        const std::shared_ptr<MmapLimiter> mmap_limiter_;
+
+        WritableFile *descriptor_file_;
+        log::Writer *descriptor_log_;
+        std::shared_ptr<const Version> current_;
+
+        // 每层下一次合并从哪个key之后开始，使合并在整层上轮转
+        std::string compact_pointer_[kNumLevels];
+    };
+
+    inline Status VersionSet::OpenTable(FileMetaData *f) const
+    {
+        const std::string fname = TableFileName(dbname_, f->number);
+        RandomAccessFile *file;
+        Status s = options_.use_mmap_reads ? options_.env->NewMmapReadableFile(fname, mmap_limiter_, &file)
+                                           : options_.env->NewRandomAccessFile(fname, &file);
+        if (!s.ok())
+            return s;
+        // 打开之后的读取大多是点查
+        file->Hint(AccessPattern::kRandom);
+        SSTable *table;
+        s = SSTable::Open(options_, file, f->file_size, &table);
+        if (!s.ok())
+        {
+            delete file;
+            return Status::Corruption(fname, s.ToString());
+        }
+        f->table.reset(table);
+        return s;
+    }
+
+    inline Status VersionSet::BuildVersion(const Version &base, const VersionEdit &edit, Version *v) const
+    {
+        for (int level = 0; level < kNumLevels; level++)
+        {
+            std::vector<FileMetaData> &files = v->files_[level];
+            for (const FileMetaData &f : base.files_[level])
+            {
+                if (edit.deleted_files_.count(std::make_pair(level, f.number)) == 0)
+                    files.push_back(f);
+            }
+        }
+        for (const auto &new_file : edit.new_files_)
+        {
+            FileMetaData f = new_file.second;
+            if (f.table == nullptr)
+            {
+                // 从MANIFEST恢复的文件，还没有打开
+                Status s = OpenTable(&f);
+                if (!s.ok())
+                    return s;
+            }
+            v->files_[new_file.first].push_back(f);
+        }
+
+        std::sort(v->files_[0].begin(), v->files_[0].end(), [](const FileMetaData &a, const FileMetaData &b)
+                  { return a.number > b.number; });
+        for (int level = 1; level < kNumLevels; level++)
+        {
+            std::vector<FileMetaData> &files = v->files_[level];
+            std::sort(files.begin(), files.end(), [](const FileMetaData &a, const FileMetaData &b)
+                      { return a.smallest < b.smallest; });
+            for (size_t i = 1; i < files.size(); i++)
+            {
+                if (files[i - 1].largest >= files[i].smallest)
+                    return Status::Corruption("overlapping ranges in same level");
+            }
+        }
+        return Status::OK();
+    }
+
+    inline void VersionSet::Finalize(Version *v) const
+    {
+        int best_level = -1;
+        double best_score = -1;
+        for (int level = 0; level < kNumLevels - 1; level++)
+        {
+            double score;
+            if (level == 0)
+            {
+                // 第0层按文件数计算：每次查找都要检查所有第0层文件，文件数比大小更重要
+                score = v->files_[level].size() / static_cast<double>(options_.level0_file_num_compaction_trigger);
+            }
+            else
+            {
+                score = static_cast<double>(v->NumLevelBytes(level)) / MaxBytesForLevel(level);
+            }
+            if (score > best_score)
+            {
+                best_level = level;
+                best_score = score;
+            }
+        }
+        v->compaction_level_ = best_level;
+        v->compaction_score_ = best_score;
+    }
+
+    inline Status VersionSet::Recover()
+    {
+        Env *env = options_.env;
+        if (!env->FileExists(CurrentFileName(dbname_)))
+            return Status::OK();
+
+        std::string current;
+        Status s = ReadFileToString(env, CurrentFileName(dbname_), &current);
+        if (!s.ok())
+            return s;
+        if (current.empty() || current[current.size() - 1] != '\n')
+            return Status::Corruption("CURRENT file does not end with newline");
+        current.resize(current.size() - 1);
+
+        const std::string dscname = dbname_ + "/" + current;
+        SequentialFile *file;
+        s = env->NewSequentialFile(dscname, &file);
+        if (!s.ok())
+            return Status::Corruption("CURRENT points to a non-existent file", s.ToString());
+
+        // 先合并所有edit再打开文件，已经被删除的文件不需要打开
+        VersionEdit merged;
+        bool have_log_number = false;
+        bool have_next_file = false;
+        uint64_t log_number = 0;
+        uint64_t next_file = 0;
+        SequenceNumber last_sequence = 0;
+        {
+            log::StatusReporter reporter;
+            log::Reader reader(file, &reporter, true);
+            Slice record;
+            std::string scratch;
+            while (reader.ReadRecord(&record, &scratch) && s.ok())
+            {
+                VersionEdit edit;
+                s = edit.DecodeFrom(record);
+                if (!s.ok())
+                    break;
+                for (const auto &deleted : edit.deleted_files_)
+                {
+                    auto &files = merged.new_files_;
+                    files.erase(std::remove_if(files.begin(), files.end(), [&](const std::pair<int, FileMetaData> &f)
+                                               { return f.first == deleted.first && f.second.number == deleted.second; }),
+                                files.end());
+                }
+                for (const auto &new_file : edit.new_files_)
+                    merged.new_files_.push_back(new_file);
+                if (edit.has_log_number_)
+                {
+                    log_number = edit.log_number_;
+                    have_log_number = true;
+                }
+                if (edit.has_next_file_number_)
+                {
+                    next_file = edit.next_file_number_;
+                    have_next_file = true;
+                }
+                if (edit.has_last_sequence_)
+                    last_sequence = edit.last_sequence_;
+            }
+            if (s.ok())
+                s = reporter.status;
+        }
+        delete file;
+        if (!s.ok())
+            return Status::Corruption(dscname, s.ToString());
+        if (!have_next_file)
+            return Status::Corruption("no meta-nextfile entry in descriptor");
+        if (!have_log_number)
+            log_number = 0;
+
+        auto v = std::make_shared<Version>();
+        s = BuildVersion(Version(), merged, v.get());
+        if (!s.ok())
+            return s;
+        Finalize(v.get());
+        current_ = v;
+        next_file_number_ = next_file;
+        log_number_ = log_number;
+        last_sequence_ = last_sequence;
+        MarkFileNumberUsed(log_number);
+        // 之后的LogAndApply会创建新的MANIFEST，旧的由调用方删除
+        return Status::OK();
+    }
+
+    inline Status VersionSet::LogAndApply(VersionEdit *edit, std::unique_lock<std::mutex> *lock)
+    {
+        if (edit->has_log_number_)
+            assert(edit->log_number_ >= log_number_ && edit->log_number_ < next_file_number_);
+        else
+            edit->SetLogNumber(log_number_);
+
+        // 打开后第一次修改时创建新的MANIFEST，开头写入完整的当前状态
+        const bool new_manifest = descriptor_log_ == nullptr;
+        uint64_t new_manifest_number = manifest_file_number_;
+        if (new_manifest)
+            new_manifest_number = NewFileNumber();
+        edit->SetNextFile(next_file_number_);
+        edit->SetLastSequence(last_sequence_);
+
+        auto v = std::make_shared<Version>();
+        Status s = BuildVersion(*current_, *edit, v.get());
+        if (!s.ok())
+            return s;
+        Finalize(v.get());
+
+        std::string record;
+        if (new_manifest)
+        {
+            VersionEdit snapshot;
+            snapshot.SetLogNumber(edit->log_number_);
+            snapshot.SetNextFile(edit->next_file_number_);
+            snapshot.SetLastSequence(edit->last_sequence_);
+            for (int level = 0; level < kNumLevels; level++)
+            {
+                for (const FileMetaData &f : v->files_[level])
+                    snapshot.AddFile(level, f);
+            }
+            snapshot.EncodeTo(&record);
+        }
+        else
+        {
+            edit->EncodeTo(&record);
+        }
+
+        // 写MANIFEST期间不需要持有锁，只有一个线程会修改版本
+        if (lock != nullptr)
+            lock->unlock();
+        const std::string dscname = DescriptorFileName(dbname_, new_manifest_number);
+        if (new_manifest)
+        {
+            s = options_.env->NewWritableFile(dscname, &descriptor_file_);
+            if (s.ok())
+                descriptor_log_ = new log::Writer(descriptor_file_);
+        }
+        if (s.ok())
+            s = descriptor_log_->AddRecord(record);
+        if (s.ok())
+            s = descriptor_file_->Sync();
+        if (s.ok() && new_manifest)
+            s = SetCurrentFile(options_.env, dbname_, new_manifest_number);
+        if (lock != nullptr)
+            lock->lock();
+
+        if (s.ok())
+        {
+            current_ = v;
+            log_number_ = edit->log_number_;
+            manifest_file_number_ = new_manifest_number;
+        }
+        else if (new_manifest)
+        {
+            delete descriptor_log_;
+            delete descriptor_file_;
+            descriptor_log_ = nullptr;
+            descriptor_file_ = nullptr;
+            options_.env->RemoveFile(dscname);
+        }
+        return s;
+    }
+
+    inline Compaction *VersionSet::PickCompaction()
+    {
+        const Version *v = current_.get();
+        if (v->compaction_score_ < 1)
+            return nullptr;
+        const int level = v->compaction_level_;
+        assert(level >= 0 && level + 1 < kNumLevels);
+
+        Compaction *c = new Compaction(level, options_.max_file_size, current_);
+        if (level == 0)
+        {
+            // 第0层的文件互相重叠，全部一起合并
+            c->inputs[0] = v->files(0);
+        }
+        else
+        {
+            // 从上次合并结束的位置继续
+            for (const FileMetaData &f : v->files(level))
+            {
+                if (compact_pointer_[level].empty() || f.largest > compact_pointer_[level])
+                {
+                    c->inputs[0].push_back(f);
+                    break;
+                }
+            }
+            if (c->inputs[0].empty())
+                c->inputs[0].push_back(v->files(level)[0]);
+        }
+
+        std::string smallest = c->inputs[0][0].smallest;
+        std::string largest = c->inputs[0][0].largest;
+        for (const FileMetaData &f : c->inputs[0])
+        {
+            smallest = std::min(smallest, f.smallest);
+            largest = std::max(largest, f.largest);
+        }
+        v->GetOverlappingInputs(level + 1, smallest, largest, &c->inputs[1]);
+        compact_pointer_[level] = largest;
+        return c;
+    }
+
+    // 遍历第1层及以下某一层的所有文件，层内文件互不重叠，依次打开即可
+    template <typename K, typename V>
+    class LevelIterator : public Iterator<K, V>
+    {
+    public:
+        // 迭代器存在期间files必须有效
+        explicit LevelIterator(const std::vector<FileMetaData> *files) : files_(files), index_(0) {}
+
+        bool Valid() const override { return file_iter_ != nullptr && file_iter_->Valid(); }
+
+        void SeekToFirst() override
+        {
+            InitFile(0);
+            if (file_iter_ != nullptr)
+                file_iter_->SeekToFirst();
+            SkipEmptyFilesForward();
+        }
+
+        void SeekToLast() override
+        {
+            InitFile(static_cast<int>(files_->size()) - 1);
+            if (file_iter_ != nullptr)
+                file_iter_->SeekToLast();
+            SkipEmptyFilesBackward();
+        }
+
+        void Seek(const K &target) override
+        {
+            encoded_.clear();
+            Codec<K>::Encode(&encoded_, target);
+            InitFile(static_cast<int>(FindFile(*files_, encoded_)));
+            if (file_iter_ != nullptr)
+                file_iter_->Seek(target);
+            SkipEmptyFilesForward();
+        }
+
+        void Next() override
+        {
+            assert(Valid());
+            file_iter_->Next();
+            SkipEmptyFilesForward();
+        }
+
+        void Prev() override
+        {
+            assert(Valid());
+            file_iter_->Prev();
+            SkipEmptyFilesBackward();
+        }
+
+        const K &key() const override { return file_iter_->key(); }
+        const V &value() const override { return file_iter_->value(); }
+        KType type() const override { return file_iter_->type(); }
+        SequenceNumber sequence() const override { return file_iter_->sequence(); }
+        uint64_t expire_at() const override { return file_iter_->expire_at(); }
+
+        Status status() const override
+        {
+            if (!status_.ok())
+                return status_;
+            if (file_iter_ != nullptr)
+                return file_iter_->status();
+            return Status::OK();
+        }
+
+    private:
+        void SkipEmptyFilesForward()
+        {
+            while (file_iter_ != nullptr && !file_iter_->Valid())
+            {
+                InitFile(index_ + 1);
+                if (file_iter_ != nullptr)
+                    file_iter_->SeekToFirst();
+            }
+        }
+
+        void SkipEmptyFilesBackward()
+        {
+            while (file_iter_ != nullptr && !file_iter_->Valid())
+            {
+                InitFile(index_ - 1);
+                if (file_iter_ != nullptr)
+                    file_iter_->SeekToLast();
+            }
+        }
+
+        // 切换到第index个文件，越界时file_iter_为nullptr
+        void InitFile(int index)
+        {
+            if (file_iter_ != nullptr && status_.ok() && !file_iter_->status().ok())
+                status_ = file_iter_->status();
+            index_ = index;
+            if (index < 0 || index >= static_cast<int>(files_->size()))
+                file_iter_.reset();
+            else
+                file_iter_.reset(new TableFileIterator<K, V>((*files_)[index].table->NewIterator()));
+        }
+
+        const std::vector<FileMetaData> *files_;
+        int index_;
+        std::unique_ptr<Iterator<K, V>> file_iter_;
+        std::string encoded_;
+        Status status_;
+    };
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "db/version_set.h"
+#include "db/sstable_builder.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+using namespace kvdb;
+
+TEST(VersionEditTest, EncodeDecode)
+{
+    VersionEdit edit;
+    edit.SetLogNumber(100);
+    edit.SetNextFile(200);
+    edit.SetLastSequence(12345);
+    for (int i = 0; i < 4; i++)
+    {
+        FileMetaData f;
+        f.number = 300 + i;
+        f.file_size = 400 + i;
+        f.smallest = "foo" + std::to_string(i);
+        f.largest = "zoo" + std::to_string(i);
+        edit.AddFile(i, f);
+        edit.RemoveFile(i + 1, 500 + i);
+    }
+
+    std::string encoded, encoded2;
+    edit.EncodeTo(&encoded);
+    VersionEdit parsed;
+    ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+    parsed.EncodeTo(&encoded2);
+    ASSERT_EQ(encoded, encoded2);
+
+    // 截断的记录
+    ASSERT_TRUE(parsed.DecodeFrom(Slice(encoded.data(), encoded.size() - 1)).IsCorruption());
+}
+
+TEST(VersionSetFormatTest, FindFile)
+{
+    std::vector<FileMetaData> files;
+    ASSERT_EQ(FindFile(files, "a"), 0u);
+    for (const char *range : {"bc", "fg", "jk"})
+    {
+        FileMetaData f;
+        f.smallest = std::string(1, range[0]);
+        f.largest = std::string(1, range[1]);
+        files.push_back(f);
+    }
+    ASSERT_EQ(FindFile(files, "a"), 0u);
+    ASSERT_EQ(FindFile(files, "c"), 0u);
+    ASSERT_EQ(FindFile(files, "d"), 1u);
+    ASSERT_EQ(FindFile(files, "g"), 1u);
+    ASSERT_EQ(FindFile(files, "h"), 2u);
+    ASSERT_EQ(FindFile(files, "z"), 3u);
+}
+
+class VersionSetTest : public testing::Test
+{
+protected:
+    VersionSetTest() : dbname_(testing::TempDir() + "kvdb_version_set"), env_(Env::Default())
+    {
+        std::vector<std::string> children;
+        if (env_->GetChildren(dbname_, &children).ok())
+        {
+            for (const std::string &child : children)
+                env_->RemoveFile(dbname_ + "/" + child);
+        }
+        env_->CreateDir(dbname_);
+    }
+
+    // 写入一个只包含smallest和largest两个key的有序表文件
+    FileMetaData MakeFile(uint64_t number, const std::string &smallest, const std::string &largest)
+    {
+        WritableFile *file;
+        EXPECT_TRUE(env_->NewWritableFile(TableFileName(dbname_, number), &file).ok());
+        SSTableBuilder builder(options_, file);
+        builder.Add(smallest, "v");
+        if (largest != smallest)
+            builder.Add(largest, "v");
+        EXPECT_TRUE(builder.Finish().ok());
+        file->Close();
+        delete file;
+
+        FileMetaData f;
+        f.number = number;
+        f.file_size = builder.FileSize();
+        f.smallest = smallest;
+        f.largest = largest;
+        return f;
+    }
+
+    std::string dbname_;
+    Env *env_;
+    Options options_;
+};
+
+TEST_F(VersionSetTest, LogAndApplyAndRecover)
+{
+    uint64_t log_number;
+    {
+        VersionSet versions(dbname_, options_);
+        ASSERT_TRUE(versions.Recover().ok());
+
+        VersionEdit edit;
+        edit.AddFile(0, MakeFile(versions.NewFileNumber(), "a", "m"));
+        edit.AddFile(0, MakeFile(versions.NewFileNumber(), "k", "z"));
+        edit.AddFile(1, MakeFile(versions.NewFileNumber(), "c", "d"));
+        edit.AddFile(1, MakeFile(versions.NewFileNumber(), "x", "y"));
+        log_number = versions.NewFileNumber();
+        edit.SetLogNumber(log_number);
+        ASSERT_TRUE(versions.LogAndApply(&edit, nullptr).ok());
+        ASSERT_TRUE(env_->FileExists(CurrentFileName(dbname_)));
+        ASSERT_EQ(versions.NumLevelFiles(0), 2);
+        ASSERT_EQ(versions.NumLevelFiles(1), 2);
+
+        // 第0层新文件在前
+        ASSERT_GT(versions.current()->files(0)[0].number, versions.current()->files(0)[1].number);
+
+        // 追加到已有的MANIFEST
+        VersionEdit edit2;
+        edit2.RemoveFile(1, versions.current()->files(1)[1].number);
+        versions.SetLastSequence(1000);
+        ASSERT_TRUE(versions.LogAndApply(&edit2, nullptr).ok());
+        ASSERT_EQ(versions.NumLevelFiles(1), 1);
+    }
+
+    VersionSet versions(dbname_, options_);
+    ASSERT_TRUE(versions.Recover().ok());
+    ASSERT_EQ(versions.NumLevelFiles(0), 2);
+    ASSERT_EQ(versions.NumLevelFiles(1), 1);
+    ASSERT_EQ(versions.LogNumber(), log_number);
+    ASSERT_EQ(versions.LastSequence(), 1000u);
+    ASSERT_GT(versions.NewFileNumber(), log_number);
+
+    // 文件已经打开，可以查找
+    bool found = false;
+    std::string value;
+    ASSERT_TRUE(versions.current()->Get("d", [&](const Slice &v)
+                                        {
+                                            value = v.ToString();
+                                            return true; },
+                                        &found)
+                    .ok());
+    ASSERT_TRUE(found);
+    ASSERT_EQ(value, "v");
+    ASSERT_TRUE(versions.current()->Get("y", [](const Slice &)
+                                        { return true; },
+                                        &found)
+                    .ok());
+    ASSERT_FALSE(found);
+}
+
+TEST_F(VersionSetTest, PickCompaction)
+{
+    options_.level0_file_num_compaction_trigger = 2;
+    VersionSet versions(dbname_, options_);
+    ASSERT_TRUE(versions.Recover().ok());
+
+    VersionEdit edit;
+    edit.AddFile(0, MakeFile(versions.NewFileNumber(), "c", "f"));
+    edit.AddFile(1, MakeFile(versions.NewFileNumber(), "a", "b"));
+    edit.AddFile(1, MakeFile(versions.NewFileNumber(), "e", "g"));
+    edit.AddFile(3, MakeFile(versions.NewFileNumber(), "h", "k"));
+    ASSERT_TRUE(versions.LogAndApply(&edit, nullptr).ok());
+    ASSERT_FALSE(versions.NeedsCompaction());
+
+    VersionEdit edit2;
+    edit2.AddFile(0, MakeFile(versions.NewFileNumber(), "d", "h"));
+    ASSERT_TRUE(versions.LogAndApply(&edit2, nullptr).ok());
+    ASSERT_TRUE(versions.NeedsCompaction());
+
+    // 第0层全部文件加上第1层中与[c, h]重叠的文件
+    std::unique_ptr<Compaction> c(versions.PickCompaction());
+    ASSERT_NE(c, nullptr);
+    ASSERT_EQ(c->level(), 0);
+    ASSERT_EQ(c->inputs[0].size(), 2u);
+    ASSERT_EQ(c->inputs[1].size(), 1u);
+    ASSERT_EQ(c->inputs[1][0].smallest, "e");
+    ASSERT_FALSE(c->IsTrivialMove());
+
+    // 第3层包含[h, k]
+    ASSERT_TRUE(c->IsBaseLevelForKey("a"));
+    ASSERT_FALSE(c->IsBaseLevelForKey("i"));
+    ASSERT_TRUE(c->IsBaseLevelForKey("z"));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,139 @@
+#ifndef STORAGE_KVDB_DB_WRITE_BATCH_H_
+#define STORAGE_KVDB_DB_WRITE_BATCH_H_
+#include <cstdint>
+#include <string>
+#include "util/KVNode.h"
+#include "util/coding.h"
+#include "util/slice.h"
+#include "util/status.h"
+namespace kvdb
+{
+    // 一组按顺序执行的Put/Delete，由Table::Write原子地写入：整个batch在同一条日志记录中，
+    // 恢复时要么全部重放，要么全部丢弃。修改在加入时就序列化到一块连续的内存中，
+    // 格式与日志记录中的条目相同，写日志时直接拼接
+    template <typename K, typename V>
+    class WriteBatch
+    {
+    public:
+        WriteBatch() : count_(0) {}
+
+        void Put(const K &key, const V &value)
+        {
+            EncodeEntry(&rep_, KType::kTypeValue, key, &value);
+            ++count_;
+        }
+
+        // expire_at为过期的时刻(Options::env的NowMicros)，到期后key对读者不存在，
+        // flush和合并会直接丢弃它，不需要再写删除标记。0表示永不过期，与Put相同
+        void PutWithExpiry(const K &key, const V &value, uint64_t expire_at)
+        {
+            EncodeEntry(&rep_, KType::kTypeValue, key, &value, expire_at);
+            ++count_;
+        }
+
+        void Delete(const K &key)
+        {
+            EncodeEntry(&rep_, KType::kTypeDelete, key, nullptr);
+            ++count_;
+        }
+
+        void Clear()
+        {
+            rep_.clear();
+            count_ = 0;
+        }
+
+        // batch中的修改个数
+        uint32_t Count() const { return count_; }
+        // 序列化后的字节数
+        size_t ApproximateSize() const { return rep_.size(); }
+
+        // 按加入的顺序对每个修改调用handler(key, value, type, expire_at)，删除时value为V()，
+        // 没有过期时间时expire_at为0
+        template <typename Handler>
+        Status Iterate(Handler &&handler) const
+        {
+            Slice input(rep_);
+            Status s = DecodeEntries(&input, count_, handler);
+            if (s.ok() && !input.empty())
+                s = Status::Corruption("trailing bytes in write batch");
+            return s;
+        }
+
+        // 序列化的所有条目，不含条目数
+        const std::string &Contents() const { return rep_; }
+
+        // 每个条目依次为 type (1字节) | 长度前缀的key | 长度前缀的value (删除时没有value)。
+        // 带过期时间的value的type为kTypeValueWithExpiry，在value之前多一个fixed64的过期时间
+        static void EncodeEntry(std::string *dst, KType type, const K &key, const V *value, uint64_t expire_at = 0);
+        // 从input开头解析count个条目，解析完的部分从input中移除
+        template <typename Handler>
+        static Status DecodeEntries(Slice *input, uint32_t count, Handler &&handler);
+
+    private:
+        std::string rep_;
+        uint32_t count_;
+    };
+
+    template <typename K, typename V>
+    void WriteBatch<K, V>::EncodeEntry(std::string *dst, KType type, const K &key, const V *value, uint64_t expire_at)
+    {
+        std::string buf;
+        const bool has_expiry = type == KType::kTypeValue && expire_at != 0;
+        dst->push_back(static_cast<char>(has_expiry ? KType::kTypeValueWithExpiry : type));
+        Codec<K>::Encode(&buf, key);
+        PutLengthPrefixedSlice(dst, buf);
+        if (has_expiry)
+            PutFixed64(dst, expire_at);
+        if (type == KType::kTypeValue)
+        {
+            buf.clear();
+            Codec<V>::Encode(&buf, *value);
+            PutLengthPrefixedSlice(dst, buf);
+        }
+    }
+
+    template <typename K, typename V>
+    template <typename Handler>
+    Status WriteBatch<K, V>::DecodeEntries(Slice *input, uint32_t count, Handler &&handler)
+    {
+        K key;
+        V value;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Slice k, v;
+            if (input->empty())
+                return Status::Corruption("log record count mismatch");
+            KType type = static_cast<KType>((*input)[0]);
+            input->remove_prefix(1);
+            if (!GetLengthPrefixedSlice(input, &k) || !Codec<K>::Decode(k, &key))
+                return Status::Corruption("bad log record key");
+            uint64_t expire_at = 0;
+            if (type == KType::kTypeValueWithExpiry)
+            {
+                if (input->size() < 8)
+                    return Status::Corruption("bad log record expiry");
+                expire_at = DecodeFixed64(input->data());
+                input->remove_prefix(8);
+                type = KType::kTypeValue;
+            }
+            if (type == KType::kTypeValue)
+            {
+                if (!GetLengthPrefixedSlice(input, &v) || !Codec<V>::Decode(v, &value))
+                    return Status::Corruption("bad log record value");
+                handler(key, value, type, expire_at);
+            }
+            else if (type == KType::kTypeDelete)
+            {
+                handler(key, V(), type, uint64_t(0));
+            }
+            else
+            {
+                return Status::Corruption("unknown log entry type");
+            }
+        }
+        return Status::OK();
+    }
+}
+
+#endif
@@ -1,5 +1,9 @@
 #ifndef STORAGE_KVDB_UTIL_KVNODE_H_
 #define STORAGE_KVDB_UTIL_KVNODE_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
 namespace kvdb
 {
@@ -7,17 +11,55 @@ namespace kvdb
     {
         kTypeValue = 0x0,
         kTypeDelete = 0x1,
+        // 只出现在日志和有序表文件的编码中，表示value之后还有过期时间。解码后为kTypeValue，过期时间单独保存
+        kTypeValueWithExpiry = 0x2,
     };
 
+    // 每次修改按写入顺序分配的序列号，同一个key的多个版本按序列号从新到旧排列
+    typedef uint64_t SequenceNumber;
+
+    // 序列号占tag的高56位，低8位是KType
+    static const SequenceNumber kMaxSequenceNumber = (1ull << 56) - 1;
+
+    inline uint64_t PackSequenceAndType(SequenceNumber seq, KType type)
+    {
+        return (seq << 8) | static_cast<uint64_t>(type);
+    }
+
+    // expire_at为条目过期的时刻(Env::NowMicros)，0表示永不过期。已经过期的条目对读者等同于删除标记
+    inline bool IsExpired(uint64_t expire_at, uint64_t now) { return expire_at != 0 && expire_at <= now; }
+
+    // 对象在堆上额外占用的字节数，默认为0。缓存的charge和memtable的内存用量都要计入这部分
+    template <typename T>
+    inline size_t HeapUsage(const T & /*x*/) { return 0; }
+
+    // 短字符串保存在对象内部，不占用堆内存
+    inline size_t HeapUsage(const std::string &s)
+    {
+        const char *data = s.data();
+        const char *object = reinterpret_cast<const char *>(&s);
+        if (data >= object && data < object + sizeof(s))
+            return 0;
+        return s.capacity() + 1;
+    }
+
     template <typename K, typename V>
     struct KVnode
     {
         K key;
         V value;
+        // sequence << 8 | type。原地修改value时会换成新的序列号，读线程不加锁读取
+        std::atomic<uint64_t> tag;
+        // 过期时间，0表示永不过期。带过期时间的节点不原地修改
+        const uint64_t expire_at;
+
+        KVnode(K k, V v, KType t, SequenceNumber s, uint64_t e = 0)
+            : key(k), value(v), tag(PackSequenceAndType(s, t)), expire_at(e) {}
 
-        KType type;
-        KVnode(K k, V v, KType t) : key(k), value(v), type(t) {}
+        KType type() const { return static_cast<KType>(tag.load(std::memory_order_acquire) & 0xff); }
+        SequenceNumber sequence() const { return tag.load(std::memory_order_acquire) >> 8; }
+        void SetTag(SequenceNumber s, KType t) { tag.store(PackSequenceAndType(s, t), std::memory_order_release); }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
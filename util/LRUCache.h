@@ -1,39 +1,165 @@
 #ifndef STORAGE_KVDB_UTIL_LRUCACHE_H_
 #define STORAGE_KVDB_UTIL_LRUCACHE_H_
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include "util/KVNode.h"
+#include "util/env.h"
+#include "util/hash.h"
+#include "util/perf_context.h"
+#include "util/swiss_table.h"
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace kvdb
 {
     namespace cache
     {
+        // 缓存中的一个条目。key/value、引用计数和LRU链表指针在同一次分配中，
+        // 缓存本身持有一个引用，每个PinnedHandle再持有一个，计数为0时释放
         template <typename K, typename V>
-        struct LRUNode
+        struct LRUHandle
         {
-            std::shared_ptr<KVnode<K, V>> kvnode_;
+            LRUHandle(const K &k, const V &v, KType t, size_t c = 1, uint64_t e = 0)
+                : key(k), value(v), type(t), charge(c), expire_at(e), refs(1), in_cache(false), policy_state(0),
+                  high_priority(false), next_hash(nullptr), next(nullptr), prev(nullptr) {}
 
-            LRUNode(std::shared_ptr<KVnode<K, V>> x) : kvnode_(x)
+            LRUHandle(const LRUHandle &) = delete;
+            LRUHandle &operator=(const LRUHandle &) = delete;
+
+            void Ref() { refs.fetch_add(1, std::memory_order_relaxed); }
+
+            void Unref()
+            {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    delete this;
+            }
+
+            // 放入缓存之后不再修改，更新时换成新的条目
+            const K key;
+            const V value;
+            const KType type;
+            // 占用的缓存容量
+            const size_t charge;
+            // 过期时间(Env::NowMicros)，0表示永不过期。过期后查找不到，缓存超过容量时先于其他条目淘汰
+            const uint64_t expire_at;
+
+            std::atomic<uint32_t> refs;
+            // 以下由分片锁保护
+            bool in_cache;
+            // 淘汰策略使用的状态
+            uint8_t policy_state;
+            // 放入缓存之前设置，PriorityLRUPolicy优先淘汰低优先级的条目，其他策略忽略
+            bool high_priority;
+            LRUHandle *next_hash;
+            LRUHandle *next;
+            LRUHandle *prev;
+        };
+
+        // 持有一个条目的引用，存在期间条目不会被释放，即使它已经被淘汰或者被新值替换。
+        // 只能移动，析构或Release时释放引用
+        template <typename K, typename V>
+        class PinnedHandle
+        {
+        public:
+            PinnedHandle() : h_(nullptr) {}
+            // 接管h的一个引用
+            explicit PinnedHandle(LRUHandle<K, V> *h) : h_(h) {}
+
+            PinnedHandle(PinnedHandle &&other) noexcept : h_(other.h_) { other.h_ = nullptr; }
+            PinnedHandle &operator=(PinnedHandle &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    Release();
+                    h_ = other.h_;
+                    other.h_ = nullptr;
+                }
+                return *this;
+            }
+
+            PinnedHandle(const PinnedHandle &) = delete;
+            PinnedHandle &operator=(const PinnedHandle &) = delete;
+
+            ~PinnedHandle() { Release(); }
+
+            void Release()
+            {
+                if (h_ != nullptr)
+                {
+                    h_->Unref();
+                    h_ = nullptr;
+                }
+            }
+
+            explicit operator bool() const { return h_ != nullptr; }
+            bool operator==(std::nullptr_t) const { return h_ == nullptr; }
+            bool operator!=(std::nullptr_t) const { return h_ != nullptr; }
+
+            // REQUIRES: 不为空
+            const K &key() const { return h_->key; }
+            const V &value() const { return h_->value; }
+            KType type() const { return h_->type; }
+            uint64_t expire_at() const { return h_->expire_at; }
+            const V &operator*() const { return h_->value; }
+            const V *operator->() const { return &h_->value; }
+
+            LRUHandle<K, V> *get() const { return h_; }
+
+        private:
+            LRUHandle<K, V> *h_;
+        };
+
+        // 条目默认的charge：句柄本身的大小加上key和value在堆上的内存，单位为字节
+        template <typename K, typename V>
+        struct DefaultCharge
+        {
+            size_t operator()(const K &key, const V &value) const
             {
+                return sizeof(LRUHandle<K, V>) + HeapUsage(key) + HeapUsage(value);
             }
-            K &key() { return kvnode_->key; }
-            V &value() { return kvnode_->value; }
-            void SetValue(const V &value) { kvnode_->value = value; }
-            LRUNode *next_hash;
-            LRUNode *next;
-            LRUNode *prev;
+        };
+
+        // 多个缓存共用的容量上限，单位与charge相同。各缓存放入条目时把charge计入共享的用量，
+        // 总用量超过上限时由正在放入条目的分片淘汰自己的条目，直到总用量回到上限以内
+        class CacheBudget
+        {
+        public:
+            explicit CacheBudget(size_t capacity) : capacity_(capacity), usage_(0) {}
+
+            CacheBudget(const CacheBudget &) = delete;
+            CacheBudget &operator=(const CacheBudget &) = delete;
+
+            size_t Capacity() const { return capacity_; }
+            size_t GetUsage() const { return usage_.load(std::memory_order_relaxed); }
+
+            void Charge(size_t charge) { usage_.fetch_add(charge, std::memory_order_relaxed); }
+            void Release(size_t charge) { usage_.fetch_sub(charge, std::memory_order_relaxed); }
+            bool Exceeded() const { return GetUsage() > capacity_; }
+
+        private:
+            const size_t capacity_;
+            std::atomic<size_t> usage_;
         };
 
         template <typename K, typename V>
         class HashTable
         {
-            typedef LRUNode<K, V> Node;
+            typedef LRUHandle<K, V> Node;
 
         private:
             int length_ = 4096;
             int elems_;
             Node **list_;
-            std::hash<K> hasher;
+            TransparentHash<K> hasher;
 
             Node **new_list_;
             int new_length_;
@@ -57,12 +183,13 @@ namespace kvdb
             {
                 if (!rehash_flag)
                     return;
+                PerfCount(&PerfContext::hash_rehash_steps);
 
                 Node *current = list_[rehash_index];
                 while (current != nullptr)
                 {
                     Node *next = current->next_hash;
-                    int index = hasher(current->key()) % new_length_;
+                    int index = hasher(current->key) % new_length_;
                     current->next_hash = new_list_[index];
                     new_list_[index] = current;
                     current = next;
@@ -86,16 +213,33 @@ namespace kvdb
                 for (int i = 0; i < length_; ++i)
                     list_[i] = nullptr;
             };
+            // 节点由LRUCache负责释放，这里只释放桶数组
+            ~HashTable()
+            {
+                delete[] list_;
+                delete[] new_list_;
+            }
+            HashTable(const HashTable &) = delete;
+            HashTable &operator=(const HashTable &) = delete;
 
-            // return nullptr if key is not find in table
-            Node *Find(const K &key)
+            // return nullptr if key is not find in table。
+            // Q为K或者IsTransparentKey<K, Q>成立的类型，如K为std::string时的std::string_view
+            template <typename Q>
+            Node *Find(const Q &key)
             {
                 return *Seek(key);
             };
-            void Insert(Node *x)
+            // 与SwissTable的接口一致，链式哈希表不使用预先计算的hash
+            template <typename Q>
+            Node *Find(const Q &key, size_t /*hash*/) { return Find(key); }
+            template <typename Q>
+            size_t Hash(const Q & /*key*/) const { return 0; }
+            void Prefetch(size_t /*hash*/) const {}
+            // 返回被替换的同key节点，没有时返回nullptr
+            Node *Insert(Node *x)
             {
                 StepRehash();
-                Node **ptr = Seek(x->key());
+                Node **ptr = Seek(x->key);
                 Node *old = *ptr;
 
                 x->next_hash = ((old == nullptr) ? nullptr : old->next_hash);
@@ -106,6 +250,7 @@ namespace kvdb
 
                 if (static_cast<double>(elems_) / length_ > load_factor_threshold && !rehash_flag)
                     StartRehash();
+                return old;
             };
             Node *Remove(const K &key)
             {
@@ -121,200 +266,608 @@ namespace kvdb
             };
 
         private:
-            Node **Seek(const K &key)
+            template <typename Q>
+            Node **Seek(const Q &key)
             {
 
                 int index = hasher(key) % length_;
 
                 Node **ptr = &list_[index];
 
-                while (*ptr != nullptr && (*ptr)->key() != key)
+                while (*ptr != nullptr && (*ptr)->key != key)
                     ptr = &(*ptr)->next_hash;
 
                 if (*ptr == nullptr && rehash_flag)
                 {
                     index = hasher(key) % new_length_;
                     ptr = &new_list_[index];
-                    while (*ptr != nullptr && (*ptr)->key() != key)
+                    while (*ptr != nullptr && (*ptr)->key != key)
                         ptr = &(*ptr)->next_hash;
                 }
                 return ptr;
             }
         };
 
+        // 条目的双向链表，头部是最新的，同时记录链表中条目的charge之和
         template <typename K, typename V>
-        class LRUCache
+        class HandleList
         {
-            typedef LRUNode<K, V> Node;
-            typedef HashTable<K, V> Table;
-            typedef std::shared_ptr<KVnode<K, V>> kvnode;
+            typedef LRUHandle<K, V> Node;
 
-        private:
-            Node *st_;
-            Node *ed_;
-            Table table_;
-            const int capacity_;
-            int size_;
+        public:
+            HandleList() : head_(nullptr), tail_(nullptr), charge_(0), size_(0) {}
 
-            void MoveNodeToFront(Node *x);
-            inline Node *NewNode(kvnode node) { return new Node(node); }
-            void Remove(Node *x);
+            HandleList(const HandleList &) = delete;
+            HandleList &operator=(const HandleList &) = delete;
 
-        public:
-            LRUCache(int capacity) : capacity_(capacity), st_(nullptr), ed_(nullptr), table_(), size_(0)
+            void PushFront(Node *x)
             {
-                assert(capacity_ > 0);
-            };
-            ~LRUCache()
+                x->prev = nullptr;
+                x->next = head_;
+                if (head_ != nullptr)
+                    head_->prev = x;
+                else
+                    tail_ = x;
+                head_ = x;
+                charge_ += x->charge;
+                ++size_;
+            }
+
+            void Remove(Node *x)
             {
-                while (st_ != nullptr)
+                if (x == head_)
+                    head_ = x->next;
+                else
+                    x->prev->next = x->next;
+
+                if (x == tail_)
+                    tail_ = x->prev;
+                else
+                    x->next->prev = x->prev;
+                charge_ -= x->charge;
+                --size_;
+            }
+
+            void MoveToFront(Node *x)
+            {
+                if (x == head_)
+                    return;
+                Remove(x);
+                PushFront(x);
+            }
+
+            Node *Front() const { return head_; }
+            Node *Back() const { return tail_; }
+            size_t Charge() const { return charge_; }
+            size_t Size() const { return size_; }
+
+            // fn可以释放条目
+            template <typename Fn>
+            void ForEach(Fn &&fn)
+            {
+                for (Node *x = head_; x != nullptr;)
                 {
-                    Node *x = st_->next;
-                    delete st_;
-                    st_ = x;
+                    Node *next = x->next;
+                    fn(x);
+                    x = next;
                 }
             }
 
-            bool Insert(const K &key, const V &value);
-            void Insert(kvnode node);
-            kvnode Get(const K &key);
-            bool Contains(const K &key);
-            void Remove(const K &key);
+        private:
+            Node *head_;
+            Node *tail_;
+            size_t charge_;
+            size_t size_;
         };
 
+        // 淘汰策略决定条目的淘汰顺序，所有方法都在分片锁内调用：
+        //   Insert(x)   新条目放入缓存
+        //   Touch(x)    缓存命中
+        //   Miss(key)   缓存未命中，key可能是K，也可能是可以代替K查找的类型(见IsTransparentKey)，要写成模板
+        //   Erase(x)    条目被删除、被新值替换或被淘汰
+        //   Victim(x)   缓存超过容量时返回下一个要淘汰的条目，x是刚放入的条目，返回nullptr时停止淘汰
+        //   ForEach(fn) 遍历缓存中的所有条目
+        // 其他策略见util/cache_policy.h
+
+        // 淘汰最久没有访问的条目
         template <typename K, typename V>
-        void LRUCache<K, V>::MoveNodeToFront(Node *x)
+        class LRUPolicy
         {
-            if (x == st_)
-                return;
+            typedef LRUHandle<K, V> Node;
 
-            if (x == ed_)
+        public:
+            explicit LRUPolicy(size_t /*capacity*/) {}
+
+            void Insert(Node *x) { list_.PushFront(x); }
+            void Touch(Node *x) { list_.MoveToFront(x); }
+            template <typename Q>
+            void Miss(const Q & /*key*/) {}
+            void Erase(Node *x) { list_.Remove(x); }
+            // 不淘汰刚放入的条目，即使它本身超过了容量
+            Node *Victim(Node *x)
             {
-                ed_ = x->prev;
-                ed_->next = nullptr;
+                Node *victim = list_.Back();
+                return victim == x ? nullptr : victim;
             }
-            else
+
+            template <typename Fn>
+            void ForEach(Fn &&fn) { list_.ForEach(fn); }
+
+        private:
+            HandleList<K, V> list_;
+        };
+
+        // 单线程的缓存分片，容量按条目的charge计算。由ShardedLRUCache加锁。
+        // 有budget时条目的charge同时计入共享的budget，超过budget的上限时也要淘汰。
+        // Policy为淘汰策略，默认LRU；Index为key到条目的索引，默认为开放寻址的SwissTable，也可以换成链式的HashTable
+        template <typename K, typename V, typename Policy = LRUPolicy<K, V>,
+                  typename Index = SwissTable<K, LRUHandle<K, V>>>
+        class LRUCache
+        {
+            typedef LRUHandle<K, V> Node;
+            typedef Index Table;
+
+        private:
+            Table table_;
+            Policy policy_;
+            const size_t capacity_;
+            size_t usage_;
+            CacheBudget *const budget_;
+            // 判断条目是否过期的时钟，只在缓存中有带过期时间的条目时读取
+            Env *const clock_;
+            // 带过期时间的条目按过期时间排列，超过容量时先从头部淘汰已经过期的
+            std::set<std::pair<uint64_t, Node *>> expiring_;
+            uint64_t hits_;
+            uint64_t misses_;
+
+            // x已经从哈希表中移除，交给淘汰策略移除并释放缓存的引用
+            void FinishErase(Node *x);
+
+        public:
+            // 有budget时capacity只用来确定淘汰策略的参数，分片本身不限制容量。clock用于判断条目是否过期
+            explicit LRUCache(size_t capacity, CacheBudget *budget = nullptr, Env *clock = Env::Default())
+                : table_(), policy_(capacity), capacity_(budget == nullptr ? capacity : std::numeric_limits<size_t>::max()),
+                  usage_(0), budget_(budget), clock_(clock), hits_(0), misses_(0)
             {
-                x->prev->next = x->next;
-                x->next->prev = x->prev;
+                assert(capacity > 0);
+            };
+            ~LRUCache()
+            {
+                // 调用方持有的条目在释放最后一个引用时删除
+                policy_.ForEach([](Node *x)
+                                {
+                                    x->in_cache = false;
+                                    x->Unref(); });
+                if (budget_ != nullptr)
+                    budget_->Release(usage_);
             }
-            x->prev = nullptr;
-            x->next = st_;
-            st_->prev = x;
-            st_ = x;
+
+            LRUCache(const LRUCache &) = delete;
+            LRUCache &operator=(const LRUCache &) = delete;
+
+            // 缓存中存在key时换成新值的条目并返回true，expire_at为新值的过期时间
+            bool Insert(const K &key, const V &value, size_t charge, uint64_t expire_at = 0);
+            // 放入缓存，接管调用方对node的引用。替换同key的旧条目
+            void Insert(Node *node);
+            // 返回增加了一个引用的条目，不存在或已经过期时返回nullptr，过期的条目同时被删除。
+            // 查找类的方法中Q为K，或者IsTransparentKey<K, Q>成立的类型(K为std::string时的std::string_view)
+            template <typename Q>
+            Node *Lookup(const Q &key) { return Lookup(key, table_.Hash(key)); }
+            // hash为Hash(key)的结果，批量查找时先对所有key调用Prefetch，再逐个Lookup
+            template <typename Q>
+            Node *Lookup(const Q &key, size_t hash);
+            template <typename Q>
+            size_t Hash(const Q &key) const { return table_.Hash(key); }
+            void Prefetch(size_t hash) const { table_.Prefetch(hash); }
+            template <typename Q>
+            bool Contains(const Q &key) { return table_.Find(key) != nullptr; }
+            template <typename Q>
+            bool Contains(const Q &key, size_t hash) { return table_.Find(key, hash) != nullptr; }
+            void Remove(const K &key);
+            // 缓存中所有条目的charge之和
+            size_t GetUsage() const { return usage_; }
+            // 缓存中正被调用方引用的条目的charge之和
+            size_t GetPinnedUsage();
+
+            // Lookup的命中和未命中次数
+            uint64_t Hits() const { return hits_; }
+            uint64_t Misses() const { return misses_; }
+            void ResetStats() { hits_ = misses_ = 0; }
+        };
+
+        template <typename K, typename V, typename Policy, typename Index>
+        void LRUCache<K, V, Policy, Index>::FinishErase(Node *x)
+        {
+            assert(x->in_cache);
+            policy_.Erase(x);
+            if (x->expire_at != 0)
+                expiring_.erase(std::make_pair(x->expire_at, x));
+            x->in_cache = false;
+            usage_ -= x->charge;
+            if (budget_ != nullptr)
+                budget_->Release(x->charge);
+            x->Unref();
         }
 
-        template <typename K, typename V>
-        void LRUCache<K, V>::Remove(Node *x)
+        // 在Table中调用，缓存内不一定有该key
+        template <typename K, typename V, typename Policy, typename Index>
+        void LRUCache<K, V, Policy, Index>::Remove(const K &key)
         {
-            if (x == nullptr)
-                return;
+            Node *x = table_.Remove(key);
+            if (x != nullptr)
+                FinishErase(x);
+        }
+
+        // 只在Table中的insert内调用。条目可能正被读者引用，不能就地修改
+        template <typename K, typename V, typename Policy, typename Index>
+        bool LRUCache<K, V, Policy, Index>::Insert(const K &key, const V &value, size_t charge, uint64_t expire_at)
+        {
+            Node *old = table_.Find(key);
+            if (old == nullptr)
+                return false;
+            Insert(new Node(key, value, KType::kTypeValue, charge, expire_at));
+            return true;
+        }
 
-            if (x == st_)
+        template <typename K, typename V, typename Policy, typename Index>
+        void LRUCache<K, V, Policy, Index>::Insert(Node *x)
+        {
+            x->in_cache = true;
+            usage_ += x->charge;
+            if (budget_ != nullptr)
+                budget_->Charge(x->charge);
+            Node *old = table_.Insert(x);
+            if (old != nullptr)
+                FinishErase(old);
+            policy_.Insert(x);
+            if (x->expire_at != 0)
+                expiring_.emplace(x->expire_at, x);
+
+            uint64_t now = 0;
+            while (usage_ > capacity_ || (budget_ != nullptr && budget_->Exceeded()))
             {
-                st_ = x->next;
+                // 已经过期的条目不会再被读到，先于淘汰策略选出的条目淘汰
+                Node *victim = nullptr;
+                if (!expiring_.empty())
+                {
+                    if (now == 0)
+                        now = clock_->NowMicros();
+                    const std::pair<uint64_t, Node *> &first = *expiring_.begin();
+                    if (IsExpired(first.first, now) && first.second != x)
+                        victim = first.second;
+                }
+                if (victim == nullptr)
+                    victim = policy_.Victim(x);
+                if (victim == nullptr)
+                    break;
+                table_.Remove(victim->key);
+                FinishErase(victim);
             }
-            else if (x == ed_)
+        }
+
+        template <typename K, typename V, typename Policy, typename Index>
+        template <typename Q>
+        typename LRUCache<K, V, Policy, Index>::Node *LRUCache<K, V, Policy, Index>::Lookup(const Q &key, size_t hash)
+        {
+            Node *x = table_.Find(key, hash);
+            if (x != nullptr && x->expire_at != 0 && IsExpired(x->expire_at, clock_->NowMicros()))
             {
-                ed_ = x->prev;
-                if (ed_ != nullptr)
-                    ed_->next = nullptr;
+                table_.Remove(x->key);
+                FinishErase(x);
+                x = nullptr;
             }
-            else
+            if (x == nullptr)
             {
-                x->next->prev = x->prev;
-                x->prev->next = x->next;
+                ++misses_;
+                policy_.Miss(key);
+                return nullptr;
             }
-
-            delete table_.Remove(x->key());
+            ++hits_;
+            policy_.Touch(x);
+            x->Ref();
+            return x;
         }
 
-        // 在Table中调用，缓存内不一定有该key
-        template <typename K, typename V>
-        void LRUCache<K, V>::Remove(const K &key)
+        template <typename K, typename V, typename Policy, typename Index>
+        size_t LRUCache<K, V, Policy, Index>::GetPinnedUsage()
         {
-            Node *x = table_.Find(key);
-            Remove(x);
+            // 缓存本身持有一个引用
+            size_t pinned = 0;
+            policy_.ForEach([&pinned](Node *x)
+                            {
+                                if (x->refs.load(std::memory_order_relaxed) > 1)
+                                    pinned += x->charge; });
+            return pinned;
         }
 
-        // 只在Table中的insert内调用，判断缓存是否持有kvnode
-        template <typename K, typename V>
-        bool
-        LRUCache<K, V>::Insert(const K &key, const V &value)
+        // 命中率统计
+        struct CacheStats
         {
-            Node *x = table_.Find(key);
+            uint64_t hits = 0;
+            uint64_t misses = 0;
 
-            if (x != nullptr)
+            double HitRatio() const
+            {
+                return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+            }
+        };
+
+        // 把keyspace按hash高位分成2^N个分片，每个分片有自己的锁、索引和淘汰策略，
+        // 不同分片上的操作互不阻塞
+        template <typename K, typename V, typename Policy = LRUPolicy<K, V>,
+                  typename Index = SwissTable<K, LRUHandle<K, V>>>
+        class ShardedLRUCache
+        {
+            typedef LRUHandle<K, V> Node;
+
+        public:
+            // 每个分片至少的容量(字节)，分片太小时LRU淘汰会明显偏离全局LRU
+            static const size_t kMinShardCapacity = 512 * 1024;
+            static const int kMaxShardBits = 6;
+
+            // capacity为所有条目charge之和的上限，num_shard_bits < 0 时根据capacity自动选择。
+            // budget不为空时与其他缓存共用budget的容量，capacity被忽略。clock用于判断条目是否过期
+            explicit ShardedLRUCache(size_t capacity, int num_shard_bits = -1,
+                                     std::shared_ptr<CacheBudget> budget = nullptr, Env *clock = Env::Default())
+                : budget_(std::move(budget))
+            {
+                if (budget_ != nullptr)
+                    capacity = budget_->Capacity();
+                shard_bits_ = num_shard_bits < 0 ? DefaultShardBits(capacity) : num_shard_bits;
+                assert(capacity > 0);
+                assert(shard_bits_ >= 0 && shard_bits_ < 32);
+                int num_shards = 1 << shard_bits_;
+                size_t per_shard = (capacity + num_shards - 1) / num_shards;
+                shards_.reserve(num_shards);
+                for (int i = 0; i < num_shards; ++i)
+                    shards_.emplace_back(new Shard(per_shard, budget_.get(), clock));
+            }
+
+            ShardedLRUCache(const ShardedLRUCache &) = delete;
+            ShardedLRUCache &operator=(const ShardedLRUCache &) = delete;
+
+            // 缓存中存在key时换成新值并返回true，charge和expire_at为新值的charge和过期时间
+            bool Insert(const K &key, const V &value, size_t charge, uint64_t expire_at = 0)
             {
+                Shard *shard = GetShard(key);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                ++shard->writes;
+                return shard->cache.Insert(key, value, charge, expire_at);
+            }
+
+            // 接管调用方对node的引用
+            void Insert(Node *node)
+            {
+                Shard *shard = GetShard(node->key);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                ++shard->writes;
+                shard->cache.Insert(node);
+            }
 
-                if (x->kvnode_.use_count() == 1)
+            // Q为K，或者IsTransparentKey<K, Q>成立的类型，K为std::string时可以用std::string_view查找，
+            // 不需要构造临时的std::string
+            template <typename Q>
+            PinnedHandle<K, V> Get(const Q &key)
+            {
+                Shard *shard = GetShard(key);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                return PinnedHandle<K, V>(shard->cache.Lookup(key));
+            }
+
+            // 未命中时在分片锁外调用load()获取条目并放入缓存，load返回nullptr时不缓存。
+            // load返回的条目引用计数为1，归缓存所有。加载可能要读磁盘，不能阻塞同一分片上的其他读写。
+            // 加载期间分片被Insert/Remove修改过时，加载的条目可能已经过期，只返回给调用方而不放入缓存
+            template <typename Q, typename Loader>
+            PinnedHandle<K, V> GetOrLoad(const Q &key, Loader &&load)
+            {
+                Shard *shard = GetShard(key);
+                uint64_t writes;
                 {
-                    // 内存里只有缓存指向该数据，证明该数据已经持久化应该释放
-                    Remove(x);
-                    return false;
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    Node *x = shard->cache.Lookup(key);
+                    if (x != nullptr)
+                        return PinnedHandle<K, V>(x);
+                    writes = shard->writes;
                 }
-                else
+
+                PinnedHandle<K, V> handle(load());
+                if (handle != nullptr)
                 {
-                    // 内存中memtable也持有该数据，直接修改即可
-                    x->SetValue(value);
-                    MoveNodeToFront(x);
-                    return true;
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    // 其他读者已经放入缓存时不再替换
+                    if (shard->writes == writes && !shard->cache.Contains(key))
+                    {
+                        handle.get()->Ref();
+                        shard->cache.Insert(handle.get());
+                    }
                 }
+                return handle;
             }
-            return false;
-        }
 
-        // 只在Table的Get调用，调用时说明第一次在缓存get失败，一定增加新kvnode
-        template <typename K, typename V>
-        void LRUCache<K, V>::Insert(kvnode node)
-        {
+            // 批量的GetOrLoad，handles[i]对应keys[i]，load返回nullptr的key对应的句柄为空。
+            // 按分片分组查找，每个分片只加一次锁，并在查找前预取所有key的索引槽位。
+            // 未命中的key按在keys中的顺序组成一批，在分片锁外调用一次load(miss_keys, n, nodes)，
+            // load把每个key的条目(引用计数为1)写入nodes[i]，没有时写入nullptr。
+            // 分片在查找之后被Insert/Remove修改过时，加载的条目可能已经过期，只返回给调用方而不放入缓存
+            template <typename BatchLoader>
+            void MultiGetOrLoad(const K *const *keys, size_t n, PinnedHandle<K, V> *handles, BatchLoader &&load)
+            {
+                // 按分片排列key的下标，同一分片内保持原来的顺序
+                std::vector<uint32_t> shard_of(n);
+                std::vector<size_t> start(shards_.size() + 1, 0);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    shard_of[i] = ShardIndex(*keys[i]);
+                    ++start[shard_of[i] + 1];
+                }
+                for (size_t s = 0; s < shards_.size(); ++s)
+                    start[s + 1] += start[s];
+                std::vector<size_t> order(n);
+                {
+                    std::vector<size_t> pos(start.begin(), start.end() - 1);
+                    for (size_t i = 0; i < n; ++i)
+                        order[pos[shard_of[i]]++] = i;
+                }
 
-            ++size_;
-            Node *x = NewNode(node);
+                std::vector<size_t> hashes(n);
+                std::vector<uint64_t> writes(n);
+                std::vector<size_t> missing;
+                for (size_t s = 0; s < shards_.size(); ++s)
+                {
+                    if (start[s] == start[s + 1])
+                        continue;
+                    Shard *shard = shards_[s].get();
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    for (size_t j = start[s]; j < start[s + 1]; ++j)
+                    {
+                        hashes[order[j]] = shard->cache.Hash(*keys[order[j]]);
+                        shard->cache.Prefetch(hashes[order[j]]);
+                    }
+                    for (size_t j = start[s]; j < start[s + 1]; ++j)
+                    {
+                        const size_t i = order[j];
+                        handles[i] = PinnedHandle<K, V>(shard->cache.Lookup(*keys[i], hashes[i]));
+                        if (handles[i] == nullptr)
+                        {
+                            missing.push_back(i);
+                            writes[i] = shard->writes;
+                        }
+                    }
+                }
+                if (missing.empty())
+                    return;
 
-            table_.Insert(x);
+                // missing按分片排列，load需要按keys中的顺序
+                std::vector<size_t> by_key(missing);
+                std::sort(by_key.begin(), by_key.end());
+                std::vector<const K *> miss_keys(by_key.size());
+                for (size_t j = 0; j < by_key.size(); ++j)
+                    miss_keys[j] = keys[by_key[j]];
+                std::vector<Node *> nodes(by_key.size(), nullptr);
+                load(miss_keys.data(), miss_keys.size(), nodes.data());
+                for (size_t j = 0; j < by_key.size(); ++j)
+                    handles[by_key[j]] = PinnedHandle<K, V>(nodes[j]);
+
+                // 按分片放入缓存，每个分片加一次锁
+                for (size_t j = 0; j < missing.size();)
+                {
+                    const uint32_t s = shard_of[missing[j]];
+                    Shard *shard = shards_[s].get();
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    for (; j < missing.size() && shard_of[missing[j]] == s; ++j)
+                    {
+                        const size_t i = missing[j];
+                        Node *x = handles[i].get();
+                        // 同一批中重复的key，或者其他读者已经放入缓存时不再替换
+                        if (x == nullptr || shard->writes != writes[i] || shard->cache.Contains(*keys[i], hashes[i]))
+                            continue;
+                        x->Ref();
+                        shard->cache.Insert(x);
+                    }
+                }
+            }
 
-            if (st_ == nullptr)
+            template <typename Q>
+            bool Contains(const Q &key)
             {
-                st_ = x;
-                ed_ = x;
-                st_->next = nullptr;
+                Shard *shard = GetShard(key);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                return shard->cache.Contains(key);
             }
-            else
+
+            void Remove(const K &key)
             {
-                x->prev = nullptr;
-                x->next = st_;
-                st_->prev = x;
-                st_ = x;
+                Shard *shard = GetShard(key);
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                ++shard->writes;
+                shard->cache.Remove(key);
             }
 
-            if (size_ > capacity_)
+            int NumShards() const { return static_cast<int>(shards_.size()); }
+
+            // 缓存中所有条目的charge之和
+            size_t GetUsage()
             {
+                size_t total = 0;
+                for (auto &shard : shards_)
+                {
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    total += shard->cache.GetUsage();
+                }
+                return total;
+            }
 
-                Remove(ed_);
-                --size_;
+            // 缓存中正被PinnedHandle引用的条目的charge之和。需要遍历所有条目，只用于统计
+            size_t GetPinnedUsage()
+            {
+                size_t total = 0;
+                for (auto &shard : shards_)
+                {
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    total += shard->cache.GetPinnedUsage();
+                }
+                return total;
             }
-        }
 
-        // key must in cache
-        template <typename K, typename V>
-        typename LRUCache<K, V>::kvnode LRUCache<K, V>::Get(const K &key)
-        {
-            Node *x = table_.Find(key);
+            CacheStats GetStats()
+            {
+                CacheStats stats;
+                for (auto &shard : shards_)
+                {
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    stats.hits += shard->cache.Hits();
+                    stats.misses += shard->cache.Misses();
+                }
+                return stats;
+            }
 
-            if (x == nullptr)
-                return nullptr;
-            MoveNodeToFront(x);
-            return x->kvnode_;
-        }
+            void ResetStats()
+            {
+                for (auto &shard : shards_)
+                {
+                    std::lock_guard<std::mutex> lock(shard->mutex);
+                    shard->cache.ResetStats();
+                }
+            }
 
-        template <typename K, typename V>
-        bool LRUCache<K, V>::Contains(const K &key)
-        {
-            Node *x = table_.Find(key);
+        private:
+            // 按cache line对齐，避免相邻分片的锁产生伪共享
+            struct alignas(64) Shard
+            {
+                Shard(size_t capacity, CacheBudget *budget, Env *clock) : writes(0), cache(capacity, budget, clock) {}
+                std::mutex mutex;
+                // Insert/Remove的次数，GetOrLoad和MultiGetOrLoad用来判断加载期间分片是否被修改过
+                uint64_t writes;
+                LRUCache<K, V, Policy, Index> cache;
+            };
 
-            return x != nullptr;
-        }
+            static int DefaultShardBits(size_t capacity)
+            {
+                int bits = 0;
+                while (bits < kMaxShardBits && (capacity >> (bits + 1)) >= kMinShardCapacity)
+                    ++bits;
+                return bits;
+            }
+
+            template <typename Q>
+            Shard *GetShard(const Q &key) { return shards_[ShardIndex(key)].get(); }
+
+            template <typename Q>
+            uint32_t ShardIndex(const Q &key) const
+            {
+                if (shard_bits_ == 0)
+                    return 0;
+                // 先打散再取高位，分片内的索引使用低位，两者互不相关
+                uint64_t h = Mix64(static_cast<uint64_t>(hasher_(key)));
+                return static_cast<uint32_t>(h >> (64 - shard_bits_));
+            }
+
+            // 声明在shards_之前，析构时晚于shards_，分片析构时还要把用量还给budget
+            std::shared_ptr<CacheBudget> budget_;
+            int shard_bits_;
+            TransparentHash<K> hasher_;
+            std::vector<std::unique_ptr<Shard>> shards_;
+        };
     }
 }
 
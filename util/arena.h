@@ -0,0 +1,139 @@
+#ifndef STORAGE_KVDB_UTIL_ARENA_H_
+#define STORAGE_KVDB_UTIL_ARENA_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kvdb
+{
+    // Arena 以块为单位向系统申请内存，再把块切成小段分配出去。
+    // 分配出去的内存不会单独释放，Arena 析构时一次性归还所有块。
+    class Arena
+    {
+    public:
+        Arena() : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        ~Arena()
+        {
+            for (size_t i = 0; i < blocks_.size(); i++)
+                delete[] blocks_[i];
+        }
+
+        // 返回一段大小为bytes的新内存
+        char *Allocate(size_t bytes);
+
+        // 与Allocate相同，但保证按指针大小(至少8字节)对齐
+        char *AllocateAligned(size_t bytes);
+
+        // 线程安全版本的AllocateAligned，供多个写线程同时分配。
+        // 同一个Arena不能在并发分配的同时调用非Concurrent的分配函数
+        char *AllocateAlignedConcurrent(size_t bytes);
+
+        // 估计Arena已占用的总内存(包括已分配块中尚未使用的部分)
+        size_t MemoryUsage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+        static const size_t kAlign = (sizeof(void *) > 8) ? sizeof(void *) : 8;
+
+    private:
+        static const size_t kBlockSize = 4096;
+
+        char *AllocateFallback(size_t bytes);
+        char *AllocateNewBlock(size_t block_bytes);
+
+        // 当前块的分配状态
+        char *alloc_ptr_;
+        size_t alloc_bytes_remaining_;
+
+        // 所有通过new[]申请的块
+        std::vector<char *> blocks_;
+
+        // 总内存占用，允许其他线程无锁读取
+        std::atomic<size_t> memory_usage_;
+
+        // 保护并发分配，临界区只有几条指令，所以用自旋锁
+        std::atomic_flag alloc_lock_ = ATOMIC_FLAG_INIT;
+    };
+
+    inline char *Arena::Allocate(size_t bytes)
+    {
+        // 不允许0字节分配，语义不明确
+        assert(bytes > 0);
+        if (bytes <= alloc_bytes_remaining_)
+        {
+            char *result = alloc_ptr_;
+            alloc_ptr_ += bytes;
+            alloc_bytes_remaining_ -= bytes;
+            return result;
+        }
+        return AllocateFallback(bytes);
+    }
+
+    inline char *Arena::AllocateAligned(size_t bytes)
+    {
+        static_assert((kAlign & (kAlign - 1)) == 0, "Pointer size should be a power of 2");
+        size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (kAlign - 1);
+        size_t slop = (current_mod == 0 ? 0 : kAlign - current_mod);
+        size_t needed = bytes + slop;
+        char *result;
+        if (needed <= alloc_bytes_remaining_)
+        {
+            result = alloc_ptr_ + slop;
+            alloc_ptr_ += needed;
+            alloc_bytes_remaining_ -= needed;
+        }
+        else
+        {
+            // AllocateFallback返回的内存总是对齐的
+            result = AllocateFallback(bytes);
+        }
+        assert((reinterpret_cast<uintptr_t>(result) & (kAlign - 1)) == 0);
+        return result;
+    }
+
+    inline char *Arena::AllocateAlignedConcurrent(size_t bytes)
+    {
+        while (alloc_lock_.test_and_set(std::memory_order_acquire))
+        {
+            // 持锁线程可能被调度走，让出CPU避免空转
+            std::this_thread::yield();
+        }
+        char *result = AllocateAligned(bytes);
+        alloc_lock_.clear(std::memory_order_release);
+        return result;
+    }
+
+    inline char *Arena::AllocateFallback(size_t bytes)
+    {
+        if (bytes > kBlockSize / 4)
+        {
+            // 大对象单独分配一个块，避免浪费当前块的剩余空间
+            return AllocateNewBlock(bytes);
+        }
+
+        // 丢弃当前块剩余的空间
+        alloc_ptr_ = AllocateNewBlock(kBlockSize);
+        alloc_bytes_remaining_ = kBlockSize;
+
+        char *result = alloc_ptr_;
+        alloc_ptr_ += bytes;
+        alloc_bytes_remaining_ -= bytes;
+        return result;
+    }
+
+    inline char *Arena::AllocateNewBlock(size_t block_bytes)
+    {
+        char *result = new char[block_bytes];
+        blocks_.push_back(result);
+        memory_usage_.fetch_add(block_bytes + sizeof(char *), std::memory_order_relaxed);
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "util/arena.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+
+TEST(ArenaTest, Empty)
+{
+    Arena arena;
+    EXPECT_EQ(arena.MemoryUsage(), 0u);
+}
+
+TEST(ArenaTest, Simple)
+{
+    std::vector<std::pair<size_t, char *>> allocated;
+    Arena arena;
+    const int N = 100000;
+    size_t bytes = 0;
+    Random rnd(301);
+    for (int i = 0; i < N; i++)
+    {
+        size_t s;
+        if (i % (N / 10) == 0)
+        {
+            s = i;
+        }
+        else
+        {
+            s = rnd.OneIn(4000)
+                    ? rnd.Uniform(6000)
+                    : (rnd.OneIn(10) ? rnd.Uniform(100) : rnd.Uniform(20));
+        }
+        if (s == 0)
+        {
+            // Arena不允许0字节分配
+            s = 1;
+        }
+        char *r;
+        if (rnd.OneIn(10))
+        {
+            r = arena.AllocateAligned(s);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(r) & (Arena::kAlign - 1), 0u);
+        }
+        else
+        {
+            r = arena.Allocate(s);
+        }
+
+        for (size_t b = 0; b < s; b++)
+        {
+            // 按位置填充，后面检查是否被其他分配覆盖
+            r[b] = i % 256;
+        }
+        bytes += s;
+        allocated.push_back(std::make_pair(s, r));
+        ASSERT_GE(arena.MemoryUsage(), bytes);
+        if (i > N / 10)
+        {
+            ASSERT_LE(arena.MemoryUsage(), bytes * 1.10);
+        }
+    }
+    for (size_t i = 0; i < allocated.size(); i++)
+    {
+        size_t num_bytes = allocated[i].first;
+        const char *p = allocated[i].second;
+        for (size_t b = 0; b < num_bytes; b++)
+        {
+            ASSERT_EQ(int(p[b]) & 0xff, i % 256);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
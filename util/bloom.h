@@ -0,0 +1,173 @@
+#ifndef STORAGE_KVDB_UTIL_BLOOM_H_
+#define STORAGE_KVDB_UTIL_BLOOM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util/hash.h"
+#include "util/slice.h"
+
+namespace kvdb
+{
+    inline uint32_t BloomHash(const Slice &key)
+    {
+        return Hash(key.data(), key.size(), 0xbc9f1d34);
+    }
+
+    // 布隆过滤器：对不存在的key大概率返回false，对存在的key一定返回true。
+    // 每个key占用bits_per_key位，bits_per_key=10时误判率约1%。
+    // 用一个哈希值加上增量模拟k个哈希函数(Kirsch-Mitzenmacher)，只需要计算一次哈希
+    class BloomFilterPolicy
+    {
+    public:
+        explicit BloomFilterPolicy(int bits_per_key) : bits_per_key_(bits_per_key)
+        {
+            // 最优的k = bits_per_key * ln(2)，向下取整可以少访问一些内存
+            k_ = static_cast<size_t>(bits_per_key * 0.69);
+            if (k_ < 1)
+                k_ = 1;
+            if (k_ > 30)
+                k_ = 30;
+        }
+
+        // 写入有序表文件的metaindex，格式不兼容的修改需要换一个名字
+        static const char *Name() { return "kvdb.BuiltinBloomFilter"; }
+
+        // 根据n个key的BloomHash生成过滤器，追加到*dst
+        void CreateFilter(const uint32_t *hashes, size_t n, std::string *dst) const
+        {
+            // key很少时误判率会很高，至少使用64位
+            size_t bits = n * bits_per_key_;
+            if (bits < 64)
+                bits = 64;
+            size_t bytes = (bits + 7) / 8;
+            bits = bytes * 8;
+
+            const size_t init_size = dst->size();
+            dst->resize(init_size + bytes, 0);
+            dst->push_back(static_cast<char>(k_)); // 记录k，读取时不依赖当前的配置
+            char *array = &(*dst)[init_size];
+            for (size_t i = 0; i < n; i++)
+            {
+                uint32_t h = hashes[i];
+                const uint32_t delta = (h >> 17) | (h << 15); // 循环右移17位
+                for (size_t j = 0; j < k_; j++)
+                {
+                    const uint32_t bitpos = h % bits;
+                    array[bitpos / 8] |= (1 << (bitpos % 8));
+                    h += delta;
+                }
+            }
+        }
+
+        // hash为BloomHash(key)
+        static bool KeyMayMatch(uint32_t hash, const Slice &bloom_filter)
+        {
+            const size_t len = bloom_filter.size();
+            if (len < 2)
+                return false;
+
+            const char *array = bloom_filter.data();
+            const size_t bits = (len - 1) * 8;
+
+            const size_t k = static_cast<uint8_t>(array[len - 1]);
+            if (k > 30)
+            {
+                // 留给以后的编码方式，当作匹配处理
+                return true;
+            }
+
+            uint32_t h = hash;
+            const uint32_t delta = (h >> 17) | (h << 15);
+            for (size_t j = 0; j < k; j++)
+            {
+                const uint32_t bitpos = h % bits;
+                if ((array[bitpos / 8] & (1 << (bitpos % 8))) == 0)
+                    return false;
+                h += delta;
+            }
+            return true;
+        }
+
+        static bool KeyMayMatch(const Slice &key, const Slice &bloom_filter)
+        {
+            return KeyMayMatch(BloomHash(key), bloom_filter);
+        }
+
+    private:
+        size_t bits_per_key_;
+        size_t k_;
+    };
+
+    // 内存中大小固定的布隆过滤器，边写入边查询，用于memtable。
+    // 一个hash的所有探测位都落在同一个64字节的块内，查询最多访问一条缓存行。
+    // Add可以被多个线程同时调用，也可以与MayContain并发
+    class DynamicBloom
+    {
+    public:
+        // total_bits向上取整到512的倍数
+        explicit DynamicBloom(size_t total_bits, int num_probes = 6)
+            : num_blocks_((total_bits + kBlockBits - 1) / kBlockBits), num_probes_(num_probes)
+        {
+            if (num_blocks_ == 0)
+                num_blocks_ = 1;
+            data_.reset(new std::atomic<uint64_t>[num_blocks_ * kWordsPerBlock]);
+            for (size_t i = 0; i < num_blocks_ * kWordsPerBlock; i++)
+                data_[i].store(0, std::memory_order_relaxed);
+        }
+
+        DynamicBloom(const DynamicBloom &) = delete;
+        DynamicBloom &operator=(const DynamicBloom &) = delete;
+
+        // hash为BloomHash(key)
+        void Add(uint32_t hash)
+        {
+            std::atomic<uint64_t> *block = Block(hash);
+            uint32_t h = hash * 0x9e3779b9u;
+            const uint32_t delta = (h >> 17) | (h << 15);
+            for (int i = 0; i < num_probes_; i++, h += delta)
+            {
+                const uint64_t mask = uint64_t(1) << (h % 64);
+                std::atomic<uint64_t> &word = block[(h / 64) % kWordsPerBlock];
+                // 大部分位已经置上，先读一次可以避免无谓的原子写
+                if ((word.load(std::memory_order_relaxed) & mask) == 0)
+                    word.fetch_or(mask, std::memory_order_relaxed);
+            }
+        }
+
+        bool MayContain(uint32_t hash) const
+        {
+            const std::atomic<uint64_t> *block = Block(hash);
+            uint32_t h = hash * 0x9e3779b9u;
+            const uint32_t delta = (h >> 17) | (h << 15);
+            for (int i = 0; i < num_probes_; i++, h += delta)
+            {
+                if ((block[(h / 64) % kWordsPerBlock].load(std::memory_order_relaxed) & (uint64_t(1) << (h % 64))) == 0)
+                    return false;
+            }
+            return true;
+        }
+
+        size_t MemoryUsage() const { return num_blocks_ * kWordsPerBlock * sizeof(uint64_t); }
+
+    private:
+        static const size_t kBlockBits = 512;
+        static const size_t kWordsPerBlock = kBlockBits / 64;
+
+        std::atomic<uint64_t> *Block(uint32_t hash) const
+        {
+            // 把hash映射到[0, num_blocks_)，避免取模
+            const size_t index = static_cast<size_t>((static_cast<uint64_t>(hash) * num_blocks_) >> 32);
+            return &data_[index * kWordsPerBlock];
+        }
+
+        size_t num_blocks_;
+        const int num_probes_;
+        std::unique_ptr<std::atomic<uint64_t>[]> data_;
+    };
+}
+
+#endif
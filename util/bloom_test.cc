@@ -0,0 +1,170 @@
+#include "util/bloom.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "util/coding.h"
+using namespace kvdb;
+
+class BloomTest : public testing::Test
+{
+protected:
+    BloomTest() : policy_(10) {}
+
+    void Add(const Slice &key) { hashes_.push_back(BloomHash(key)); }
+
+    void Build()
+    {
+        filter_.clear();
+        policy_.CreateFilter(hashes_.data(), hashes_.size(), &filter_);
+        hashes_.clear();
+    }
+
+    bool Matches(const Slice &key)
+    {
+        if (!hashes_.empty())
+            Build();
+        return BloomFilterPolicy::KeyMayMatch(key, filter_);
+    }
+
+    // 用不存在的key估计误判率
+    double FalsePositiveRate()
+    {
+        char buffer[sizeof(int)];
+        int result = 0;
+        for (int i = 0; i < 10000; i++)
+        {
+            EncodeFixed32(buffer, i + 1000000000);
+            if (Matches(Slice(buffer, sizeof(buffer))))
+                result++;
+        }
+        return result / 10000.0;
+    }
+
+    BloomFilterPolicy policy_;
+    std::string filter_;
+    std::vector<uint32_t> hashes_;
+};
+
+TEST_F(BloomTest, EmptyFilter)
+{
+    ASSERT_FALSE(Matches("hello"));
+    ASSERT_FALSE(Matches("world"));
+}
+
+TEST_F(BloomTest, Small)
+{
+    Add("hello");
+    Add("world");
+    ASSERT_TRUE(Matches("hello"));
+    ASSERT_TRUE(Matches("world"));
+    ASSERT_FALSE(Matches("x"));
+    ASSERT_FALSE(Matches("foo"));
+}
+
+static int NextLength(int length)
+{
+    if (length < 10)
+        return length + 1;
+    if (length < 100)
+        return length + 10;
+    if (length < 1000)
+        return length + 100;
+    return length + 1000;
+}
+
+TEST_F(BloomTest, VaryingLengths)
+{
+    char buffer[sizeof(int)];
+    int mediocre_filters = 0;
+    int good_filters = 0;
+
+    for (int length = 1; length <= 10000; length = NextLength(length))
+    {
+        for (int i = 0; i < length; i++)
+        {
+            EncodeFixed32(buffer, i);
+            Add(Slice(buffer, sizeof(buffer)));
+        }
+        Build();
+
+        // 每个key 10位，加上记录k的1字节
+        ASSERT_LE(filter_.size(), static_cast<size_t>((length * 10 / 8) + 40)) << length;
+
+        // 加入过的key一定匹配
+        for (int i = 0; i < length; i++)
+        {
+            EncodeFixed32(buffer, i);
+            ASSERT_TRUE(Matches(Slice(buffer, sizeof(buffer)))) << "Length " << length << "; key " << i;
+        }
+
+        double rate = FalsePositiveRate();
+        ASSERT_LE(rate, 0.02) << length;
+        if (rate > 0.0125)
+            mediocre_filters++;
+        else
+            good_filters++;
+    }
+    ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+TEST(DynamicBloomTest, AddAndQuery)
+{
+    char buffer[sizeof(int)];
+    for (int n : {1, 100, 10000})
+    {
+        // 每个key 10位
+        DynamicBloom bloom(n * 10);
+        for (int i = 0; i < n; i++)
+        {
+            EncodeFixed32(buffer, i);
+            bloom.Add(BloomHash(Slice(buffer, sizeof(buffer))));
+        }
+        for (int i = 0; i < n; i++)
+        {
+            EncodeFixed32(buffer, i);
+            ASSERT_TRUE(bloom.MayContain(BloomHash(Slice(buffer, sizeof(buffer))))) << n << " " << i;
+        }
+        int false_positives = 0;
+        for (int i = 0; i < 10000; i++)
+        {
+            EncodeFixed32(buffer, i + 1000000000);
+            false_positives += bloom.MayContain(BloomHash(Slice(buffer, sizeof(buffer))));
+        }
+        ASSERT_LE(false_positives, 300) << n;
+    }
+}
+
+TEST(DynamicBloomTest, ConcurrentAdd)
+{
+    const int kThreads = 4, kKeys = 20000;
+    DynamicBloom bloom(kThreads * kKeys * 10);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++)
+    {
+        threads.emplace_back([&bloom, t]()
+                             {
+                                 char buf[sizeof(int)];
+                                 for (int i = 0; i < kKeys; i++)
+                                 {
+                                     EncodeFixed32(buf, t * kKeys + i);
+                                     bloom.Add(BloomHash(Slice(buf, sizeof(buf))));
+                                 } });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    char buffer[sizeof(int)];
+    for (int i = 0; i < kThreads * kKeys; i++)
+    {
+        EncodeFixed32(buffer, i);
+        ASSERT_TRUE(bloom.MayContain(BloomHash(Slice(buffer, sizeof(buffer))))) << i;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
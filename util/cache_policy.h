@@ -0,0 +1,326 @@
+#ifndef STORAGE_KVDB_UTIL_CACHE_POLICY_H_
+#define STORAGE_KVDB_UTIL_CACHE_POLICY_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "util/LRUCache.h"
+#include "util/hash.h"
+
+namespace kvdb
+{
+    namespace cache
+    {
+        // CLOCK(second chance)：命中时只设置访问位，不移动链表。
+        // 淘汰时从最旧的条目开始检查，访问位为1的清零后移到头部，为0的淘汰
+        template <typename K, typename V>
+        class ClockPolicy
+        {
+            typedef LRUHandle<K, V> Node;
+
+        public:
+            explicit ClockPolicy(size_t /*capacity*/) {}
+
+            void Insert(Node *x)
+            {
+                x->policy_state = 0;
+                list_.PushFront(x);
+            }
+            void Touch(Node *x) { x->policy_state = 1; }
+            template <typename Q>
+            void Miss(const Q & /*key*/) {}
+            void Erase(Node *x) { list_.Remove(x); }
+
+            // 与LRU一样不淘汰刚放入的条目
+            Node *Victim(Node *x)
+            {
+                for (;;)
+                {
+                    Node *victim = list_.Back();
+                    if (victim == nullptr || (victim == x && list_.Front() == x))
+                        return nullptr;
+                    if (victim != x && victim->policy_state == 0)
+                        return victim;
+                    victim->policy_state = 0;
+                    list_.MoveToFront(victim);
+                }
+            }
+
+            template <typename Fn>
+            void ForEach(Fn &&fn) { list_.ForEach(fn); }
+
+        private:
+            HandleList<K, V> list_;
+        };
+
+        // 带高优先级池的LRU：high_priority的条目放入占容量一半的高优先级池，池满时最旧的降级到普通LRU链表的头部。
+        // 淘汰时先淘汰普通链表中的条目，只剩高优先级的条目时才淘汰它们。
+        // 块缓存用它保护索引块和过滤器块，大量只读一次的数据块不会把它们挤出去
+        template <typename K, typename V>
+        class PriorityLRUPolicy
+        {
+            typedef LRUHandle<K, V> Node;
+
+        public:
+            explicit PriorityLRUPolicy(size_t capacity) : high_capacity_(capacity / 2) {}
+
+            void Insert(Node *x)
+            {
+                if (!x->high_priority)
+                {
+                    x->policy_state = kLow;
+                    low_.PushFront(x);
+                    return;
+                }
+                x->policy_state = kHigh;
+                high_.PushFront(x);
+                while (high_.Charge() > high_capacity_ && high_.Back() != x)
+                {
+                    Node *demoted = high_.Back();
+                    high_.Remove(demoted);
+                    demoted->policy_state = kLow;
+                    low_.PushFront(demoted);
+                }
+            }
+
+            void Touch(Node *x) { List(x->policy_state).MoveToFront(x); }
+            template <typename Q>
+            void Miss(const Q & /*key*/) {}
+            void Erase(Node *x) { List(x->policy_state).Remove(x); }
+
+            // 与LRU一样不淘汰刚放入的条目
+            Node *Victim(Node *x)
+            {
+                Node *victim = low_.Back();
+                if (victim == nullptr || victim == x)
+                    victim = high_.Back();
+                return victim == x ? nullptr : victim;
+            }
+
+            template <typename Fn>
+            void ForEach(Fn &&fn)
+            {
+                high_.ForEach(fn);
+                low_.ForEach(fn);
+            }
+
+        private:
+            enum Pool : uint8_t
+            {
+                kLow = 0,
+                kHigh = 1,
+            };
+
+            HandleList<K, V> &List(uint8_t pool) { return pool == kHigh ? high_ : low_; }
+
+            const size_t high_capacity_;
+            HandleList<K, V> high_;
+            HandleList<K, V> low_;
+        };
+
+        // 记录key最近的访问频率的Count-Min Sketch。4行计数器，每行宽度不小于缓存条目数的4倍，
+        // 每个计数器最大15。累计增加次数达到条目数的10倍时所有计数器减半，让旧的访问频率逐渐衰减
+        class FrequencySketch
+        {
+        public:
+            explicit FrequencySketch(size_t capacity) { EnsureCapacity(capacity); }
+
+            // 缓存的条目数超过原来的估计时加宽。新的槽位号去掉高位就是原来的槽位号，
+            // 把原来的计数复制到对应的槽位，已有的频率统计不会丢失
+            void EnsureCapacity(size_t capacity)
+            {
+                capacity = std::max<size_t>(capacity, 4);
+                if (!table_.empty() && capacity * 4 <= mask_ + 1)
+                    return;
+                size_t width = 16;
+                while (width < capacity * 4)
+                    width <<= 1;
+                std::vector<uint8_t> table(width * kDepth, 0);
+                if (!table_.empty())
+                {
+                    const size_t old_width = mask_ + 1;
+                    for (int i = 0; i < kDepth; i++)
+                        for (size_t j = 0; j < width; j++)
+                            table[i * width + j] = table_[i * old_width + (j & mask_)];
+                }
+                table_.swap(table);
+                mask_ = width - 1;
+                sample_size_ = 10 * capacity;
+            }
+
+            void Increment(uint64_t hash)
+            {
+                bool added = false;
+                for (int i = 0; i < kDepth; i++)
+                {
+                    uint8_t &counter = table_[Index(hash, i)];
+                    if (counter < kMaxCount)
+                    {
+                        counter++;
+                        added = true;
+                    }
+                }
+                if (added && ++size_ >= sample_size_)
+                    Reset();
+            }
+
+            int Frequency(uint64_t hash) const
+            {
+                int frequency = kMaxCount;
+                for (int i = 0; i < kDepth; i++)
+                    frequency = std::min<int>(frequency, table_[Index(hash, i)]);
+                return frequency;
+            }
+
+        private:
+            static const int kDepth = 4;
+            static const uint8_t kMaxCount = 15;
+
+            // 每行用不同的组合 h1 + i * h2
+            size_t Index(uint64_t hash, int i) const
+            {
+                const uint32_t h1 = static_cast<uint32_t>(hash);
+                const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+                return (i * (mask_ + 1)) + ((h1 + i * h2) & mask_);
+            }
+
+            void Reset()
+            {
+                for (uint8_t &counter : table_)
+                    counter >>= 1;
+                size_ /= 2;
+            }
+
+            std::vector<uint8_t> table_;
+            size_t mask_ = 0;
+            size_t sample_size_ = 0;
+            size_t size_ = 0;
+        };
+
+        // W-TinyLFU(Einziger等人, "TinyLFU: A Highly Efficient Cache Admission Policy")。
+        // 容量按charge计算，频率统计的大小随缓存中的条目数增长。
+        // 新条目先进入占容量1%的LRU窗口，从窗口挤出的条目要与主区域中最该淘汰的条目比较访问频率，
+        // 频率更高才能进入主区域。主区域是分段LRU：probation中再次命中的条目升级到protected(占主区域80%)。
+        // 一次扫描访问的大量新key频率都很低，不会挤掉主区域中的热门条目
+        template <typename K, typename V>
+        class TinyLFUPolicy
+        {
+            typedef LRUHandle<K, V> Node;
+
+        public:
+            explicit TinyLFUPolicy(size_t capacity)
+                : capacity_(capacity), window_capacity_(std::max<size_t>(1, capacity / 100)),
+                  protected_capacity_((capacity - std::min(capacity, window_capacity_)) * 8 / 10),
+                  sketch_(16) {}
+
+            void Insert(Node *x)
+            {
+                x->policy_state = kWindow;
+                window_.PushFront(x);
+                sketch_.EnsureCapacity(window_.Size() + probation_.Size() + protected_.Size());
+                // 缓存未满时从窗口挤出的条目直接进入主区域，满了之后由Victim比较频率决定去留
+                while (window_.Charge() > window_capacity_ && window_.Back() != x &&
+                       window_.Charge() + probation_.Charge() + protected_.Charge() <= capacity_)
+                {
+                    Node *y = window_.Back();
+                    window_.Remove(y);
+                    y->policy_state = kProbation;
+                    probation_.PushFront(y);
+                }
+            }
+
+            void Touch(Node *x)
+            {
+                sketch_.Increment(Hash(x->key));
+                switch (x->policy_state)
+                {
+                case kWindow:
+                    window_.MoveToFront(x);
+                    break;
+                case kProbation:
+                    probation_.Remove(x);
+                    x->policy_state = kProtected;
+                    protected_.PushFront(x);
+                    // protected超出容量时把最旧的降级回probation
+                    while (protected_.Charge() > protected_capacity_ && protected_.Back() != x)
+                    {
+                        Node *demoted = protected_.Back();
+                        protected_.Remove(demoted);
+                        demoted->policy_state = kProbation;
+                        probation_.PushFront(demoted);
+                    }
+                    break;
+                default:
+                    protected_.MoveToFront(x);
+                    break;
+                }
+            }
+
+            // 不在缓存中的key也计入频率，Q为K或者可以代替K查找的类型
+            template <typename Q>
+            void Miss(const Q &key) { sketch_.Increment(Hash(key)); }
+
+            void Erase(Node *x) { List(x->policy_state).Remove(x); }
+
+            // 刚放入的条目也可能因为访问频率太低而被淘汰
+            Node *Victim(Node * /*x*/)
+            {
+                Node *candidate = window_.Back();
+                Node *victim = probation_.Back() != nullptr ? probation_.Back() : protected_.Back();
+                if (candidate == nullptr)
+                    return victim;
+                if (victim == nullptr)
+                    return candidate;
+                if (window_.Charge() <= window_capacity_)
+                    return victim;
+
+                // 窗口已满，候选条目与主区域的淘汰对象比较频率，败者被淘汰
+                if (sketch_.Frequency(Hash(candidate->key)) > sketch_.Frequency(Hash(victim->key)))
+                {
+                    window_.Remove(candidate);
+                    candidate->policy_state = kProbation;
+                    probation_.PushFront(candidate);
+                    return victim;
+                }
+                return candidate;
+            }
+
+            template <typename Fn>
+            void ForEach(Fn &&fn)
+            {
+                window_.ForEach(fn);
+                probation_.ForEach(fn);
+                protected_.ForEach(fn);
+            }
+
+        private:
+            enum Segment : uint8_t
+            {
+                kWindow = 0,
+                kProbation = 1,
+                kProtected = 2,
+            };
+
+            HandleList<K, V> &List(uint8_t segment)
+            {
+                return segment == kWindow ? window_ : (segment == kProbation ? probation_ : protected_);
+            }
+
+            template <typename Q>
+            uint64_t Hash(const Q &key) const { return Mix64(hasher_(key)); }
+
+            const size_t capacity_;
+            const size_t window_capacity_;
+            const size_t protected_capacity_;
+            HandleList<K, V> window_;
+            HandleList<K, V> probation_;
+            HandleList<K, V> protected_;
+            FrequencySketch sketch_;
+            TransparentHash<K> hasher_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,265 @@
+#include "util/cache_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+using namespace kvdb::cache;
+
+typedef LRUHandle<int, std::string> Handle;
+typedef ShardedLRUCache<int, std::string, LRUPolicy<int, std::string>> LRU;
+typedef ShardedLRUCache<int, std::string, ClockPolicy<int, std::string>> Clock;
+typedef ShardedLRUCache<int, std::string, TinyLFUPolicy<int, std::string>> TinyLFU;
+typedef ShardedLRUCache<int, std::string, PriorityLRUPolicy<int, std::string>> PriorityLRU;
+
+static Handle *NewNode(int key, size_t charge = 1)
+{
+    return new Handle(key, std::to_string(key), KType::kTypeValue, charge);
+}
+
+// 与Table::Get相同的用法：未命中时加载并放入缓存
+template <typename Cache>
+static bool Access(Cache *cache, int key)
+{
+    bool loaded = false;
+    auto h = cache->GetOrLoad(key, [&]()
+                              {
+                                  loaded = true;
+                                  return NewNode(key); });
+    EXPECT_EQ(*h, std::to_string(key));
+    return !loaded;
+}
+
+// 热门的key反复访问之后，一次扫描大量只访问一次的key，返回扫描后热门key仍在缓存中的比例
+template <typename Cache>
+static double HotSetAfterScan()
+{
+    const int kCapacity = 1000;
+    const int kHot = 500;
+    Cache cache(kCapacity, 0);
+    for (int round = 0; round < 10; round++)
+        for (int i = 0; i < kHot; i++)
+            Access(&cache, i);
+    for (int i = 0; i < 100000; i++)
+        Access(&cache, kHot + i);
+    int present = 0;
+    for (int i = 0; i < kHot; i++)
+        present += cache.Contains(i);
+    return static_cast<double>(present) / kHot;
+}
+
+TEST(CachePolicyTest, ScanResistance)
+{
+    EXPECT_LT(HotSetAfterScan<LRU>(), 0.01);
+    EXPECT_GT(HotSetAfterScan<TinyLFU>(), 0.95);
+}
+
+TEST(CachePolicyTest, ClockSecondChance)
+{
+    Clock cache(3, 0);
+    cache.Insert(NewNode(1));
+    cache.Insert(NewNode(2));
+    cache.Insert(NewNode(3));
+    // 1被访问过，获得第二次机会，最旧的未访问条目2被淘汰
+    cache.Get(1);
+    cache.Insert(NewNode(4));
+    EXPECT_TRUE(cache.Contains(1));
+    EXPECT_FALSE(cache.Contains(2));
+    EXPECT_TRUE(cache.Contains(3));
+    EXPECT_TRUE(cache.Contains(4));
+
+    // 1的访问位已经清零，再次转到链表尾部时被淘汰
+    cache.Insert(NewNode(5));
+    cache.Insert(NewNode(6));
+    EXPECT_TRUE(cache.Contains(1));
+    cache.Insert(NewNode(7));
+    EXPECT_FALSE(cache.Contains(1));
+}
+
+TEST(CachePolicyTest, PriorityPool)
+{
+    PriorityLRU cache(10, 0);
+    for (int i = 0; i < 3; i++)
+    {
+        Handle *h = NewNode(i);
+        h->high_priority = true;
+        cache.Insert(h);
+    }
+    // 大量低优先级的条目只在普通链表中互相淘汰
+    for (int i = 100; i < 1000; i++)
+        Access(&cache, i);
+    for (int i = 0; i < 3; i++)
+        EXPECT_TRUE(cache.Contains(i));
+    EXPECT_EQ(cache.GetUsage(), 10u);
+
+    // 高优先级池占一半容量，超出的最旧条目降级，之后和普通条目一起按LRU淘汰
+    for (int i = 3; i < 6; i++)
+    {
+        Handle *h = NewNode(i);
+        h->high_priority = true;
+        cache.Insert(h);
+    }
+    EXPECT_TRUE(cache.Contains(0));
+    for (int i = 1000; i < 1010; i++)
+        Access(&cache, i);
+    EXPECT_FALSE(cache.Contains(0));
+    for (int i = 1; i < 6; i++)
+        EXPECT_TRUE(cache.Contains(i));
+}
+
+TEST(CachePolicyTest, TinyLFUAdmission)
+{
+    TinyLFU cache(100, 0);
+    for (int round = 0; round < 5; round++)
+        for (int i = 0; i < 100; i++)
+            Access(&cache, i);
+    // 只访问过一次的新key先进入窗口，被挤出窗口时频率低于主区域中的条目，不被接纳
+    for (int i = 0; i < 10; i++)
+        Access(&cache, 1000 + i);
+    EXPECT_FALSE(cache.Contains(1000));
+    EXPECT_EQ(cache.GetUsage(), 100u);
+    int present = 0;
+    for (int i = 0; i < 100; i++)
+        present += cache.Contains(i);
+    // 只有开始时在窗口中的一个条目被挤掉
+    EXPECT_GE(present, 99);
+
+    // 频率足够高之后被接纳
+    for (int i = 0; i < 10; i++)
+        Access(&cache, 1000);
+    Access(&cache, 2000);
+    Access(&cache, 2001);
+    EXPECT_TRUE(cache.Contains(1000));
+    EXPECT_FALSE(cache.Contains(2000));
+}
+
+TEST(CachePolicyTest, Stats)
+{
+    TinyLFU cache(100, 2);
+    for (int i = 0; i < 10; i++)
+        Access(&cache, i);
+    for (int i = 0; i < 10; i++)
+        Access(&cache, i);
+    CacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.hits, 10u);
+    EXPECT_EQ(stats.misses, 10u);
+    EXPECT_DOUBLE_EQ(stats.HitRatio(), 0.5);
+
+    // Contains不计入统计
+    cache.Contains(0);
+    cache.ResetStats();
+    stats = cache.GetStats();
+    EXPECT_EQ(stats.hits + stats.misses, 0u);
+    EXPECT_DOUBLE_EQ(stats.HitRatio(), 0.0);
+}
+
+TEST(CachePolicyTest, FrequencySketch)
+{
+    FrequencySketch sketch(64);
+    EXPECT_EQ(sketch.Frequency(Mix64(1)), 0);
+    for (int i = 0; i < 5; i++)
+        sketch.Increment(Mix64(1));
+    EXPECT_EQ(sketch.Frequency(Mix64(1)), 5);
+    for (int i = 0; i < 100; i++)
+        sketch.Increment(Mix64(2));
+    EXPECT_EQ(sketch.Frequency(Mix64(2)), 15);
+
+    // 增加次数达到10倍条目数后计数减半
+    for (int i = 0; i < 10 * 64; i++)
+        sketch.Increment(Mix64(1000 + i));
+    EXPECT_LT(sketch.Frequency(Mix64(2)), 15);
+}
+
+TEST(CachePolicyTest, FrequencySketchGrowKeepsCounts)
+{
+    FrequencySketch sketch(16);
+    for (int key = 0; key < 16; key++)
+        for (int i = 0; i < key % 8; i++)
+            sketch.Increment(Mix64(key));
+    std::vector<int> before;
+    for (int key = 0; key < 16; key++)
+        before.push_back(sketch.Frequency(Mix64(key)));
+
+    // 加宽后每个key的估计值不变
+    sketch.EnsureCapacity(1000);
+    for (int key = 0; key < 16; key++)
+        EXPECT_EQ(sketch.Frequency(Mix64(key)), before[key]) << key;
+    EXPECT_EQ(sketch.Frequency(Mix64(12345)), 0);
+}
+
+// 随机的插入、访问、删除，所有策略都不超过容量
+template <typename Cache>
+static void RandomOps()
+{
+    const size_t kCapacity = 200;
+    Cache cache(kCapacity, 2);
+    Random rnd(301);
+    std::vector<PinnedHandle<int, std::string>> pinned;
+    for (int i = 0; i < 50000; i++)
+    {
+        int key = rnd.Skewed(10);
+        switch (rnd.Uniform(4))
+        {
+        case 0:
+            cache.Insert(NewNode(key, 1 + rnd.Uniform(3)));
+            break;
+        case 1:
+            cache.Remove(key);
+            break;
+        case 2:
+            pinned.push_back(cache.Get(key));
+            if (pinned.size() > 10)
+                pinned.erase(pinned.begin());
+            break;
+        default:
+            Access(&cache, key);
+        }
+        // 每个分片最多超出一个条目的charge
+        ASSERT_LE(cache.GetUsage(), kCapacity + 4 * 3);
+    }
+    for (auto &h : pinned)
+        if (h != nullptr)
+        {
+            ASSERT_EQ(*h, std::to_string(h.key()));
+        }
+}
+
+TEST(CachePolicyTest, RandomOps)
+{
+    RandomOps<LRU>();
+    RandomOps<Clock>();
+    RandomOps<TinyLFU>();
+    RandomOps<PriorityLRU>();
+}
+
+TEST(CachePolicyTest, MultiThreaded)
+{
+    TinyLFU cache(1024, 2);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&cache, t]()
+                             {
+                                 Random rnd(t + 1);
+                                 for (int i = 0; i < 20000; i++)
+                                 {
+                                     int key = rnd.Skewed(12);
+                                     Access(&cache, key);
+                                     if (i % 16 == 0)
+                                         cache.Remove(key);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    CacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.hits + stats.misses, 4u * 20000);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
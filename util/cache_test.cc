@@ -5,28 +5,42 @@ namespace kvdb
 {
     namespace cache
     {
+        typedef LRUHandle<int, int> Handle;
+
+        // 放入新条目，charge为1，缓存接管这个引用
+        static void Put(LRUCache<int, int> *cache, int key, int value)
+        {
+            cache->Insert(new Handle(key, value, KType::kTypeValue));
+        }
+
+        // 返回key的值，查找期间持有条目的引用
+        static int Get(LRUCache<int, int> *cache, int key)
+        {
+            PinnedHandle<int, int> h(cache->Lookup(key));
+            return h != nullptr ? *h : -1;
+        }
 
         // 测试 Insert 和 Get 方法
         TEST(LRUCacheTest, InsertAndGet)
         {
             LRUCache<int, int> cache(10);
-            cache.Insert(2, 1);
+            Put(&cache, 2, 1);
 
-            EXPECT_EQ(cache.Get(2), 1);
+            EXPECT_EQ(Get(&cache, 2), 1);
         }
 
         // 测试 LRU 策略，插入超过容量后旧数据被淘汰
         TEST(LRUCacheTest, LRUPolicy)
         {
             LRUCache<int, int> cache(3);
-            cache.Insert(1, 10);
-            cache.Insert(2, 20);
-            cache.Insert(3, 30);
-            cache.Insert(4, 40); // 插入后 1 应该被淘汰
+            Put(&cache, 1, 10);
+            Put(&cache, 2, 20);
+            Put(&cache, 3, 30);
+            Put(&cache, 4, 40); // 插入后 1 应该被淘汰
 
-            EXPECT_EQ(cache.Get(2), 20);
-            EXPECT_EQ(cache.Get(3), 30);
-            EXPECT_EQ(cache.Get(4), 40);
+            EXPECT_EQ(Get(&cache, 2), 20);
+            EXPECT_EQ(Get(&cache, 3), 30);
+            EXPECT_EQ(Get(&cache, 4), 40);
             EXPECT_FALSE(cache.Contains(1));
         }
 
@@ -34,26 +48,27 @@ namespace kvdb
         TEST(LRUCacheTest, UpdateValue)
         {
             LRUCache<int, int> cache(3);
-            cache.Insert(1, 10);
-            cache.Insert(2, 20);
+            Put(&cache, 1, 10);
+            Put(&cache, 2, 20);
 
-            cache.Insert(1, 100); // 更新键为 1 的值
+            EXPECT_TRUE(cache.Insert(1, 100, 1)); // 更新键为 1 的值
+            EXPECT_FALSE(cache.Insert(5, 50, 1)); // 不存在的键不会放入
 
-            EXPECT_EQ(cache.Get(1), 100);
-            EXPECT_EQ(cache.Get(2), 20);
+            EXPECT_EQ(Get(&cache, 1), 100);
+            EXPECT_EQ(Get(&cache, 2), 20);
         }
 
         // 测试 Get 方法移动节点到前端的功能
         TEST(LRUCacheTest, MoveNodeToFrontOnGet)
         {
             LRUCache<int, int> cache(3);
-            cache.Insert(1, 10);
-            cache.Insert(2, 20);
-            cache.Insert(3, 30);
-            cache.Get(1);
-            cache.Insert(4, 40);
+            Put(&cache, 1, 10);
+            Put(&cache, 2, 20);
+            Put(&cache, 3, 30);
+            Get(&cache, 1);
+            Put(&cache, 4, 40);
 
-            EXPECT_EQ(cache.Get(1), 10);
+            EXPECT_EQ(Get(&cache, 1), 10);
             EXPECT_FALSE(cache.Contains(2));
         }
 
@@ -0,0 +1,246 @@
+#ifndef STORAGE_KVDB_UTIL_CODING_H_
+#define STORAGE_KVDB_UTIL_CODING_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 定长整数统一按小端存储
+
+    inline void EncodeFixed32(char *dst, uint32_t value)
+    {
+        uint8_t *const buffer = reinterpret_cast<uint8_t *>(dst);
+        buffer[0] = static_cast<uint8_t>(value);
+        buffer[1] = static_cast<uint8_t>(value >> 8);
+        buffer[2] = static_cast<uint8_t>(value >> 16);
+        buffer[3] = static_cast<uint8_t>(value >> 24);
+    }
+
+    inline void EncodeFixed64(char *dst, uint64_t value)
+    {
+        uint8_t *const buffer = reinterpret_cast<uint8_t *>(dst);
+        for (int i = 0; i < 8; i++)
+            buffer[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    inline uint32_t DecodeFixed32(const char *ptr)
+    {
+        const uint8_t *const buffer = reinterpret_cast<const uint8_t *>(ptr);
+        return (static_cast<uint32_t>(buffer[0])) |
+               (static_cast<uint32_t>(buffer[1]) << 8) |
+               (static_cast<uint32_t>(buffer[2]) << 16) |
+               (static_cast<uint32_t>(buffer[3]) << 24);
+    }
+
+    inline uint64_t DecodeFixed64(const char *ptr)
+    {
+        const uint8_t *const buffer = reinterpret_cast<const uint8_t *>(ptr);
+        uint64_t result = 0;
+        for (int i = 7; i >= 0; i--)
+            result = (result << 8) | buffer[i];
+        return result;
+    }
+
+    inline void PutFixed32(std::string *dst, uint32_t value)
+    {
+        char buf[sizeof(value)];
+        EncodeFixed32(buf, value);
+        dst->append(buf, sizeof(buf));
+    }
+
+    inline void PutFixed64(std::string *dst, uint64_t value)
+    {
+        char buf[sizeof(value)];
+        EncodeFixed64(buf, value);
+        dst->append(buf, sizeof(buf));
+    }
+
+    // 变长整数：每字节低7位存数据，最高位表示后面还有字节
+
+    inline char *EncodeVarint32(char *dst, uint32_t v)
+    {
+        uint8_t *ptr = reinterpret_cast<uint8_t *>(dst);
+        static const int B = 128;
+        while (v >= B)
+        {
+            *(ptr++) = v | B;
+            v >>= 7;
+        }
+        *(ptr++) = static_cast<uint8_t>(v);
+        return reinterpret_cast<char *>(ptr);
+    }
+
+    inline char *EncodeVarint64(char *dst, uint64_t v)
+    {
+        static const int B = 128;
+        uint8_t *ptr = reinterpret_cast<uint8_t *>(dst);
+        while (v >= B)
+        {
+            *(ptr++) = v | B;
+            v >>= 7;
+        }
+        *(ptr++) = static_cast<uint8_t>(v);
+        return reinterpret_cast<char *>(ptr);
+    }
+
+    inline void PutVarint32(std::string *dst, uint32_t v)
+    {
+        char buf[5];
+        char *ptr = EncodeVarint32(buf, v);
+        dst->append(buf, ptr - buf);
+    }
+
+    inline void PutVarint64(std::string *dst, uint64_t v)
+    {
+        char buf[10];
+        char *ptr = EncodeVarint64(buf, v);
+        dst->append(buf, ptr - buf);
+    }
+
+    inline void PutLengthPrefixedSlice(std::string *dst, const Slice &value)
+    {
+        PutVarint32(dst, static_cast<uint32_t>(value.size()));
+        dst->append(value.data(), value.size());
+    }
+
+    inline int VarintLength(uint64_t v)
+    {
+        int len = 1;
+        while (v >= 128)
+        {
+            v >>= 7;
+            len++;
+        }
+        return len;
+    }
+
+    // 解析失败(数据不完整)时返回nullptr
+    inline const char *GetVarint32Ptr(const char *p, const char *limit, uint32_t *value)
+    {
+        uint32_t result = 0;
+        for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7)
+        {
+            uint32_t byte = *(reinterpret_cast<const uint8_t *>(p));
+            p++;
+            if (byte & 128)
+            {
+                result |= ((byte & 127) << shift);
+            }
+            else
+            {
+                result |= (byte << shift);
+                *value = result;
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    inline const char *GetVarint64Ptr(const char *p, const char *limit, uint64_t *value)
+    {
+        uint64_t result = 0;
+        for (uint32_t shift = 0; shift <= 63 && p < limit; shift += 7)
+        {
+            uint64_t byte = *(reinterpret_cast<const uint8_t *>(p));
+            p++;
+            if (byte & 128)
+            {
+                result |= ((byte & 127) << shift);
+            }
+            else
+            {
+                result |= (byte << shift);
+                *value = result;
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    inline bool GetVarint32(Slice *input, uint32_t *value)
+    {
+        const char *p = input->data();
+        const char *limit = p + input->size();
+        const char *q = GetVarint32Ptr(p, limit, value);
+        if (q == nullptr)
+            return false;
+        *input = Slice(q, limit - q);
+        return true;
+    }
+
+    inline bool GetVarint64(Slice *input, uint64_t *value)
+    {
+        const char *p = input->data();
+        const char *limit = p + input->size();
+        const char *q = GetVarint64Ptr(p, limit, value);
+        if (q == nullptr)
+            return false;
+        *input = Slice(q, limit - q);
+        return true;
+    }
+
+    inline bool GetLengthPrefixedSlice(Slice *input, Slice *result)
+    {
+        uint32_t len;
+        if (GetVarint32(input, &len) && input->size() >= len)
+        {
+            *result = Slice(input->data(), len);
+            input->remove_prefix(len);
+            return true;
+        }
+        return false;
+    }
+
+    // Codec<T>把Table的key/value类型编码成字节，用于日志和磁盘文件。
+    // 编码保持顺序：两个值编码后按字节比较的结果与T的operator<一致
+    template <typename T, typename Enable = void>
+    struct Codec;
+
+    // 整数按大端存储，有符号数翻转符号位
+    template <typename T>
+    struct Codec<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+    {
+        typedef typename std::make_unsigned<T>::type U;
+        static const U kSignBit = std::is_signed<T>::value ? (U(1) << (sizeof(T) * 8 - 1)) : U(0);
+
+        static void Encode(std::string *dst, const T &value)
+        {
+            U v = static_cast<U>(value) ^ kSignBit;
+            char buf[sizeof(T)];
+            for (size_t i = 0; i < sizeof(T); i++)
+                buf[i] = static_cast<char>(v >> (8 * (sizeof(T) - 1 - i)));
+            dst->append(buf, sizeof(T));
+        }
+
+        static bool Decode(const Slice &input, T *value)
+        {
+            if (input.size() != sizeof(T))
+                return false;
+            U v = 0;
+            for (size_t i = 0; i < sizeof(T); i++)
+                v = static_cast<U>((v << 8) | static_cast<uint8_t>(input[i]));
+            *value = static_cast<T>(v ^ kSignBit);
+            return true;
+        }
+    };
+
+    template <>
+    struct Codec<std::string>
+    {
+        // 也接受std::string_view，用std::string_view查找时不需要先构造std::string
+        static void Encode(std::string *dst, std::string_view value) { dst->append(value.data(), value.size()); }
+
+        static bool Decode(const Slice &input, std::string *value)
+        {
+            value->assign(input.data(), input.size());
+            return true;
+        }
+    };
+}
+
+#endif
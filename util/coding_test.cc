@@ -0,0 +1,134 @@
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+#include <gtest/gtest.h>
+
+#include <climits>
+#include <string>
+#include <vector>
+using namespace kvdb;
+
+TEST(CodingTest, Fixed)
+{
+    std::string s;
+    for (uint32_t v = 0; v < 100000; v++)
+        PutFixed32(&s, v);
+    const char *p = s.data();
+    for (uint32_t v = 0; v < 100000; v++)
+    {
+        ASSERT_EQ(v, DecodeFixed32(p));
+        p += sizeof(uint32_t);
+    }
+
+    s.clear();
+    for (int power = 0; power <= 63; power++)
+        PutFixed64(&s, uint64_t(1) << power);
+    p = s.data();
+    for (int power = 0; power <= 63; power++)
+    {
+        ASSERT_EQ(uint64_t(1) << power, DecodeFixed64(p));
+        p += sizeof(uint64_t);
+    }
+}
+
+TEST(CodingTest, Varint)
+{
+    std::vector<uint64_t> values = {0, 100, ~uint64_t(0), ~uint64_t(0) - 1};
+    for (uint32_t k = 0; k < 64; k++)
+    {
+        const uint64_t power = 1ull << k;
+        values.push_back(power);
+        values.push_back(power - 1);
+        values.push_back(power + 1);
+    }
+    std::string s;
+    for (uint64_t v : values)
+        PutVarint64(&s, v);
+    Slice input(s);
+    for (uint64_t v : values)
+    {
+        uint64_t actual;
+        ASSERT_TRUE(GetVarint64(&input, &actual));
+        ASSERT_EQ(v, actual);
+    }
+    ASSERT_TRUE(input.empty());
+
+    // 数据不完整时解析失败
+    std::string truncated;
+    PutVarint32(&truncated, 1u << 30);
+    uint32_t result;
+    ASSERT_TRUE(GetVarint32Ptr(truncated.data(), truncated.data() + truncated.size() - 1, &result) == nullptr);
+}
+
+TEST(CodingTest, LengthPrefixedSlice)
+{
+    std::string s;
+    PutLengthPrefixedSlice(&s, Slice(""));
+    PutLengthPrefixedSlice(&s, Slice("foo"));
+    PutLengthPrefixedSlice(&s, Slice(std::string(200, 'x')));
+    Slice input(s), v;
+    ASSERT_TRUE(GetLengthPrefixedSlice(&input, &v));
+    ASSERT_EQ("", v.ToString());
+    ASSERT_TRUE(GetLengthPrefixedSlice(&input, &v));
+    ASSERT_EQ("foo", v.ToString());
+    ASSERT_TRUE(GetLengthPrefixedSlice(&input, &v));
+    ASSERT_EQ(std::string(200, 'x'), v.ToString());
+    ASSERT_FALSE(GetLengthPrefixedSlice(&input, &v));
+}
+
+// 编码后按字节比较的顺序必须与原类型一致
+TEST(CodingTest, CodecPreservesOrder)
+{
+    std::vector<int> ints = {INT_MIN, -100000, -1, 0, 1, 255, 256, 100000, INT_MAX};
+    for (size_t i = 0; i + 1 < ints.size(); i++)
+    {
+        std::string a, b;
+        Codec<int>::Encode(&a, ints[i]);
+        Codec<int>::Encode(&b, ints[i + 1]);
+        ASSERT_LT(Slice(a).compare(Slice(b)), 0);
+        int decoded;
+        ASSERT_TRUE(Codec<int>::Decode(a, &decoded));
+        ASSERT_EQ(decoded, ints[i]);
+    }
+
+    std::string a, b;
+    Codec<std::string>::Encode(&a, "abc");
+    Codec<std::string>::Encode(&b, "abd");
+    ASSERT_LT(Slice(a).compare(Slice(b)), 0);
+    std::string decoded;
+    ASSERT_TRUE(Codec<std::string>::Decode(a, &decoded));
+    ASSERT_EQ(decoded, "abc");
+}
+
+TEST(CRC32CTest, StandardResults)
+{
+    char buf[32];
+
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(0x8a9136aau, crc32c::Value(buf, sizeof(buf)));
+
+    memset(buf, 0xff, sizeof(buf));
+    ASSERT_EQ(0x62a8ab43u, crc32c::Value(buf, sizeof(buf)));
+
+    for (int i = 0; i < 32; i++)
+        buf[i] = i;
+    ASSERT_EQ(0x46dd794eu, crc32c::Value(buf, sizeof(buf)));
+
+    for (int i = 0; i < 32; i++)
+        buf[i] = 31 - i;
+    ASSERT_EQ(0x113fdb5cu, crc32c::Value(buf, sizeof(buf)));
+}
+
+TEST(CRC32CTest, ExtendAndMask)
+{
+    ASSERT_EQ(crc32c::Value("hello world", 11), crc32c::Extend(crc32c::Value("hello ", 6), "world", 5));
+    uint32_t crc = crc32c::Value("foo", 3);
+    ASSERT_NE(crc, crc32c::Mask(crc));
+    ASSERT_EQ(crc, crc32c::Unmask(crc32c::Mask(crc)));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,91 @@
+#ifndef STORAGE_KVDB_UTIL_COMPARATOR_H_
+#define STORAGE_KVDB_UTIL_COMPARATOR_H_
+
+#include <cstdint>
+#include "util/coding.h"
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 运行时指定的key顺序，用于按字节存储key的结构(InlineSkipList)。
+    // 实现必须是全序，并且线程安全：多个线程会同时调用Compare
+    class Comparator
+    {
+    public:
+        virtual ~Comparator() = default;
+
+        // 返回值 <0, ==0, >0 分别表示a < b, a == b, a > b
+        virtual int Compare(const Slice &a, const Slice &b) const = 0;
+
+        // 比较器的名字，持久化的数据要用同名的比较器打开
+        virtual const char *Name() const = 0;
+
+        bool Equal(const Slice &a, const Slice &b) const { return Compare(a, b) == 0; }
+    };
+
+    // 内置比较器的CRTP基类。Derived提供静态的CompareKeys，Compare被声明为final，
+    // 模板代码以具体类型(而不是Comparator)调用时编译器可以直接内联CompareKeys，没有虚函数调用
+    template <typename Derived>
+    class BuiltinComparator : public Comparator
+    {
+    public:
+        int Compare(const Slice &a, const Slice &b) const final { return Derived::CompareKeys(a, b); }
+        const char *Name() const final { return Derived::kName; }
+    };
+
+    // 按字节的字典序，与有序表文件中key的顺序相同
+    class BytewiseComparatorImpl final : public BuiltinComparator<BytewiseComparatorImpl>
+    {
+    public:
+        static constexpr const char *kName = "kvdb.BytewiseComparator";
+        static int CompareKeys(const Slice &a, const Slice &b) { return a.compare(b); }
+    };
+
+    // 按字节的逆字典序
+    class ReverseBytewiseComparatorImpl final : public BuiltinComparator<ReverseBytewiseComparatorImpl>
+    {
+    public:
+        static constexpr const char *kName = "kvdb.ReverseBytewiseComparator";
+        static int CompareKeys(const Slice &a, const Slice &b) { return b.compare(a); }
+    };
+
+    // key为fixed64编码(小端)的无符号整数，按数值比较。长度不是8的key排在所有整数之后并按字节比较
+    class U64FixedComparatorImpl final : public BuiltinComparator<U64FixedComparatorImpl>
+    {
+    public:
+        static constexpr const char *kName = "kvdb.U64FixedComparator";
+        static int CompareKeys(const Slice &a, const Slice &b)
+        {
+            const bool fixed_a = a.size() == sizeof(uint64_t), fixed_b = b.size() == sizeof(uint64_t);
+            if (fixed_a && fixed_b)
+            {
+                const uint64_t x = DecodeFixed64(a.data()), y = DecodeFixed64(b.data());
+                return x < y ? -1 : (x > y ? 1 : 0);
+            }
+            if (fixed_a != fixed_b)
+                return fixed_a ? -1 : 1;
+            return a.compare(b);
+        }
+    };
+
+    // 内置比较器的单例，不能delete
+    inline const BytewiseComparatorImpl *BytewiseComparator()
+    {
+        static const BytewiseComparatorImpl instance;
+        return &instance;
+    }
+
+    inline const ReverseBytewiseComparatorImpl *ReverseBytewiseComparator()
+    {
+        static const ReverseBytewiseComparatorImpl instance;
+        return &instance;
+    }
+
+    inline const U64FixedComparatorImpl *U64FixedComparator()
+    {
+        static const U64FixedComparatorImpl instance;
+        return &instance;
+    }
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef STORAGE_KVDB_UTIL_COMPRESSION_H_
+#define STORAGE_KVDB_UTIL_COMPRESSION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util/coding.h"
+#include "util/lz4.h"
+#include "util/slice.h"
+#include "util/status.h"
+
+// Snappy和Zstd需要外部库，编译时定义KVDB_HAVE_SNAPPY/KVDB_HAVE_ZSTD并链接-lsnappy/-lzstd才启用，
+// makefile检测到头文件时自动开启。LZ4是内置的实现，总是可用
+#ifdef KVDB_HAVE_SNAPPY
+#include <snappy.h>
+#endif
+#ifdef KVDB_HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+namespace kvdb
+{
+    // 块的压缩算法，保存在块尾部的type字节中，取值不能修改
+    enum CompressionType : char
+    {
+        kNoCompression = 0x0,
+        kSnappyCompression = 0x1,
+        kLZ4Compression = 0x4,
+        kZstdCompression = 0x7,
+    };
+
+    // 当前编译的版本能否压缩和解压这种格式
+    inline bool CompressionTypeSupported(CompressionType type)
+    {
+        switch (type)
+        {
+        case kNoCompression:
+        case kLZ4Compression:
+            return true;
+#ifdef KVDB_HAVE_SNAPPY
+        case kSnappyCompression:
+            return true;
+#endif
+#ifdef KVDB_HAVE_ZSTD
+        case kZstdCompression:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    inline const char *CompressionTypeName(CompressionType type)
+    {
+        switch (type)
+        {
+        case kNoCompression:
+            return "none";
+        case kSnappyCompression:
+            return "snappy";
+        case kLZ4Compression:
+            return "lz4";
+        case kZstdCompression:
+            return "zstd";
+        default:
+            return "unknown";
+        }
+    }
+
+    // 一个文件的Zstd字典。构造时预先处理好，压缩和解压每个块时不需要重新加载字典
+    class CompressionDict
+    {
+    public:
+        enum Use
+        {
+            kCompress,
+            kUncompress,
+        };
+
+        CompressionDict(const Slice &dict, Use use, int level) : dict_(dict.data(), dict.size())
+        {
+#ifdef KVDB_HAVE_ZSTD
+            if (use == kCompress)
+                cdict_ = ZSTD_createCDict(dict_.data(), dict_.size(), level);
+            else
+                ddict_ = ZSTD_createDDict(dict_.data(), dict_.size());
+#else
+            (void)use;
+            (void)level;
+#endif
+        }
+
+        CompressionDict(const CompressionDict &) = delete;
+        CompressionDict &operator=(const CompressionDict &) = delete;
+
+        ~CompressionDict()
+        {
+#ifdef KVDB_HAVE_ZSTD
+            ZSTD_freeCDict(cdict_);
+            ZSTD_freeDDict(ddict_);
+#endif
+        }
+
+        const std::string &data() const { return dict_; }
+
+#ifdef KVDB_HAVE_ZSTD
+        const ZSTD_CDict *cdict() const { return cdict_; }
+        const ZSTD_DDict *ddict() const { return ddict_; }
+#endif
+
+    private:
+        const std::string dict_;
+#ifdef KVDB_HAVE_ZSTD
+        ZSTD_CDict *cdict_ = nullptr;
+        ZSTD_DDict *ddict_ = nullptr;
+#endif
+    };
+
+#ifdef KVDB_HAVE_ZSTD
+    // 每个线程复用一组Zstd的上下文，避免每个块重新分配
+    struct ZstdContext
+    {
+        ZstdContext() : cctx(ZSTD_createCCtx()), dctx(ZSTD_createDCtx()) {}
+        ~ZstdContext()
+        {
+            ZSTD_freeCCtx(cctx);
+            ZSTD_freeDCtx(dctx);
+        }
+
+        static ZstdContext *Get()
+        {
+            static thread_local ZstdContext context;
+            return &context;
+        }
+
+        ZSTD_CCtx *const cctx;
+        ZSTD_DCtx *const dctx;
+    };
+#endif
+
+    // 压缩后的格式为 varint32原始长度 | 压缩算法的输出。
+    // 把input压缩后追加到*output，level只对Zstd有效，dict为nullptr时不使用字典。
+    // 当前编译的版本不支持时返回false
+    inline bool Compress(CompressionType type, const Slice &input, int level, const CompressionDict *dict,
+                         std::string *output)
+    {
+        if (input.size() > UINT32_MAX)
+            return false;
+        const size_t base = output->size();
+        PutVarint32(output, static_cast<uint32_t>(input.size()));
+        switch (type)
+        {
+        case kLZ4Compression:
+            lz4::Compress(input.data(), input.size(), output);
+            return true;
+#ifdef KVDB_HAVE_SNAPPY
+        case kSnappyCompression:
+        {
+            const size_t header = output->size();
+            output->resize(header + snappy::MaxCompressedLength(input.size()));
+            size_t n;
+            snappy::RawCompress(input.data(), input.size(), &(*output)[header], &n);
+            output->resize(header + n);
+            return true;
+        }
+#endif
+#ifdef KVDB_HAVE_ZSTD
+        case kZstdCompression:
+        {
+            const size_t header = output->size();
+            output->resize(header + ZSTD_compressBound(input.size()));
+            ZSTD_CCtx *cctx = ZstdContext::Get()->cctx;
+            char *dst = &(*output)[header];
+            const size_t capacity = output->size() - header;
+            const size_t n = dict != nullptr && dict->cdict() != nullptr
+                                 ? ZSTD_compress_usingCDict(cctx, dst, capacity, input.data(), input.size(), dict->cdict())
+                                 : ZSTD_compressCCtx(cctx, dst, capacity, input.data(), input.size(), level);
+            if (ZSTD_isError(n))
+            {
+                output->resize(base);
+                return false;
+            }
+            output->resize(header + n);
+            return true;
+        }
+#endif
+        default:
+            (void)level;
+            (void)dict;
+            output->resize(base);
+            return false;
+        }
+    }
+
+    // 解压Compress的输出，成功时*result为new[]分配的内容，由调用方delete[]
+    inline Status Uncompress(CompressionType type, const Slice &input, const CompressionDict *dict, char **result,
+                             size_t *result_size)
+    {
+        Slice compressed = input;
+        uint32_t n;
+        if (!GetVarint32(&compressed, &n))
+            return Status::Corruption("bad compressed block length");
+        if (!CompressionTypeSupported(type))
+            return Status::NotSupported("compression type not supported in this build", CompressionTypeName(type));
+
+        std::unique_ptr<char[]> buf(new char[n]);
+        bool ok = false;
+        switch (type)
+        {
+        case kLZ4Compression:
+            ok = lz4::Uncompress(compressed.data(), compressed.size(), buf.get(), n);
+            break;
+#ifdef KVDB_HAVE_SNAPPY
+        case kSnappyCompression:
+        {
+            size_t length;
+            ok = snappy::GetUncompressedLength(compressed.data(), compressed.size(), &length) && length == n &&
+                 snappy::RawUncompress(compressed.data(), compressed.size(), buf.get());
+            break;
+        }
+#endif
+#ifdef KVDB_HAVE_ZSTD
+        case kZstdCompression:
+        {
+            ZSTD_DCtx *dctx = ZstdContext::Get()->dctx;
+            const size_t size =
+                dict != nullptr && dict->ddict() != nullptr
+                    ? ZSTD_decompress_usingDDict(dctx, buf.get(), n, compressed.data(), compressed.size(), dict->ddict())
+                    : ZSTD_decompressDCtx(dctx, buf.get(), n, compressed.data(), compressed.size());
+            ok = !ZSTD_isError(size) && size == n;
+            break;
+        }
+#endif
+        default:
+            (void)dict;
+            break;
+        }
+        if (!ok)
+            return Status::Corruption("corrupted compressed block contents", CompressionTypeName(type));
+        *result = buf.release();
+        *result_size = n;
+        return Status::OK();
+    }
+
+    // 用samples训练一个不超过max_dict_bytes的Zstd字典。样本太少或不支持Zstd时返回false
+    inline bool TrainCompressionDict(const std::vector<std::string> &samples, size_t max_dict_bytes,
+                                     std::string *dict)
+    {
+#ifdef KVDB_HAVE_ZSTD
+        std::string buffer;
+        std::vector<size_t> sizes;
+        sizes.reserve(samples.size());
+        for (const std::string &sample : samples)
+        {
+            buffer.append(sample);
+            sizes.push_back(sample.size());
+        }
+        dict->resize(max_dict_bytes);
+        const size_t n = ZDICT_trainFromBuffer(&(*dict)[0], dict->size(), buffer.data(), sizes.data(),
+                                               static_cast<unsigned>(sizes.size()));
+        if (ZDICT_isError(n))
+        {
+            dict->clear();
+            return false;
+        }
+        dict->resize(n);
+        return true;
+#else
+        (void)samples;
+        (void)max_dict_bytes;
+        (void)dict;
+        return false;
+#endif
+    }
+}
+
+#endif
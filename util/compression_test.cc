@@ -0,0 +1,154 @@
+#include "util/compression.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+
+// mode 0: 随机字节；1: 小字母表；2: 短周期重复；3: 大量引用之前出现过的内容
+static std::string MakeInput(Random *rnd, size_t n, int mode)
+{
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; i++)
+    {
+        switch (mode)
+        {
+        case 0:
+            s[i] = static_cast<char>(rnd->Uniform(256));
+            break;
+        case 1:
+            s[i] = static_cast<char>('a' + rnd->Uniform(3));
+            break;
+        case 2:
+            s[i] = static_cast<char>('a' + i % 37);
+            break;
+        default:
+            s[i] = i > 10 && rnd->Uniform(8) != 0 ? s[i - 1 - rnd->Uniform(10)] : static_cast<char>(rnd->Uniform(256));
+        }
+    }
+    return s;
+}
+
+// 类似JSON的value，字段名在每条记录中重复
+static std::string JsonRecords(int n)
+{
+    std::string s;
+    for (int i = 0; i < n; i++)
+        s += "{\"name\":\"user" + std::to_string(i) + "\",\"age\":" + std::to_string(i % 90) + ",\"active\":true}";
+    return s;
+}
+
+TEST(CompressionTest, LZ4RoundTrip)
+{
+    Random rnd(301);
+    for (int i = 0; i < 2000; i++)
+    {
+        const size_t n = i < 100 ? i : rnd.Uniform(70000);
+        const std::string input = MakeInput(&rnd, n, i % 4);
+        std::string compressed;
+        lz4::Compress(input.data(), input.size(), &compressed);
+        ASSERT_LE(compressed.size(), lz4::MaxCompressedLength(n));
+        std::string output(n, '\0');
+        ASSERT_TRUE(lz4::Uncompress(compressed.data(), compressed.size(), &output[0], n)) << i;
+        ASSERT_EQ(output, input) << i;
+        if (n > 0)
+        {
+            ASSERT_FALSE(lz4::Uncompress(compressed.data(), compressed.size(), &output[0], n - 1));
+        }
+    }
+
+    const std::string json = JsonRecords(1000);
+    std::string compressed;
+    lz4::Compress(json.data(), json.size(), &compressed);
+    ASSERT_LT(compressed.size() * 3, json.size());
+}
+
+TEST(CompressionTest, LZ4CorruptInput)
+{
+    Random rnd(301);
+    const std::string input = MakeInput(&rnd, 10000, 3);
+    std::string compressed;
+    lz4::Compress(input.data(), input.size(), &compressed);
+    std::string output(input.size(), '\0');
+    // 损坏的输入可能解压失败，也可能得到错误的内容，但不能越界
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string bad = compressed;
+        bad[rnd.Uniform(bad.size())] ^= static_cast<char>(1 << rnd.Uniform(8));
+        lz4::Uncompress(bad.data(), bad.size(), &output[0], output.size());
+        bad.resize(rnd.Uniform(bad.size()));
+        ASSERT_FALSE(lz4::Uncompress(bad.data(), bad.size(), &output[0], output.size()));
+    }
+}
+
+TEST(CompressionTest, AllTypes)
+{
+    const std::string input = JsonRecords(200);
+    for (CompressionType type : {kSnappyCompression, kLZ4Compression, kZstdCompression})
+    {
+        std::string compressed;
+        if (!CompressionTypeSupported(type))
+        {
+            // 不支持的算法不压缩，遇到这种块时报告NotSupported
+            ASSERT_FALSE(Compress(type, input, 3, nullptr, &compressed)) << CompressionTypeName(type);
+            ASSERT_TRUE(compressed.empty());
+            char *result;
+            size_t size;
+            ASSERT_TRUE(Uncompress(type, "\x01x", nullptr, &result, &size).IsNotSupported());
+            continue;
+        }
+        ASSERT_TRUE(Compress(type, input, 3, nullptr, &compressed)) << CompressionTypeName(type);
+        ASSERT_LT(compressed.size(), input.size() / 2) << CompressionTypeName(type);
+
+        char *result;
+        size_t size;
+        ASSERT_TRUE(Uncompress(type, compressed, nullptr, &result, &size).ok());
+        ASSERT_EQ(std::string(result, size), input);
+        delete[] result;
+
+        // 长度前缀与内容不符
+        compressed[0]++;
+        ASSERT_TRUE(Uncompress(type, compressed, nullptr, &result, &size).IsCorruption());
+    }
+}
+
+TEST(CompressionTest, ZstdDictionary)
+{
+    std::vector<std::string> samples;
+    for (int i = 0; i < 200; i++)
+        samples.push_back(JsonRecords(20 + i % 5));
+    std::string dict;
+    if (!CompressionTypeSupported(kZstdCompression))
+    {
+        ASSERT_FALSE(TrainCompressionDict(samples, 4096, &dict));
+        return;
+    }
+    ASSERT_TRUE(TrainCompressionDict(samples, 4096, &dict));
+    ASSERT_GT(dict.size(), 0u);
+    ASSERT_LE(dict.size(), 4096u);
+
+    CompressionDict cdict(dict, CompressionDict::kCompress, 3);
+    CompressionDict ddict(dict, CompressionDict::kUncompress, 3);
+    const std::string input = JsonRecords(3);
+    std::string plain, with_dict;
+    ASSERT_TRUE(Compress(kZstdCompression, input, 3, nullptr, &plain));
+    ASSERT_TRUE(Compress(kZstdCompression, input, 3, &cdict, &with_dict));
+    // 小块中的字段名都在字典里
+    ASSERT_LT(with_dict.size(), plain.size());
+
+    char *result;
+    size_t size;
+    ASSERT_TRUE(Uncompress(kZstdCompression, with_dict, &ddict, &result, &size).ok());
+    ASSERT_EQ(std::string(result, size), input);
+    delete[] result;
+    // 没有字典无法解压
+    ASSERT_FALSE(Uncompress(kZstdCompression, with_dict, nullptr, &result, &size).ok());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+#ifndef STORAGE_KVDB_UTIL_CRC32C_H_
+#define STORAGE_KVDB_UTIL_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kvdb
+{
+    namespace crc32c
+    {
+        // CRC32C(Castagnoli多项式)查表实现，表在编译期生成
+        struct Table
+        {
+            uint32_t t[4][256];
+
+            constexpr Table() : t()
+            {
+                const uint32_t kPoly = 0x82f63b78; // 0x1EDC6F41按位反转
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? (kPoly ^ (c >> 1)) : (c >> 1);
+                    t[0][i] = c;
+                }
+                // 每次处理4个字节(slicing-by-4)
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    for (int k = 1; k < 4; k++)
+                        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+                }
+            }
+        };
+
+        inline const Table &GetTable()
+        {
+            static constexpr Table table;
+            return table;
+        }
+
+        // 返回 concat(A, data[0,n-1]) 的crc32c，init_crc是A的crc32c
+        inline uint32_t Extend(uint32_t init_crc, const char *data, size_t n)
+        {
+            const Table &table = GetTable();
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+            const uint8_t *e = p + n;
+            uint32_t l = init_crc ^ 0xffffffffu;
+
+            while (e - p >= 4)
+            {
+                l ^= static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                     (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+                l = table.t[3][l & 0xff] ^ table.t[2][(l >> 8) & 0xff] ^
+                    table.t[1][(l >> 16) & 0xff] ^ table.t[0][l >> 24];
+                p += 4;
+            }
+            while (p != e)
+            {
+                l = table.t[0][(l ^ *p) & 0xff] ^ (l >> 8);
+                p++;
+            }
+            return l ^ 0xffffffffu;
+        }
+
+        // 返回data[0,n-1]的crc32c
+        inline uint32_t Value(const char *data, size_t n) { return Extend(0, data, n); }
+
+        static const uint32_t kMaskDelta = 0xa282ead8ul;
+
+        // 对包含内嵌crc的数据再计算crc容易出问题，所以存储前先对crc做一次变换
+        inline uint32_t Mask(uint32_t crc)
+        {
+            // 循环右移15位再加上常数
+            return ((crc >> 15) | (crc << 17)) + kMaskDelta;
+        }
+
+        // Mask的逆变换
+        inline uint32_t Unmask(uint32_t masked_crc)
+        {
+            uint32_t rot = masked_crc - kMaskDelta;
+            return ((rot >> 17) | (rot << 15));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,515 @@
+#ifndef STORAGE_KVDB_UTIL_ENV_H_
+#define STORAGE_KVDB_UTIL_ENV_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util/slice.h"
+#include "util/status.h"
+
+namespace kvdb
+{
+    // 顺序读取的文件，用于日志恢复
+    class SequentialFile
+    {
+    public:
+        SequentialFile() = default;
+        SequentialFile(const SequentialFile &) = delete;
+        SequentialFile &operator=(const SequentialFile &) = delete;
+        virtual ~SequentialFile() = default;
+
+        // 最多读取n个字节，*result可能指向scratch[0..n-1]，读到文件末尾时result为空
+        virtual Status Read(size_t n, Slice *result, char *scratch) = 0;
+
+        // 跳过n个字节
+        virtual Status Skip(uint64_t n) = 0;
+    };
+
+    // 对随机读取文件之后的访问方式的提示
+    enum class AccessPattern
+    {
+        kRandom,     // 点查，不需要预读
+        kSequential, // 从头到尾读一遍，例如合并的输入
+    };
+
+    // 随机读取的文件，可以被多个线程同时读取
+    class RandomAccessFile
+    {
+    public:
+        RandomAccessFile() = default;
+        RandomAccessFile(const RandomAccessFile &) = delete;
+        RandomAccessFile &operator=(const RandomAccessFile &) = delete;
+        virtual ~RandomAccessFile() = default;
+
+        // 从offset开始最多读取n个字节，*result可能指向scratch[0..n-1]
+        virtual Status Read(uint64_t offset, size_t n, Slice *result, char *scratch) const = 0;
+
+        // 为true时Read返回的数据总是指向文件自己持有、在文件释放之前一直有效的内存，
+        // 调用方可以传入nullptr作为scratch并直接使用结果，不需要拷贝
+        virtual bool ZeroCopy() const { return false; }
+
+        // 提示之后的访问方式，默认忽略
+        virtual void Hint(AccessPattern /*pattern*/) const {}
+    };
+
+    // 限制同时映射到内存的文件数，超过时退回到pread。可以被多个线程同时使用
+    class MmapLimiter
+    {
+    public:
+        explicit MmapLimiter(int max_acquires) : acquires_allowed_(max_acquires) {}
+
+        MmapLimiter(const MmapLimiter &) = delete;
+        MmapLimiter &operator=(const MmapLimiter &) = delete;
+
+        // 还有剩余额度时占用一个并返回true
+        bool Acquire()
+        {
+            int old = acquires_allowed_.fetch_sub(1, std::memory_order_relaxed);
+            if (old > 0)
+                return true;
+            acquires_allowed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // 归还Acquire成功时占用的额度
+        void Release() { acquires_allowed_.fetch_add(1, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int> acquires_allowed_;
+    };
+
+    // 顺序写入的文件，内部有缓冲区，Sync之前数据不保证落盘
+    class WritableFile
+    {
+    public:
+        WritableFile() = default;
+        WritableFile(const WritableFile &) = delete;
+        WritableFile &operator=(const WritableFile &) = delete;
+        virtual ~WritableFile() = default;
+
+        virtual Status Append(const Slice &data) = 0;
+        virtual Status Close() = 0;
+        virtual Status Flush() = 0;
+        virtual Status Sync() = 0;
+    };
+
+    namespace posix
+    {
+        inline Status PosixError(const std::string &context, int error_number)
+        {
+            if (error_number == ENOENT)
+                return Status::NotFound(context, std::strerror(error_number));
+            return Status::IOError(context, std::strerror(error_number));
+        }
+
+        class PosixSequentialFile final : public SequentialFile
+        {
+        public:
+            PosixSequentialFile(std::string filename, int fd) : fd_(fd), filename_(std::move(filename)) {}
+            ~PosixSequentialFile() override { close(fd_); }
+
+            Status Read(size_t n, Slice *result, char *scratch) override
+            {
+                while (true)
+                {
+                    ::ssize_t read_size = ::read(fd_, scratch, n);
+                    if (read_size < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        return PosixError(filename_, errno);
+                    }
+                    *result = Slice(scratch, read_size);
+                    return Status::OK();
+                }
+            }
+
+            Status Skip(uint64_t n) override
+            {
+                if (::lseek(fd_, n, SEEK_CUR) == static_cast<off_t>(-1))
+                    return PosixError(filename_, errno);
+                return Status::OK();
+            }
+
+        private:
+            const int fd_;
+            const std::string filename_;
+        };
+
+        class PosixRandomAccessFile final : public RandomAccessFile
+        {
+        public:
+            PosixRandomAccessFile(std::string filename, int fd) : fd_(fd), filename_(std::move(filename)) {}
+            ~PosixRandomAccessFile() override { close(fd_); }
+
+            Status Read(uint64_t offset, size_t n, Slice *result, char *scratch) const override
+            {
+                // pread不修改文件偏移，多个线程可以共用一个fd
+                ssize_t read_size = ::pread(fd_, scratch, n, static_cast<off_t>(offset));
+                *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+                if (read_size < 0)
+                    return PosixError(filename_, errno);
+                return Status::OK();
+            }
+
+        private:
+            const int fd_;
+            const std::string filename_;
+        };
+
+        // 整个文件映射到内存，Read直接返回映射中的地址，不拷贝也不分配缓冲区
+        class PosixMmapReadableFile final : public RandomAccessFile
+        {
+        public:
+            // 接管映射[base, base + length)以及limiter中的一个额度
+            PosixMmapReadableFile(std::string filename, char *base, size_t length,
+                                  std::shared_ptr<MmapLimiter> limiter)
+                : base_(base), length_(length), limiter_(std::move(limiter)), filename_(std::move(filename)) {}
+
+            ~PosixMmapReadableFile() override
+            {
+                ::munmap(base_, length_);
+                limiter_->Release();
+            }
+
+            Status Read(uint64_t offset, size_t n, Slice *result, char * /*scratch*/) const override
+            {
+                if (offset > length_ || n > length_ - offset)
+                {
+                    *result = Slice();
+                    return PosixError(filename_, EINVAL);
+                }
+                *result = Slice(base_ + offset, n);
+                return Status::OK();
+            }
+
+            bool ZeroCopy() const override { return true; }
+
+            void Hint(AccessPattern pattern) const override
+            {
+                ::madvise(base_, length_, pattern == AccessPattern::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            }
+
+        private:
+            char *const base_;
+            const size_t length_;
+            const std::shared_ptr<MmapLimiter> limiter_;
+            const std::string filename_;
+        };
+
+        class PosixWritableFile final : public WritableFile
+        {
+        public:
+            static const size_t kWritableFileBufferSize = 65536;
+
+            PosixWritableFile(std::string filename, int fd) : pos_(0), fd_(fd), filename_(std::move(filename)) {}
+
+            ~PosixWritableFile() override
+            {
+                if (fd_ >= 0)
+                    Close();
+            }
+
+            Status Append(const Slice &data) override
+            {
+                size_t write_size = data.size();
+                const char *write_data = data.data();
+
+                // 尽量放进缓冲区
+                size_t copy_size = std::min(write_size, kWritableFileBufferSize - pos_);
+                std::memcpy(buf_ + pos_, write_data, copy_size);
+                write_data += copy_size;
+                write_size -= copy_size;
+                pos_ += copy_size;
+                if (write_size == 0)
+                    return Status::OK();
+
+                // 缓冲区满了，先写出缓冲区
+                Status status = FlushBuffer();
+                if (!status.ok())
+                    return status;
+
+                // 小块数据继续缓冲，大块数据直接写
+                if (write_size < kWritableFileBufferSize)
+                {
+                    std::memcpy(buf_, write_data, write_size);
+                    pos_ = write_size;
+                    return Status::OK();
+                }
+                return WriteUnbuffered(write_data, write_size);
+            }
+
+            Status Close() override
+            {
+                Status status = FlushBuffer();
+                const int close_result = ::close(fd_);
+                if (close_result < 0 && status.ok())
+                    status = PosixError(filename_, errno);
+                fd_ = -1;
+                return status;
+            }
+
+            Status Flush() override { return FlushBuffer(); }
+
+            Status Sync() override
+            {
+                Status status = FlushBuffer();
+                if (!status.ok())
+                    return status;
+                // 只需要数据落盘，不需要同步mtime等元数据
+                if (::fdatasync(fd_) != 0)
+                    return PosixError(filename_, errno);
+                return Status::OK();
+            }
+
+        private:
+            Status FlushBuffer()
+            {
+                Status status = WriteUnbuffered(buf_, pos_);
+                pos_ = 0;
+                return status;
+            }
+
+            Status WriteUnbuffered(const char *data, size_t size)
+            {
+                while (size > 0)
+                {
+                    ssize_t write_result = ::write(fd_, data, size);
+                    if (write_result < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        return PosixError(filename_, errno);
+                    }
+                    data += write_result;
+                    size -= write_result;
+                }
+                return Status::OK();
+            }
+
+            char buf_[kWritableFileBufferSize];
+            size_t pos_;
+            int fd_;
+            const std::string filename_;
+        };
+    }
+
+    // 文件系统操作的封装，目前只有posix实现
+    class Env
+    {
+    public:
+        Env() = default;
+        Env(const Env &) = delete;
+        Env &operator=(const Env &) = delete;
+        virtual ~Env() = default;
+
+        // 进程内共享的默认Env，不能被delete
+        static Env *Default()
+        {
+            static Env env;
+            return &env;
+        }
+
+        virtual Status NewSequentialFile(const std::string &filename, SequentialFile **result)
+        {
+            int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                *result = nullptr;
+                return posix::PosixError(filename, errno);
+            }
+            *result = new posix::PosixSequentialFile(filename, fd);
+            return Status::OK();
+        }
+
+        virtual Status NewRandomAccessFile(const std::string &filename, RandomAccessFile **result)
+        {
+            int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                *result = nullptr;
+                return posix::PosixError(filename, errno);
+            }
+            *result = new posix::PosixRandomAccessFile(filename, fd);
+            return Status::OK();
+        }
+
+        // 把整个文件映射到内存读取。limiter没有剩余额度或者映射失败时退回到NewRandomAccessFile
+        virtual Status NewMmapReadableFile(const std::string &filename, const std::shared_ptr<MmapLimiter> &limiter,
+                                           RandomAccessFile **result)
+        {
+            if (!limiter->Acquire())
+                return NewRandomAccessFile(filename, result);
+
+            uint64_t size;
+            Status s = GetFileSize(filename, &size);
+            int fd = -1;
+            if (s.ok())
+            {
+                fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    s = posix::PosixError(filename, errno);
+            }
+            if (!s.ok())
+            {
+                limiter->Release();
+                *result = nullptr;
+                return s;
+            }
+
+            // 映射建立之后关闭fd不影响读取
+            void *base = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+            ::close(fd);
+            if (base == MAP_FAILED)
+            {
+                limiter->Release();
+                return NewRandomAccessFile(filename, result);
+            }
+            *result = new posix::PosixMmapReadableFile(filename, static_cast<char *>(base), size, limiter);
+            return Status::OK();
+        }
+
+        // 创建新文件，已存在时清空
+        virtual Status NewWritableFile(const std::string &filename, WritableFile **result)
+        {
+            int fd = ::open(filename.c_str(), O_TRUNC | O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0)
+            {
+                *result = nullptr;
+                return posix::PosixError(filename, errno);
+            }
+            *result = new posix::PosixWritableFile(filename, fd);
+            return Status::OK();
+        }
+
+        virtual bool FileExists(const std::string &filename)
+        {
+            return ::access(filename.c_str(), F_OK) == 0;
+        }
+
+        // 返回目录下的文件名(不含路径)
+        virtual Status GetChildren(const std::string &directory_path, std::vector<std::string> *result)
+        {
+            result->clear();
+            ::DIR *dir = ::opendir(directory_path.c_str());
+            if (dir == nullptr)
+                return posix::PosixError(directory_path, errno);
+            struct ::dirent *entry;
+            while ((entry = ::readdir(dir)) != nullptr)
+                result->emplace_back(entry->d_name);
+            ::closedir(dir);
+            return Status::OK();
+        }
+
+        virtual Status RemoveFile(const std::string &filename)
+        {
+            if (::unlink(filename.c_str()) != 0)
+                return posix::PosixError(filename, errno);
+            return Status::OK();
+        }
+
+        // 目录已存在时也返回OK
+        virtual Status CreateDir(const std::string &dirname)
+        {
+            if (::mkdir(dirname.c_str(), 0755) != 0 && errno != EEXIST)
+                return posix::PosixError(dirname, errno);
+            return Status::OK();
+        }
+
+        virtual Status GetFileSize(const std::string &filename, uint64_t *size)
+        {
+            struct ::stat file_stat;
+            if (::stat(filename.c_str(), &file_stat) != 0)
+            {
+                *size = 0;
+                return posix::PosixError(filename, errno);
+            }
+            *size = file_stat.st_size;
+            return Status::OK();
+        }
+
+        virtual Status RenameFile(const std::string &from, const std::string &to)
+        {
+            if (std::rename(from.c_str(), to.c_str()) != 0)
+                return posix::PosixError(from, errno);
+            return Status::OK();
+        }
+
+        // 同步目录，使新建/删除/重命名的目录项落盘
+        virtual Status SyncDir(const std::string &dirname)
+        {
+            int fd = ::open(dirname.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return posix::PosixError(dirname, errno);
+            Status status;
+            if (::fsync(fd) != 0)
+                status = posix::PosixError(dirname, errno);
+            ::close(fd);
+            return status;
+        }
+
+        // 当前的墙上时间(微秒)，用于条目的过期时间。测试可以重写它来控制时间
+        virtual uint64_t NowMicros()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                             std::chrono::system_clock::now().time_since_epoch())
+                                             .count());
+        }
+    };
+
+    // 把data写入新文件fname
+    inline Status WriteStringToFile(Env *env, const Slice &data, const std::string &fname, bool should_sync)
+    {
+        WritableFile *file;
+        Status s = env->NewWritableFile(fname, &file);
+        if (!s.ok())
+            return s;
+        s = file->Append(data);
+        if (s.ok() && should_sync)
+            s = file->Sync();
+        if (s.ok())
+            s = file->Close();
+        delete file;
+        if (!s.ok())
+            env->RemoveFile(fname);
+        return s;
+    }
+
+    inline Status ReadFileToString(Env *env, const std::string &fname, std::string *data)
+    {
+        data->clear();
+        SequentialFile *file;
+        Status s = env->NewSequentialFile(fname, &file);
+        if (!s.ok())
+            return s;
+        static const int kBufferSize = 8192;
+        char *space = new char[kBufferSize];
+        while (true)
+        {
+            Slice fragment;
+            s = file->Read(kBufferSize, &fragment, space);
+            if (!s.ok())
+                break;
+            data->append(fragment.data(), fragment.size());
+            if (fragment.empty())
+                break;
+        }
+        delete[] space;
+        delete file;
+        return s;
+    }
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef STORAGE_KVDB_UTIL_HASH_H_
+#define STORAGE_KVDB_UTIL_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "util/coding.h"
+
+namespace kvdb
+{
+    // 类似murmur hash的32位哈希，用于布隆过滤器等需要稳定落盘结果的地方
+    // (std::hash的结果在不同平台/版本之间可能不同)
+    inline uint32_t Hash(const char *data, size_t n, uint32_t seed)
+    {
+        const uint32_t m = 0xc6a4a793;
+        const uint32_t r = 24;
+        const char *limit = data + n;
+        uint32_t h = seed ^ (n * m);
+
+        // 每次处理4个字节
+        while (data + 4 <= limit)
+        {
+            uint32_t w = DecodeFixed32(data);
+            data += 4;
+            h += w;
+            h *= m;
+            h ^= (h >> 16);
+        }
+
+        // 剩下的字节
+        switch (limit - data)
+        {
+        case 3:
+            h += static_cast<uint8_t>(data[2]) << 16;
+            [[fallthrough]];
+        case 2:
+            h += static_cast<uint8_t>(data[1]) << 8;
+            [[fallthrough]];
+        case 1:
+            h += static_cast<uint8_t>(data[0]);
+            h *= m;
+            h ^= (h >> r);
+            break;
+        }
+        return h;
+    }
+
+    // 64位整数的混合函数(MurmurHash3的fmix64)。std::hash对整数是恒等映射，
+    // 按高位或低位选择分片、桶之前先打散
+    inline uint64_t Mix64(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // 按wyhash的结构实现的64位哈希：每16字节做一次64x64->128位乘法并把高低两半异或。
+    // 短key只需要两次乘法，比std::hash<std::string>快。结果只在进程内使用，不要落盘
+    inline uint64_t Hash64(const char *data, size_t n, uint64_t seed = 0)
+    {
+        static const uint64_t kSecret[4] = {0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL,
+                                            0x589965cc75374cc3ULL};
+        auto mix = [](uint64_t a, uint64_t b)
+        {
+            const __uint128_t r = static_cast<__uint128_t>(a) * b;
+            return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+        };
+        // 结果不落盘，按本机字节序直接读取
+        auto read8 = [](const char *p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        };
+        auto read4 = [](const char *p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return static_cast<uint64_t>(v);
+        };
+        const char *p = data;
+        uint64_t a, b;
+        seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+        if (n <= 16)
+        {
+            if (n >= 8)
+            {
+                // 首尾各取8字节，可能重叠
+                a = read8(p);
+                b = read8(p + n - 8);
+            }
+            else if (n >= 4)
+            {
+                a = read4(p);
+                b = read4(p + n - 4);
+            }
+            else if (n > 0)
+            {
+                a = (static_cast<uint64_t>(static_cast<uint8_t>(p[0])) << 16) |
+                    (static_cast<uint64_t>(static_cast<uint8_t>(p[n >> 1])) << 8) | static_cast<uint8_t>(p[n - 1]);
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t i = n;
+            if (i > 48)
+            {
+                // 三路并行，减少乘法之间的依赖
+                uint64_t see1 = seed, see2 = seed;
+                do
+                {
+                    seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16)
+            {
+                seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+                p += 16;
+                i -= 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        const __uint128_t r = static_cast<__uint128_t>(a ^ kSecret[1]) * (b ^ seed);
+        return mix(static_cast<uint64_t>(r) ^ kSecret[0] ^ n, static_cast<uint64_t>(r >> 64) ^ kSecret[1]);
+    }
+
+    // 缓存的索引、分片和淘汰策略使用的hash函数对象，默认与std::hash<K>相同。
+    // K为std::string时用Hash64，并且是transparent的：std::string_view的结果与内容相同的
+    // std::string一致，可以直接用std::string_view查找，不需要构造临时的std::string
+    template <typename K>
+    struct TransparentHash : std::hash<K>
+    {
+    };
+
+    template <>
+    struct TransparentHash<std::string>
+    {
+        typedef void is_transparent;
+
+        size_t operator()(std::string_view key) const noexcept { return Hash64(key.data(), key.size()); }
+    };
+
+    // Q能否代替K在缓存和memtable中查找：TransparentHash<K>对Q和K的结果一致，并且Q可以直接与K比较
+    template <typename K, typename Q>
+    struct IsTransparentKey : std::is_same<K, Q>
+    {
+    };
+
+    template <>
+    struct IsTransparentKey<std::string, std::string_view> : std::true_type
+    {
+    };
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef STORAGE_KVDB_UTIL_LZ4_H_
+#define STORAGE_KVDB_UTIL_LZ4_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace kvdb
+{
+    namespace lz4
+    {
+        // LZ4块格式(与liblz4的LZ4_compress_default/LZ4_decompress_safe兼容)。
+        // 每个序列为 token | 字面量长度的扩展字节 | 字面量 | 2字节小端偏移 | 匹配长度的扩展字节，
+        // token高4位是字面量长度，低4位是匹配长度减4，等于15时后面跟着255...的扩展字节。
+        // 最后一个序列只有字面量，最后5个字节总是字面量，最后一个匹配至少在结尾12字节之前开始
+        static const size_t kMinMatch = 4;
+        static const size_t kLastLiterals = 5;
+        static const size_t kMatchFindLimit = 12;
+        static const size_t kMaxOffset = 65535;
+        static const int kHashLog = 12;
+
+        // 压缩n个字节最多需要的空间
+        inline size_t MaxCompressedLength(size_t n) { return n + n / 255 + 16; }
+
+        inline uint32_t Load32(const uint8_t *p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t HashSequence(uint32_t v) { return (v * 2654435761u) >> (32 - kHashLog); }
+
+        // 写入长度超过15的部分
+        inline uint8_t *PutLength(uint8_t *op, size_t len)
+        {
+            for (; len >= 255; len -= 255)
+                *op++ = 255;
+            *op++ = static_cast<uint8_t>(len);
+            return op;
+        }
+
+        inline uint8_t *PutLiterals(uint8_t *op, const uint8_t *literals, size_t len, uint8_t *token)
+        {
+            if (len >= 15)
+            {
+                *token = 15 << 4;
+                op = PutLength(op, len - 15);
+            }
+            else
+            {
+                *token = static_cast<uint8_t>(len << 4);
+            }
+            std::memcpy(op, literals, len);
+            return op + len;
+        }
+
+        // 把input压缩后追加到*output。贪心匹配，连续找不到匹配时逐渐加大步长，不可压缩的数据也很快
+        inline void Compress(const char *input, size_t n, std::string *output)
+        {
+            const size_t base = output->size();
+            output->resize(base + MaxCompressedLength(n));
+            const uint8_t *const in = reinterpret_cast<const uint8_t *>(input);
+            const uint8_t *const end = in + n;
+            const uint8_t *ip = in;
+            const uint8_t *anchor = in;
+            uint8_t *op = reinterpret_cast<uint8_t *>(&(*output)[base]);
+
+            if (n > kMatchFindLimit)
+            {
+                const uint8_t *const match_limit = end - kLastLiterals;
+                const uint8_t *const find_limit = end - kMatchFindLimit;
+                // 每个哈希槽保存最近一个4字节序列的位置，初值0也只是一个需要验证的候选位置
+                uint32_t table[1 << kHashLog] = {0};
+                size_t misses = 0;
+                while (ip < find_limit)
+                {
+                    const uint32_t sequence = Load32(ip);
+                    uint32_t *slot = &table[HashSequence(sequence)];
+                    const uint8_t *ref = in + *slot;
+                    *slot = static_cast<uint32_t>(ip - in);
+                    if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset || Load32(ref) != sequence)
+                    {
+                        ip += 1 + (misses++ >> 6);
+                        continue;
+                    }
+                    misses = 0;
+
+                    // 向前延长匹配，向后延长到前面的字面量中
+                    const uint8_t *match_end = ip + kMinMatch;
+                    const uint8_t *ref_end = ref + kMinMatch;
+                    while (match_end < match_limit && *match_end == *ref_end)
+                    {
+                        ++match_end;
+                        ++ref_end;
+                    }
+                    while (ip > anchor && ref > in && ip[-1] == ref[-1])
+                    {
+                        --ip;
+                        --ref;
+                    }
+
+                    uint8_t *token = op++;
+                    op = PutLiterals(op, anchor, ip - anchor, token);
+                    const size_t offset = ip - ref;
+                    *op++ = static_cast<uint8_t>(offset);
+                    *op++ = static_cast<uint8_t>(offset >> 8);
+                    const size_t match_len = match_end - ip - kMinMatch;
+                    if (match_len >= 15)
+                    {
+                        *token |= 15;
+                        op = PutLength(op, match_len - 15);
+                    }
+                    else
+                    {
+                        *token |= static_cast<uint8_t>(match_len);
+                    }
+                    ip = anchor = match_end;
+                }
+            }
+
+            uint8_t *token = op++;
+            op = PutLiterals(op, anchor, end - anchor, token);
+            output->resize(op - reinterpret_cast<uint8_t *>(&(*output)[0]));
+        }
+
+        // 解压到output，解压后的长度必须正好是output_length。输入损坏时返回false，不会越界读写
+        inline bool Uncompress(const char *input, size_t n, char *output, size_t output_length)
+        {
+            const uint8_t *ip = reinterpret_cast<const uint8_t *>(input);
+            const uint8_t *const iend = ip + n;
+            uint8_t *op = reinterpret_cast<uint8_t *>(output);
+            uint8_t *const out = op;
+            uint8_t *const oend = op + output_length;
+
+            auto read_length = [&](size_t *len)
+            {
+                uint8_t b;
+                do
+                {
+                    if (ip >= iend)
+                        return false;
+                    b = *ip++;
+                    *len += b;
+                } while (b == 255);
+                return true;
+            };
+
+            while (ip < iend)
+            {
+                const uint8_t token = *ip++;
+                size_t literals = token >> 4;
+                if (literals == 15 && !read_length(&literals))
+                    return false;
+                if (literals > static_cast<size_t>(iend - ip) || literals > static_cast<size_t>(oend - op))
+                    return false;
+                std::memcpy(op, ip, literals);
+                op += literals;
+                ip += literals;
+                if (ip == iend)
+                    break; // 最后一个序列没有匹配
+
+                if (iend - ip < 2)
+                    return false;
+                const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+                ip += 2;
+                if (offset == 0 || offset > static_cast<size_t>(op - out))
+                    return false;
+                size_t match_len = token & 15;
+                if (match_len == 15 && !read_length(&match_len))
+                    return false;
+                match_len += kMinMatch;
+                if (match_len > static_cast<size_t>(oend - op))
+                    return false;
+
+                const uint8_t *match = op - offset;
+                if (offset >= match_len)
+                {
+                    std::memcpy(op, match, match_len);
+                    op += match_len;
+                }
+                else
+                {
+                    // 与输出重叠，逐字节复制才能重复最近的内容
+                    for (size_t i = 0; i < match_len; ++i)
+                        *op++ = *match++;
+                }
+            }
+            return op == oend;
+        }
+    }
+}
+
+#endif
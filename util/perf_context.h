@@ -0,0 +1,176 @@
+#ifndef STORAGE_KVDB_UTIL_PERF_CONTEXT_H_
+#define STORAGE_KVDB_UTIL_PERF_CONTEXT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace kvdb
+{
+    // 每个线程的PerfContext记录到什么程度，只影响调用SetPerfLevel的线程
+    enum class PerfLevel : uint8_t
+    {
+        // 什么都不记录，默认值
+        kDisable = 0,
+        // 只记录计数，不读时钟
+        kEnableCount = 1,
+        // 计数和各阶段的耗时，每个计时的阶段多读两次时钟
+        kEnableTime = 2,
+    };
+
+    // 当前线程上的操作在各阶段的计数和耗时(纳秒)，只增不减。
+    // 调用方在一次操作前Reset，操作后读取，就得到这次操作的明细
+    struct PerfContext
+    {
+        // memtable的跳表查找中与key的比较次数
+        uint64_t key_comparisons;
+        // 跳表查找中前进经过的节点数
+        uint64_t skiplist_nodes_visited;
+        // 跳表查找从最高层下降到第0层经过的层数
+        uint64_t skiplist_levels_visited;
+        // Table的行缓存
+        uint64_t row_cache_hit_count;
+        uint64_t row_cache_miss_count;
+        // 在memtable或imm_中找到了key
+        uint64_t memtable_hit_count;
+        // 有序表文件的块缓存
+        uint64_t block_cache_hit_count;
+        uint64_t block_cache_miss_count;
+        // 从文件读取的块数和字节数(压缩后)
+        uint64_t block_read_count;
+        uint64_t block_read_bytes;
+        // 布隆过滤器判断key不在文件中，省去读数据块
+        uint64_t bloom_filter_useful;
+        // 链式哈希表的渐进式rehash搬迁的桶数
+        uint64_t hash_rehash_steps;
+
+        // 以下为耗时，只在kEnableTime下记录
+        uint64_t get_from_memtable_nanos;
+        uint64_t get_from_table_files_nanos;
+        // 读文件、校验crc和解压一个块
+        uint64_t block_read_nanos;
+        uint64_t block_decompress_nanos;
+        // 排队等待成为leader或者等待leader写完
+        uint64_t write_wait_nanos;
+        // 因第0层文件过多或memtable已满而等待
+        uint64_t write_stall_nanos;
+        uint64_t write_wal_nanos;
+        uint64_t write_memtable_nanos;
+        // Scan中创建迭代器并定位到起点
+        uint64_t seek_nanos;
+
+        PerfContext() { Reset(); }
+
+        void Reset() { *this = PerfContext(0); }
+
+        // 每行一个"name = value"，exclude_zero为true时省略为0的项
+        std::string ToString(bool exclude_zero = true) const
+        {
+            std::string result;
+            auto append = [&](const char *name, uint64_t value)
+            {
+                if (exclude_zero && value == 0)
+                    return;
+                char buf[96];
+                std::snprintf(buf, sizeof(buf), "%s = %llu\n", name, static_cast<unsigned long long>(value));
+                result += buf;
+            };
+            append("key_comparisons", key_comparisons);
+            append("skiplist_nodes_visited", skiplist_nodes_visited);
+            append("skiplist_levels_visited", skiplist_levels_visited);
+            append("row_cache_hit_count", row_cache_hit_count);
+            append("row_cache_miss_count", row_cache_miss_count);
+            append("memtable_hit_count", memtable_hit_count);
+            append("block_cache_hit_count", block_cache_hit_count);
+            append("block_cache_miss_count", block_cache_miss_count);
+            append("block_read_count", block_read_count);
+            append("block_read_bytes", block_read_bytes);
+            append("bloom_filter_useful", bloom_filter_useful);
+            append("hash_rehash_steps", hash_rehash_steps);
+            append("get_from_memtable_nanos", get_from_memtable_nanos);
+            append("get_from_table_files_nanos", get_from_table_files_nanos);
+            append("block_read_nanos", block_read_nanos);
+            append("block_decompress_nanos", block_decompress_nanos);
+            append("write_wait_nanos", write_wait_nanos);
+            append("write_stall_nanos", write_stall_nanos);
+            append("write_wal_nanos", write_wal_nanos);
+            append("write_memtable_nanos", write_memtable_nanos);
+            append("seek_nanos", seek_nanos);
+            return result;
+        }
+
+    private:
+        // 全部清零
+        explicit PerfContext(int)
+            : key_comparisons(0), skiplist_nodes_visited(0), skiplist_levels_visited(0), row_cache_hit_count(0),
+              row_cache_miss_count(0), memtable_hit_count(0), block_cache_hit_count(0), block_cache_miss_count(0),
+              block_read_count(0), block_read_bytes(0), bloom_filter_useful(0), hash_rehash_steps(0),
+              get_from_memtable_nanos(0), get_from_table_files_nanos(0), block_read_nanos(0),
+              block_decompress_nanos(0), write_wait_nanos(0), write_stall_nanos(0), write_wal_nanos(0),
+              write_memtable_nanos(0), seek_nanos(0) {}
+    };
+
+    namespace perf
+    {
+        inline PerfLevel &Level()
+        {
+            static thread_local PerfLevel level = PerfLevel::kDisable;
+            return level;
+        }
+
+        inline uint64_t NowNanos()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now().time_since_epoch())
+                                             .count());
+        }
+    }
+
+    inline void SetPerfLevel(PerfLevel level) { perf::Level() = level; }
+    inline PerfLevel GetPerfLevel() { return perf::Level(); }
+
+    // 当前线程的PerfContext
+    inline PerfContext *GetPerfContext()
+    {
+        static thread_local PerfContext context;
+        return &context;
+    }
+
+    // 级别至少为kEnableCount时把n加到当前线程的计数上
+    inline void PerfCount(uint64_t PerfContext::*counter, uint64_t n = 1)
+    {
+        if (GetPerfLevel() >= PerfLevel::kEnableCount)
+            GetPerfContext()->*counter += n;
+    }
+
+    // 作用域内的耗时加到当前线程的计数上，级别低于kEnableTime时不读时钟
+    class PerfTimer
+    {
+    public:
+        explicit PerfTimer(uint64_t PerfContext::*metric)
+            : metric_(GetPerfLevel() >= PerfLevel::kEnableTime ? metric : nullptr),
+              start_(metric_ != nullptr ? perf::NowNanos() : 0) {}
+
+        PerfTimer(const PerfTimer &) = delete;
+        PerfTimer &operator=(const PerfTimer &) = delete;
+
+        ~PerfTimer() { Stop(); }
+
+        // 提前结束计时，之后析构不再计入
+        void Stop()
+        {
+            if (metric_ != nullptr)
+            {
+                GetPerfContext()->*metric_ += perf::NowNanos() - start_;
+                metric_ = nullptr;
+            }
+        }
+
+    private:
+        uint64_t PerfContext::*metric_;
+        const uint64_t start_;
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef STORAGE_KVDB_UTIL_PREFIX_EXTRACTOR_H_
+#define STORAGE_KVDB_UTIL_PREFIX_EXTRACTOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 从编码后的key(见Codec<K>，std::string的key就是它本身)中取出前缀，
+    // 用于memtable和有序表文件的前缀布隆过滤器以及前缀扫描。
+    // 前缀相同的key按字节序必须是连续的：key以Transform(key)开头即可保证
+    class PrefixExtractor
+    {
+    public:
+        virtual ~PrefixExtractor() = default;
+
+        // 写入有序表文件的过滤器块名中，换了名字的提取器不会使用旧文件的前缀过滤器
+        virtual const char *Name() const = 0;
+
+        // key是否有前缀，没有前缀的key不加入前缀过滤器，查找时也不检查过滤器
+        virtual bool InDomain(const Slice &key) const = 0;
+
+        // REQUIRES: InDomain(key)
+        virtual Slice Transform(const Slice &key) const = 0;
+    };
+
+    // 前n个字节为前缀，短于n的key没有前缀
+    class FixedPrefixExtractor : public PrefixExtractor
+    {
+    public:
+        explicit FixedPrefixExtractor(size_t n) : n_(n), name_("kvdb.FixedPrefix." + std::to_string(n)) {}
+
+        const char *Name() const override { return name_.c_str(); }
+        bool InDomain(const Slice &key) const override { return key.size() >= n_; }
+        Slice Transform(const Slice &key) const override { return Slice(key.data(), n_); }
+
+    private:
+        const size_t n_;
+        const std::string name_;
+    };
+
+    // 到第count个delim为止(包括delim)为前缀，例如delim为':'、count为1时
+    // "tenant:entity:field"的前缀为"tenant:"，count为2时为"tenant:entity:"。
+    // delim少于count个的key没有前缀
+    class DelimitedPrefixExtractor : public PrefixExtractor
+    {
+    public:
+        DelimitedPrefixExtractor(char delim, int count)
+            : delim_(delim), count_(count),
+              name_("kvdb.DelimitedPrefix." + std::string(1, delim) + "." + std::to_string(count)) {}
+
+        const char *Name() const override { return name_.c_str(); }
+        bool InDomain(const Slice &key) const override { return PrefixLength(key) > 0; }
+        Slice Transform(const Slice &key) const override { return Slice(key.data(), PrefixLength(key)); }
+
+    private:
+        // 前缀的长度，没有前缀时返回0
+        size_t PrefixLength(const Slice &key) const
+        {
+            int found = 0;
+            for (size_t i = 0; i < key.size(); i++)
+            {
+                if (key[i] == delim_ && ++found == count_)
+                    return i + 1;
+            }
+            return 0;
+        }
+
+        const char delim_;
+        const int count_;
+        const std::string name_;
+    };
+
+    inline std::shared_ptr<const PrefixExtractor> NewFixedPrefixExtractor(size_t n)
+    {
+        return std::make_shared<FixedPrefixExtractor>(n);
+    }
+
+    inline std::shared_ptr<const PrefixExtractor> NewDelimitedPrefixExtractor(char delim, int count = 1)
+    {
+        return std::make_shared<DelimitedPrefixExtractor>(delim, count);
+    }
+}
+
+#endif
@@ -0,0 +1,345 @@
+#include "util/LRUCache.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "util/cache_policy.h"
+using namespace kvdb;
+using namespace kvdb::cache;
+
+typedef LRUHandle<int, std::string> Handle;
+typedef ShardedLRUCache<int, std::string> Cache;
+
+static Handle *NewNode(int key, const std::string &value, size_t charge = 1)
+{
+    return new Handle(key, value, KType::kTypeValue, charge);
+}
+
+TEST(ShardedCacheTest, DefaultShardBits)
+{
+    // 容量较小时不分片，保持精确的LRU
+    ShardedLRUCache<int, std::string> small(10000);
+    EXPECT_EQ(small.NumShards(), 1);
+
+    ShardedLRUCache<int, std::string> large(1 << 30);
+    EXPECT_EQ(large.NumShards(), 1 << Cache::kMaxShardBits);
+}
+
+TEST(ShardedCacheTest, InsertGetRemove)
+{
+    ShardedLRUCache<int, std::string> cache(1000, 4);
+    EXPECT_EQ(cache.NumShards(), 16);
+    for (int i = 0; i < 100; ++i)
+        cache.Insert(NewNode(i, std::to_string(i)));
+    for (int i = 0; i < 100; ++i)
+    {
+        PinnedHandle<int, std::string> x = cache.Get(i);
+        ASSERT_TRUE(x != nullptr);
+        EXPECT_EQ(*x, std::to_string(i));
+    }
+
+    EXPECT_TRUE(cache.Insert(5, "five", 1));
+    EXPECT_EQ(*cache.Get(5), "five");
+    EXPECT_FALSE(cache.Insert(500, "absent", 1));
+
+    cache.Remove(5);
+    EXPECT_FALSE(cache.Contains(5));
+    EXPECT_TRUE(cache.Get(5) == nullptr);
+}
+
+TEST(ShardedCacheTest, GetOrLoad)
+{
+    ShardedLRUCache<int, std::string> cache(100, 2);
+    int loads = 0;
+    auto load = [&]()
+    {
+        ++loads;
+        return NewNode(7, "seven");
+    };
+    EXPECT_EQ(*cache.GetOrLoad(7, load), "seven");
+    EXPECT_EQ(*cache.GetOrLoad(7, load), "seven");
+    EXPECT_EQ(loads, 1);
+
+    // load返回nullptr时不缓存
+    EXPECT_TRUE(cache.GetOrLoad(8, []()
+                                { return static_cast<Handle *>(nullptr); }) == nullptr);
+    EXPECT_FALSE(cache.Contains(8));
+}
+
+TEST(ShardedCacheTest, CapacityPerShard)
+{
+    ShardedLRUCache<int, std::string> cache(64, 2);
+    for (int i = 0; i < 10000; ++i)
+        cache.Insert(NewNode(i, "v"));
+    int count = 0;
+    for (int i = 0; i < 10000; ++i)
+        count += cache.Contains(i);
+    EXPECT_LE(count, 64);
+    EXPECT_GT(count, 0);
+}
+
+TEST(ShardedCacheTest, PinnedHandle)
+{
+    ShardedLRUCache<int, std::string> cache(2, 0);
+    cache.Insert(NewNode(1, "one"));
+    PinnedHandle<int, std::string> pinned = cache.Get(1);
+
+    // 被新值替换或被淘汰之后，已经取得的句柄仍然有效
+    EXPECT_TRUE(cache.Insert(1, "uno", 1));
+    cache.Insert(NewNode(2, "two"));
+    cache.Insert(NewNode(3, "three"));
+    EXPECT_FALSE(cache.Contains(1));
+    EXPECT_EQ(*pinned, "one");
+    EXPECT_EQ(pinned.key(), 1);
+
+    pinned.Release();
+    EXPECT_TRUE(pinned == nullptr);
+}
+
+TEST(ShardedCacheTest, Charge)
+{
+    ShardedLRUCache<int, std::string> cache(100, 0);
+    for (int i = 0; i < 10; ++i)
+        cache.Insert(NewNode(i, "v", 10));
+    EXPECT_EQ(cache.GetUsage(), 100u);
+
+    // 大条目挤掉多个旧条目
+    cache.Insert(NewNode(10, "big", 35));
+    EXPECT_LE(cache.GetUsage(), 100u);
+    EXPECT_TRUE(cache.Contains(10));
+    EXPECT_FALSE(cache.Contains(0));
+    EXPECT_FALSE(cache.Contains(3));
+    EXPECT_TRUE(cache.Contains(4));
+}
+
+TEST(ShardedCacheTest, MultiThreaded)
+{
+    ShardedLRUCache<int, std::string> cache(4096, 4);
+    const int numThreads = 4;
+    const int N = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&cache, t]()
+                             {
+                                 for (int i = 0; i < N; ++i)
+                                 {
+                                     int key = (i * 7 + t) % 8192;
+                                     auto x = cache.GetOrLoad(key, [key]()
+                                                              { return NewNode(key, std::to_string(key)); });
+                                     ASSERT_EQ(*x, std::to_string(key));
+                                     if (i % 16 == 0)
+                                         cache.Remove(key);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+TEST(ShardedCacheTest, MultiGetOrLoad)
+{
+    Cache cache(1000, 3);
+    for (int i = 0; i < 10; ++i)
+        cache.Insert(NewNode(i, std::to_string(i)));
+
+    // 0..9命中，10..19一次性加载，奇数不存在
+    std::vector<int> keys;
+    for (int i = 0; i < 20; ++i)
+        keys.push_back(i);
+    keys.push_back(12);
+    std::vector<const int *> ptrs;
+    for (const int &k : keys)
+        ptrs.push_back(&k);
+    std::vector<PinnedHandle<int, std::string>> handles(keys.size());
+    int calls = 0;
+    cache.MultiGetOrLoad(ptrs.data(), ptrs.size(), handles.data(),
+                         [&](const int *const *miss, size_t n, Handle **nodes)
+                         {
+                             ++calls;
+                             EXPECT_EQ(n, 11u);
+                             for (size_t i = 0; i < n; ++i)
+                             {
+                                 // 按在keys中的顺序传入
+                                 if (i > 0 && i < 10)
+                                 {
+                                     EXPECT_LT(*miss[i - 1], *miss[i]);
+                                 }
+                                 if (*miss[i] % 2 == 0)
+                                     nodes[i] = NewNode(*miss[i], "loaded");
+                             }
+                         });
+    EXPECT_EQ(calls, 1);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (keys[i] < 10)
+            EXPECT_EQ(*handles[i], std::to_string(keys[i]));
+        else if (keys[i] % 2 == 0)
+            EXPECT_EQ(*handles[i], "loaded");
+        else
+            EXPECT_EQ(handles[i], nullptr);
+    }
+    EXPECT_TRUE(cache.Contains(12));
+    EXPECT_FALSE(cache.Contains(13));
+    CacheStats stats = cache.GetStats();
+    EXPECT_EQ(stats.hits, 10u);
+    EXPECT_EQ(stats.misses, 11u);
+}
+
+TEST(ShardedCacheTest, MultiGetOrLoadSkipsStaleFill)
+{
+    // 加载期间写入方修改了分片，加载的值可能已经过期，不放入缓存
+    Cache cache(1000, 0);
+    const int key = 1;
+    const int *ptr = &key;
+    PinnedHandle<int, std::string> handle;
+    cache.MultiGetOrLoad(&ptr, 1, &handle, [&](const int *const *, size_t, Handle **nodes)
+                         {
+                             nodes[0] = NewNode(key, "old");
+                             cache.Remove(key); });
+    EXPECT_EQ(*handle, "old");
+    EXPECT_FALSE(cache.Contains(key));
+    handle.Release();
+
+    cache.MultiGetOrLoad(&ptr, 1, &handle, [&](const int *const *, size_t, Handle **nodes)
+                         { nodes[0] = NewNode(key, "new"); });
+    EXPECT_TRUE(cache.Contains(key));
+}
+
+TEST(ShardedCacheTest, GetOrLoadSkipsStaleFill)
+{
+    // load在分片锁外执行，期间可以访问同一分片；写入方修改过分片时加载的值不放入缓存
+    Cache cache(1000, 0);
+    PinnedHandle<int, std::string> handle = cache.GetOrLoad(1, [&]()
+                                                            {
+                                                                cache.Remove(1);
+                                                                return NewNode(1, "old"); });
+    EXPECT_EQ(*handle, "old");
+    EXPECT_FALSE(cache.Contains(1));
+    handle.Release();
+
+    EXPECT_EQ(*cache.GetOrLoad(1, [&]()
+                               { return NewNode(1, "new"); }),
+              "new");
+    EXPECT_TRUE(cache.Contains(1));
+}
+
+TEST(ShardedCacheTest, DefaultCharge)
+{
+    // 短字符串保存在对象内部，不额外计入堆内存
+    DefaultCharge<int, std::string> charge;
+    EXPECT_EQ(charge(1, "v"), sizeof(Handle));
+    EXPECT_GT(charge(1, std::string(4096, 'v')), sizeof(Handle) + 4096);
+}
+
+TEST(ShardedCacheTest, SharedBudget)
+{
+    auto budget = std::make_shared<CacheBudget>(1000);
+    {
+        Cache a(0, 2, budget);
+        Cache b(0, 0, budget);
+        for (int i = 0; i < 1000; ++i)
+        {
+            a.Insert(NewNode(i, "v", 10));
+            b.Insert(NewNode(i, "v", 10));
+            ASSERT_LE(budget->GetUsage(), 1000u + 10);
+        }
+        EXPECT_EQ(budget->GetUsage(), a.GetUsage() + b.GetUsage());
+    }
+    EXPECT_EQ(budget->GetUsage(), 0u);
+}
+
+// 用std::string_view查找std::string的key，两种索引和各淘汰策略的结果都与用std::string查找相同
+template <typename C>
+static void CheckTransparentLookup()
+{
+    C cache(1000, 2);
+    for (int i = 0; i < 100; ++i)
+    {
+        const std::string key = "key" + std::to_string(i);
+        cache.Insert(new LRUHandle<std::string, int>(key, i, KType::kTypeValue, 1));
+    }
+    for (int i = 0; i < 110; ++i)
+    {
+        const std::string key = "key" + std::to_string(i);
+        const std::string_view sv(key);
+        PinnedHandle<std::string, int> x = cache.Get(sv);
+        ASSERT_EQ(x != nullptr, i < 100) << i;
+        ASSERT_EQ(cache.Contains(sv), i < 100) << i;
+        if (i < 100)
+        {
+            EXPECT_EQ(*x, i);
+        }
+    }
+    bool loaded = false;
+    PinnedHandle<std::string, int> x = cache.GetOrLoad(std::string_view("key200"), [&]()
+                                                      {
+                                                          loaded = true;
+                                                          return new LRUHandle<std::string, int>("key200", 200, KType::kTypeValue, 1); });
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(*cache.Get(std::string("key200")), 200);
+}
+
+TEST(ShardedCacheTest, TransparentLookup)
+{
+    CheckTransparentLookup<ShardedLRUCache<std::string, int>>();
+    CheckTransparentLookup<ShardedLRUCache<std::string, int, LRUPolicy<std::string, int>,
+                                           HashTable<std::string, int>>>();
+    CheckTransparentLookup<ShardedLRUCache<std::string, int, ClockPolicy<std::string, int>>>();
+    CheckTransparentLookup<ShardedLRUCache<std::string, int, TinyLFUPolicy<std::string, int>>>();
+}
+
+// 时间只由测试推进的Env
+class ManualClockEnv : public Env
+{
+public:
+    uint64_t NowMicros() override { return now; }
+    uint64_t now = 100;
+};
+
+template <typename TestCache>
+static void CheckExpiredEntries()
+{
+    ManualClockEnv clock;
+    TestCache cache(10, 0, nullptr, &clock);
+    auto node = [](int key, uint64_t expire_at)
+    { return new Handle(key, std::to_string(key), KType::kTypeValue, 1, expire_at); };
+    // 0-4永不过期，5-9在200时过期，并且最近被访问过
+    for (int i = 0; i < 10; ++i)
+        cache.Insert(node(i, i < 5 ? 0 : 200));
+    for (int i = 5; i < 10; ++i)
+        ASSERT_EQ(cache.Get(i).expire_at(), 200u);
+
+    // 超过容量时先淘汰已经过期的条目，即使它们比其他条目更新
+    clock.now = 200;
+    for (int i = 10; i < 15; ++i)
+        cache.Insert(node(i, 0));
+    for (int i = 0; i < 15; ++i)
+        ASSERT_EQ(cache.Contains(i), i < 5 || i >= 10) << i;
+    ASSERT_EQ(cache.GetUsage(), 10u);
+
+    // 查找到过期的条目时删除它
+    ASSERT_TRUE(cache.Insert(3, "three", 1, 300));
+    ASSERT_EQ(*cache.Get(3), "three");
+    clock.now = 300;
+    ASSERT_TRUE(cache.Contains(3));
+    ASSERT_EQ(cache.Get(3), nullptr);
+    ASSERT_FALSE(cache.Contains(3));
+    ASSERT_EQ(cache.GetUsage(), 9u);
+    ASSERT_EQ(*cache.Get(4), "4");
+}
+
+TEST(ShardedCacheTest, ExpiredEntries)
+{
+    CheckExpiredEntries<Cache>();
+    CheckExpiredEntries<ShardedLRUCache<int, std::string, ClockPolicy<int, std::string>>>();
+    CheckExpiredEntries<ShardedLRUCache<int, std::string, TinyLFUPolicy<int, std::string>>>();
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
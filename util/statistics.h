@@ -0,0 +1,494 @@
+#ifndef STORAGE_KVDB_UTIL_STATISTICS_H_
+#define STORAGE_KVDB_UTIL_STATISTICS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "util/env.h"
+#include "util/perf_context.h"
+#include "util/status.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace kvdb
+{
+    // 累计计数，只增不减(Reset除外)
+    enum Ticker : uint32_t
+    {
+        kRowCacheHit = 0,
+        kRowCacheMiss,
+        // 行缓存未命中后在memtable或imm_中找到
+        kMemTableHit,
+        kMemTableMiss,
+        kBlockCacheHit,
+        kBlockCacheMiss,
+        kBlockCacheAdd,
+        // 布隆过滤器判断key不在文件中
+        kBloomFilterUseful,
+        // memtable的前缀布隆过滤器判断key的前缀不在memtable中，不查找跳表
+        kMemTablePrefixBloomUseful,
+        // 前缀扫描时文件的前缀过滤器判断前缀不在文件中，不遍历这个文件
+        kPrefixFilterUseful,
+        kBlockReadCount,
+        kBlockReadBytes,
+        // Get/MultiGet查找的key数和找到的key数
+        kKeysRead,
+        kKeysFound,
+        // Insert/Write/Remove写入的修改数
+        kKeysWritten,
+        // 写日志的组数，并发的写入合并成一组
+        kWriteGroups,
+        kWalSyncs,
+        // 写入因第0层文件过多或memtable已满而等待的总时间
+        kWriteStallNanos,
+        kMemTableFlushes,
+        kFlushBytesWritten,
+        kCompactions,
+        // flush和合并时因为已经过期而丢弃的条目数
+        kExpiredKeysDropped,
+        kTickerMax,
+    };
+
+    // 延迟分布，单位纳秒
+    enum HistogramType : uint32_t
+    {
+        kGetLatency = 0,
+        kMultiGetLatency,
+        kPutLatency,
+        kWriteBatchLatency,
+        kDeleteLatency,
+        // Scan创建迭代器并定位到起点，不包括之后的遍历
+        kScanLatency,
+        kWalSyncLatency,
+        kFlushLatency,
+        kCompactionLatency,
+        kHistogramMax,
+    };
+
+    // 瞬时值，由SetGauge设置，Table::DumpStatistics导出前更新
+    enum Gauge : uint32_t
+    {
+        kMemTableBytes = 0,
+        kImmMemTableBytes,
+        kRowCacheUsage,
+        kBlockCacheUsage,
+        kNumTableFiles,
+        kNumLevel0Files,
+        kGaugeMax,
+    };
+
+    // 文本格式中的名字，Prometheus格式把'.'换成'_'
+    inline const char *TickerName(Ticker ticker)
+    {
+        static const char *const kNames[kTickerMax] = {
+            "kvdb.row.cache.hit",
+            "kvdb.row.cache.miss",
+            "kvdb.memtable.hit",
+            "kvdb.memtable.miss",
+            "kvdb.block.cache.hit",
+            "kvdb.block.cache.miss",
+            "kvdb.block.cache.add",
+            "kvdb.bloom.filter.useful",
+            "kvdb.memtable.prefix.bloom.useful",
+            "kvdb.prefix.filter.useful",
+            "kvdb.block.read.count",
+            "kvdb.block.read.bytes",
+            "kvdb.keys.read",
+            "kvdb.keys.found",
+            "kvdb.keys.written",
+            "kvdb.write.groups",
+            "kvdb.wal.syncs",
+            "kvdb.write.stall.nanos",
+            "kvdb.memtable.flushes",
+            "kvdb.flush.bytes.written",
+            "kvdb.compactions",
+            "kvdb.expired.keys.dropped",
+        };
+        return ticker < kTickerMax ? kNames[ticker] : "unknown";
+    }
+
+    inline const char *HistogramName(HistogramType type)
+    {
+        static const char *const kNames[kHistogramMax] = {
+            "kvdb.get.latency",
+            "kvdb.multiget.latency",
+            "kvdb.put.latency",
+            "kvdb.write.batch.latency",
+            "kvdb.delete.latency",
+            "kvdb.scan.latency",
+            "kvdb.wal.sync.latency",
+            "kvdb.flush.latency",
+            "kvdb.compaction.latency",
+        };
+        return type < kHistogramMax ? kNames[type] : "unknown";
+    }
+
+    inline const char *GaugeName(Gauge gauge)
+    {
+        static const char *const kNames[kGaugeMax] = {
+            "kvdb.memtable.bytes",
+            "kvdb.imm.memtable.bytes",
+            "kvdb.row.cache.usage.bytes",
+            "kvdb.block.cache.usage.bytes",
+            "kvdb.table.files",
+            "kvdb.level0.files",
+        };
+        return gauge < kGaugeMax ? kNames[gauge] : "unknown";
+    }
+
+    // 延迟分布的一个快照
+    struct HistogramData
+    {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        double median = 0;
+        double p95 = 0;
+        double p99 = 0;
+        double p999 = 0;
+
+        double Average() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+    };
+
+    // 记录到什么程度
+    enum class StatsLevel : uint8_t
+    {
+        // 只记录计数，不读时钟，没有延迟分布
+        kExceptTimers,
+        kAll,
+    };
+
+    // 一个或多个Table共用的运行统计：计数、延迟分布和瞬时值。
+    // 每个CPU核心一组计数，写入时按当前线程所在的核心选择，不同核心上的线程不会争用同一个缓存行；
+    // 读取时把所有核心的计数加起来。延迟按2的幂分段，每段再等分成4个桶，相对误差不超过25%
+    class Statistics
+    {
+    public:
+        // 前4个桶各对应一个值(0..3纳秒)，之后每个2的幂[2^e, 2^(e+1))分成4个桶。
+        // 不小于2^kMaxExponent纳秒(约18分钟)的值计入最后一个桶
+        static const int kMaxExponent = 40;
+        static const int kNumBuckets = 4 * (kMaxExponent - 1) + 1;
+
+        enum Format
+        {
+            // 每行一项，计数为"name COUNT : n"，延迟分布为"name P50 : x P95 : x ... COUNT : n SUM : n"
+            kText,
+            // Prometheus的text exposition格式，计数为counter，延迟分布为以秒为单位的summary
+            kPrometheus,
+        };
+
+        Statistics() : num_cores_(NumCores()), cores_(new CoreData[num_cores_]), level_(StatsLevel::kAll)
+        {
+            for (uint32_t i = 0; i < kGaugeMax; i++)
+                gauges_[i].store(0, std::memory_order_relaxed);
+            Reset();
+        }
+
+        Statistics(const Statistics &) = delete;
+        Statistics &operator=(const Statistics &) = delete;
+
+        StatsLevel stats_level() const { return level_.load(std::memory_order_relaxed); }
+        void set_stats_level(StatsLevel level) { level_.store(level, std::memory_order_relaxed); }
+
+        void RecordTick(Ticker ticker, uint64_t n = 1)
+        {
+            Local()->tickers[ticker].fetch_add(n, std::memory_order_relaxed);
+        }
+
+        void MeasureTime(HistogramType type, uint64_t nanos)
+        {
+            HistogramCounts &h = Local()->histograms[type];
+            h.count.fetch_add(1, std::memory_order_relaxed);
+            h.sum.fetch_add(nanos, std::memory_order_relaxed);
+            h.buckets[BucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+            uint64_t old = h.min.load(std::memory_order_relaxed);
+            while (nanos < old && !h.min.compare_exchange_weak(old, nanos, std::memory_order_relaxed))
+            {
+            }
+            old = h.max.load(std::memory_order_relaxed);
+            while (nanos > old && !h.max.compare_exchange_weak(old, nanos, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void SetGauge(Gauge gauge, int64_t value) { gauges_[gauge].store(value, std::memory_order_relaxed); }
+
+        uint64_t GetTickerCount(Ticker ticker) const
+        {
+            uint64_t n = 0;
+            for (size_t i = 0; i < num_cores_; i++)
+                n += cores_[i].tickers[ticker].load(std::memory_order_relaxed);
+            return n;
+        }
+
+        int64_t GetGauge(Gauge gauge) const { return gauges_[gauge].load(std::memory_order_relaxed); }
+
+        HistogramData GetHistogramData(HistogramType type) const
+        {
+            HistogramData data;
+            uint64_t buckets[kNumBuckets] = {0};
+            uint64_t min = UINT64_MAX;
+            for (size_t i = 0; i < num_cores_; i++)
+            {
+                const HistogramCounts &h = cores_[i].histograms[type];
+                data.count += h.count.load(std::memory_order_relaxed);
+                data.sum += h.sum.load(std::memory_order_relaxed);
+                min = std::min(min, h.min.load(std::memory_order_relaxed));
+                data.max = std::max(data.max, h.max.load(std::memory_order_relaxed));
+                for (int b = 0; b < kNumBuckets; b++)
+                    buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+            }
+            data.min = data.count == 0 ? 0 : min;
+            data.median = Percentile(buckets, data, 50);
+            data.p95 = Percentile(buckets, data, 95);
+            data.p99 = Percentile(buckets, data, 99);
+            data.p999 = Percentile(buckets, data, 99.9);
+            return data;
+        }
+
+        // 计数和延迟分布清零，瞬时值不变。与并发的写入之间没有同步，清零期间的记录可能部分丢失
+        void Reset()
+        {
+            for (size_t i = 0; i < num_cores_; i++)
+            {
+                CoreData &core = cores_[i];
+                for (uint32_t t = 0; t < kTickerMax; t++)
+                    core.tickers[t].store(0, std::memory_order_relaxed);
+                for (uint32_t type = 0; type < kHistogramMax; type++)
+                {
+                    HistogramCounts &h = core.histograms[type];
+                    h.count.store(0, std::memory_order_relaxed);
+                    h.sum.store(0, std::memory_order_relaxed);
+                    h.min.store(UINT64_MAX, std::memory_order_relaxed);
+                    h.max.store(0, std::memory_order_relaxed);
+                    for (int b = 0; b < kNumBuckets; b++)
+                        h.buckets[b].store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::string ToString() const
+        {
+            std::string result;
+            char buf[256];
+            for (uint32_t t = 0; t < kTickerMax; t++)
+            {
+                std::snprintf(buf, sizeof(buf), "%s COUNT : %llu\n", TickerName(static_cast<Ticker>(t)),
+                              static_cast<unsigned long long>(GetTickerCount(static_cast<Ticker>(t))));
+                result += buf;
+            }
+            for (uint32_t type = 0; type < kHistogramMax; type++)
+            {
+                const HistogramData h = GetHistogramData(static_cast<HistogramType>(type));
+                std::snprintf(buf, sizeof(buf),
+                              "%s.nanos P50 : %.1f P95 : %.1f P99 : %.1f P99.9 : %.1f MAX : %llu COUNT : %llu "
+                              "SUM : %llu\n",
+                              HistogramName(static_cast<HistogramType>(type)), h.median, h.p95, h.p99, h.p999,
+                              static_cast<unsigned long long>(h.max), static_cast<unsigned long long>(h.count),
+                              static_cast<unsigned long long>(h.sum));
+                result += buf;
+            }
+            for (uint32_t g = 0; g < kGaugeMax; g++)
+            {
+                std::snprintf(buf, sizeof(buf), "%s : %lld\n", GaugeName(static_cast<Gauge>(g)),
+                              static_cast<long long>(GetGauge(static_cast<Gauge>(g))));
+                result += buf;
+            }
+            return result;
+        }
+
+        std::string ToPrometheus() const
+        {
+            std::string result;
+            char buf[256];
+            for (uint32_t t = 0; t < kTickerMax; t++)
+            {
+                const std::string name = PrometheusName(TickerName(static_cast<Ticker>(t))) + "_total";
+                std::snprintf(buf, sizeof(buf), "# TYPE %s counter\n%s %llu\n", name.c_str(), name.c_str(),
+                              static_cast<unsigned long long>(GetTickerCount(static_cast<Ticker>(t))));
+                result += buf;
+            }
+            for (uint32_t type = 0; type < kHistogramMax; type++)
+            {
+                const HistogramData h = GetHistogramData(static_cast<HistogramType>(type));
+                const std::string name = PrometheusName(HistogramName(static_cast<HistogramType>(type))) + "_seconds";
+                std::snprintf(buf, sizeof(buf), "# TYPE %s summary\n", name.c_str());
+                result += buf;
+                const std::pair<const char *, double> quantiles[] = {
+                    {"0.5", h.median}, {"0.95", h.p95}, {"0.99", h.p99}, {"0.999", h.p999}};
+                for (const auto &q : quantiles)
+                {
+                    std::snprintf(buf, sizeof(buf), "%s{quantile=\"%s\"} %.9g\n", name.c_str(), q.first,
+                                  q.second / 1e9);
+                    result += buf;
+                }
+                std::snprintf(buf, sizeof(buf), "%s_sum %.9g\n%s_count %llu\n", name.c_str(), h.sum / 1e9,
+                              name.c_str(), static_cast<unsigned long long>(h.count));
+                result += buf;
+            }
+            for (uint32_t g = 0; g < kGaugeMax; g++)
+            {
+                const std::string name = PrometheusName(GaugeName(static_cast<Gauge>(g)));
+                std::snprintf(buf, sizeof(buf), "# TYPE %s gauge\n%s %lld\n", name.c_str(), name.c_str(),
+                              static_cast<long long>(GetGauge(static_cast<Gauge>(g))));
+                result += buf;
+            }
+            return result;
+        }
+
+        // 先写入fname.tmp再重命名为fname，定期导出时读取方(如node_exporter的textfile collector)
+        // 不会读到写了一半的文件
+        Status DumpTo(Env *env, const std::string &fname, Format format) const
+        {
+            const std::string tmp = fname + ".tmp";
+            Status s = WriteStringToFile(env, format == kPrometheus ? ToPrometheus() : ToString(), tmp, false);
+            if (s.ok())
+                s = env->RenameFile(tmp, fname);
+            if (!s.ok())
+                env->RemoveFile(tmp);
+            return s;
+        }
+
+        // 值为nanos的桶
+        static int BucketIndex(uint64_t nanos)
+        {
+            if (nanos < 4)
+                return static_cast<int>(nanos);
+            const int e = 63 - __builtin_clzll(nanos);
+            if (e >= kMaxExponent)
+                return kNumBuckets - 1;
+            return 4 * (e - 1) + static_cast<int>((nanos >> (e - 2)) & 3);
+        }
+
+        // 第index个桶的值的范围[*lower, *upper)
+        static void BucketRange(int index, uint64_t *lower, uint64_t *upper)
+        {
+            if (index < 4)
+            {
+                *lower = index;
+                *upper = index + 1;
+                return;
+            }
+            const int e = index / 4 + 1;
+            const uint64_t sub = index % 4;
+            *lower = (4 + sub) << (e - 2);
+            *upper = (5 + sub) << (e - 2);
+        }
+
+    private:
+        struct HistogramCounts
+        {
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> sum;
+            std::atomic<uint64_t> min;
+            std::atomic<uint64_t> max;
+            std::atomic<uint64_t> buckets[kNumBuckets];
+        };
+
+        // 一个核心上的计数，独占缓存行
+        struct alignas(64) CoreData
+        {
+            std::atomic<uint64_t> tickers[kTickerMax];
+            HistogramCounts histograms[kHistogramMax];
+        };
+
+        // 不小于CPU核心数的2的幂
+        static size_t NumCores()
+        {
+            size_t n = 1;
+            while (n < std::thread::hardware_concurrency())
+                n <<= 1;
+            return n;
+        }
+
+        CoreData *Local() const
+        {
+#ifdef __linux__
+            const int cpu = sched_getcpu();
+            if (cpu >= 0)
+                return &cores_[static_cast<size_t>(cpu) & (num_cores_ - 1)];
+#endif
+            // 取不到当前核心时按线程分散
+            static thread_local const size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id());
+            return &cores_[slot & (num_cores_ - 1)];
+        }
+
+        // p分位数，在所在的桶内按线性插值，结果限制在[min, max]内
+        static double Percentile(const uint64_t *buckets, const HistogramData &data, double p)
+        {
+            if (data.count == 0)
+                return 0;
+            const double threshold = data.count * (p / 100.0);
+            uint64_t cumulative = 0;
+            for (int b = 0; b < kNumBuckets; b++)
+            {
+                if (buckets[b] == 0)
+                    continue;
+                cumulative += buckets[b];
+                if (cumulative >= threshold)
+                {
+                    uint64_t lower, upper;
+                    BucketRange(b, &lower, &upper);
+                    const double before = static_cast<double>(cumulative - buckets[b]);
+                    double r = lower + (upper - lower) * (threshold - before) / buckets[b];
+                    r = std::max(r, static_cast<double>(data.min));
+                    return std::min(r, static_cast<double>(data.max));
+                }
+            }
+            return static_cast<double>(data.max);
+        }
+
+        static std::string PrometheusName(const char *name)
+        {
+            std::string result(name);
+            std::replace(result.begin(), result.end(), '.', '_');
+            return result;
+        }
+
+        const size_t num_cores_;
+        const std::unique_ptr<CoreData[]> cores_;
+        std::atomic<int64_t> gauges_[kGaugeMax];
+        std::atomic<StatsLevel> level_;
+    };
+
+    // stats不为nullptr时计数
+    inline void RecordTick(Statistics *stats, Ticker ticker, uint64_t n = 1)
+    {
+        if (stats != nullptr)
+            stats->RecordTick(ticker, n);
+    }
+
+    // 作用域内的耗时计入stats的延迟分布，stats为nullptr或级别为kExceptTimers时不读时钟
+    class StatsTimer
+    {
+    public:
+        StatsTimer(Statistics *stats, HistogramType type)
+            : stats_(stats != nullptr && stats->stats_level() == StatsLevel::kAll ? stats : nullptr), type_(type),
+              start_(stats_ != nullptr ? perf::NowNanos() : 0) {}
+
+        StatsTimer(const StatsTimer &) = delete;
+        StatsTimer &operator=(const StatsTimer &) = delete;
+
+        ~StatsTimer()
+        {
+            if (stats_ != nullptr)
+                stats_->MeasureTime(type_, perf::NowNanos() - start_);
+        }
+
+    private:
+        Statistics *const stats_;
+        const HistogramType type_;
+        const uint64_t start_;
+    };
+}
+
+#endif
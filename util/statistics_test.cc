@@ -0,0 +1,202 @@
+#include "util/statistics.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "util/env.h"
+#include "util/random.h"
+using namespace kvdb;
+
+TEST(StatisticsTest, Buckets)
+{
+    Random rnd(301);
+    int last = -1;
+    for (uint64_t v = 0; v < 100000; v++)
+    {
+        const int index = Statistics::BucketIndex(v);
+        ASSERT_GE(index, last);
+        last = index;
+        uint64_t lower, upper;
+        Statistics::BucketRange(index, &lower, &upper);
+        ASSERT_LE(lower, v);
+        ASSERT_LT(v, upper);
+    }
+    for (int i = 0; i < 10000; i++)
+    {
+        const uint64_t v = (static_cast<uint64_t>(rnd.Next()) << rnd.Uniform(10)) + rnd.Uniform(100);
+        const int index = Statistics::BucketIndex(v);
+        ASSERT_LT(index, Statistics::kNumBuckets);
+        uint64_t lower, upper;
+        Statistics::BucketRange(index, &lower, &upper);
+        ASSERT_LE(lower, v);
+        ASSERT_LT(v, upper);
+        // 每个桶的宽度不超过下界的1/4
+        ASSERT_LE((upper - lower) * 4, std::max<uint64_t>(lower, 4));
+    }
+    ASSERT_EQ(Statistics::BucketIndex(UINT64_MAX), Statistics::kNumBuckets - 1);
+}
+
+TEST(StatisticsTest, ConcurrentTickers)
+{
+    Statistics stats;
+    const int kThreads = 8;
+    const int kOps = 100000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++)
+    {
+        threads.emplace_back([&stats, t]()
+                             {
+                                 for (int i = 0; i < kOps; i++)
+                                 {
+                                     stats.RecordTick(kKeysRead);
+                                     stats.RecordTick(kBlockReadBytes, 3);
+                                     stats.MeasureTime(kGetLatency, 1000 + t);
+                                 } });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    ASSERT_EQ(stats.GetTickerCount(kKeysRead), uint64_t(kThreads) * kOps);
+    ASSERT_EQ(stats.GetTickerCount(kBlockReadBytes), uint64_t(kThreads) * kOps * 3);
+    ASSERT_EQ(stats.GetTickerCount(kKeysFound), 0u);
+    HistogramData h = stats.GetHistogramData(kGetLatency);
+    ASSERT_EQ(h.count, uint64_t(kThreads) * kOps);
+    ASSERT_EQ(h.min, 1000u);
+    ASSERT_EQ(h.max, 1000u + kThreads - 1);
+
+    stats.Reset();
+    ASSERT_EQ(stats.GetTickerCount(kKeysRead), 0u);
+    ASSERT_EQ(stats.GetHistogramData(kGetLatency).count, 0u);
+}
+
+TEST(StatisticsTest, Percentiles)
+{
+    Statistics stats;
+    for (uint64_t v = 1; v <= 10000; v++)
+        stats.MeasureTime(kPutLatency, v);
+    // 少量很慢的操作只影响尾部
+    for (int i = 0; i < 20; i++)
+        stats.MeasureTime(kPutLatency, 5000000);
+    HistogramData h = stats.GetHistogramData(kPutLatency);
+    ASSERT_EQ(h.count, 10020u);
+    ASSERT_EQ(h.min, 1u);
+    ASSERT_EQ(h.max, 5000000u);
+    ASSERT_NEAR(h.median, 5000, 5000 * 0.25);
+    ASSERT_NEAR(h.p95, 9500, 9500 * 0.25);
+    ASSERT_LE(h.p99, 10000 * 1.25);
+    ASSERT_GE(h.p999, 5000000 * 0.75);
+    ASSERT_NEAR(h.Average(), (10000.0 * 10001 / 2 + 20 * 5000000.0) / 10020, 1);
+
+    HistogramData empty = stats.GetHistogramData(kScanLatency);
+    ASSERT_EQ(empty.count, 0u);
+    ASSERT_EQ(empty.p99, 0);
+}
+
+TEST(StatisticsTest, Dump)
+{
+    Statistics stats;
+    stats.RecordTick(kRowCacheHit, 7);
+    stats.MeasureTime(kGetLatency, 2000);
+    stats.SetGauge(kMemTableBytes, 4096);
+
+    const std::string text = stats.ToString();
+    ASSERT_NE(text.find("kvdb.row.cache.hit COUNT : 7\n"), std::string::npos);
+    ASSERT_NE(text.find("kvdb.get.latency.nanos P50 : "), std::string::npos);
+    ASSERT_NE(text.find("kvdb.memtable.bytes : 4096\n"), std::string::npos);
+
+    const std::string prom = stats.ToPrometheus();
+    ASSERT_NE(prom.find("# TYPE kvdb_row_cache_hit_total counter\nkvdb_row_cache_hit_total 7\n"), std::string::npos);
+    ASSERT_NE(prom.find("# TYPE kvdb_get_latency_seconds summary\n"), std::string::npos);
+    ASSERT_NE(prom.find("kvdb_get_latency_seconds{quantile=\"0.99\"} 2e-06\n"), std::string::npos);
+    ASSERT_NE(prom.find("kvdb_get_latency_seconds_count 1\n"), std::string::npos);
+    ASSERT_NE(prom.find("# TYPE kvdb_memtable_bytes gauge\nkvdb_memtable_bytes 4096\n"), std::string::npos);
+
+    Env *env = Env::Default();
+    const std::string fname = testing::TempDir() + "kvdb_statistics.prom";
+    ASSERT_TRUE(stats.DumpTo(env, fname, Statistics::kPrometheus).ok());
+    std::string contents;
+    ASSERT_TRUE(ReadFileToString(env, fname, &contents).ok());
+    ASSERT_EQ(contents, prom);
+    ASSERT_FALSE(env->FileExists(fname + ".tmp"));
+    ASSERT_TRUE(stats.DumpTo(env, fname, Statistics::kText).ok());
+    ASSERT_TRUE(ReadFileToString(env, fname, &contents).ok());
+    ASSERT_EQ(contents, stats.ToString());
+    env->RemoveFile(fname);
+}
+
+TEST(StatisticsTest, StatsLevel)
+{
+    Statistics stats;
+    {
+        StatsTimer timer(&stats, kDeleteLatency);
+    }
+    ASSERT_EQ(stats.GetHistogramData(kDeleteLatency).count, 1u);
+    stats.set_stats_level(StatsLevel::kExceptTimers);
+    {
+        StatsTimer timer(&stats, kDeleteLatency);
+        StatsTimer none(nullptr, kDeleteLatency);
+    }
+    ASSERT_EQ(stats.GetHistogramData(kDeleteLatency).count, 1u);
+    RecordTick(&stats, kWalSyncs);
+    RecordTick(nullptr, kWalSyncs);
+    ASSERT_EQ(stats.GetTickerCount(kWalSyncs), 1u);
+}
+
+TEST(StatisticsTest, PerfContextLevels)
+{
+    GetPerfContext()->Reset();
+    SetPerfLevel(PerfLevel::kDisable);
+    PerfCount(&PerfContext::block_read_count);
+    {
+        PerfTimer timer(&PerfContext::block_read_nanos);
+    }
+    ASSERT_EQ(GetPerfContext()->block_read_count, 0u);
+    ASSERT_EQ(GetPerfContext()->ToString(), "");
+
+    // 只计数时不计时
+    SetPerfLevel(PerfLevel::kEnableCount);
+    PerfCount(&PerfContext::block_read_count);
+    PerfCount(&PerfContext::block_read_bytes, 4096);
+    {
+        PerfTimer timer(&PerfContext::block_read_nanos);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(GetPerfContext()->block_read_count, 1u);
+    ASSERT_EQ(GetPerfContext()->block_read_bytes, 4096u);
+    ASSERT_EQ(GetPerfContext()->block_read_nanos, 0u);
+
+    SetPerfLevel(PerfLevel::kEnableTime);
+    {
+        PerfTimer timer(&PerfContext::block_read_nanos);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        timer.Stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    ASSERT_GE(GetPerfContext()->block_read_nanos, 1000000u);
+    ASSERT_LT(GetPerfContext()->block_read_nanos, 20000000u);
+    const std::string text = GetPerfContext()->ToString();
+    ASSERT_NE(text.find("block_read_count = 1\n"), std::string::npos);
+    ASSERT_EQ(text.find("key_comparisons"), std::string::npos);
+    ASSERT_NE(GetPerfContext()->ToString(false).find("key_comparisons = 0\n"), std::string::npos);
+
+    // 每个线程有自己的级别和计数
+    std::thread other([]()
+                      {
+                          ASSERT_EQ(GetPerfLevel(), PerfLevel::kDisable);
+                          ASSERT_EQ(GetPerfContext()->block_read_count, 0u);
+                          SetPerfLevel(PerfLevel::kEnableCount);
+                          PerfCount(&PerfContext::block_read_count, 5); });
+    other.join();
+    ASSERT_EQ(GetPerfContext()->block_read_count, 1u);
+
+    GetPerfContext()->Reset();
+    ASSERT_EQ(GetPerfContext()->block_read_nanos, 0u);
+    SetPerfLevel(PerfLevel::kDisable);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
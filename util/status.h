@@ -0,0 +1,83 @@
+#ifndef STORAGE_KVDB_UTIL_STATUS_H_
+#define STORAGE_KVDB_UTIL_STATUS_H_
+
+#include <string>
+#include "util/slice.h"
+
+namespace kvdb
+{
+    // 底层IO接口的返回值，成功时不分配内存
+    class Status
+    {
+    public:
+        Status() : code_(kOk) {}
+
+        static Status OK() { return Status(); }
+        static Status NotFound(const Slice &msg, const Slice &msg2 = Slice()) { return Status(kNotFound, msg, msg2); }
+        static Status Corruption(const Slice &msg, const Slice &msg2 = Slice()) { return Status(kCorruption, msg, msg2); }
+        static Status NotSupported(const Slice &msg, const Slice &msg2 = Slice()) { return Status(kNotSupported, msg, msg2); }
+        static Status InvalidArgument(const Slice &msg, const Slice &msg2 = Slice()) { return Status(kInvalidArgument, msg, msg2); }
+        static Status IOError(const Slice &msg, const Slice &msg2 = Slice()) { return Status(kIOError, msg, msg2); }
+
+        bool ok() const { return code_ == kOk; }
+        bool IsNotFound() const { return code_ == kNotFound; }
+        bool IsCorruption() const { return code_ == kCorruption; }
+        bool IsIOError() const { return code_ == kIOError; }
+        bool IsNotSupported() const { return code_ == kNotSupported; }
+        bool IsInvalidArgument() const { return code_ == kInvalidArgument; }
+
+        std::string ToString() const
+        {
+            const char *type;
+            switch (code_)
+            {
+            case kOk:
+                return "OK";
+            case kNotFound:
+                type = "NotFound: ";
+                break;
+            case kCorruption:
+                type = "Corruption: ";
+                break;
+            case kNotSupported:
+                type = "Not implemented: ";
+                break;
+            case kInvalidArgument:
+                type = "Invalid argument: ";
+                break;
+            case kIOError:
+                type = "IO error: ";
+                break;
+            default:
+                type = "Unknown code: ";
+                break;
+            }
+            return type + msg_;
+        }
+
+    private:
+        enum Code
+        {
+            kOk = 0,
+            kNotFound = 1,
+            kCorruption = 2,
+            kNotSupported = 3,
+            kInvalidArgument = 4,
+            kIOError = 5
+        };
+
+        Status(Code code, const Slice &msg, const Slice &msg2) : code_(code), msg_(msg.ToString())
+        {
+            if (!msg2.empty())
+            {
+                msg_.append(": ");
+                msg_.append(msg2.data(), msg2.size());
+            }
+        }
+
+        Code code_;
+        std::string msg_;
+    };
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef STORAGE_KVDB_UTIL_SWISS_TABLE_H_
+#define STORAGE_KVDB_UTIL_SWISS_TABLE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "util/hash.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace kvdb
+{
+    namespace cache
+    {
+        // 开放寻址的哈希索引，布局参考Abseil的SwissTable。
+        // 槽位数为2的幂，每个槽位对应1字节的控制字节：空为kEmpty，已删除为kDeleted，
+        // 有节点时为hash的低7位(H2)。查找时按16个槽位一组，用SSE2一次比较整组的控制字节，
+        // 只对H2相同的槽位比较key，遇到含有空槽位的组即可停止。
+        // 只保存Node指针，不拥有节点；Node需要有名为key的成员
+        template <typename K, typename Node>
+        class SwissTable
+        {
+        public:
+            SwissTable() : ctrl_(nullptr), slots_(nullptr), capacity_(0), size_(0)
+            {
+                Resize(kGroupWidth);
+            }
+            ~SwissTable()
+            {
+                delete[] ctrl_;
+                delete[] slots_;
+            }
+            SwissTable(const SwissTable &) = delete;
+            SwissTable &operator=(const SwissTable &) = delete;
+
+            // return nullptr if key is not find in table。
+            // 查找时Q为K，或者IsTransparentKey<K, Q>成立的类型，如K为std::string时的std::string_view
+            template <typename Q>
+            Node *Find(const Q &key) const { return Find(key, Hash(key)); }
+            // hash必须等于Hash(key)
+            template <typename Q>
+            Node *Find(const Q &key, size_t hash) const
+            {
+                size_t slot;
+                return FindSlot(key, hash, &slot) ? slots_[slot] : nullptr;
+            }
+
+            template <typename Q>
+            size_t Hash(const Q &key) const { return static_cast<size_t>(Mix64(hasher_(key))); }
+
+            // 预取key的起始组的控制字节和槽位，批量查找时先对所有key预取，再逐个Find
+            void Prefetch(size_t hash) const
+            {
+                const size_t base = (H1(hash) & group_mask_) * kGroupWidth;
+                __builtin_prefetch(ctrl_ + base);
+                __builtin_prefetch(slots_ + base);
+            }
+
+            // 返回被替换的同key节点，没有时返回nullptr
+            Node *Insert(Node *x)
+            {
+                const size_t hash = Hash(x->key);
+                size_t slot;
+                if (FindSlot(x->key, hash, &slot))
+                {
+                    Node *old = slots_[slot];
+                    slots_[slot] = x;
+                    return old;
+                }
+
+                if (growth_left_ == 0)
+                    Rehash();
+                slot = FindInsertSlot(hash);
+                if (ctrl_[slot] == kEmpty)
+                    --growth_left_;
+                ctrl_[slot] = H2(hash);
+                slots_[slot] = x;
+                ++size_;
+                return nullptr;
+            }
+
+            Node *Remove(const K &key)
+            {
+                size_t slot;
+                if (!FindSlot(key, Hash(key), &slot))
+                    return nullptr;
+                Node *result = slots_[slot];
+                // 一个组满过之后不会再出现空槽位，所以组内仍有空槽位说明没有探测序列越过这个组，
+                // 可以直接置空；否则留下删除标记，让越过这个组的查找继续向后探测
+                if (Group(ctrl_ + slot / kGroupWidth * kGroupWidth).MatchEmpty() != 0)
+                {
+                    ctrl_[slot] = kEmpty;
+                    ++growth_left_;
+                }
+                else
+                {
+                    ctrl_[slot] = kDeleted;
+                }
+                slots_[slot] = nullptr;
+                --size_;
+                return result;
+            }
+
+            size_t Size() const { return size_; }
+            size_t Capacity() const { return capacity_; }
+
+        private:
+            static constexpr size_t kGroupWidth = 16;
+            // 空和已删除的最高位为1，有节点的控制字节在[0, 127]内
+            static constexpr int8_t kEmpty = -128;
+            static constexpr int8_t kDeleted = -2;
+
+            // 一组16个控制字节。Match*返回的掩码第i位对应组内第i个槽位
+            struct Group
+            {
+#if defined(__SSE2__)
+                explicit Group(const int8_t *p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+
+                uint32_t Match(int8_t h2) const
+                {
+                    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+                }
+                uint32_t MatchEmpty() const { return Match(kEmpty); }
+                uint32_t MatchEmptyOrDeleted() const { return static_cast<uint32_t>(_mm_movemask_epi8(ctrl)); }
+
+                __m128i ctrl;
+#else
+                explicit Group(const int8_t *p) { std::memcpy(ctrl, p, kGroupWidth); }
+
+                uint32_t Match(int8_t h2) const
+                {
+                    uint32_t mask = 0;
+                    for (size_t i = 0; i < kGroupWidth; ++i)
+                        mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+                    return mask;
+                }
+                uint32_t MatchEmpty() const { return Match(kEmpty); }
+                uint32_t MatchEmptyOrDeleted() const
+                {
+                    uint32_t mask = 0;
+                    for (size_t i = 0; i < kGroupWidth; ++i)
+                        mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+                    return mask;
+                }
+
+                int8_t ctrl[kGroupWidth];
+#endif
+            };
+
+            // H1选择起始组，H2存入控制字节
+            static size_t H1(size_t hash) { return hash >> 7; }
+            static int8_t H2(size_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+            // 三角数探测：第i次向后跳i个组，组数为2的幂时会遍历所有的组。
+            // 负载上限保证至少有一个空槽位，探测总会结束
+            template <typename Q>
+            bool FindSlot(const Q &key, size_t hash, size_t *slot) const
+            {
+                const int8_t h2 = H2(hash);
+                size_t group = H1(hash) & group_mask_;
+                for (size_t i = 1;; ++i)
+                {
+                    const size_t base = group * kGroupWidth;
+                    Group g(ctrl_ + base);
+                    for (uint32_t match = g.Match(h2); match != 0; match &= match - 1)
+                    {
+                        const size_t s = base + __builtin_ctz(match);
+                        if (slots_[s]->key == key)
+                        {
+                            *slot = s;
+                            return true;
+                        }
+                    }
+                    if (g.MatchEmpty() != 0)
+                        return false;
+                    group = (group + i) & group_mask_;
+                }
+            }
+
+            // 探测序列上第一个空或已删除的槽位
+            size_t FindInsertSlot(size_t hash) const
+            {
+                size_t group = H1(hash) & group_mask_;
+                for (size_t i = 1;; ++i)
+                {
+                    uint32_t match = Group(ctrl_ + group * kGroupWidth).MatchEmptyOrDeleted();
+                    if (match != 0)
+                        return group * kGroupWidth + __builtin_ctz(match);
+                    group = (group + i) & group_mask_;
+                }
+            }
+
+            // 没有可用的空槽位时调用。删除标记不少于有效节点时原地重建以清除删除标记，否则扩容一倍
+            void Rehash()
+            {
+                Resize(size_ * 16 <= capacity_ * 7 ? capacity_ : capacity_ * 2);
+            }
+
+            void Resize(size_t new_capacity)
+            {
+                assert(new_capacity % kGroupWidth == 0 && (new_capacity & (new_capacity - 1)) == 0);
+                int8_t *old_ctrl = ctrl_;
+                Node **old_slots = slots_;
+                const size_t old_capacity = capacity_;
+
+                ctrl_ = new int8_t[new_capacity];
+                std::memset(ctrl_, kEmpty, new_capacity);
+                slots_ = new Node *[new_capacity]();
+                capacity_ = new_capacity;
+                group_mask_ = new_capacity / kGroupWidth - 1;
+                // 负载上限7/8
+                growth_left_ = new_capacity - new_capacity / 8 - size_;
+
+                for (size_t i = 0; i < old_capacity; ++i)
+                {
+                    if (old_ctrl[i] >= 0)
+                    {
+                        const size_t hash = Hash(old_slots[i]->key);
+                        const size_t s = FindInsertSlot(hash);
+                        ctrl_[s] = H2(hash);
+                        slots_[s] = old_slots[i];
+                    }
+                }
+                delete[] old_ctrl;
+                delete[] old_slots;
+            }
+
+            int8_t *ctrl_;
+            Node **slots_;
+            size_t capacity_;
+            size_t group_mask_;
+            size_t size_;
+            // 还能占用的空槽位数，用完时Rehash
+            size_t growth_left_;
+            TransparentHash<K> hasher_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "util/swiss_table.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "util/random.h"
+using namespace kvdb;
+using namespace kvdb::cache;
+
+template <typename K>
+struct TestNode
+{
+    explicit TestNode(const K &k) : key(k) {}
+    K key;
+};
+
+typedef TestNode<int> IntNode;
+
+TEST(SwissTableTest, Empty)
+{
+    SwissTable<int, IntNode> table;
+    EXPECT_EQ(table.Find(1), nullptr);
+    EXPECT_EQ(table.Remove(1), nullptr);
+    EXPECT_EQ(table.Size(), 0u);
+}
+
+TEST(SwissTableTest, InsertReplaceRemove)
+{
+    SwissTable<std::string, TestNode<std::string>> table;
+    TestNode<std::string> a("a"), a2("a"), b("b");
+    EXPECT_EQ(table.Insert(&a), nullptr);
+    EXPECT_EQ(table.Insert(&b), nullptr);
+    EXPECT_EQ(table.Find("a"), &a);
+
+    // 同key替换时返回旧节点
+    EXPECT_EQ(table.Insert(&a2), &a);
+    EXPECT_EQ(table.Find("a"), &a2);
+    EXPECT_EQ(table.Size(), 2u);
+
+    EXPECT_EQ(table.Remove("a"), &a2);
+    EXPECT_EQ(table.Find("a"), nullptr);
+    EXPECT_EQ(table.Find("b"), &b);
+    EXPECT_EQ(table.Size(), 1u);
+}
+
+TEST(SwissTableTest, Grow)
+{
+    const int N = 100000;
+    std::vector<IntNode> nodes;
+    nodes.reserve(N);
+    SwissTable<int, IntNode> table;
+    for (int i = 0; i < N; ++i)
+    {
+        nodes.emplace_back(i);
+        ASSERT_EQ(table.Insert(&nodes.back()), nullptr);
+    }
+    EXPECT_EQ(table.Size(), static_cast<size_t>(N));
+    // 负载不超过7/8
+    EXPECT_GE(table.Capacity() * 7 / 8, table.Size());
+    for (int i = 0; i < N; ++i)
+        ASSERT_EQ(table.Find(i), &nodes[i]) << i;
+    EXPECT_EQ(table.Find(N), nullptr);
+    EXPECT_EQ(table.Find(-1), nullptr);
+}
+
+TEST(SwissTableTest, ChurnReusesDeletedSlots)
+{
+    // 像LRU一样不断插入新key并删除最旧的key，删除标记被回收，容量不会无限增长
+    const int kLive = 1000;
+    std::vector<IntNode> nodes;
+    for (int i = 0; i < 200000; ++i)
+        nodes.emplace_back(i);
+
+    SwissTable<int, IntNode> table;
+    for (int i = 0; i < static_cast<int>(nodes.size()); ++i)
+    {
+        ASSERT_EQ(table.Insert(&nodes[i]), nullptr);
+        if (i >= kLive)
+        {
+            ASSERT_EQ(table.Remove(i - kLive), &nodes[i - kLive]);
+        }
+    }
+    EXPECT_EQ(table.Size(), static_cast<size_t>(kLive));
+    EXPECT_LE(table.Capacity(), 4096u);
+    for (int i = 0; i < static_cast<int>(nodes.size()) - kLive; ++i)
+        ASSERT_EQ(table.Find(i), nullptr) << i;
+    for (int i = static_cast<int>(nodes.size()) - kLive; i < static_cast<int>(nodes.size()); ++i)
+        ASSERT_EQ(table.Find(i), &nodes[i]) << i;
+}
+
+TEST(SwissTableTest, RandomAgainstUnorderedMap)
+{
+    const int kKeys = 5000;
+    std::vector<IntNode> nodes;
+    for (int i = 0; i < kKeys; ++i)
+        nodes.emplace_back(i);
+
+    Random rnd(301);
+    SwissTable<int, IntNode> table;
+    std::unordered_map<int, IntNode *> model;
+    for (int i = 0; i < 200000; ++i)
+    {
+        int key = rnd.Uniform(kKeys);
+        switch (rnd.Uniform(3))
+        {
+        case 0:
+        {
+            IntNode *old = model.count(key) ? model[key] : nullptr;
+            ASSERT_EQ(table.Insert(&nodes[key]), old);
+            model[key] = &nodes[key];
+            break;
+        }
+        case 1:
+        {
+            IntNode *old = model.count(key) ? model[key] : nullptr;
+            ASSERT_EQ(table.Remove(key), old);
+            model.erase(key);
+            break;
+        }
+        default:
+            ASSERT_EQ(table.Find(key), model.count(key) ? model[key] : nullptr);
+        }
+        ASSERT_EQ(table.Size(), model.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
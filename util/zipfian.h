@@ -0,0 +1,124 @@
+#ifndef STORAGE_KVDB_UTIL_ZIPFIAN_H_
+#define STORAGE_KVDB_UTIL_ZIPFIAN_H_
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include "util/random.h"
+
+namespace kvdb
+{
+    // [0, 1)内均匀分布的double，精度31位
+    inline double NextDouble(Random *rnd)
+    {
+        // Random::Next()返回[1, 2^31-2]
+        return (rnd->Next() - 1) / 2147483646.0;
+    }
+
+    // 按Zipf分布生成[0, n)内的整数，0最热门，i出现的概率正比于1/(i+1)^theta。
+    // 算法来自Gray等人的"Quickly Generating Billion-Record Synthetic Databases"，
+    // 与YCSB的ZipfianGenerator相同。n可以随调用增长，zeta(n)增量计算
+    class ZipfianGenerator
+    {
+    public:
+        // YCSB默认的偏斜程度
+        static constexpr double kDefaultTheta = 0.99;
+
+        explicit ZipfianGenerator(uint64_t n, double theta = kDefaultTheta, uint32_t seed = 301)
+            : rnd_(seed), theta_(theta), alpha_(1.0 / (1.0 - theta)), zeta2_(Zeta(0, 2, theta, 0)), n_(0), zetan_(0)
+        {
+            assert(n > 0);
+            Resize(n);
+        }
+
+        uint64_t Next() { return Next(n_); }
+
+        // n小于上次的值时重新计算zeta(n)，代价为O(n)
+        uint64_t Next(uint64_t n)
+        {
+            if (n != n_)
+                Resize(n);
+            const double u = NextDouble(&rnd_);
+            const double uz = u * zetan_;
+            if (uz < 1.0)
+                return 0;
+            if (uz < 1.0 + std::pow(0.5, theta_))
+                return 1;
+            uint64_t result = static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+            return result < n_ ? result : n_ - 1;
+        }
+
+        uint64_t n() const { return n_; }
+
+    private:
+        // sum(1/i^theta)，i取(from, to]
+        static double Zeta(uint64_t from, uint64_t to, double theta, double initial)
+        {
+            double sum = initial;
+            for (uint64_t i = from; i < to; i++)
+                sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+            return sum;
+        }
+
+        void Resize(uint64_t n)
+        {
+            assert(n > 0);
+            if (n > n_)
+                zetan_ = Zeta(n_, n, theta_, zetan_);
+            else
+                zetan_ = Zeta(0, n, theta_, 0);
+            n_ = n;
+            eta_ = (1 - std::pow(2.0 / n_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+        }
+
+        Random rnd_;
+        const double theta_;
+        const double alpha_;
+        const double zeta2_;
+        uint64_t n_;
+        double zetan_;
+        double eta_;
+    };
+
+    // 热门的key分散在整个范围内，而不是集中在最小的几个key上
+    class ScrambledZipfianGenerator
+    {
+    public:
+        explicit ScrambledZipfianGenerator(uint64_t n, double theta = ZipfianGenerator::kDefaultTheta,
+                                           uint32_t seed = 301)
+            : zipf_(n, theta, seed) {}
+
+        uint64_t Next() { return FNVHash64(zipf_.Next()) % zipf_.n(); }
+
+    private:
+        static uint64_t FNVHash64(uint64_t value)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (int i = 0; i < 8; i++)
+            {
+                hash ^= value & 0xff;
+                hash *= 0x100000001b3ull;
+                value >>= 8;
+            }
+            return hash;
+        }
+
+        ZipfianGenerator zipf_;
+    };
+
+    // 越新插入的key越热门：返回n-1-zipf(n)，n为当前已插入的key数
+    class LatestGenerator
+    {
+    public:
+        explicit LatestGenerator(uint64_t n, double theta = ZipfianGenerator::kDefaultTheta, uint32_t seed = 301)
+            : zipf_(n, theta, seed) {}
+
+        // REQUIRES: n不小于上次调用时的值
+        uint64_t Next(uint64_t n) { return n - 1 - zipf_.Next(n); }
+
+    private:
+        ZipfianGenerator zipf_;
+    };
+}
+
+#endif
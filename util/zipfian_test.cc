@@ -0,0 +1,86 @@
+#include "util/zipfian.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+using namespace kvdb;
+
+TEST(ZipfianTest, SkewedTowardsSmallValues)
+{
+    const uint64_t kN = 1000;
+    const int kSamples = 200000;
+    ZipfianGenerator zipf(kN);
+    std::vector<int> counts(kN, 0);
+    for (int i = 0; i < kSamples; i++)
+    {
+        uint64_t v = zipf.Next();
+        ASSERT_LT(v, kN);
+        counts[v]++;
+    }
+
+    // P(0)/P(1)约为2^theta
+    double ratio = static_cast<double>(counts[0]) / counts[1];
+    ASSERT_NEAR(ratio, std::pow(2.0, ZipfianGenerator::kDefaultTheta), 0.2);
+    // 前1%的值占了约40%的访问
+    int top = 0;
+    for (uint64_t i = 0; i < kN / 100; i++)
+        top += counts[i];
+    ASSERT_GT(top, kSamples * 35 / 100);
+    ASSERT_GT(counts[kN - 1], 0);
+}
+
+TEST(ZipfianTest, GrowingRange)
+{
+    ZipfianGenerator zipf(10);
+    for (uint64_t n = 10; n < 2000; n++)
+        ASSERT_LT(zipf.Next(n), n);
+    // 缩小时重新计算
+    for (int i = 0; i < 1000; i++)
+        ASSERT_LT(zipf.Next(5), 5u);
+}
+
+TEST(ZipfianTest, Scrambled)
+{
+    const uint64_t kN = 1000;
+    const int kSamples = 200000;
+    ScrambledZipfianGenerator zipf(kN);
+    std::vector<int> counts(kN, 0);
+    for (int i = 0; i < kSamples; i++)
+    {
+        uint64_t v = zipf.Next();
+        ASSERT_LT(v, kN);
+        counts[v]++;
+    }
+    // 仍然偏斜，但最热门的值不再是最小的几个
+    std::vector<int> sorted = counts;
+    std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+    int top = 0;
+    for (uint64_t i = 0; i < kN / 100; i++)
+        top += sorted[i];
+    ASSERT_GT(top, kSamples * 3 / 10);
+    ASSERT_NE(std::max_element(counts.begin(), counts.end()) - counts.begin(), 0);
+}
+
+TEST(ZipfianTest, Latest)
+{
+    LatestGenerator latest(100);
+    int newest = 0;
+    for (uint64_t n = 100; n < 10000; n++)
+    {
+        uint64_t v = latest.Next(n);
+        ASSERT_LT(v, n);
+        if (v + 10 >= n)
+            newest++;
+    }
+    // 大部分访问落在最新的几个key上
+    ASSERT_GT(newest, 9900 / 3);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}